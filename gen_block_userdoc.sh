@@ -2,7 +2,7 @@
 
 BLOCK_INDEX=docs/user/block_index.rst
 
-BLOCKS="trig ptrig \
+BLOCKS="trig ptrig rt_executor \
 	math_double \
 	rand_double \
 	ramp_double \
@@ -11,7 +11,7 @@ BLOCKS="trig ptrig \
 	luablock \
 	cconst \
 	iconst \
-        lfds_cyclic mqueue hexdump \
+        lfds_cyclic mqueue hexdump recorder fused \
 	"
 
 cat <<EOF > $BLOCK_INDEX
@@ -5,16 +5,21 @@
  */
 
 
+#define _GNU_SOURCE	/* RUSAGE_THREAD */
+
 #include <stdlib.h>
 #include <stdio.h>
 #include <limits.h>
 #include <inttypes.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
 #include "trig_utils.h"
 
 
-static const char *FILE_HDR = "block, cnt, min_us, max_us, avg_us\n";
-static const char *FILE_FMT = "%s, %" PRIu64 ", %" PRIu64 ", %" PRIu64 ", %" PRIu64 "\n";
-static const char *LOG_FMT = "TSTAT: %s: cnt %" PRIu64 ", min %" PRIu64 " us, max %" PRIu64 " us, avg %" PRIu64 " us";
+static const char *FILE_HDR = "block, cnt, min_us, max_us, avg_us, minflt, majflt, overruns\n";
+static const char *FILE_FMT = "%s, %" PRIu64 ", %" PRIu64 ", %" PRIu64 ", %" PRIu64 ", %lu, %lu, %lu\n";
+static const char *LOG_FMT = "TSTAT: %s: cnt %" PRIu64 ", min %" PRIu64 " us, max %" PRIu64 " us, avg %" PRIu64 " us, minflt %lu, majflt %lu, overruns %lu";
 static const char *TSTAT_TOTALS = "#total#";
 
 def_port_accessors(tstat, struct ubx_tstat);
@@ -39,6 +44,9 @@ void tstat_init2(struct ubx_tstat *ts, const char *block_name, const char *chain
 	ts->total.nsec = 0;
 
 	ts->cnt = 0;
+	ts->minflt = 0;
+	ts->majflt = 0;
+	ts->overruns = 0;
 }
 
 
@@ -66,6 +74,14 @@ void tstat_update(struct ubx_tstat *stats,
 	stats->cnt++;
 }
 
+void tstat_update_faults(struct ubx_tstat *stats,
+			 const struct rusage *start,
+			 const struct rusage *end)
+{
+	stats->minflt += end->ru_minflt - start->ru_minflt;
+	stats->majflt += end->ru_majflt - start->ru_majflt;
+}
+
 int tstat_fwrite(FILE *fp, struct ubx_tstat *stats)
 {
 	struct ubx_timespec avg;
@@ -77,7 +93,8 @@ int tstat_fwrite(FILE *fp, struct ubx_tstat *stats)
 			stats->id, stats->cnt,
 			ubx_ts_to_us(&stats->min),
 			ubx_ts_to_us(&stats->max),
-			ubx_ts_to_us(&avg));
+			ubx_ts_to_us(&avg),
+			stats->minflt, stats->majflt, stats->overruns);
 	} else {
 		fprintf(fp, "%s: cnt: 0 - no stats aquired\n", stats->id);
 	}
@@ -101,13 +118,16 @@ void tstat_log(const ubx_block_t *b, const struct ubx_tstat *stats)
 		 stats->id, stats->cnt,
 		 ubx_ts_to_us(&stats->min),
 		 ubx_ts_to_us(&stats->max),
-		 ubx_ts_to_us(&avg));
+		 ubx_ts_to_us(&avg),
+		 stats->minflt, stats->majflt, stats->overruns);
 }
 
 /*
  * chain API
  */
 
+static void chain_mon_unregister(struct ubx_chain *chain);
+
 int ubx_chain_init(struct ubx_chain *chain,
 		   const char *chain_id,
 		   double tstats_output_rate)
@@ -144,9 +164,434 @@ int ubx_chain_init(struct ubx_chain *chain,
 
 void ubx_chain_cleanup(struct ubx_chain *chain)
 {
+	chain_mon_unregister(chain);
 	free(chain->blk_tstats);
+	chain->blk_tstats = NULL;
+}
+
+long ubx_chain_migrate(struct ubx_chain *chain, int node)
+{
+	long ret, failed = 0;
+
+	for (int i = 0; i < chain->triggees_len; i++) {
+		ret = ubx_block_migrate_private(chain->triggees[i].b, node);
+
+		if (ret < 0)
+			return ret;
+
+		failed += ret;
+	}
+
+	return failed;
+}
+
+/*
+ * NUMA placement
+ *
+ * A block set is a small, unordered array of blocks. It is only used
+ * before the first cycle, so linear lookups are fine.
+ */
+struct blk_set {
+	const ubx_block_t **blks;
+	long len;
+	long size;
+};
+
+static int blk_set_has(const struct blk_set *s, const ubx_block_t *b)
+{
+	for (long i = 0; i < s->len; i++) {
+		if (s->blks[i] == b)
+			return 1;
+	}
+
+	return 0;
+}
+
+/* returns 1 if added, 0 if already present or -ENOMEM */
+static int blk_set_add(struct blk_set *s, const ubx_block_t *b)
+{
+	const ubx_block_t **blks;
+
+	if (blk_set_has(s, b))
+		return 0;
+
+	if (s->len == s->size) {
+		blks = realloc(s->blks, 2 * (s->size + 8) * sizeof(*blks));
+
+		if (blks == NULL)
+			return -ENOMEM;
+
+		s->blks = blks;
+		s->size = 2 * (s->size + 8);
+	}
+
+	s->blks[s->len++] = b;
+	return 1;
+}
+
+/*
+ * add b and all blocks triggered by it. These are found via configs
+ * of type struct ubx_triggee, which covers the members of ubx/fused
+ * blocks and the chains of nested trig blocks.
+ */
+static int blk_set_add_triggered(struct blk_set *s, const ubx_block_t *b)
+{
+	int ret;
+	const ubx_config_t *c;
+	const struct ubx_triggee *t;
+
+	if (b == NULL)
+		return 0;
+
+	ret = blk_set_add(s, b);
+
+	if (ret <= 0)
+		return ret;
+
+	DL_FOREACH(b->configs, c) {
+		if (c->value == NULL ||
+		    strcmp(c->type->name, "struct ubx_triggee") != 0)
+			continue;
+
+		t = (const struct ubx_triggee *)c->value->data;
+
+		for (long i = 0; i < c->value->len; i++) {
+			ret = blk_set_add_triggered(s, t[i].b);
+
+			if (ret < 0)
+				return ret;
+		}
+	}
+
+	return 0;
+}
+
+/* check if ib is written to only by blocks of the set */
+static int iblock_is_exclusive(const struct blk_set *s, const ubx_block_t *ib)
+{
+	ubx_block_t *b, *btmp;
+	const ubx_port_t *p;
+
+	HASH_ITER(hh, ib->nd->blocks, b, btmp) {
+		if (blk_set_has(s, b))
+			continue;
+
+		DL_FOREACH(b->ports, p) {
+			if (p->out_interaction == NULL)
+				continue;
+
+			for (int i = 0; p->out_interaction[i] != NULL; i++) {
+				if (p->out_interaction[i] == ib)
+					return 0;
+			}
+		}
+	}
+
+	return 1;
+}
+
+int ubx_chains_place(const ubx_block_t *b,
+		     struct ubx_chain *chains, int num_chains,
+		     int node, struct ubx_chain_placement *pl)
+{
+	long ret;
+	int i;
+	const ubx_port_t *p;
+	struct blk_set blks = { 0 };
+	struct blk_set iblks = { 0 };
+
+	memset(pl, 0, sizeof(*pl));
+	pl->node = node;
+
+	/* collect all blocks triggered by this trigger */
+	ret = blk_set_add(&blks, b);
+
+	for (i = 0; i < num_chains && ret >= 0; i++) {
+		for (long j = 0; j < chains[i].triggees_len && ret >= 0; j++)
+			ret = blk_set_add_triggered(&blks, chains[i].triggees[j].b);
+	}
+
+	if (ret < 0)
+		goto out;
+
+	/* collect the iblocks these write to */
+	for (i = 0; i < blks.len; i++) {
+		DL_FOREACH(blks.blks[i]->ports, p) {
+			if (p->out_interaction == NULL)
+				continue;
+
+			for (int k = 0; p->out_interaction[k] != NULL; k++) {
+				ret = blk_set_add(&iblks, p->out_interaction[k]);
+
+				if (ret < 0)
+					goto out;
+			}
+		}
+	}
+
+	/* move the private data of blocks and exclusive iblocks */
+	for (i = 0; i < blks.len; i++) {
+		ret = ubx_block_migrate_private((ubx_block_t *)blks.blks[i], node);
+
+		if (ret < 0)
+			goto out;
+
+		pl->failed += ret;
+		pl->num_blocks++;
+	}
+
+	for (i = 0; i < iblks.len; i++) {
+		ubx_blocks_lock();
+		ret = iblock_is_exclusive(&blks, iblks.blks[i]);
+		ubx_blocks_unlock();
+
+		if (!ret) {
+			ubx_debug(b, "not moving shared iblock %s", iblks.blks[i]->name);
+			pl->num_shared++;
+			continue;
+		}
+
+		ret = ubx_block_migrate_private((ubx_block_t *)iblks.blks[i], node);
+
+		if (ret < 0)
+			goto out;
+
+		pl->failed += ret;
+		pl->num_iblocks++;
+	}
+
+	ret = 0;
+
+out:
+	free(blks.blks);
+	free(iblks.blks);
+	return ret;
 }
 
+int ubx_chains_check_disjoint(struct ubx_chain *chains, int num_chains,
+			      struct ubx_chain_overlap *ov)
+{
+	int i, n, ret = 0;
+	struct blk_set *sets;
+
+	sets = calloc(num_chains, sizeof(*sets));
+
+	if (sets == NULL)
+		return -ENOMEM;
+
+	for (i = 0; i < num_chains; i++) {
+		for (long j = 0; j < chains[i].triggees_len; j++) {
+			ret = blk_set_add_triggered(&sets[i], chains[i].triggees[j].b);
+
+			if (ret < 0)
+				goto out;
+		}
+
+		for (n = 0; n < i; n++) {
+			for (long k = 0; k < sets[i].len; k++) {
+				if (!blk_set_has(&sets[n], sets[i].blks[k]))
+					continue;
+
+				ov->b = sets[i].blks[k];
+				ov->chain_a = n;
+				ov->chain_b = i;
+				ret = 1;
+				goto out;
+			}
+		}
+	}
+
+	ret = 0;
+
+out:
+	for (i = 0; i < num_chains; i++)
+		free(sets[i].blks);
+
+	free(sets);
+	return ret;
+}
+
+
+/*
+ * chain monitoring
+ *
+ * Registered chains are kept in a process wide list protected by
+ * chain_mon_mutex. The trigger threads never take this mutex, they
+ * only write the seqlocked snapshot of their chain.
+ */
+
+static pthread_mutex_t chain_mon_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct ubx_chain *chain_mon_head;
+
+/* number of seqlock read attempts before yielding */
+#define CHAIN_MON_READ_SPIN	100
+
+int ubx_chain_mon_register(const ubx_block_t *b, struct ubx_chain *chain)
+{
+	int ret = 0;
+	long len;
+	struct ubx_tstat *blk;
+
+	if (chain->tstats_mode == TSTATS_DISABLED) {
+		chain_mon_unregister(chain);
+		return 0;
+	}
+
+	len = (chain->tstats_mode == TSTATS_PERBLOCK) ? chain->triggees_len : 0;
+
+	pthread_mutex_lock(&chain_mon_mutex);
+
+	if (len != chain->mon_blk_len) {
+		blk = realloc(chain->mon_blk, len * sizeof(struct ubx_tstat));
+
+		if (blk == NULL && len > 0) {
+			ret = EOUTOFMEM;
+			goto out_unlock;
+		}
+
+		chain->mon_blk = blk;
+		chain->mon_blk_len = len;
+	}
+
+	/* publish the initial (empty) stats */
+	chain->mon_global = chain->global_tstats;
+
+	if (len > 0)
+		memcpy(chain->mon_blk, chain->blk_tstats, len * sizeof(struct ubx_tstat));
+
+	chain->mon_last = 0;
+
+	if (chain->mon_block == NULL) {
+		chain->mon_block = b;
+		chain->mon_next = chain_mon_head;
+		chain_mon_head = chain;
+	}
+
+out_unlock:
+	pthread_mutex_unlock(&chain_mon_mutex);
+	return ret;
+}
+
+/* unlink chain, the caller must hold chain_mon_mutex */
+static void __chain_mon_unregister(struct ubx_chain *chain)
+{
+	struct ubx_chain **pp;
+
+	for (pp = &chain_mon_head; *pp != NULL; pp = &(*pp)->mon_next) {
+		if (*pp == chain) {
+			*pp = chain->mon_next;
+			break;
+		}
+	}
+
+	free(chain->mon_blk);
+	chain->mon_blk = NULL;
+	chain->mon_blk_len = 0;
+	chain->mon_block = NULL;
+	chain->mon_next = NULL;
+}
+
+static void chain_mon_unregister(struct ubx_chain *chain)
+{
+	if (chain->mon_block == NULL)
+		return;
+
+	pthread_mutex_lock(&chain_mon_mutex);
+	__chain_mon_unregister(chain);
+	pthread_mutex_unlock(&chain_mon_mutex);
+}
+
+void ubx_chain_mon_unregister_block(const ubx_block_t *b)
+{
+	struct ubx_chain *chain, *next;
+
+	pthread_mutex_lock(&chain_mon_mutex);
+
+	for (chain = chain_mon_head; chain != NULL; chain = next) {
+		next = chain->mon_next;
+
+		if (chain->mon_block == b)
+			__chain_mon_unregister(chain);
+	}
+
+	pthread_mutex_unlock(&chain_mon_mutex);
+}
+
+int ubx_chain_mon_foreach(const ubx_node_t *nd, ubx_chain_mon_fn fn, void *arg)
+{
+	int cnt = 0;
+	long len;
+	unsigned int seq, tries;
+	struct ubx_chain *chain;
+	struct ubx_tstat global, *blk = NULL, *tmp;
+	long blk_size = 0;
+
+	pthread_mutex_lock(&chain_mon_mutex);
+
+	for (chain = chain_mon_head; chain != NULL; chain = chain->mon_next) {
+		if (chain->mon_block->nd != nd)
+			continue;
+
+		len = chain->mon_blk_len;
+
+		if (len > blk_size) {
+			tmp = realloc(blk, len * sizeof(struct ubx_tstat));
+
+			if (tmp == NULL) {
+				cnt = EOUTOFMEM;
+				goto out_unlock;
+			}
+
+			blk = tmp;
+			blk_size = len;
+		}
+
+		tries = 0;
+
+		do {
+			if (++tries % CHAIN_MON_READ_SPIN == 0)
+				sched_yield();
+
+			seq = ubx_seqlock_read_begin(&chain->mon_lock);
+			global = chain->mon_global;
+
+			if (len > 0)
+				memcpy(blk, chain->mon_blk, len * sizeof(struct ubx_tstat));
+		} while (ubx_seqlock_read_retry(&chain->mon_lock, seq));
+
+		fn(chain->mon_block, &global, (len > 0) ? blk : NULL, len, arg);
+		cnt++;
+	}
+
+out_unlock:
+	pthread_mutex_unlock(&chain_mon_mutex);
+	free(blk);
+	return cnt;
+}
+
+/**
+ * chain_mon_publish
+ *
+ * if the chain is monitored and UBX_CHAIN_MON_PERIOD_NS has passed,
+ * update the monitoring snapshot.
+ */
+static void chain_mon_publish(struct ubx_chain *chain, uint64_t now)
+{
+	if (chain->mon_block == NULL ||
+	    now < chain->mon_last + UBX_CHAIN_MON_PERIOD_NS)
+		return;
+
+	ubx_seqlock_write_begin(&chain->mon_lock);
+
+	chain->mon_global = chain->global_tstats;
+
+	if (chain->mon_blk_len > 0)
+		memcpy(chain->mon_blk, chain->blk_tstats,
+		       chain->mon_blk_len * sizeof(struct ubx_tstat));
+
+	ubx_seqlock_write_end(&chain->mon_lock);
+	chain->mon_last = now;
+}
 
 /**
  * tstats_output_throttled
@@ -204,13 +649,23 @@ out:
 /**
  * trig_stats_perblock
  *
- * trigger the given chain and aquire per-block statistics
+ * trigger the given chain and aquire per-block statistics. If
+ * tstats_faults is set, the page faults are sampled once after each
+ * block. The time spent sampling is excluded from the global
+ * duration.
  */
 static int trig_stats_perblock(struct ubx_chain *chain)
 {
 	int ret = 0;
 	uint64_t ts_end_ns;
 	struct ubx_timespec ts_start, ts_end, blk_ts_start, blk_ts_end;
+	struct ubx_timespec ts_smpl, smpl_dur, smpl_total = { 0 };
+	struct rusage ru_start, ru_prev, ru_cur;
+
+	if (chain->tstats_faults) {
+		getrusage(RUSAGE_THREAD, &ru_start);
+		ru_prev = ru_start;
+	}
 
 	ubx_gettime(&ts_start);
 
@@ -231,16 +686,35 @@ static int trig_stats_perblock(struct ubx_chain *chain)
 
 		ubx_gettime(&blk_ts_end);
 		tstat_update(&chain->blk_tstats[i], &blk_ts_start, &blk_ts_end);
+
+		if (chain->tstats_faults) {
+			getrusage(RUSAGE_THREAD, &ru_cur);
+			tstat_update_faults(&chain->blk_tstats[i], &ru_prev, &ru_cur);
+			ru_prev = ru_cur;
+
+			ubx_gettime(&ts_smpl);
+			ubx_ts_sub(&ts_smpl, &blk_ts_end, &smpl_dur);
+			ubx_ts_add(&smpl_total, &smpl_dur, &smpl_total);
+		}
 	}
 
 	/* finalize global measurement,	output stats */
 	ubx_gettime(&ts_end);
-	tstat_update(&chain->global_tstats, &ts_start, &ts_end);
 	ts_end_ns = ubx_ts_to_ns(&ts_end);
 
+	ubx_ts_sub(&ts_end, &smpl_total, &ts_end);
+	tstat_update(&chain->global_tstats, &ts_start, &ts_end);
+
+	if (chain->tstats_faults) {
+		getrusage(RUSAGE_THREAD, &ru_cur);
+		tstat_update_faults(&chain->global_tstats, &ru_start, &ru_cur);
+	}
+
 	if (chain->tstats_output_rate)
 		tstats_output_throttled(chain, ts_end_ns);
 
+	chain_mon_publish(chain, ts_end_ns);
+
 	return ret;
 }
 
@@ -254,6 +728,10 @@ static int trig_stats_global(struct ubx_chain *chain)
 	int ret = 0;
 	uint64_t ts_end_ns;
 	struct ubx_timespec ts_start, ts_end;
+	struct rusage ru_start, ru_end;
+
+	if (chain->tstats_faults)
+		getrusage(RUSAGE_THREAD, &ru_start);
 
 	ubx_gettime(&ts_start);
 
@@ -274,11 +752,19 @@ static int trig_stats_global(struct ubx_chain *chain)
 	/* finalize global measurement,	output stats */
 	ubx_gettime(&ts_end);
 	tstat_update(&chain->global_tstats, &ts_start, &ts_end);
+
+	if (chain->tstats_faults) {
+		getrusage(RUSAGE_THREAD, &ru_end);
+		tstat_update_faults(&chain->global_tstats, &ru_start, &ru_end);
+	}
+
 	ts_end_ns = ubx_ts_to_ns(&ts_end);
 
 	if (chain->tstats_output_rate)
 		tstats_output_throttled(chain, ts_end_ns);
 
+	chain_mon_publish(chain, ts_end_ns);
+
 	return ret;
 }
 
@@ -336,6 +822,11 @@ out:
 	return ret;
 }
 
+void ubx_chain_account_overrun(struct ubx_chain *chain)
+{
+	chain->global_tstats.overruns++;
+}
+
 /*
  * chain logging and writing to ports and files
  */
@@ -10,10 +10,16 @@
 #ifndef TRIG_UTILS_H
 #define TRIG_UTILS_H
 
+#include <sys/resource.h>
+
 #include "ubx.h"
+#include "ubx_seqlock.h"
 #include "triggee.h"
 #include "tstat.h"
 
+/* max rate at which chains publish their monitoring snapshot */
+#define UBX_CHAIN_MON_PERIOD_NS		(NSEC_PER_SEC / 50)
+
 enum tstats_mode {
 	TSTATS_DISABLED=0,
 	TSTATS_GLOBAL,
@@ -59,6 +65,20 @@ void tstat_update(struct ubx_tstat *stats,
 		  struct ubx_timespec *start,
 		  struct ubx_timespec *end);
 
+/**
+ * tstat_update_faults - accumulate page faults
+ *
+ * Add the minor and major page faults that occured between the two
+ * getrusage(RUSAGE_THREAD) samples.
+ *
+ * @stats stats to update
+ * @start rusage sampled at start of measurement
+ * @end rusage sampled at end of measurement
+ */
+void tstat_update_faults(struct ubx_tstat *stats,
+			 const struct rusage *start,
+			 const struct rusage *end);
+
 /**
  * tstat_log - log a tstats
  */
@@ -84,6 +104,7 @@ int tstat_fwrite(FILE *fp, struct ubx_tstat *stats);
  * @triggees_len: length of the above array
  * @tstats_mode: desired enum tstats_mode
  * @tstats_skip_first skip this many steps before starting to acquire stats
+ * @tstats_faults: if set, sample the page faults with getrusage(RUSAGE_THREAD)
  * @p_tstats: tstats output port (optional)
  * @every_cnt: counter for reducing trigger frequency via "every" triggee value
  * @global_tstats global tstats structure
@@ -91,6 +112,7 @@ int tstat_fwrite(FILE *fp, struct ubx_tstat *stats);
  * @tstats_output_rate:	output rate
  * @tstats_output_last_msg: timestamp of last message
  * @tstats_output_idx: index of last output sample
+ * @mon_*: monitoring snapshot, see ubx_chain_mon_register
  */
 struct ubx_chain {
 	/* public fields to be configured directly */
@@ -98,6 +120,7 @@ struct ubx_chain {
 	long triggees_len;
 	int tstats_mode;
 	unsigned int tstats_skip_first;
+	int tstats_faults;
 	ubx_port_t *p_tstats;
 
 	/* internal, initialized via ubx_chain_init */
@@ -108,6 +131,14 @@ struct ubx_chain {
 	uint64_t tstats_output_rate;
 	uint64_t tstats_output_last_msg;
 	long tstats_output_idx;
+
+	const ubx_block_t *mon_block;
+	struct ubx_seqlock mon_lock;
+	struct ubx_tstat mon_global;
+	struct ubx_tstat *mon_blk;
+	long mon_blk_len;
+	uint64_t mon_last;
+	struct ubx_chain *mon_next;
 };
 
 /**
@@ -150,6 +181,157 @@ void ubx_chain_cleanup(struct ubx_chain* chain);
  */
 int ubx_chain_trigger(struct ubx_chain* chain);
 
+/**
+ * ubx_chain_account_overrun - account a runtime overrun
+ *
+ * count a trigger of the chain that exceeded its runtime budget
+ * (e.g. the SCHED_DEADLINE runtime) in the overruns of the global
+ * tstats.
+ *
+ * @chain: chain whose last trigger overran
+ */
+void ubx_chain_account_overrun(struct ubx_chain *chain);
+
+/**
+ * ubx_chain_migrate - migrate private data of triggees to a NUMA node
+ *
+ * move the private data allocated with ubx_block_alloc_private of
+ * all blocks of the chain to the given NUMA node. This is intended
+ * to be called from the trigger thread before triggering the chain.
+ *
+ * @chain: chain to migrate
+ * @node: target NUMA node
+ * @return number of pages that could not be moved or <0 in case of error
+ */
+long ubx_chain_migrate(struct ubx_chain *chain, int node);
+
+/**
+ * struct ubx_chain_placement - result of ubx_chains_place
+ *
+ * @node: NUMA node the data was placed on
+ * @num_blocks: number of blocks whose private data was moved
+ * @num_iblocks: number of exclusively written iblocks moved
+ * @num_shared: number of iblocks left in place, since these are also
+ *		written by blocks triggered elsewhere
+ * @failed: number of pages that could not be moved
+ */
+struct ubx_chain_placement {
+	int node;
+	long num_blocks;
+	long num_iblocks;
+	long num_shared;
+	long failed;
+};
+
+/**
+ * ubx_chains_place - place triggered blocks and their iblocks on a NUMA node
+ *
+ * bind and move the private data of the trigger block @b, of all
+ * blocks triggered by its chains (including the blocks these
+ * trigger in turn, e.g. the members of a ubx/fused block) and of
+ * all iblocks written exclusively by these blocks to the given
+ * node. iblocks that are also written by other blocks are left in
+ * place. The block metadata (ubx_block_t, ports and configs) is
+ * not moved, as it shares pages with other blocks.
+ *
+ * This is intended to be called from the trigger thread before
+ * triggering the chains. It must not run concurrently with adding
+ * or removing connections.
+ *
+ * @b: trigger block
+ * @chains: array of chains
+ * @num_chains: length of chains
+ * @node: target NUMA node
+ * @pl: filled with the resulting placement
+ * @return 0 or <0 (-errno) in case of error
+ */
+int ubx_chains_place(const ubx_block_t *b,
+		     struct ubx_chain *chains, int num_chains,
+		     int node, struct ubx_chain_placement *pl);
+
+/**
+ * struct ubx_chain_overlap - result of ubx_chains_check_disjoint
+ *
+ * @b: block triggered by both chains
+ * @chain_a: index of the first chain
+ * @chain_b: index of the second chain
+ */
+struct ubx_chain_overlap {
+	const ubx_block_t *b;
+	int chain_a;
+	int chain_b;
+};
+
+/**
+ * ubx_chains_check_disjoint - check that chains trigger disjoint blocks
+ *
+ * check that no block is triggered by more than one of the chains,
+ * including the blocks triggered in turn by the triggees (e.g. the
+ * members of a ubx/fused block or the chains of a nested trig).
+ * This is required for chains that are triggered concurrently.
+ *
+ * @chains: array of chains
+ * @num_chains: length of chains
+ * @ov: filled with the first overlap found
+ * @return 0 if disjoint, 1 if not or <0 (-errno) in case of error
+ */
+int ubx_chains_check_disjoint(struct ubx_chain *chains, int num_chains,
+			      struct ubx_chain_overlap *ov);
+
+/**
+ * ubx_chain_mon_register - publish the tstats of a chain for monitoring
+ *
+ * Once registered, the chain copies its tstats into a seqlocked
+ * snapshot at most every UBX_CHAIN_MON_PERIOD_NS while it is
+ * triggered. Monitoring clients can read these snapshots via
+ * ubx_chain_mon_foreach without interfering with the trigger
+ * thread. Registering an already registered chain updates the
+ * snapshot size. Chains with tstats disabled are not registered.
+ *
+ * This function must be called after ubx_chain_init and must not be
+ * called while the chain is being triggered. The chain is
+ * unregistered by ubx_chain_cleanup or ubx_chain_mon_unregister_block.
+ *
+ * @b: block owning the chain
+ * @chain: chain to register
+ * @return 0 if OK, < 0 otherwise
+ */
+int ubx_chain_mon_register(const ubx_block_t *b, struct ubx_chain *chain);
+
+/**
+ * ubx_chain_mon_unregister_block - unregister all chains of a block
+ *
+ * @b: block whose chains to unregister
+ */
+void ubx_chain_mon_unregister_block(const ubx_block_t *b);
+
+/**
+ * ubx_chain_mon_fn - ubx_chain_mon_foreach callback
+ *
+ * @b: block owning the chain
+ * @global: snapshot of the global tstats
+ * @blk: snapshot of the per block tstats (NULL if len is 0)
+ * @len: number of per block tstats
+ * @arg: user argument
+ */
+typedef void (*ubx_chain_mon_fn)(const ubx_block_t *b,
+				 const struct ubx_tstat *global,
+				 const struct ubx_tstat *blk,
+				 long len, void *arg);
+
+/**
+ * ubx_chain_mon_foreach - call fn with a consistent snapshot of each chain
+ *
+ * This is not real-time safe and serializes with chain registration,
+ * but never blocks the trigger threads.
+ *
+ * @nd: only report chains of blocks of this node
+ * @fn: function to call
+ * @arg: user argument passed to fn
+ * @return number of chains or < 0 in case of error
+ */
+int ubx_chain_mon_foreach(const ubx_node_t *nd, ubx_chain_mon_fn fn, void *arg);
+
 /**
  * ubx_chain_tstats_log - log all tstats
  *
@@ -28,6 +28,15 @@ long FUNCNAME ## _array(const ubx_port_t* p, TYPENAME* val, const long len) \
 	ubx_data_t data;					   \
 	static ubx_type_t *type = NULL;				   \
 								   \
+	/* fast path: verified port of the already resolved type */	\
+	if (type != NULL && p != NULL && (p->attrs & PORT_ATTR_VERIFIED) && \
+	    p->in_type == type && len > 0 && len <= p->in_data_len) {	\
+		data.data = (void*) val;				\
+		data.type = type;					\
+		data.len = len;						\
+		return __port_read_unchecked(p, &data);			\
+	}								\
+								   \
 	if (p == NULL || p->block == NULL) {			   \
 		ERR("invalid input port");			   \
 		return EINVALID_PORT;				   \
@@ -80,6 +89,16 @@ int FUNCNAME ## _array(const ubx_port_t *p, const TYPENAME *val, const long len)
 	ubx_data_t data;						\
 	static ubx_type_t *type = NULL;					\
 									\
+	/* fast path: verified port of the already resolved type */	\
+	if (type != NULL && p != NULL && (p->attrs & PORT_ATTR_VERIFIED) && \
+	    p->out_type == type && len > 0 && len <= p->out_data_len) { \
+		data.data = (void*) val;				\
+		data.type = type;					\
+		data.len = len;						\
+		__port_write_unchecked(p, &data);			\
+		return 0;						\
+	}								\
+									\
 	if (p == NULL || p->block == NULL) {				\
 		ERR("invalid output port");				\
 		return EINVALID_PORT;					\
@@ -12,6 +12,7 @@
 
 #include "ubx.h"
 #include <config.h>
+#include <pthread.h>
 
 /* core logging helpers */
 #define CORE_LOG_SRC			"ubxcore"
@@ -40,6 +41,13 @@
 # define logf_debug(nd, fmt, ...)	do {} while (0)
 #endif
 
+/* number of interaction array slots (including the terminating
+ * NULL) reserved after each port direction allocated from the arena */
+#define ARENA_IACT_SLOTS		4
+
+/* set in ubx_config_live.mid if the middle buffer holds a new value */
+#define CONFIG_LIVE_DIRTY		(1U << 2)
+
 /* predicates */
 int blk_is_proto(const ubx_block_t *b) { return b->prototype == NULL; }
 int blk_is_instance(const ubx_block_t *b) { return !blk_is_proto(b); }
@@ -53,6 +61,86 @@ int port_is_dyn(const ubx_port_t *p) { return !port_is_cloned(p); }
 int cfg_is_cloned(const ubx_config_t *c) { return c->attrs & CONFIG_ATTR_CLONED; }
 int cfg_is_dyn(const ubx_config_t *c) { return !cfg_is_cloned(c); }
 
+/**
+ * blk_zalloc - allocate zeroed memory for block metadata
+ *
+ * Block instances of nodes with ND_ARENA are allocated from the node
+ * arena, prototypes and everything else from the heap. If the arena
+ * is exhausted, this falls back to the heap.
+ *
+ * @b: block for which to allocate
+ * @size: number of bytes
+ * @align: alignment or 0 for default
+ *
+ * @return pointer to memory or NULL
+ */
+static void *blk_zalloc(const ubx_block_t *b, size_t size, size_t align)
+{
+	void *ptr = NULL;
+
+	if (blk_is_instance(b) && b->nd != NULL && b->nd->attrs & ND_ARENA)
+		ptr = ubx_arena_alloc(&b->nd->arena, size, align);
+
+	return (ptr != NULL) ? ptr : calloc(1, size);
+}
+
+/**
+ * nd_free - free block metadata unless owned by the node arena
+ *
+ * @nd: node (may be NULL)
+ * @ptr: memory to free
+ */
+static void nd_free(const ubx_node_t *nd, void *ptr)
+{
+	if (nd != NULL && ubx_arena_owns(&nd->arena, ptr))
+		return;
+
+	free(ptr);
+}
+
+/*
+ * header preceding each block private allocation. It is padded to
+ * PRIV_HDR_SIZE so that the returned memory is cache line aligned.
+ */
+struct ubx_priv_alloc {
+	struct ubx_priv_alloc *prev;
+	struct ubx_priv_alloc *next;
+	size_t size;	/* total size including the header */
+	int mapped;	/* allocated with mmap */
+};
+
+#define PRIV_HDR_SIZE			UBX_CACHELINE_SIZE
+
+static void priv_alloc_release(struct ubx_priv_alloc *pa)
+{
+	if (pa->mapped)
+		munmap(pa, pa->size);
+	else
+		free(pa);
+}
+
+/**
+ * port_iact_slots - get the interaction slots reserved in the arena
+ *
+ * @p: port
+ * @out: 1 for out_interaction, 0 for in_interaction
+ *
+ * @return pointer to the ARENA_IACT_SLOTS reserved slots or NULL if
+ *         the port was not allocated from the arena.
+ */
+static const ubx_block_t **port_iact_slots(const ubx_port_t *p, int out)
+{
+	const ubx_block_t **slots;
+
+	if (p->block == NULL || p->block->nd == NULL ||
+	    !ubx_arena_owns(&p->block->nd->arena, p))
+		return NULL;
+
+	slots = (const ubx_block_t **)(p + 1);
+
+	return (out && port_is_in(p)) ? slots + ARENA_IACT_SLOTS : slots;
+}
+
 
 
 /* for pretty printing */
@@ -287,6 +375,47 @@ int ubx_node_init(ubx_node_t *nd, const char *name, uint32_t attrs)
 		logf_info(nd, "mlockall CUR|FUT succeeded");
 	}
 
+	if (attrs & ND_HEAP_RESERVE) {
+		nd->heap_reserve = (nd->heap_reserve == 0) ?
+			UBX_HEAP_RESERVE_DEFAULT : nd->heap_reserve;
+
+		if (ubx_heap_reserve(nd->heap_reserve) != 0) {
+			logf_err(nd, "failed to prefault %zu byte heap reserve",
+				 nd->heap_reserve);
+			goto out;
+		}
+		logf_info(nd, "prefaulted %zu byte heap reserve", nd->heap_reserve);
+	}
+
+	if (attrs & ND_ARENA) {
+		size_t size = (nd->arena.size == 0) ?
+			UBX_ARENA_SIZE_DEFAULT : nd->arena.size;
+
+		if (ubx_arena_init(&nd->arena, size) != 0) {
+			logf_err(nd, "failed to allocate %zu byte arena: %m", size);
+			goto out;
+		}
+		logf_info(nd, "allocated %zu byte arena", nd->arena.size);
+	} else {
+		memset(&nd->arena, 0, sizeof(nd->arena));
+	}
+
+	nd->pool = NULL;
+
+	if (attrs & ND_POOL) {
+		size_t size = (nd->pool_size == 0) ?
+			UBX_POOL_SIZE_DEFAULT : nd->pool_size;
+
+		nd->pool = ubx_pool_create(size);
+
+		if (nd->pool == NULL) {
+			logf_err(nd, "failed to allocate %zu byte data pool: %m", size);
+			goto out;
+		}
+		nd->pool_size = nd->pool->size;
+		logf_info(nd, "allocated %zu byte data pool", nd->pool_size);
+	}
+
 #ifdef TIMESRC_TSC
 	logf_info(nd, "TSC timesource enabled");
 #endif
@@ -346,8 +475,9 @@ void ubx_node_clear(ubx_node_t *nd)
 /**
  * ubx_node_cleanup - cleanup a node
  *
- * This function will run ubx_node_clear and then unload all
- * modules. The node is empty but still valid afterwards.
+ * This function will run ubx_node_clear, unload all modules and
+ * release the node arena and data pool. The node is empty but still valid
+ * afterwards, however further blocks will be allocated from the heap.
  *
  * @param ni
  */
@@ -380,6 +510,20 @@ void ubx_node_cleanup(ubx_node_t *nd)
 	if (cnt > 0)
 		logf_warn(nd, "%d modules after cleanup", cnt);
 
+	if (nd->arena.base != NULL) {
+		logf_info(nd, "arena: used %zu/%zu bytes, %lu allocs, %lu heap fallbacks",
+			  nd->arena.used, nd->arena.size,
+			  nd->arena.num_allocs, nd->arena.num_fallbacks);
+		ubx_arena_cleanup(&nd->arena);
+	}
+
+	if (nd->pool != NULL) {
+		cnt = ubx_pool_release(nd->pool);
+		if (cnt > 0)
+			logf_warn(nd, "%d data pool chunks in use, deferring release", cnt);
+		nd->pool = NULL;
+	}
+
 	nd->cur_seqid = 0;
 }
 
@@ -414,6 +558,24 @@ int ubx_block_check(ubx_node_t *nd, ubx_block_t *b)
 	return 0;
 }
 
+/*
+ * protects the block tables of all nodes against concurrent
+ * registration and removal. Threads other than the one managing a
+ * node (e.g. monitoring threads) must hold it while iterating over
+ * nd->blocks, see ubx_blocks_lock.
+ */
+static pthread_mutex_t blocks_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+void ubx_blocks_lock(void)
+{
+	pthread_mutex_lock(&blocks_mutex);
+}
+
+void ubx_blocks_unlock(void)
+{
+	pthread_mutex_unlock(&blocks_mutex);
+}
+
 /**
  * __block_register - register a block with a node
  *
@@ -434,10 +596,12 @@ static int __block_register(ubx_node_t *nd, ubx_block_t *block)
 		return -1;
 	}
 
-	HASH_ADD_KEYPTR(hh, nd->blocks, block->name, strlen(block->name), block);
-
 	block->nd = nd;
 
+	ubx_blocks_lock();
+	HASH_ADD_KEYPTR(hh, nd->blocks, block->name, strlen(block->name), block);
+	ubx_blocks_unlock();
+
 	logf_debug(nd, "registered %s", block->name);
 
 	return 0;
@@ -582,7 +746,10 @@ int ubx_block_unregister(ubx_node_t *nd, const char *name)
 	logf_debug(nd, "unregistering %s block %s",
 		   (blk_is_proto(tmpc) ? "prototype" : "instance"), name);
 
+	ubx_blocks_lock();
 	HASH_DEL(nd->blocks, tmpc);
+	ubx_blocks_unlock();
+
 	ubx_block_free(tmpc);
 	return 0;
 }
@@ -757,6 +924,45 @@ void ubx_type_hashstr(const ubx_type_t *t, char *buf)
 }
 
 
+/**
+ * data_zalloc - allocate zeroed memory for ubx_data
+ *
+ * If the node of the type has a data pool, try to allocate from it
+ * first and fall back to the heap.
+ *
+ * @typ: type of data
+ * @size: number of bytes
+ *
+ * @return pointer to memory or NULL
+ */
+static void *data_zalloc(const ubx_type_t *typ, size_t size)
+{
+	void *ptr = NULL;
+
+	if (typ->nd != NULL && typ->nd->pool != NULL)
+		ptr = ubx_pool_alloc(typ->nd->pool, size);
+
+	return (ptr != NULL) ? ptr : calloc(1, size);
+}
+
+/**
+ * data_free - free memory allocated with data_zalloc
+ *
+ * The owning pool is determined from the address, so that this works
+ * even if the type or node is already gone.
+ *
+ * @ptr: memory to free
+ */
+static void data_free(void *ptr)
+{
+	struct ubx_pool *p = ubx_pool_find(ptr);
+
+	if (p != NULL)
+		ubx_pool_free(p, ptr);
+	else
+		free(ptr);
+}
+
 /**
  * Allocate a ubx_data_t of the given type and array length.
  *
@@ -774,13 +980,13 @@ ubx_data_t *__ubx_data_alloc(const ubx_type_t *typ, const long array_len)
 	if (typ == NULL)
 		goto out;
 
-	d = calloc(1, sizeof(ubx_data_t));
+	d = data_zalloc(typ, sizeof(ubx_data_t));
 
 	if (d == NULL)
 		goto out;
 
 	if (array_len > 0) {
-		d->data = calloc(array_len, typ->size);
+		d->data = data_zalloc(typ, array_len * typ->size);
 		if (d->data == NULL)
 			goto out_free;
 	}
@@ -792,7 +998,7 @@ ubx_data_t *__ubx_data_alloc(const ubx_type_t *typ, const long array_len)
 	goto out;
 
 out_free:
-	free(d);
+	data_free(d);
 	d = NULL;
 out:
 	return d;
@@ -840,9 +1046,26 @@ int ubx_data_resize(ubx_data_t *d, long newlen)
 	int ret = EOUTOFMEM;
 	void *ptr;
 	unsigned int newsz = newlen * d->type->size;
+	struct ubx_pool *p = ubx_pool_find(d->data);
+
+	if (p != NULL) {
+		/* pool chunks are only replaced if they are too small */
+		if (newsz <= ubx_pool_chunk_size(p, d->data)) {
+			ptr = d->data;
+		} else {
+			ptr = data_zalloc(d->type, newsz);
+			if (ptr == NULL)
+				goto out;
+			memcpy(ptr, d->data, data_size(d));
+			ubx_pool_free(p, d->data);
+		}
+	} else if (d->data == NULL && newsz > 0) {
+		ptr = data_zalloc(d->type, newsz);
+	} else {
+		ptr = realloc(d->data, newsz);
+	}
 
-	ptr = realloc(d->data, newsz);
-	if (ptr == NULL)
+	if (ptr == NULL && newsz > 0)
 		goto out;
 
 	d->data = ptr;
@@ -864,8 +1087,8 @@ void ubx_data_free(ubx_data_t *d)
 	d->refcnt--;
 
 	if (d->refcnt < 0) {
-		free(d->data);
-		free(d);
+		data_free(d->data);
+		data_free(d);
 	}
 }
 
@@ -910,10 +1133,70 @@ int ubx_num_modules(ubx_node_t *nd)
  */
 void ubx_port_free(ubx_port_t *p)
 {
-	if (p->in_interaction) free((struct ubx_block_t *)p->in_interaction);
-	if (p->out_interaction) free((struct ubx_block_t *)p->out_interaction);
+	const ubx_node_t *nd = (p->block) ? p->block->nd : NULL;
+
+	if (p->in_interaction) nd_free(nd, (ubx_block_t **)p->in_interaction);
+	if (p->out_interaction) nd_free(nd, (ubx_block_t **)p->out_interaction);
 	if (p->doc) free((char *)p->doc);
-	free(p);
+	nd_free(nd, p);
+}
+
+/**
+ * config_live_free - release the live update buffers of a config
+ *
+ * All buffers except the current value are freed. Must not be called
+ * while the block may call ubx_config_changed.
+ *
+ * @c: config
+ */
+static void config_live_free(ubx_config_t *c)
+{
+	struct ubx_config_live *live = c->live;
+
+	if (live == NULL)
+		return;
+
+	for (int i = 0; i < 3; i++) {
+		if (live->buf[i] != c->value)
+			ubx_data_free(live->buf[i]);
+	}
+
+	free(live);
+	c->live = NULL;
+}
+
+/**
+ * config_live_create - allocate the live update buffers of a config
+ *
+ * @c: config
+ * @return live state or NULL
+ */
+static struct ubx_config_live *config_live_create(ubx_config_t *c)
+{
+	struct ubx_config_live *live;
+
+	live = calloc(1, sizeof(struct ubx_config_live));
+
+	if (live == NULL)
+		return NULL;
+
+	live->buf[0] = c->value;
+	live->buf[1] = __ubx_data_alloc(c->type, c->value->len);
+	live->buf[2] = __ubx_data_alloc(c->type, c->value->len);
+
+	if (live->buf[1] == NULL || live->buf[2] == NULL) {
+		if (live->buf[1]) ubx_data_free(live->buf[1]);
+		if (live->buf[2]) ubx_data_free(live->buf[2]);
+		free(live);
+		return NULL;
+	}
+
+	live->rd = 0;
+	live->wr = 1;
+	live->mid = 2;
+
+	__atomic_store_n(&c->live, live, __ATOMIC_RELEASE);
+	return live;
 }
 
 /**
@@ -923,9 +1206,10 @@ void ubx_port_free(ubx_port_t *p)
  */
 static void ubx_config_free(ubx_config_t *c)
 {
+	config_live_free(c);
 	if (c->doc) free((char *)c->doc);
 	if (c->value) ubx_data_free(c->value);
-	free(c);
+	nd_free(c->block->nd, c);
 }
 
 
@@ -944,6 +1228,8 @@ int ubx_config_assign(ubx_config_t *c, ubx_data_t *d)
 	if (c->type != d->type)
 		return ETYPE_MISMATCH;
 
+	config_live_free(c);
+
 	if (c->value)
 		ubx_data_free(c->value);
 
@@ -952,6 +1238,121 @@ int ubx_config_assign(ubx_config_t *c, ubx_data_t *d)
 	return 0;
 }
 
+/**
+ * ubx_config_publish - publish a new value of a running config
+ *
+ * Copy the value of @d into a back buffer and atomically make it
+ * available to the block. The block picks up the new value when it
+ * next calls ubx_config_changed, typically at the beginning of
+ * step. Until then, it continues to read the previous value, which
+ * is never modified by this function.
+ *
+ * This function is not real-time safe (the back buffers are
+ * allocated on first use) and must not be called concurrently for
+ * the same config. The array length of the config can not be changed
+ * this way. Publishing to a config that shares its value with other
+ * configs (see ubx_config_assign) only updates this config.
+ *
+ * @c: config to update
+ * @d: data holding the new value
+ *
+ * @return 0 if OK, <0 otherwise
+ */
+int ubx_config_publish(ubx_config_t *c, const ubx_data_t *d)
+{
+	unsigned int old;
+	ubx_data_t *wbuf, *cur;
+	struct ubx_config_live *live = c->live;
+
+	if (c->type != d->type)
+		return ETYPE_MISMATCH;
+
+	/* c->value may concurrently be switched by ubx_config_changed */
+	cur = __atomic_load_n(&c->value, __ATOMIC_ACQUIRE);
+
+	if (cur == NULL || d->len == 0 || cur->len != d->len)
+		return EINVALID_CONFIG_LEN;
+
+	if (live == NULL) {
+		live = config_live_create(c);
+
+		if (live == NULL)
+			return EOUTOFMEM;
+	}
+
+	/* the value may have been resized while the block was inactive */
+	wbuf = live->buf[live->wr];
+
+	if (wbuf->len != d->len && ubx_data_resize(wbuf, d->len) != 0)
+		return EOUTOFMEM;
+
+	memcpy(wbuf->data, d->data, data_size(d));
+	__atomic_store_n(&live->ver[live->wr], ++live->version, __ATOMIC_RELAXED);
+
+	old = __atomic_exchange_n(&live->mid, live->wr | CONFIG_LIVE_DIRTY,
+				  __ATOMIC_ACQ_REL);
+	live->wr = old & ~CONFIG_LIVE_DIRTY;
+
+	return 0;
+}
+
+/**
+ * ubx_config_changed - check for and pick up a published config value
+ *
+ * This is real-time safe and cheap enough to be called in every
+ * step. If it returns 1, c->value has been switched to the newly
+ * published value and any cached pointers to the config data (e.g. as
+ * obtained via cfg_getptr_<TYPE>) must be refreshed. Only the block
+ * owning the config may call this.
+ *
+ * @c: config
+ *
+ * @return 1 if the value changed since the last call, 0 otherwise
+ */
+int ubx_config_changed(ubx_config_t *c)
+{
+	unsigned int old;
+	struct ubx_config_live *live;
+
+	live = __atomic_load_n(&c->live, __ATOMIC_ACQUIRE);
+
+	if (live == NULL ||
+	    !(__atomic_load_n(&live->mid, __ATOMIC_RELAXED) & CONFIG_LIVE_DIRTY))
+		return 0;
+
+	old = __atomic_exchange_n(&live->mid, live->rd, __ATOMIC_ACQ_REL);
+	__atomic_store_n(&live->rd, old & ~CONFIG_LIVE_DIRTY, __ATOMIC_RELEASE);
+
+	__atomic_store_n(&c->value, live->buf[live->rd], __ATOMIC_RELEASE);
+	return 1;
+}
+
+/**
+ * ubx_config_version - return the version of the current config value
+ *
+ * This may be called from any thread. If called concurrently to
+ * ubx_config_changed, the result may be the version of the previous
+ * value.
+ *
+ * @c: config
+ *
+ * @return number of updates published via ubx_config_publish which
+ *         have been picked up by the block (0 if none)
+ */
+unsigned long ubx_config_version(const ubx_config_t *c)
+{
+	unsigned int rd;
+	const struct ubx_config_live *live;
+
+	live = __atomic_load_n(&c->live, __ATOMIC_ACQUIRE);
+
+	if (live == NULL)
+		return 0;
+
+	rd = __atomic_load_n(&live->rd, __ATOMIC_ACQUIRE);
+	return __atomic_load_n(&live->ver[rd], __ATOMIC_RELAXED);
+}
+
 /**
  * ubx_block_free - free all memory related to a block
  *
@@ -966,6 +1367,7 @@ void ubx_block_free(ubx_block_t *b)
 {
 	struct ubx_port *p = NULL, *ptmp = NULL;
 	struct ubx_config *c = NULL, *ctmp = NULL;
+	struct ubx_priv_alloc *pa = NULL, *patmp = NULL;
 
 	if (b->meta_data)
 		free((char *)b->meta_data);
@@ -980,7 +1382,120 @@ void ubx_block_free(ubx_block_t *b)
 		ubx_port_free(p);
 	}
 
-	free(b);
+	DL_FOREACH_SAFE(b->priv_allocs, pa, patmp) {
+		logf_warn(b->nd, "block %s: private data %p not freed",
+			  b->name, (uint8_t *)pa + PRIV_HDR_SIZE);
+		DL_DELETE(b->priv_allocs, pa);
+		priv_alloc_release(pa);
+	}
+
+	nd_free(b->nd, b);
+}
+
+/**
+ * ubx_block_alloc_private - allocate block private data
+ *
+ * Allocate zeroed, cache line aligned memory for the private state
+ * of a block. On systems with more than one NUMA node the memory is
+ * allocated with page granularity, so that it can later be migrated
+ * to the node of the thread that triggers the block (see
+ * ubx_block_migrate_private). The memory must be released using
+ * ubx_block_free_private. Any remaining allocations are freed when
+ * the block is removed.
+ *
+ * @b: block
+ * @size: size in bytes
+ *
+ * @return pointer to memory or NULL in case of error
+ */
+void *ubx_block_alloc_private(ubx_block_t *b, size_t size)
+{
+	long pgsz;
+	void *mem;
+	int mapped = 0;
+	struct ubx_priv_alloc *pa;
+	size_t total = size + PRIV_HDR_SIZE;
+
+	if (ubx_numa_num_nodes() > 1) {
+		pgsz = sysconf(_SC_PAGESIZE);
+		total = (total + pgsz - 1) & ~(pgsz - 1);
+
+		mem = mmap(NULL, total, PROT_READ | PROT_WRITE,
+			   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+		if (mem == MAP_FAILED)
+			goto out_err;
+
+		mapped = 1;
+	} else {
+		if (posix_memalign(&mem, UBX_CACHELINE_SIZE, total) != 0)
+			goto out_err;
+
+		memset(mem, 0x0, total);
+	}
+
+	pa = mem;
+	pa->size = total;
+	pa->mapped = mapped;
+	DL_APPEND(b->priv_allocs, pa);
+
+	return (uint8_t *)mem + PRIV_HDR_SIZE;
+
+out_err:
+	ubx_err(b, "failed to allocate %zu bytes of private data", size);
+	return NULL;
+}
+
+/**
+ * ubx_block_free_private - free block private data
+ *
+ * @b: block
+ * @ptr: memory obtained with ubx_block_alloc_private or NULL
+ */
+void ubx_block_free_private(ubx_block_t *b, void *ptr)
+{
+	struct ubx_priv_alloc *pa;
+
+	if (ptr == NULL)
+		return;
+
+	pa = (struct ubx_priv_alloc *)((uint8_t *)ptr - PRIV_HDR_SIZE);
+	DL_DELETE(b->priv_allocs, pa);
+	priv_alloc_release(pa);
+}
+
+/**
+ * ubx_block_migrate_private - move block private data to a NUMA node
+ *
+ * This is intended to be called by trigger blocks from the context
+ * of the triggering thread before the first step, so that the state
+ * of the triggered blocks becomes local to the CPU executing
+ * them. This is a no-op on single node systems.
+ *
+ * @b: block
+ * @node: target NUMA node
+ *
+ * @return number of pages that could not be moved or < 0 in case of
+ * error.
+ */
+long ubx_block_migrate_private(ubx_block_t *b, int node)
+{
+	long ret, failed = 0;
+	struct ubx_priv_alloc *pa;
+
+	DL_FOREACH(b->priv_allocs, pa) {
+		if (!pa->mapped)
+			continue;
+
+		ret = ubx_numa_move(pa, pa->size, node);
+
+		if (ret < 0)
+			return ret;
+
+		failed += ret;
+	}
+
+	return failed;
 }
 
 static int __ubx_port_add(ubx_block_t *b,
@@ -1011,11 +1526,18 @@ static int __ubx_config_add(ubx_block_t *b,
 static ubx_block_t *ubx_block_clone(ubx_block_t *prot, const char *name)
 {
 	int ret;
-	ubx_block_t *newb;
+	ubx_block_t *newb = NULL;
 	ubx_config_t *csrc = NULL;
 	ubx_port_t *psrc = NULL;
 
-	newb = calloc(1, sizeof(ubx_block_t));
+	/* with ND_ARENA, the block, its configs, ports and interaction
+	 * slots are bump allocated and hence laid out contiguously */
+	if (prot->nd->attrs & ND_ARENA)
+		newb = ubx_arena_alloc(&prot->nd->arena, sizeof(ubx_block_t),
+				       UBX_CACHELINE_SIZE);
+
+	if (newb == NULL)
+		newb = calloc(1, sizeof(ubx_block_t));
 
 	if (newb == NULL) {
 		logf_err(prot->nd, "EOUTOFMEM");
@@ -1025,6 +1547,7 @@ static ubx_block_t *ubx_block_clone(ubx_block_t *prot, const char *name)
 	newb->block_state = BLOCK_STATE_PREINIT;
 	strncpy((char*) newb->name, name, UBX_BLOCK_NAME_MAXLEN);
 	newb->prototype = prot;
+	newb->nd = prot->nd;
 
 	newb->type = prot->type;
 	newb->attrs = prot->attrs;
@@ -1188,10 +1711,12 @@ int ubx_block_rm(ubx_node_t *nd, const char *name)
  *
  * @param arr
  * @param newblock
+ * @param slots reserved arena slots of the port or NULL
  *
  * @return < 0 in case of error, 0 otherwise.
  */
-static int array_block_add(const ubx_block_t ***arr, const ubx_block_t *newblock)
+static int array_block_add(const ubx_block_t ***arr, const ubx_block_t *newblock,
+			   const ubx_block_t **slots)
 {
 	int ret;
 	long newlen; /* new length of array including NULL element */
@@ -1208,10 +1733,25 @@ static int array_block_add(const ubx_block_t ***arr, const ubx_block_t *newblock
 		for (tmpb = *arr, newlen = 2; *tmpb != NULL; tmpb++, newlen++)
 			;
 
-	*arr = realloc(*arr, sizeof(ubx_block_t *) * newlen);
-	if (*arr == NULL) {
-		ret = EOUTOFMEM;
-		goto out;
+	/* use the reserved arena slots as long as these suffice */
+	if (slots != NULL && (*arr == NULL || *arr == slots)) {
+		if (newlen <= ARENA_IACT_SLOTS) {
+			*arr = slots;
+		} else {
+			tmpb = malloc(sizeof(ubx_block_t *) * newlen);
+			if (tmpb == NULL) {
+				ret = EOUTOFMEM;
+				goto out;
+			}
+			memcpy(tmpb, slots, sizeof(ubx_block_t *) * (newlen - 2));
+			*arr = tmpb;
+		}
+	} else {
+		*arr = realloc(*arr, sizeof(ubx_block_t *) * newlen);
+		if (*arr == NULL) {
+			ret = EOUTOFMEM;
+			goto out;
+		}
 	}
 
 	(*arr)[newlen - 2] = newblock;
@@ -1247,6 +1787,42 @@ out:
 	return ret;
 }
 
+/**
+ * port_verify - verify a port and update PORT_ATTR_VERIFIED
+ *
+ * @param p port
+ *
+ * @return 0 if verified, < 0 otherwise
+ */
+static int port_verify(ubx_port_t *p)
+{
+	const ubx_block_t **iaptr;
+
+	p->attrs &= ~PORT_ATTR_VERIFIED;
+
+	if (!port_is_in(p) && !port_is_out(p))
+		return EINVALID_PORT_DIR;
+
+	if (p->in_interaction != NULL) {
+		for (iaptr = p->in_interaction; *iaptr != NULL; iaptr++) {
+			if ((*iaptr)->type != BLOCK_TYPE_INTERACTION ||
+			    (*iaptr)->read == NULL)
+				return EINVALID_BLOCK_TYPE;
+		}
+	}
+
+	if (p->out_interaction != NULL) {
+		for (iaptr = p->out_interaction; *iaptr != NULL; iaptr++) {
+			if ((*iaptr)->type != BLOCK_TYPE_INTERACTION ||
+			    (*iaptr)->write == NULL)
+				return EINVALID_BLOCK_TYPE;
+		}
+	}
+
+	p->attrs |= PORT_ATTR_VERIFIED;
+	return 0;
+}
+
 /**
  * ubx_port_connect_out - connect a port out channel to an iblock.
  *
@@ -1260,7 +1836,8 @@ int ubx_port_connect_out(ubx_port_t *p, const ubx_block_t *iblock)
 	int ret = -1;
 
 	if (port_is_out(p)) {
-		ret = array_block_add(&p->out_interaction, iblock);
+		ret = array_block_add(&p->out_interaction, iblock,
+				      port_iact_slots(p, 1));
 		if (ret != 0)
 			goto out;
 	} else {
@@ -1268,6 +1845,10 @@ int ubx_port_connect_out(ubx_port_t *p, const ubx_block_t *iblock)
 		goto out;
 	}
 
+	if (port_verify(p) != 0)
+		logf_warn(iblock->nd, "port %s: %s has no write hook, disabling fast path",
+			  p->name, iblock->name);
+
 	/* all ok */
 	ret = 0;
 out:
@@ -1287,7 +1868,8 @@ int ubx_port_connect_in(ubx_port_t *p, const ubx_block_t *iblock)
 	int ret;
 
 	if (port_is_in(p)) {
-		ret = array_block_add(&p->in_interaction, iblock);
+		ret = array_block_add(&p->in_interaction, iblock,
+				      port_iact_slots(p, 0));
 		if (ret != 0)
 			goto out;
 	} else {
@@ -1295,6 +1877,10 @@ int ubx_port_connect_in(ubx_port_t *p, const ubx_block_t *iblock)
 		goto out;
 	}
 
+	if (port_verify(p) != 0)
+		logf_warn(iblock->nd, "port %s: %s has no read hook, disabling fast path",
+			  p->name, iblock->name);
+
 	/* all ok */
 	ret = 0;
 out:
@@ -1374,6 +1960,7 @@ int ubx_port_disconnect_out(ubx_port_t *out_port, const ubx_block_t *iblock)
 		ret = array_block_rm(&out_port->out_interaction, iblock);
 		if (ret != 0)
 			goto out;
+		port_verify(out_port);
 	} else {
 		logf_err(iblock->nd,
 			 "port %s is not an out-port",
@@ -1403,6 +1990,7 @@ int ubx_port_disconnect_in(ubx_port_t *in_port, const ubx_block_t *iblock)
 		ret = array_block_rm(&in_port->in_interaction, iblock);
 		if (ret != 0)
 			goto out;
+		port_verify(in_port);
 	} else {
 		logf_err(iblock->nd, "port %s is not an in-port", in_port->name);
 		ret = EINVALID_PORT_TYPE;
@@ -1592,7 +2180,7 @@ static int __ubx_config_add(ubx_block_t *b,
 		goto out;
 	}
 
-	cnew = calloc(1, sizeof(struct ubx_config));
+	cnew = blk_zalloc(b, sizeof(struct ubx_config), 0);
 
 	if (cnew == NULL) {
 		ubx_err(b, "EOUTOFMEM");
@@ -1636,7 +2224,7 @@ static int __ubx_config_add(ubx_block_t *b,
 	return 0;
 
 out_free:
-	free(cnew);
+	nd_free(b->nd, cnew);
 out:
 	return ret;
 }
@@ -1801,6 +2389,7 @@ static int __ubx_port_add(ubx_block_t *b,
 			  const long out_data_len)
 {
 	int ret;
+	size_t iact_size;
 	ubx_port_t *pnew;
 
 	if (ubx_port_get(b, name)) {
@@ -1808,7 +2397,12 @@ static int __ubx_port_add(ubx_block_t *b,
 		return EENTEXISTS;
 	}
 
-	pnew = calloc(1, sizeof(struct ubx_port));
+	/* if allocated from the arena, reserve interaction slots
+	 * directly behind the port (see port_iact_slots) */
+	iact_size = ARENA_IACT_SLOTS * sizeof(ubx_block_t *) *
+		((in_type != NULL) + (out_type != NULL));
+
+	pnew = blk_zalloc(b, sizeof(struct ubx_port) + iact_size, 0);
 
 	if (pnew == NULL) {
 		ubx_err(b, "EOUTOFMEM");
@@ -1847,7 +2441,7 @@ static int __ubx_port_add(ubx_block_t *b,
 	return 0;
 
 out_free:
-	free(pnew);
+	nd_free(b->nd, pnew);
 out:
 	return ret;
 }
@@ -2093,6 +2687,7 @@ int ubx_block_init(ubx_block_t *b)
 int ubx_block_start(ubx_block_t *b)
 {
 	int ret;
+	ubx_port_t *p;
 
 	if (b == NULL) {
 		ret = EINVALID_BLOCK;
@@ -2113,6 +2708,11 @@ int ubx_block_start(ubx_block_t *b)
 	if (ret < 0)
 		goto out;
 
+	/* (re-)verify ports, e.g. unconnected or connected before
+	 * the iblocks were initialized */
+	DL_FOREACH(b->ports, p)
+		port_verify(p);
+
 	b->block_state = BLOCK_STATE_ACTIVE;
 
 	if (b->start == NULL)
@@ -2296,16 +2896,21 @@ long __port_read(const ubx_port_t *port, ubx_data_t *data)
 		goto out;
 	}
 
-	/* port completely unconnected? */
+	if (port->attrs & PORT_ATTR_VERIFIED) {
+		ret = __port_read_unchecked(port, data);
+		goto out;
+	}
+
+	/* unverified, skip iblocks without read hook */
 	if (port->in_interaction == NULL)
 		goto out;
 
-	for (iaptr = (ubx_block_t**)port->in_interaction; *iaptr != NULL; iaptr++) {
-		if ((*iaptr)->block_state == BLOCK_STATE_ACTIVE) {
+	for (iaptr = (ubx_block_t **)port->in_interaction; *iaptr != NULL; iaptr++) {
+		if ((*iaptr)->block_state == BLOCK_STATE_ACTIVE && (*iaptr)->read != NULL) {
 			ret = (*iaptr)->read(*iaptr, data);
 			if (ret > 0) {
 				(*iaptr)->stat_num_reads++;
-				goto out;
+				break;
 			}
 		}
 	}
@@ -2323,7 +2928,6 @@ long __port_read(const ubx_port_t *port, ubx_data_t *data)
  */
 void __port_write(const ubx_port_t *port, const ubx_data_t *data)
 {
-	/* int i; */
 	const char *tp;
 	ubx_block_t **iaptr;
 
@@ -2345,13 +2949,17 @@ void __port_write(const ubx_port_t *port, const ubx_data_t *data)
 		goto out;
 	}
 
-	/* port completely unconnected? */
+	if (port->attrs & PORT_ATTR_VERIFIED) {
+		__port_write_unchecked(port, data);
+		goto out;
+	}
+
+	/* unverified, skip iblocks without write hook */
 	if (port->out_interaction == NULL)
 		goto out;
 
-	/* pump it out */
-	for (iaptr = (ubx_block_t**)port->out_interaction; *iaptr != NULL; iaptr++) {
-		if ((*iaptr)->block_state == BLOCK_STATE_ACTIVE) {
+	for (iaptr = (ubx_block_t **)port->out_interaction; *iaptr != NULL; iaptr++) {
+		if ((*iaptr)->block_state == BLOCK_STATE_ACTIVE && (*iaptr)->write != NULL) {
 			(*iaptr)->write(*iaptr, data);
 			(*iaptr)->stat_num_writes++;
 		}
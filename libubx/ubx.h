@@ -48,6 +48,10 @@ struct ubx_proto_config;
 #include "ubx_core.h"
 #include "ubx_time.h"
 #include "ubx_utils.h"
+#include "ubx_arena.h"
+#include "ubx_pool.h"
+#include "ubx_numa.h"
+#include "ubx_model.h"
 #include "accessors.h"
 #include "md5.h"
 #include "rtlog.h"
@@ -168,10 +172,57 @@ typedef struct ubx_proto_block {
 				      const ubx_data_t *value);
 			unsigned long stat_num_reads;
 			unsigned long stat_num_writes;
+			unsigned long stat_num_overruns;
 		};
 	};
 } ubx_proto_block_t;
 
+/*
+ * unchecked port I/O
+ *
+ * These skip all checks of __port_read/__port_write and directly
+ * invoke the hooks of the active iblocks. The caller must ensure that
+ * the port is PORT_ATTR_VERIFIED, that data->type is the port type of
+ * the respective direction and that 0 < data->len <= port data_len.
+ */
+static inline long __port_read_unchecked(const ubx_port_t *port, ubx_data_t *data)
+{
+	long ret = 0;
+	ubx_block_t **iaptr;
+
+	/* port completely unconnected? */
+	if (port->in_interaction == NULL)
+		return 0;
+
+	for (iaptr = (ubx_block_t **)port->in_interaction; *iaptr != NULL; iaptr++) {
+		if ((*iaptr)->block_state == BLOCK_STATE_ACTIVE) {
+			ret = (*iaptr)->read(*iaptr, data);
+			if (ret > 0) {
+				(*iaptr)->stat_num_reads++;
+				break;
+			}
+		}
+	}
+
+	return ret;
+}
+
+static inline void __port_write_unchecked(const ubx_port_t *port, const ubx_data_t *data)
+{
+	ubx_block_t **iaptr;
+
+	/* port completely unconnected? */
+	if (port->out_interaction == NULL)
+		return;
+
+	for (iaptr = (ubx_block_t **)port->out_interaction; *iaptr != NULL; iaptr++) {
+		if ((*iaptr)->block_state == BLOCK_STATE_ACTIVE) {
+			(*iaptr)->write(*iaptr, data);
+			(*iaptr)->stat_num_writes++;
+		}
+	}
+}
+
 #ifdef __cplusplus
 }
 #endif
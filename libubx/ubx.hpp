@@ -0,0 +1,511 @@
+/*
+ * microblx: embedded, realtime safe, reflective function blocks.
+ *
+ * Copyright (C) 2020 Markus Klotzbuecher <mk@mkio.de>
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * Header-only C++ layer for writing blocks with compile-time typed
+ * ports and configs:
+ *
+ *	class Gen : public ubx::Block<Gen> {
+ *		ubx::InPort<double, 3> in;
+ *		ubx::OutPort<double, 3> out;
+ *		ubx::Config<double> gain;
+ *	public:
+ *		Gen(ubx_block_t *b) : Block(b) {
+ *			add(in, "in"); add(out, "out"); add(gain, "gain");
+ *		}
+ *		void step() {
+ *			double v[3];
+ *			if (in.read(v) > 0) { ...; out.write(v); }
+ *		}
+ *	};
+ *
+ *	ubx_proto_block_t gen_proto = {
+ *		...
+ *		.init = ubx::hooks<Gen>::init,
+ *		.start = ubx::hooks<Gen>::start,
+ *		...
+ *	};
+ *
+ * The types and array lengths of all added ports and configs are
+ * verified once when the block is started. After that, reads and
+ * writes use __port_read_unchecked/__port_write_unchecked to directly
+ * invoke the hooks of the connected iblocks on the caller's buffer.
+ */
+
+#ifndef UBX_HPP
+#define UBX_HPP
+
+#include <cstring>
+#include <cstdio>
+#include <new>
+#include <memory>
+#include <exception>
+#include <array>
+#include <vector>
+#include <type_traits>
+#include <initializer_list>
+
+#include "ubx.h"
+
+namespace ubx {
+
+namespace detail {
+
+inline bool name_in(const char *name, std::initializer_list<const char *> names)
+{
+	for (const char *n : names)
+		if (strcmp(name, n) == 0)
+			return true;
+	return false;
+}
+
+/* match the C name of an integer type or the stdint alias of same
+ * size and signedness (e.g. int and int32_t) */
+template <typename T>
+inline bool int_match(const char *name, const char *cname)
+{
+	char alias[16];
+
+	if (strcmp(name, cname) == 0)
+		return true;
+
+	snprintf(alias, sizeof(alias), "%sint%zu_t",
+		 std::is_signed<T>::value ? "" : "u", sizeof(T) * 8);
+
+	return strcmp(name, alias) == 0;
+}
+
+/* call f, turning exceptions into an error code, as these must not
+ * propagate into the C core */
+template <typename F>
+inline int guard(const ubx_block_t *b, const char *hook, F f)
+{
+	try {
+		return f();
+	} catch (const std::bad_alloc &) {
+		ubx_err(b, "EOUTOFMEM: %s: allocation failed", hook);
+		return EOUTOFMEM;
+	} catch (const std::exception &e) {
+		ubx_err(b, "%s: exception: %s", hook, e.what());
+	} catch (...) {
+		ubx_err(b, "%s: unknown exception", hook);
+	}
+	return -1;
+}
+
+} /* namespace detail */
+
+/**
+ * type_traits - map a C++ type to ubx type names
+ *
+ * Specializations must provide a static match(const char *name)
+ * function returning true if the ubx type name refers to T. Use
+ * UBX_CPP_TYPE to define these for custom struct types.
+ */
+template <typename T>
+struct type_traits;
+
+#define UBX_CPP_INT_TYPE(T)						\
+template <> struct type_traits<T> {					\
+	static bool match(const char *name) {				\
+		return detail::int_match<T>(name, #T);			\
+	}								\
+}
+
+template <> struct type_traits<char> {
+	static bool match(const char *name) { return strcmp(name, "char") == 0; }
+};
+
+UBX_CPP_INT_TYPE(signed char);
+UBX_CPP_INT_TYPE(unsigned char);
+UBX_CPP_INT_TYPE(short);
+UBX_CPP_INT_TYPE(unsigned short);
+UBX_CPP_INT_TYPE(int);
+UBX_CPP_INT_TYPE(unsigned int);
+UBX_CPP_INT_TYPE(long);
+UBX_CPP_INT_TYPE(unsigned long);
+UBX_CPP_INT_TYPE(long long);
+UBX_CPP_INT_TYPE(unsigned long long);
+
+#undef UBX_CPP_INT_TYPE
+
+template <> struct type_traits<float> {
+	static bool match(const char *name) { return strcmp(name, "float") == 0; }
+};
+
+template <> struct type_traits<double> {
+	static bool match(const char *name) { return strcmp(name, "double") == 0; }
+};
+
+/**
+ * type_check - check that the ubx type t is compatible with T
+ *
+ * @return 0 if OK, ETYPE_MISMATCH otherwise
+ */
+template <typename T>
+inline int type_check(const ubx_type_t *t)
+{
+	static_assert(std::is_standard_layout<T>::value &&
+		      std::is_trivially_copyable<T>::value,
+		      "ubx types must be standard layout and trivially copyable");
+
+	if (t == NULL || t->size != (long)sizeof(T) || !type_traits<T>::match(t->name))
+		return ETYPE_MISMATCH;
+
+	return 0;
+}
+
+/**
+ * Span - non-owning view of a contiguous array
+ */
+template <typename T>
+class Span {
+	T *ptr_;
+	long len_;
+public:
+	Span() : ptr_(NULL), len_(0) {}
+	Span(T *ptr, long len) : ptr_(ptr), len_(len) {}
+
+	template <size_t N>
+	Span(T (&arr)[N]) : ptr_(arr), len_(N) {}
+
+	template <typename U, size_t N,
+		  typename = typename std::enable_if<std::is_same<const U, T>::value ||
+						     std::is_same<U, T>::value>::type>
+	Span(std::array<U, N> &arr) : ptr_(arr.data()), len_(N) {}
+
+	template <typename U, size_t N,
+		  typename = typename std::enable_if<std::is_same<const U, T>::value>::type>
+	Span(const std::array<U, N> &arr) : ptr_(arr.data()), len_(N) {}
+
+	T *data() const { return ptr_; }
+	long size() const { return len_; }
+	bool empty() const { return len_ == 0; }
+	T *begin() const { return ptr_; }
+	T *end() const { return ptr_ + len_; }
+	T &operator[](long i) const { return ptr_[i]; }
+};
+
+/**
+ * InPort - typed input port of array length N
+ *
+ * read returns the number of elements read (> 0), 0 if no data was
+ * available or a negative PORT_READ_* value, like the C readers.
+ * As the generated C readers, it only takes the fast path while the
+ * port is PORT_ATTR_VERIFIED, which may change when (re)connecting.
+ */
+template <typename T, long N = 1>
+class InPort {
+	static_assert(N > 0, "port array length must be > 0");
+
+	const ubx_port_t *port_ = NULL;
+	const ubx_type_t *type_ = NULL;
+public:
+	/**
+	 * bind - resolve and verify the port
+	 * @return 0 or EINVALID_PORT, EINVALID_PORT_DIR, ETYPE_MISMATCH,
+	 *         EINVALID_DATA_LEN
+	 */
+	int bind(const ubx_block_t *b, const char *name)
+	{
+		const ubx_port_t *p = ubx_port_get(b, name);
+
+		if (p == NULL) {
+			ubx_err(b, "EINVALID_PORT: no port %s", name);
+			return EINVALID_PORT;
+		}
+
+		if (p->in_type == NULL) {
+			ubx_err(b, "EINVALID_PORT_DIR: port %s is not an input port", name);
+			return EINVALID_PORT_DIR;
+		}
+
+		if (type_check<T>(p->in_type) != 0) {
+			ubx_err(b, "ETYPE_MISMATCH: port %s is %s", name, p->in_type->name);
+			return ETYPE_MISMATCH;
+		}
+
+		if (p->in_data_len < N) {
+			ubx_err(b, "EINVALID_DATA_LEN: port %s has len %ld but %ld expected",
+				name, p->in_data_len, N);
+			return EINVALID_DATA_LEN;
+		}
+
+		port_ = p;
+		type_ = p->in_type;
+		return 0;
+	}
+
+	const ubx_port_t *port() const { return port_; }
+
+	long read(Span<T> s) const
+	{
+		ubx_data_t d;
+
+		d.refcnt = 0;
+		d.type = type_;
+		d.len = (s.size() < N) ? s.size() : N;
+		d.data = s.data();
+
+		if (d.len <= 0)
+			return 0;
+
+		if (port_->attrs & PORT_ATTR_VERIFIED)
+			return __port_read_unchecked(port_, &d);
+
+		return __port_read(port_, &d);
+	}
+
+	long read(T (&val)[N]) const { return read(Span<T>(val, N)); }
+	long read(std::array<T, N> &val) const { return read(Span<T>(val.data(), N)); }
+	long read(T &val) const { return read(Span<T>(&val, 1)); }
+};
+
+/**
+ * OutPort - typed output port of array length N
+ *
+ * write takes the fast path only while the port is PORT_ATTR_VERIFIED.
+ */
+template <typename T, long N = 1>
+class OutPort {
+	static_assert(N > 0, "port array length must be > 0");
+
+	const ubx_port_t *port_ = NULL;
+	const ubx_type_t *type_ = NULL;
+public:
+	int bind(const ubx_block_t *b, const char *name)
+	{
+		const ubx_port_t *p = ubx_port_get(b, name);
+
+		if (p == NULL) {
+			ubx_err(b, "EINVALID_PORT: no port %s", name);
+			return EINVALID_PORT;
+		}
+
+		if (p->out_type == NULL) {
+			ubx_err(b, "EINVALID_PORT_DIR: port %s is not an output port", name);
+			return EINVALID_PORT_DIR;
+		}
+
+		if (type_check<T>(p->out_type) != 0) {
+			ubx_err(b, "ETYPE_MISMATCH: port %s is %s", name, p->out_type->name);
+			return ETYPE_MISMATCH;
+		}
+
+		if (p->out_data_len < N) {
+			ubx_err(b, "EINVALID_DATA_LEN: port %s has len %ld but %ld expected",
+				name, p->out_data_len, N);
+			return EINVALID_DATA_LEN;
+		}
+
+		port_ = p;
+		type_ = p->out_type;
+		return 0;
+	}
+
+	const ubx_port_t *port() const { return port_; }
+
+	void write(Span<const T> s) const
+	{
+		ubx_data_t d;
+
+		d.refcnt = 0;
+		d.type = type_;
+		d.len = (s.size() < N) ? s.size() : N;
+		d.data = const_cast<T *>(s.data());
+
+		if (d.len <= 0)
+			return;
+
+		if (port_->attrs & PORT_ATTR_VERIFIED)
+			__port_write_unchecked(port_, &d);
+		else
+			__port_write(port_, &d);
+	}
+
+	void write(const T (&val)[N]) const { write(Span<const T>(val, N)); }
+	void write(const std::array<T, N> &val) const { write(Span<const T>(val.data(), N)); }
+	void write(const T &val) const { write(Span<const T>(&val, 1)); }
+};
+
+/**
+ * Config - typed config
+ *
+ * The value is accessed in place, hence get() reflects changes made
+ * to the config value (but these must not resize it while the block
+ * is running).
+ */
+template <typename T>
+class Config {
+	const ubx_config_t *cfg_ = NULL;
+public:
+	int bind(const ubx_block_t *b, const char *name)
+	{
+		const ubx_config_t *c = ubx_config_get(b, name);
+
+		if (c == NULL) {
+			ubx_err(b, "EINVALID_CONFIG: no config %s", name);
+			return EINVALID_CONFIG;
+		}
+
+		if (type_check<T>(c->type) != 0) {
+			ubx_err(b, "ETYPE_MISMATCH: config %s is %s", name, c->type->name);
+			return ETYPE_MISMATCH;
+		}
+
+		cfg_ = c;
+		return 0;
+	}
+
+	const ubx_config_t *config() const { return cfg_; }
+
+	Span<const T> get() const
+	{
+		return Span<const T>((const T *)cfg_->value->data, cfg_->value->len);
+	}
+
+	long len() const { return cfg_->value->len; }
+
+	/* return the first element or def if unset */
+	T value(const T &def) const
+	{
+		return (cfg_->value->len > 0) ? *(const T *)cfg_->value->data : def;
+	}
+};
+
+/**
+ * Block - CRTP base class of C++ blocks
+ *
+ * Derived classes are constructed in the init hook with the block
+ * pointer and add their ports and configs using add(). They may
+ * define any of init, start, step, stop and cleanup, which are
+ * called (non-virtually) from the respective ubx::hooks.
+ */
+template <class Derived>
+class Block {
+	struct binding {
+		void *obj;
+		const char *name;
+		int (*bind)(void *obj, const ubx_block_t *b, const char *name);
+	};
+
+	std::vector<binding> bindings_;
+
+	template <class P>
+	static int bind_one(void *obj, const ubx_block_t *b, const char *name)
+	{
+		return static_cast<P *>(obj)->bind(b, name);
+	}
+
+protected:
+	ubx_block_t *block;
+
+	explicit Block(ubx_block_t *b) : block(b) {}
+
+	/* add a port or config to be verified and bound on start */
+	template <class P>
+	void add(P &p, const char *name)
+	{
+		bindings_.push_back(binding{ &p, name, &Block::bind_one<P> });
+	}
+
+public:
+	/* bind all added ports and configs */
+	int bind()
+	{
+		for (const binding &bd : bindings_) {
+			int ret = bd.bind(bd.obj, block, bd.name);
+
+			if (ret != 0)
+				return ret;
+		}
+		return 0;
+	}
+
+	/* default hooks */
+	int init() { return 0; }
+	int start() { return 0; }
+	void step() {}
+	void stop() {}
+	void cleanup() {}
+
+	Block(const Block &) = delete;
+	Block &operator=(const Block &) = delete;
+};
+
+/**
+ * hooks - block hooks for the Block derived class B
+ *
+ * init constructs B, cleanup destroys it. start binds (and hence
+ * verifies) all ports and configs before calling B::start.
+ * Exceptions thrown by B are logged. In init and start these make
+ * the hook fail, in the others they are ignored.
+ */
+template <class B>
+struct hooks {
+	static B *self(ubx_block_t *b) { return static_cast<B *>(b->private_data); }
+
+	static int init(ubx_block_t *b)
+	{
+		return detail::guard(b, "init", [b]() {
+			std::unique_ptr<B> o(new B(b));
+			int ret = o->init();
+
+			if (ret == 0)
+				b->private_data = o.release();
+
+			return ret;
+		});
+	}
+
+	static int start(ubx_block_t *b)
+	{
+		return detail::guard(b, "start", [b]() {
+			int ret = self(b)->bind();
+
+			if (ret != 0)
+				return ret;
+
+			return self(b)->start();
+		});
+	}
+
+	static void step(ubx_block_t *b)
+	{
+		detail::guard(b, "step", [b]() { self(b)->step(); return 0; });
+	}
+
+	static void stop(ubx_block_t *b)
+	{
+		detail::guard(b, "stop", [b]() { self(b)->stop(); return 0; });
+	}
+
+	static void cleanup(ubx_block_t *b)
+	{
+		detail::guard(b, "cleanup", [b]() { self(b)->cleanup(); return 0; });
+		delete self(b);
+		b->private_data = NULL;
+	}
+};
+
+} /* namespace ubx */
+
+/**
+ * UBX_CPP_TYPE - declare the ubx type name of a C++ struct type
+ *
+ * Must be used at global scope, e.g.
+ * UBX_CPP_TYPE(struct cpp_demo_type, "struct cpp_demo_type");
+ */
+#define UBX_CPP_TYPE(T, ...)						\
+namespace ubx {								\
+template <> struct type_traits<T> {					\
+	static bool match(const char *name) {				\
+		return detail::name_in(name, { __VA_ARGS__ });		\
+	}								\
+};									\
+}
+
+#endif /* UBX_HPP */
@@ -0,0 +1,162 @@
+/*
+ * microblx node memory arena
+ *
+ * A simple bump allocator that serves the node's long lived metadata
+ * (block instances, ports, configs and interaction arrays) from a
+ * single mlocked and prefaulted region. Individual allocations are
+ * never freed, instead the whole arena is released at once.
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ */
+
+#include "ubx.h"
+
+/**
+ * ubx_mmap_locked - map, lock and prefault anonymous memory
+ *
+ * @size: requested size in bytes. Is rounded up to a multiple of the
+ *        page size.
+ *
+ * @return pointer to memory or NULL in case of error
+ */
+void *ubx_mmap_locked(size_t *size)
+{
+	long pgsz = sysconf(_SC_PAGESIZE);
+	uint8_t *mem;
+
+	*size = (*size + pgsz - 1) & ~(pgsz - 1);
+
+	mem = mmap(NULL, *size, PROT_READ | PROT_WRITE,
+		   MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+
+	if (mem == MAP_FAILED)
+		return NULL;
+
+	if (mlock(mem, *size) != 0) {
+		munmap(mem, *size);
+		return NULL;
+	}
+
+	ubx_prefault(mem, *size);
+	return mem;
+}
+
+/**
+ * ubx_munmap_locked - release memory obtained with ubx_mmap_locked
+ *
+ * @ptr: memory
+ * @size: size as returned by ubx_mmap_locked
+ */
+void ubx_munmap_locked(void *ptr, size_t size)
+{
+	munlock(ptr, size);
+	munmap(ptr, size);
+}
+
+/**
+ * ubx_prefault - touch every page of a memory region
+ *
+ * MAP_POPULATE and mlock are only hints regarding when the pages are
+ * faulted in, so write each page once to be sure.
+ *
+ * @ptr: start of region
+ * @size: size in bytes
+ */
+void ubx_prefault(void *ptr, size_t size)
+{
+	long pgsz = sysconf(_SC_PAGESIZE);
+	volatile uint8_t *mem = ptr;
+	size_t off;
+
+	for (off = 0; off < size; off += pgsz)
+		mem[off] = mem[off];
+}
+
+/**
+ * ubx_arena_init - allocate, lock and prefault an arena
+ *
+ * @a: arena to initialize
+ * @size: size in bytes. Rounded up to a multiple of the page size.
+ *
+ * @return 0 if OK, EOUTOFMEM if mapping or locking the memory failed.
+ */
+int ubx_arena_init(struct ubx_arena *a, size_t size)
+{
+	memset(a, 0, sizeof(*a));
+
+	a->base = ubx_mmap_locked(&size);
+
+	if (a->base == NULL)
+		return EOUTOFMEM;
+
+	a->size = size;
+	return 0;
+}
+
+/**
+ * ubx_arena_cleanup - release an arena
+ *
+ * All memory allocated from the arena becomes invalid.
+ *
+ * @a: arena to release
+ */
+void ubx_arena_cleanup(struct ubx_arena *a)
+{
+	if (a->base == NULL)
+		return;
+
+	ubx_munmap_locked(a->base, a->size);
+	memset(a, 0, sizeof(*a));
+}
+
+/**
+ * ubx_arena_alloc - allocate zeroed memory from an arena
+ *
+ * @a: arena
+ * @size: number of bytes
+ * @align: alignment (power of two) or 0 for UBX_ARENA_ALIGN
+ *
+ * @return pointer to memory or NULL if the arena is not initialized
+ *         or exhausted.
+ */
+void *ubx_arena_alloc(struct ubx_arena *a, size_t size, size_t align)
+{
+	size_t start;
+
+	if (a->base == NULL)
+		return NULL;
+
+	if (align == 0)
+		align = UBX_ARENA_ALIGN;
+
+	start = (a->used + align - 1) & ~(align - 1);
+
+	if (start + size > a->size || start + size < start) {
+		a->num_fallbacks++;
+		return NULL;
+	}
+
+	a->used = start + size;
+	a->num_allocs++;
+
+	/* fresh arena memory is zero, so no memset required */
+	return a->base + start;
+}
+
+/**
+ * ubx_arena_owns - check whether memory was allocated from an arena
+ *
+ * @a: arena
+ * @ptr: pointer to check
+ *
+ * @return 1 if ptr lies within the arena, 0 otherwise
+ */
+int ubx_arena_owns(const struct ubx_arena *a, const void *ptr)
+{
+	const uint8_t *p = ptr;
+
+	if (a == NULL || a->base == NULL)
+		return 0;
+
+	return p >= a->base && p < a->base + a->size;
+}
@@ -0,0 +1,23 @@
+/*
+ * microblx node memory arena
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ */
+
+#ifndef _UBX_ARENA_H
+#define _UBX_ARENA_H
+
+#define UBX_ARENA_SIZE_DEFAULT		(8 * 1024 * 1024)
+#define UBX_ARENA_ALIGN			16
+#define UBX_CACHELINE_SIZE		64
+
+void *ubx_mmap_locked(size_t *size);
+void ubx_munmap_locked(void *ptr, size_t size);
+void ubx_prefault(void *ptr, size_t size);
+
+int ubx_arena_init(struct ubx_arena *a, size_t size);
+void ubx_arena_cleanup(struct ubx_arena *a);
+void *ubx_arena_alloc(struct ubx_arena *a, size_t size, size_t align);
+int ubx_arena_owns(const struct ubx_arena *a, const void *ptr);
+
+#endif /* _UBX_ARENA_H */
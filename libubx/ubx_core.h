@@ -29,12 +29,21 @@ int ubx_num_blocks(ubx_node_t *nd);
 int ubx_num_types(ubx_node_t *nd);
 int ubx_num_modules(ubx_node_t *nd);
 
+/* lock the block tables of all nodes against registration and removal */
+void ubx_blocks_lock(void);
+void ubx_blocks_unlock(void);
+
 /* blocks */
 ubx_block_t *ubx_block_get(ubx_node_t *nd, const char *name);
 ubx_block_t *ubx_block_create(ubx_node_t *nd, const char *type, const char *name);
 void ubx_block_free(ubx_block_t *b);
 int ubx_block_rm(ubx_node_t *nd, const char *name);
 
+/* block private data */
+void *ubx_block_alloc_private(ubx_block_t *b, size_t size);
+void ubx_block_free_private(ubx_block_t *b, void *ptr);
+long ubx_block_migrate_private(ubx_block_t *b, int node);
+
 /* lifecycle hooks */
 int ubx_block_init(ubx_block_t *b);
 int ubx_block_start(ubx_block_t *b);
@@ -114,6 +123,9 @@ ubx_data_t *ubx_config_get_data(const ubx_block_t *b, const char *name);
 long ubx_config_get_data_ptr(const ubx_block_t *b, const char *name, void **ptr);
 long ubx_config_data_len(const ubx_block_t *b, const char *cfg_name);
 int ubx_config_assign(ubx_config_t *c, ubx_data_t *d);
+int ubx_config_publish(ubx_config_t *c, const ubx_data_t *d);
+int ubx_config_changed(ubx_config_t *c);
+unsigned long ubx_config_version(const ubx_config_t *c);
 int ubx_config_add2(ubx_block_t *b, const char *name, const char *doc, const char *type_name, uint16_t min, uint16_t max, uint32_t attrs);
 int ubx_config_add(ubx_block_t *b, const char *name, const char *doc, const char *type_name);
 int ubx_config_rm(ubx_block_t *b, const char *name);
@@ -0,0 +1,514 @@
+/*
+ * microblx: embedded, realtime safe, reflective function blocks.
+ *
+ * Copyright (C) 2020 Markus Klotzbuecher <mk@mkio.de>
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * Loader for compiled binary models (see ubx_model.h).
+ *
+ * This allows to deploy a system that was validated and compiled
+ * with blockdiagram without requiring luajit on the target. All
+ * references are already resolved, so loading boils down to loading
+ * the modules, creating the blocks, copying the config values and
+ * connecting the ports.
+ */
+
+#include <stdlib.h>
+
+#include "ubx.h"
+
+#define logf_err(nd, fmt, ...)		ubx_log(UBX_LOGLEVEL_ERR,    nd, __func__, fmt, ##__VA_ARGS__)
+#define logf_info(nd, fmt, ...)		ubx_log(UBX_LOGLEVEL_INFO,   nd, __func__, fmt, ##__VA_ARGS__)
+
+#define MODEL_ALIGN(n)	(((n) + UBX_MODEL_ALIGN - 1) & ~((uint64_t)UBX_MODEL_ALIGN - 1))
+
+/* model string */
+#define MSTR(m, off)	((m)->strtab + (off))
+
+/* check that a section fits into the model and advance off */
+static int model_section(const uint8_t *base, uint64_t len, uint64_t *off,
+			 uint64_t num, size_t elem_size, const void **sec)
+{
+	uint64_t size = num * elem_size;
+
+	if (num > UINT32_MAX || *off > len || size > len - *off)
+		return -1;
+
+	*sec = base + *off;
+	*off = MODEL_ALIGN(*off + size);
+	return 0;
+}
+
+/* check a serialized ubx_data value against the blob area */
+static int model_data_check(const struct ubx_model *m, const struct ubx_model_data *d)
+{
+	if (d->blob > m->hdr->blob_len || d->size > m->hdr->blob_len - d->blob)
+		return -1;
+	return 0;
+}
+
+/**
+ * ubx_model_open - open and validate a compiled model
+ *
+ * This checks the header and that all sections, strings, indices and
+ * values are within the bounds of the model, so that the other
+ * ubx_model_ functions can access these without further checks. The
+ * model is not copied, hence @buf must remain valid until
+ * ubx_model_instantiate returns.
+ *
+ * @m: model to initialize
+ * @buf: buffer holding the model
+ * @len: length of buf in bytes
+ *
+ * @return 0 if OK, EINVALID_ARG if the model is malformed
+ */
+int ubx_model_open(struct ubx_model *m, const void *buf, size_t len)
+{
+	const struct ubx_model_hdr *hdr = buf;
+	const uint8_t *base = buf;
+	uint64_t off;
+	uint32_t i;
+
+	memset(m, 0x0, sizeof(struct ubx_model));
+
+	if (len < sizeof(struct ubx_model_hdr))
+		return EINVALID_ARG;
+
+	if (hdr->magic != UBX_MODEL_MAGIC ||
+	    hdr->version != UBX_MODEL_VERSION ||
+	    hdr->ptr_size != sizeof(void *) ||
+	    hdr->size != len)
+		return EINVALID_ARG;
+
+	m->hdr = hdr;
+	off = MODEL_ALIGN(sizeof(struct ubx_model_hdr));
+
+	if (model_section(base, len, &off, hdr->num_deps,
+			  sizeof(struct ubx_model_dep), (const void **)&m->deps) ||
+	    model_section(base, len, &off, hdr->num_modules,
+			  sizeof(uint32_t), (const void **)&m->modules) ||
+	    model_section(base, len, &off, hdr->num_blocks,
+			  sizeof(struct ubx_model_block), (const void **)&m->mblocks) ||
+	    model_section(base, len, &off, hdr->num_ndcfgs,
+			  sizeof(struct ubx_model_ndcfg), (const void **)&m->mndcfgs) ||
+	    model_section(base, len, &off, hdr->num_configs,
+			  sizeof(struct ubx_model_config), (const void **)&m->configs) ||
+	    model_section(base, len, &off, hdr->num_relocs,
+			  sizeof(struct ubx_model_reloc), (const void **)&m->relocs) ||
+	    model_section(base, len, &off, hdr->num_conns,
+			  sizeof(struct ubx_model_conn), (const void **)&m->conns) ||
+	    model_section(base, len, &off, hdr->strtab_len,
+			  1, (const void **)&m->strtab))
+		goto out_inval;
+
+	/* off may exceed len due to the alignment of the strtab */
+	if (off > len || hdr->blob_len != len - off)
+		goto out_inval;
+
+	m->blobs = base + off;
+
+	/* all strings must be terminated and offset 0 is "" */
+	if (hdr->strtab_len == 0 ||
+	    m->strtab[0] != '\0' ||
+	    m->strtab[hdr->strtab_len - 1] != '\0')
+		goto out_inval;
+
+	for (i = 0; i < hdr->num_deps; i++)
+		if (m->deps[i].path >= hdr->strtab_len)
+			goto out_inval;
+
+	for (i = 0; i < hdr->num_modules; i++)
+		if (m->modules[i] >= hdr->strtab_len)
+			goto out_inval;
+
+	for (i = 0; i < hdr->num_blocks; i++)
+		if (m->mblocks[i].name >= hdr->strtab_len ||
+		    m->mblocks[i].type >= hdr->strtab_len)
+			goto out_inval;
+
+	for (i = 0; i < hdr->num_ndcfgs; i++)
+		if (m->mndcfgs[i].name >= hdr->strtab_len ||
+		    model_data_check(m, &m->mndcfgs[i].data))
+			goto out_inval;
+
+	for (i = 0; i < hdr->num_configs; i++) {
+		const struct ubx_model_config *c = &m->configs[i];
+
+		if (c->block >= hdr->num_blocks || c->name >= hdr->strtab_len)
+			goto out_inval;
+
+		if (c->flags & UBX_MODEL_CFG_NDCFG) {
+			if (c->ndcfg >= hdr->num_ndcfgs)
+				goto out_inval;
+		} else if (model_data_check(m, &c->data)) {
+			goto out_inval;
+		}
+	}
+
+	/* relocs must be sorted by config, see model_relocs_apply */
+	for (i = 0; i < hdr->num_relocs; i++) {
+		const struct ubx_model_reloc *r = &m->relocs[i];
+
+		if (r->config >= hdr->num_configs ||
+		    r->block >= hdr->num_blocks ||
+		    (i > 0 && r->config < m->relocs[i - 1].config) ||
+		    m->configs[r->config].flags & UBX_MODEL_CFG_NDCFG ||
+		    r->offset > m->configs[r->config].data.size ||
+		    m->configs[r->config].data.size - r->offset < sizeof(ubx_block_t *))
+			goto out_inval;
+	}
+
+	for (i = 0; i < hdr->num_conns; i++)
+		if (m->conns[i].block >= hdr->num_blocks ||
+		    m->conns[i].iblock >= hdr->num_blocks ||
+		    m->conns[i].port >= hdr->strtab_len)
+			goto out_inval;
+
+	return 0;
+
+out_inval:
+	memset(m, 0x0, sizeof(struct ubx_model));
+	return EINVALID_ARG;
+}
+
+/**
+ * ubx_model_str - return a string of the model string table
+ *
+ * @m: opened model
+ * @off: strtab offset
+ *
+ * @return string
+ */
+const char *ubx_model_str(const struct ubx_model *m, uint32_t off)
+{
+	return MSTR(m, off);
+}
+
+/**
+ * ubx_model_load_modules - load the modules required by a model
+ *
+ * Absolute module paths are loaded as is, all others are loaded from
+ * @moddir. As in ubx.load_module, the ".so" suffix is optional.
+ *
+ * @nd: node
+ * @m: opened model
+ * @moddir: module directory (e.g. /usr/local/lib/ubx/0.9)
+ *
+ * @return 0 if OK, <0 otherwise
+ */
+int ubx_model_load_modules(ubx_node_t *nd, const struct ubx_model *m, const char *moddir)
+{
+	int ret;
+	uint32_t i;
+	size_t len;
+	const char *name, *sfx;
+	char path[PATH_MAX];
+
+	for (i = 0; i < m->hdr->num_modules; i++) {
+		name = MSTR(m, m->modules[i]);
+
+		len = strlen(name);
+		sfx = (len > 3 && strcmp(name + len - 3, ".so") == 0) ? "" : ".so";
+
+		if (name[0] == '/')
+			ret = snprintf(path, PATH_MAX, "%s", name);
+		else
+			ret = snprintf(path, PATH_MAX, "%s/%s%s", moddir, name, sfx);
+
+		if (ret >= PATH_MAX) {
+			logf_err(nd, "module path of %s too long", name);
+			return EINVALID_ARG;
+		}
+
+		ret = ubx_module_load(nd, path);
+
+		if (ret != 0) {
+			logf_err(nd, "failed to load module %s", path);
+			return ret;
+		}
+	}
+
+	return 0;
+}
+
+/* look up and check the type of a serialized value */
+static const ubx_type_t *model_data_type(ubx_node_t *nd, const struct ubx_model_data *d)
+{
+	const ubx_type_t *typ = ubx_type_get_by_hash(nd, d->type_hash);
+
+	if (typ == NULL || d->size != d->len * typ->size)
+		return NULL;
+
+	return typ;
+}
+
+/* patch the block pointers into the value of config ci. *cur is the
+ * index of the first reloc not yet applied */
+static void model_relocs_apply(const struct ubx_model *m, uint32_t ci,
+			       uint32_t *cur, ubx_data_t *d)
+{
+	const struct ubx_model_reloc *r;
+
+	while (*cur < m->hdr->num_relocs && m->relocs[*cur].config < ci)
+		(*cur)++;
+
+	for (; *cur < m->hdr->num_relocs && m->relocs[*cur].config == ci; (*cur)++) {
+		r = &m->relocs[*cur];
+		memcpy((uint8_t *)d->data + r->offset,
+		       &m->blocks[r->block], sizeof(ubx_block_t *));
+	}
+}
+
+/* apply all early (late=0) or late (late=1) configs */
+static int model_configs_apply(ubx_node_t *nd, const struct ubx_model *m, int late)
+{
+	int ret;
+	uint32_t i, cur = 0;
+	ubx_block_t *b;
+	ubx_config_t *c;
+	const char *name;
+	const struct ubx_model_config *mc;
+
+	for (i = 0; i < m->hdr->num_configs; i++) {
+		mc = &m->configs[i];
+
+		if (!(mc->flags & UBX_MODEL_CFG_LATE) != !late)
+			continue;
+
+		b = m->blocks[mc->block];
+		name = MSTR(m, mc->name);
+		c = ubx_config_get(b, name);
+
+		if (c == NULL) {
+			logf_err(nd, "block %s has no config %s", b->name, name);
+			return EINVALID_CONFIG;
+		}
+
+		if (mc->flags & UBX_MODEL_CFG_NDCFG) {
+			ret = ubx_config_assign(c, m->ndcfgs[mc->ndcfg]);
+
+			if (ret != 0) {
+				logf_err(nd, "failed to assign node config to %s.%s: %d",
+					 b->name, name, ret);
+				return ret;
+			}
+			continue;
+		}
+
+		/* the config type is known, so compare the hash directly
+		 * instead of looking up the type */
+		if (memcmp(c->type->hash, mc->data.type_hash, UBX_TYPE_HASH_LEN) != 0 ||
+		    mc->data.size != mc->data.len * c->type->size) {
+			logf_err(nd, "config %s.%s: type mismatch", b->name, name);
+			return ETYPE_MISMATCH;
+		}
+
+		ret = ubx_data_resize(c->value, mc->data.len);
+
+		if (ret != 0) {
+			logf_err(nd, "config %s.%s: failed to resize to %lu",
+				 b->name, name, (unsigned long)mc->data.len);
+			return ret;
+		}
+
+		if (mc->data.size > 0)
+			memcpy(c->value->data, m->blobs + mc->data.blob, mc->data.size);
+
+		model_relocs_apply(m, i, &cur, c->value);
+	}
+
+	return 0;
+}
+
+/**
+ * ubx_model_instantiate - create a system from a compiled model
+ *
+ * Create all blocks, allocate the node configs, apply the configs,
+ * initialize the blocks, apply the late configs and connect the
+ * ports. The modules must already be loaded (see
+ * ubx_model_load_modules). The types of all config values are
+ * checked by hash before copying them in.
+ *
+ * In case of failure, the blocks created so far are not removed
+ * from the node. The caller is expected to call ubx_node_rm and then
+ * ubx_model_close.
+ *
+ * @nd: node
+ * @m: opened model
+ *
+ * @return 0 if OK, <0 otherwise
+ */
+int ubx_model_instantiate(ubx_node_t *nd, struct ubx_model *m)
+{
+	int ret;
+	uint32_t i;
+	ubx_block_t *b;
+	ubx_port_t *p;
+	const char *name;
+	const ubx_type_t *typ;
+	const struct ubx_model_hdr *hdr = m->hdr;
+	const struct ubx_model_ndcfg *mnc;
+	const struct ubx_model_conn *mc;
+
+	m->blocks = calloc(hdr->num_blocks + 1, sizeof(ubx_block_t *));
+	m->ndcfgs = calloc(hdr->num_ndcfgs + 1, sizeof(ubx_data_t *));
+
+	if (m->blocks == NULL || m->ndcfgs == NULL) {
+		logf_err(nd, "failed to allocate model tables");
+		return EOUTOFMEM;
+	}
+
+	for (i = 0; i < hdr->num_blocks; i++) {
+		name = MSTR(m, m->mblocks[i].name);
+		m->blocks[i] = ubx_block_create(nd, MSTR(m, m->mblocks[i].type), name);
+
+		if (m->blocks[i] == NULL) {
+			logf_err(nd, "failed to create block %s of type %s",
+				 name, MSTR(m, m->mblocks[i].type));
+			return EINVALID_BLOCK;
+		}
+	}
+
+	for (i = 0; i < hdr->num_ndcfgs; i++) {
+		mnc = &m->mndcfgs[i];
+		typ = model_data_type(nd, &mnc->data);
+
+		if (typ == NULL) {
+			logf_err(nd, "node config %s: type not found or mismatching",
+				 MSTR(m, mnc->name));
+			return ETYPE_MISMATCH;
+		}
+
+		m->ndcfgs[i] = __ubx_data_alloc(typ, mnc->data.len);
+
+		if (m->ndcfgs[i] == NULL) {
+			logf_err(nd, "failed to allocate node config %s",
+				 MSTR(m, mnc->name));
+			return EOUTOFMEM;
+		}
+
+		if (mnc->data.size > 0)
+			memcpy(m->ndcfgs[i]->data, m->blobs + mnc->data.blob,
+			       mnc->data.size);
+	}
+
+	ret = model_configs_apply(nd, m, 0);
+
+	if (ret != 0)
+		return ret;
+
+	for (i = 0; i < hdr->num_blocks; i++) {
+		ret = ubx_block_init(m->blocks[i]);
+
+		if (ret != 0) {
+			logf_err(nd, "failed to initialize block %s: %d",
+				 m->blocks[i]->name, ret);
+			return ret;
+		}
+	}
+
+	ret = model_configs_apply(nd, m, 1);
+
+	if (ret != 0)
+		return ret;
+
+	for (i = 0; i < hdr->num_conns; i++) {
+		mc = &m->conns[i];
+		b = m->blocks[mc->block];
+		name = MSTR(m, mc->port);
+		p = ubx_port_get(b, name);
+
+		if (p == NULL) {
+			logf_err(nd, "block %s has no port %s", b->name, name);
+			return EINVALID_PORT;
+		}
+
+		if (mc->dir == UBX_MODEL_CONN_IN)
+			ret = ubx_port_connect_in(p, m->blocks[mc->iblock]);
+		else
+			ret = ubx_port_connect_out(p, m->blocks[mc->iblock]);
+
+		if (ret != 0) {
+			logf_err(nd, "failed to connect %s.%s to %s: %d", b->name,
+				 name, m->blocks[mc->iblock]->name, ret);
+			return ret;
+		}
+	}
+
+	logf_info(nd, "instantiated %u blocks, %u configs, %u connections",
+		  hdr->num_blocks, hdr->num_configs, hdr->num_conns);
+
+	return 0;
+}
+
+/* start order: iblocks, passive cblocks, active cblocks */
+static int model_start_pass(const ubx_block_t *b)
+{
+	if (b->type == BLOCK_TYPE_INTERACTION)
+		return 0;
+	if (b->attrs & BLOCK_ATTR_ACTIVE)
+		return 2;
+	return 1;
+}
+
+/**
+ * ubx_model_start - start the blocks of an instantiated model
+ *
+ * The interaction blocks are started first, then the passive and
+ * finally the active computation blocks, so that no block is
+ * triggered before its ports can be used. Blocks which are already
+ * active are skipped. The model buffer is not accessed anymore.
+ *
+ * @m: instantiated model
+ *
+ * @return 0 if OK, <0 otherwise
+ */
+int ubx_model_start(const struct ubx_model *m)
+{
+	int ret, pass;
+	uint32_t i;
+	ubx_block_t *b;
+
+	for (pass = 0; pass < 3; pass++) {
+		for (i = 0; m->blocks[i] != NULL; i++) {
+			b = m->blocks[i];
+
+			if (b->block_state != BLOCK_STATE_INACTIVE ||
+			    model_start_pass(b) != pass)
+				continue;
+
+			ret = ubx_block_start(b);
+
+			if (ret != 0) {
+				ubx_err(b, "failed to start block: %d", ret);
+				return ret;
+			}
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * ubx_model_close - release the resources of a model
+ *
+ * This drops the references to the node configs, which are freed
+ * once the last block using them is removed. The blocks themselves
+ * are owned by the node. The model buffer may be released after
+ * ubx_model_instantiate returned, as ubx_model_start and
+ * ubx_model_close only use the NULL terminated @blocks and @ndcfgs.
+ *
+ * @m: model
+ */
+void ubx_model_close(struct ubx_model *m)
+{
+	uint32_t i;
+
+	for (i = 0; m->ndcfgs != NULL && m->ndcfgs[i] != NULL; i++)
+		ubx_data_free(m->ndcfgs[i]);
+
+	free(m->ndcfgs);
+	free(m->blocks);
+	memset(m, 0x0, sizeof(struct ubx_model));
+}
@@ -0,0 +1,206 @@
+/*
+ * microblx: embedded, realtime safe, reflective function blocks.
+ *
+ * Copyright (C) 2020 Markus Klotzbuecher <mk@mkio.de>
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * Compiled binary model format.
+ *
+ * A compiled model is a validated and flattened system with all
+ * references resolved. It is produced by blockdiagram's
+ * system:compile and consists of a header followed by these
+ * sections, each starting at an 8 byte aligned offset:
+ *
+ *   deps[num_deps]		source files the model was compiled from
+ *   modules[num_modules]	uint32_t strtab offsets of module names
+ *   blocks[num_blocks]		block instances in creation order
+ *   ndcfgs[num_ndcfgs]		node configs
+ *   configs[num_configs]	block configs
+ *   relocs[num_relocs]		block pointers to patch into configs
+ *   conns[num_conns]		port to iblock connections
+ *   strtab[strtab_len]		zero terminated strings
+ *   blobs[blob_len]		raw config values
+ *
+ * Config values are stored as the raw memory of the value and are
+ * keyed by the binary hash of their type, so a model can only be
+ * loaded on a host of the same ABI and with matching types.
+ *
+ * Models are loaded from C with ubx_model_open,
+ * ubx_model_load_modules, ubx_model_instantiate and ubx_model_start
+ * (see ubx_model.c and tools/ubx-mlaunch.c).
+ *
+ * This file is luajit-ffi parsable.
+ */
+
+#ifndef UBX_MODEL_H
+#define UBX_MODEL_H
+
+enum {
+	UBX_MODEL_MAGIC		= 0x4d584255,	/* "UBXM" */
+	UBX_MODEL_VERSION	= 1,
+	UBX_MODEL_ALIGN		= 8,
+};
+
+/* config flags */
+enum {
+	UBX_MODEL_CFG_LATE	= 1 << 0,	/* apply after block init */
+	UBX_MODEL_CFG_NDCFG	= 1 << 1,	/* assign node config ndcfg */
+};
+
+/* connection directions */
+enum {
+	UBX_MODEL_CONN_IN	= 1,		/* iblock -> port */
+	UBX_MODEL_CONN_OUT	= 2,		/* port -> iblock */
+};
+
+/**
+ * struct ubx_model_hdr - compiled model header
+ * @magic: UBX_MODEL_MAGIC
+ * @version: UBX_MODEL_VERSION
+ * @ptr_size: sizeof(void*) of the compiling host
+ * @src_hash: md5 of the model sources (the cache key)
+ * @num_*: number of entries of the respective section
+ * @strtab_len: size of the string table in bytes
+ * @blob_len: size of the blob area in bytes
+ * @size: total size of the model in bytes
+ */
+struct ubx_model_hdr {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t ptr_size;
+	uint8_t src_hash[UBX_TYPE_HASH_LEN];
+	uint32_t num_deps;
+	uint32_t num_modules;
+	uint32_t num_blocks;
+	uint32_t num_ndcfgs;
+	uint32_t num_configs;
+	uint32_t num_relocs;
+	uint32_t num_conns;
+	uint32_t strtab_len;
+	uint64_t blob_len;
+	uint64_t size;
+};
+
+/**
+ * struct ubx_model_dep - source file dependency
+ * @hash: md5 of the file contents at compile time
+ * @path: strtab offset of the file path
+ */
+struct ubx_model_dep {
+	uint8_t hash[UBX_TYPE_HASH_LEN];
+	uint32_t path;
+	uint32_t pad;
+};
+
+/**
+ * struct ubx_model_block - block instance
+ * @name: strtab offset of the (fully qualified) block name
+ * @type: strtab offset of the prototype name
+ */
+struct ubx_model_block {
+	uint32_t name;
+	uint32_t type;
+};
+
+/**
+ * struct ubx_model_data - serialized ubx_data value
+ * @type_hash: binary hash of the value type
+ * @len: array length
+ * @size: size in bytes (len * type size)
+ * @blob: offset of the value in the blob area
+ */
+struct ubx_model_data {
+	uint8_t type_hash[UBX_TYPE_HASH_LEN];
+	uint64_t len;
+	uint64_t size;
+	uint64_t blob;
+};
+
+/**
+ * struct ubx_model_ndcfg - node config
+ * @name: strtab offset of the node config name
+ * @data: value
+ */
+struct ubx_model_ndcfg {
+	uint32_t name;
+	uint32_t pad;
+	struct ubx_model_data data;
+};
+
+/**
+ * struct ubx_model_config - block config value
+ * @block: index of the block
+ * @name: strtab offset of the config name
+ * @flags: UBX_MODEL_CFG_*
+ * @ndcfg: index of the node config if UBX_MODEL_CFG_NDCFG is set
+ * @data: value if UBX_MODEL_CFG_NDCFG is not set
+ */
+struct ubx_model_config {
+	uint32_t block;
+	uint32_t name;
+	uint32_t flags;
+	uint32_t ndcfg;
+	struct ubx_model_data data;
+};
+
+/**
+ * struct ubx_model_reloc - block pointer stored in a config value
+ * @config: index of the config
+ * @block: index of the block whose pointer is to be stored
+ * @offset: byte offset of the pointer in the config value
+ */
+struct ubx_model_reloc {
+	uint32_t config;
+	uint32_t block;
+	uint64_t offset;
+};
+
+/**
+ * struct ubx_model_conn - connection of a port to an iblock
+ * @block: index of the block owning the port
+ * @port: strtab offset of the port name
+ * @iblock: index of the iblock
+ * @dir: UBX_MODEL_CONN_IN or UBX_MODEL_CONN_OUT
+ */
+struct ubx_model_conn {
+	uint32_t block;
+	uint32_t port;
+	uint32_t iblock;
+	uint32_t dir;
+};
+
+/**
+ * struct ubx_model - an opened compiled model
+ * @hdr: model header, the start of the model buffer
+ * @deps..@blobs: pointers to the respective sections
+ * @blocks: NULL terminated block handles, see ubx_model_instantiate
+ * @ndcfgs: NULL terminated node config values
+ *
+ * The section pointers refer to the buffer passed to ubx_model_open,
+ * which must remain valid until ubx_model_instantiate returns.
+ */
+struct ubx_model {
+	const struct ubx_model_hdr *hdr;
+	const struct ubx_model_dep *deps;
+	const uint32_t *modules;
+	const struct ubx_model_block *mblocks;
+	const struct ubx_model_ndcfg *mndcfgs;
+	const struct ubx_model_config *configs;
+	const struct ubx_model_reloc *relocs;
+	const struct ubx_model_conn *conns;
+	const char *strtab;
+	const uint8_t *blobs;
+
+	ubx_block_t **blocks;
+	ubx_data_t **ndcfgs;
+};
+
+int ubx_model_open(struct ubx_model *m, const void *buf, size_t len);
+const char *ubx_model_str(const struct ubx_model *m, uint32_t off);
+int ubx_model_load_modules(ubx_node_t *nd, const struct ubx_model *m, const char *moddir);
+int ubx_model_instantiate(ubx_node_t *nd, struct ubx_model *m);
+int ubx_model_start(const struct ubx_model *m);
+void ubx_model_close(struct ubx_model *m);
+
+#endif /* UBX_MODEL_H */
@@ -0,0 +1,161 @@
+/*
+ * microblx NUMA helpers
+ *
+ * Minimal NUMA support based on the raw getcpu(2), mbind(2) and
+ * move_pages(2) syscalls to avoid a dependency on libnuma.
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ */
+
+#define _GNU_SOURCE
+#include <sys/syscall.h>
+
+#include "ubx.h"
+
+#ifndef MPOL_BIND
+# define MPOL_BIND	2
+#endif
+
+#ifndef MPOL_MF_MOVE
+# define MPOL_MF_MOVE	(1 << 1)
+#endif
+
+#define NUMA_NODE_POSSIBLE	"/sys/devices/system/node/possible"
+#define NUMA_MOVE_BATCH		64
+#define NUMA_MAX_NODES		1024
+#define NUMA_MASK_BITS		(8 * sizeof(unsigned long))
+
+static int numa_num_nodes;
+
+/**
+ * ubx_numa_num_nodes - return the number of possible NUMA nodes
+ *
+ * The value is read from sysfs once and cached.
+ *
+ * @return number of nodes (>= 1)
+ */
+int ubx_numa_num_nodes(void)
+{
+	FILE *fp;
+	int first, last;
+
+	if (numa_num_nodes > 0)
+		return numa_num_nodes;
+
+	numa_num_nodes = 1;
+
+	fp = fopen(NUMA_NODE_POSSIBLE, "r");
+
+	if (fp == NULL)
+		return numa_num_nodes;
+
+	/* format is either "0" or "0-N" */
+	switch (fscanf(fp, "%d-%d", &first, &last)) {
+	case 2:
+		numa_num_nodes = last + 1;
+		break;
+	case 1:
+		numa_num_nodes = first + 1;
+		break;
+	}
+
+	fclose(fp);
+	return numa_num_nodes;
+}
+
+/**
+ * ubx_numa_cur_node - return the NUMA node of the calling thread
+ *
+ * @return node id or < 0 in case of error
+ */
+int ubx_numa_cur_node(void)
+{
+	unsigned int cpu, node;
+
+	if (syscall(SYS_getcpu, &cpu, &node, NULL) != 0)
+		return -errno;
+
+	return node;
+}
+
+/**
+ * numa_bind - bind a memory region to a NUMA node
+ *
+ * Pages of the region which are faulted in later are allocated on
+ * @node, existing pages are moved there on a best effort basis.
+ *
+ * @return 0 or -errno
+ */
+static int numa_bind(void *ptr, size_t len, int node)
+{
+	unsigned long mask[NUMA_MAX_NODES / NUMA_MASK_BITS] = { 0 };
+
+	if (node < 0 || node >= NUMA_MAX_NODES)
+		return -EINVAL;
+
+	mask[node / NUMA_MASK_BITS] = 1UL << (node % NUMA_MASK_BITS);
+
+	if (syscall(SYS_mbind, ptr, len, MPOL_BIND, mask,
+		    NUMA_MAX_NODES + 1, MPOL_MF_MOVE) != 0)
+		return -errno;
+
+	return 0;
+}
+
+/**
+ * ubx_numa_move - bind and migrate a memory region to a NUMA node
+ *
+ * The region is bound to @node, so that pages faulted in later
+ * (e.g. untouched parts of a buffer) are allocated there too, and
+ * the pages already faulted in are migrated. Pages which are already
+ * located on @node are left untouched by the kernel. The region must
+ * be page aligned and backed by private anonymous memory.
+ *
+ * @ptr: page aligned start of region
+ * @len: length of region in bytes
+ * @node: target NUMA node
+ *
+ * @return number of pages that could not be moved or < 0 in case of
+ * error
+ */
+long ubx_numa_move(void *ptr, size_t len, int node)
+{
+	long ret, failed = 0;
+	long pgsz = sysconf(_SC_PAGESIZE);
+	unsigned long i, num, batch;
+	void *pages[NUMA_MOVE_BATCH];
+	int nodes[NUMA_MOVE_BATCH];
+	int status[NUMA_MOVE_BATCH];
+
+	ret = numa_bind(ptr, len, node);
+
+	if (ret < 0)
+		return ret;
+
+	num = (len + pgsz - 1) / pgsz;
+
+	while (num > 0) {
+		batch = (num > NUMA_MOVE_BATCH) ? NUMA_MOVE_BATCH : num;
+
+		for (i = 0; i < batch; i++) {
+			pages[i] = (uint8_t *)ptr + i * pgsz;
+			nodes[i] = node;
+		}
+
+		ret = syscall(SYS_move_pages, 0, batch, pages,
+			      nodes, status, MPOL_MF_MOVE);
+
+		if (ret < 0)
+			return -errno;
+
+		/* -ENOENT: page not yet faulted in, nothing to move */
+		for (i = 0; i < batch; i++)
+			if (status[i] < 0 && status[i] != -ENOENT)
+				failed++;
+
+		ptr = (uint8_t *)ptr + batch * pgsz;
+		num -= batch;
+	}
+
+	return failed;
+}
@@ -0,0 +1,14 @@
+/*
+ * microblx NUMA helpers
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ */
+
+#ifndef _UBX_NUMA_H
+#define _UBX_NUMA_H
+
+int ubx_numa_num_nodes(void);
+int ubx_numa_cur_node(void);
+long ubx_numa_move(void *ptr, size_t len, int node);
+
+#endif /* _UBX_NUMA_H */
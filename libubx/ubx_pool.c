@@ -0,0 +1,424 @@
+/*
+ * microblx real-time safe ubx_data pool
+ *
+ * A pool is a single mlocked and prefaulted mapping split into power
+ * of two size classes. Each class has a lock-free free list (a
+ * Treiber stack with an ABA tag). On top of that, each thread caches
+ * a few free chunks per class of the pool it last used, so most
+ * alloc/free pairs don't touch shared state at all.
+ *
+ * Pools are registered in a small global range table, so that
+ * ubx_data_free can determine the owning pool from the address only
+ * (the data's type might already be gone). A pool that still has
+ * allocated chunks when its node is cleaned up is only unmapped once
+ * the last chunk is freed.
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ */
+
+#include <pthread.h>
+#include "ubx.h"
+
+struct pool_range {
+	uintptr_t start;
+	uintptr_t end;
+	struct ubx_pool *pool;
+};
+
+/* per-thread chunk cache */
+struct pool_tcache {
+	struct ubx_pool *pool;
+	unsigned long gen;
+	unsigned int cnt[UBX_POOL_NUM_CLASSES];
+	void *chunks[UBX_POOL_NUM_CLASSES][UBX_POOL_TCACHE_LEN];
+};
+
+static struct pool_range pool_ranges[UBX_POOL_MAX];
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t tcache_once = PTHREAD_ONCE_INIT;
+static pthread_key_t tcache_key;
+static unsigned long pool_gen;
+static __thread struct pool_tcache tcache;
+
+static inline void *cls_chunk(const struct ubx_pool_class *c, uint32_t idx)
+{
+	return c->start + idx * c->chunk_size;
+}
+
+/* pop a chunk from the lock-free free list */
+static void *cls_pop(struct ubx_pool_class *c)
+{
+	uint64_t old, new;
+	uint32_t idx, next;
+
+	old = __atomic_load_n(&c->free_head, __ATOMIC_ACQUIRE);
+
+	do {
+		idx = (uint32_t) old;
+		if (idx == 0)
+			return NULL;
+
+		next = __atomic_load_n((uint32_t *) cls_chunk(c, idx - 1),
+				       __ATOMIC_RELAXED);
+		new = (((old >> 32) + 1) << 32) | next;
+	} while (!__atomic_compare_exchange_n(&c->free_head, &old, new, 1,
+					      __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+
+	return cls_chunk(c, idx - 1);
+}
+
+/* push a chunk onto the lock-free free list */
+static void cls_push(struct ubx_pool_class *c, void *chunk)
+{
+	uint64_t old, new;
+	uint32_t idx = ((uint8_t *) chunk - c->start) / c->chunk_size;
+
+	old = __atomic_load_n(&c->free_head, __ATOMIC_RELAXED);
+
+	do {
+		__atomic_store_n((uint32_t *) chunk, (uint32_t) old, __ATOMIC_RELAXED);
+		new = (((old >> 32) + 1) << 32) | (idx + 1);
+	} while (!__atomic_compare_exchange_n(&c->free_head, &old, new, 1,
+					      __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+static int size_to_cls(size_t size)
+{
+	int cls;
+
+	for (cls = 0; cls < UBX_POOL_NUM_CLASSES; cls++) {
+		if (size <= (1UL << (UBX_POOL_MIN_SHIFT + cls)))
+			return cls;
+	}
+
+	return -1;
+}
+
+static int ptr_to_cls(const struct ubx_pool *p, const void *ptr)
+{
+	int cls;
+	const struct ubx_pool_class *c;
+
+	for (cls = 0; cls < UBX_POOL_NUM_CLASSES; cls++) {
+		c = &p->cls[cls];
+		if ((const uint8_t *) ptr >= c->start &&
+		    (const uint8_t *) ptr < c->start + c->num_chunks * c->chunk_size)
+			return cls;
+	}
+
+	return -1;
+}
+
+/* unregister and unmap a pool */
+static void pool_destroy(struct ubx_pool *p)
+{
+	int i;
+
+	pthread_mutex_lock(&pool_lock);
+
+	for (i = 0; i < UBX_POOL_MAX; i++) {
+		if (pool_ranges[i].pool != p)
+			continue;
+
+		/* clear end first, so the range is never [0, end) */
+		__atomic_store_n(&pool_ranges[i].end, 0, __ATOMIC_RELEASE);
+		__atomic_store_n(&pool_ranges[i].start, 0, __ATOMIC_RELEASE);
+		pool_ranges[i].pool = NULL;
+	}
+
+	pthread_mutex_unlock(&pool_lock);
+
+	ubx_munmap_locked(p, p->size);
+}
+
+/* drop a reference, destroy the pool if it was the last one */
+static void pool_put(struct ubx_pool *p)
+{
+	if (__atomic_sub_fetch(&p->refcnt, 1, __ATOMIC_ACQ_REL) == 0)
+		pool_destroy(p);
+}
+
+/**
+ * tcache_flush_locked - return cached chunks to their pool
+ *
+ * The chunks are only returned if the cached pool is still
+ * registered, otherwise they are dropped. Must be called with
+ * pool_lock held.
+ *
+ * @tc: thread cache
+ */
+static void tcache_flush_locked(struct pool_tcache *tc)
+{
+	int i, cls;
+	unsigned int n;
+
+	for (i = 0; i < UBX_POOL_MAX && tc->pool != NULL; i++) {
+		if (pool_ranges[i].pool != tc->pool || tc->pool->gen != tc->gen)
+			continue;
+
+		for (cls = 0; cls < UBX_POOL_NUM_CLASSES; cls++)
+			for (n = 0; n < tc->cnt[cls]; n++)
+				cls_push(&tc->pool->cls[cls], tc->chunks[cls][n]);
+		break;
+	}
+
+	memset(tc->cnt, 0, sizeof(tc->cnt));
+	tc->pool = NULL;
+	tc->gen = 0;
+}
+
+static void tcache_destroy(void *arg)
+{
+	pthread_mutex_lock(&pool_lock);
+	tcache_flush_locked(arg);
+	pthread_mutex_unlock(&pool_lock);
+}
+
+static void tcache_key_init(void)
+{
+	pthread_key_create(&tcache_key, tcache_destroy);
+}
+
+/**
+ * tcache_bind - bind the calling thread's cache to a pool
+ *
+ * Rebinding to a different pool requires flushing the cache under
+ * the pool lock, but this only happens when a thread switches nodes.
+ *
+ * @p: pool
+ *
+ * @return 1 if the thread cache can be used with p, 0 otherwise
+ */
+static int tcache_bind(struct ubx_pool *p)
+{
+	if (tcache.pool == p && tcache.gen == p->gen)
+		return 1;
+
+	if (p->zombie)
+		return 0;
+
+	pthread_mutex_lock(&pool_lock);
+	tcache_flush_locked(&tcache);
+	pthread_mutex_unlock(&pool_lock);
+
+	tcache.pool = p;
+	tcache.gen = p->gen;
+	pthread_setspecific(tcache_key, &tcache);
+	return 1;
+}
+
+/**
+ * ubx_pool_create - create a new pool
+ *
+ * The memory is mapped, locked and prefaulted and split evenly among
+ * the size classes.
+ *
+ * @size: size of pool in bytes
+ *
+ * @return new pool or NULL in case of error
+ */
+struct ubx_pool *ubx_pool_create(size_t size)
+{
+	int i, cls;
+	unsigned long n;
+	size_t hdr, cls_size;
+	uint8_t *mem, *cur;
+	struct ubx_pool *p;
+	struct ubx_pool_class *c;
+
+	pthread_once(&tcache_once, tcache_key_init);
+
+	mem = ubx_mmap_locked(&size);
+
+	if (mem == NULL)
+		return NULL;
+
+	p = (struct ubx_pool *) mem;
+	p->size = size;
+	p->gen = __atomic_add_fetch(&pool_gen, 1, __ATOMIC_RELAXED);
+	p->refcnt = 1;
+
+	hdr = (sizeof(struct ubx_pool) + UBX_CACHELINE_SIZE - 1) &
+		~(UBX_CACHELINE_SIZE - 1);
+	cls_size = (size - hdr) / UBX_POOL_NUM_CLASSES;
+	cur = mem + hdr;
+
+	for (cls = 0; cls < UBX_POOL_NUM_CLASSES; cls++) {
+		c = &p->cls[cls];
+		c->chunk_size = 1UL << (UBX_POOL_MIN_SHIFT + cls);
+		c->start = cur;
+		c->num_chunks = cls_size / c->chunk_size;
+
+		/* build the free list: each free chunk holds index+1 of the next */
+		for (n = 0; n < c->num_chunks; n++)
+			*(uint32_t *) cls_chunk(c, n) = (n + 1 < c->num_chunks) ? n + 2 : 0;
+
+		c->free_head = (c->num_chunks > 0) ? 1 : 0;
+		cur += c->num_chunks * c->chunk_size;
+	}
+
+	pthread_mutex_lock(&pool_lock);
+
+	for (i = 0; i < UBX_POOL_MAX; i++) {
+		if (pool_ranges[i].pool != NULL)
+			continue;
+
+		pool_ranges[i].pool = p;
+		__atomic_store_n(&pool_ranges[i].start, (uintptr_t) mem, __ATOMIC_RELEASE);
+		__atomic_store_n(&pool_ranges[i].end, (uintptr_t) mem + size, __ATOMIC_RELEASE);
+		break;
+	}
+
+	pthread_mutex_unlock(&pool_lock);
+
+	if (i == UBX_POOL_MAX) {
+		ubx_munmap_locked(mem, size);
+		return NULL;
+	}
+
+	return p;
+}
+
+/**
+ * ubx_pool_release - release a pool
+ *
+ * If no chunks are allocated, the pool is destroyed immediately.
+ * Otherwise it is marked as zombie and destroyed when the last chunk
+ * is freed.
+ *
+ * @p: pool
+ *
+ * @return the number of chunks still allocated.
+ */
+unsigned long ubx_pool_release(struct ubx_pool *p)
+{
+	unsigned long used = __atomic_load_n(&p->used, __ATOMIC_ACQUIRE);
+
+	if (tcache.pool == p) {
+		memset(tcache.cnt, 0, sizeof(tcache.cnt));
+		tcache.pool = NULL;
+		tcache.gen = 0;
+	}
+
+	__atomic_store_n(&p->zombie, 1, __ATOMIC_RELEASE);
+	pool_put(p);
+
+	return used;
+}
+
+/**
+ * ubx_pool_alloc - allocate zeroed memory from a pool
+ *
+ * This function is real-time safe.
+ *
+ * @p: pool
+ * @size: number of bytes
+ *
+ * @return pointer to memory or NULL if the size class is exhausted or
+ *         size exceeds the largest class.
+ */
+void *ubx_pool_alloc(struct ubx_pool *p, size_t size)
+{
+	int cls;
+	void *chunk = NULL;
+	unsigned long used, hw;
+	struct ubx_pool_class *c;
+
+	cls = size_to_cls(size);
+
+	if (cls < 0) {
+		__atomic_add_fetch(&p->num_fallbacks, 1, __ATOMIC_RELAXED);
+		return NULL;
+	}
+
+	c = &p->cls[cls];
+
+	if (tcache.pool == p && tcache.gen == p->gen && tcache.cnt[cls] > 0)
+		chunk = tcache.chunks[cls][--tcache.cnt[cls]];
+	else
+		chunk = cls_pop(c);
+
+	if (chunk == NULL) {
+		__atomic_add_fetch(&c->num_fallbacks, 1, __ATOMIC_RELAXED);
+		return NULL;
+	}
+
+	__atomic_add_fetch(&p->refcnt, 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&p->used, 1, __ATOMIC_RELAXED);
+	used = __atomic_add_fetch(&c->used, 1, __ATOMIC_RELAXED);
+	hw = __atomic_load_n(&c->high_water, __ATOMIC_RELAXED);
+
+	while (used > hw &&
+	       !__atomic_compare_exchange_n(&c->high_water, &hw, used, 1,
+					    __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+		;
+
+	memset(chunk, 0, size);
+	return chunk;
+}
+
+/**
+ * ubx_pool_free - return a chunk to a pool
+ *
+ * This function is real-time safe, unless it frees the last chunk of
+ * a zombie pool.
+ *
+ * @p: pool as returned by ubx_pool_find(ptr)
+ * @ptr: chunk to free
+ */
+void ubx_pool_free(struct ubx_pool *p, void *ptr)
+{
+	int cls = ptr_to_cls(p, ptr);
+
+	if (cls < 0)
+		return;
+
+	__atomic_sub_fetch(&p->cls[cls].used, 1, __ATOMIC_RELAXED);
+	__atomic_sub_fetch(&p->used, 1, __ATOMIC_RELAXED);
+
+	if (tcache_bind(p) && tcache.cnt[cls] < UBX_POOL_TCACHE_LEN)
+		tcache.chunks[cls][tcache.cnt[cls]++] = ptr;
+	else
+		cls_push(&p->cls[cls], ptr);
+
+	pool_put(p);
+}
+
+/**
+ * ubx_pool_find - find the pool owning a pointer
+ *
+ * @ptr: pointer
+ *
+ * @return owning pool or NULL if ptr was not allocated from a pool
+ */
+struct ubx_pool *ubx_pool_find(const void *ptr)
+{
+	int i;
+	uintptr_t addr = (uintptr_t) ptr;
+
+	if (ptr == NULL)
+		return NULL;
+
+	for (i = 0; i < UBX_POOL_MAX; i++) {
+		if (addr >= __atomic_load_n(&pool_ranges[i].start, __ATOMIC_ACQUIRE) &&
+		    addr < __atomic_load_n(&pool_ranges[i].end, __ATOMIC_ACQUIRE))
+			return pool_ranges[i].pool;
+	}
+
+	return NULL;
+}
+
+/**
+ * ubx_pool_chunk_size - get the usable size of a chunk
+ *
+ * @p: pool
+ * @ptr: chunk
+ *
+ * @return size of the chunk or 0 if ptr is not a chunk of p
+ */
+size_t ubx_pool_chunk_size(const struct ubx_pool *p, const void *ptr)
+{
+	int cls = ptr_to_cls(p, ptr);
+
+	return (cls < 0) ? 0 : p->cls[cls].chunk_size;
+}
@@ -0,0 +1,21 @@
+/*
+ * microblx real-time safe ubx_data pool
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ */
+
+#ifndef _UBX_POOL_H
+#define _UBX_POOL_H
+
+#define UBX_POOL_SIZE_DEFAULT		(4 * 1024 * 1024)
+#define UBX_POOL_TCACHE_LEN		8	/* chunks per class and thread */
+#define UBX_POOL_MAX			16	/* max. number of live pools */
+
+struct ubx_pool *ubx_pool_create(size_t size);
+unsigned long ubx_pool_release(struct ubx_pool *p);
+void *ubx_pool_alloc(struct ubx_pool *p, size_t size);
+void ubx_pool_free(struct ubx_pool *p, void *ptr);
+struct ubx_pool *ubx_pool_find(const void *ptr);
+size_t ubx_pool_chunk_size(const struct ubx_pool *p, const void *ptr);
+
+#endif /* _UBX_POOL_H */
@@ -0,0 +1,49 @@
+/*
+ * microblx: embedded, realtime safe, reflective function blocks.
+ *
+ * Copyright (C) 2020 Markus Klotzbuecher <mk@mkio.de>
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * Minimal sequence lock for publishing snapshots from a single
+ * (real-time) writer to any number of readers. The writer never
+ * blocks or waits; readers retry if the snapshot was modified while
+ * copying it:
+ *
+ *	do {
+ *		seq = ubx_seqlock_read_begin(&sl);
+ *		memcpy(&copy, &snap, sizeof(copy));
+ *	} while (ubx_seqlock_read_retry(&sl, seq));
+ */
+
+#ifndef _UBX_SEQLOCK_H
+#define _UBX_SEQLOCK_H
+
+struct ubx_seqlock {
+	unsigned int seq;
+};
+
+static inline void ubx_seqlock_write_begin(struct ubx_seqlock *sl)
+{
+	__atomic_store_n(&sl->seq, sl->seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline void ubx_seqlock_write_end(struct ubx_seqlock *sl)
+{
+	__atomic_store_n(&sl->seq, sl->seq + 1, __ATOMIC_RELEASE);
+}
+
+static inline unsigned int ubx_seqlock_read_begin(const struct ubx_seqlock *sl)
+{
+	return __atomic_load_n(&sl->seq, __ATOMIC_ACQUIRE);
+}
+
+/* returns non-zero if the data read since read_begin is inconsistent */
+static inline int ubx_seqlock_read_retry(const struct ubx_seqlock *sl, unsigned int seq)
+{
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	return (seq & 1) || __atomic_load_n(&sl->seq, __ATOMIC_RELAXED) != seq;
+}
+
+#endif /* _UBX_SEQLOCK_H */
@@ -148,11 +148,18 @@ enum {
  * 		      removing custom ports in cleanup without
  * 		      touching the "static" ones created from the
  * 		      prototype.
+ * @PORT_ATTR_VERIFIED: set when the port was verified upon connecting
+ *		      or starting its block: all connected blocks are
+ *		      iblocks with the respective read/write hook. The
+ *		      generated accessors use the unchecked
+ *		      __port_read_unchecked/__port_write_unchecked for
+ *		      verified ports.
  *
  * the first 8 bits are reserved, the others can be used freely.
  */
 enum {
 	PORT_ATTR_CLONED 		= 1<<0,
+	PORT_ATTR_VERIFIED		= 1<<1,
 	/* ... */
 	PORT_ATTR_RESERVED7 		= 1<<7,
 };
@@ -194,6 +201,31 @@ typedef struct ubx_port {
 } ubx_port_t;
 
 
+/**
+ * struct ubx_config_live - buffers for publishing live config updates
+ *
+ * The reader (the block) and the writer (ubx_config_publish) each own
+ * one buffer. New values are handed over by atomically exchanging
+ * the writer buffer with the middle one, so neither side ever waits
+ * for the other or sees a partially written value.
+ *
+ * @buf: the three buffers
+ * @ver: version of the value contained in each buffer
+ * @mid: index of the middle buffer | CONFIG_LIVE_DIRTY if it holds a
+ *       value not yet picked up by the reader
+ * @wr: index of the writer buffer
+ * @rd: index of the reader buffer (the current config value)
+ * @version: last published version
+ */
+struct ubx_config_live {
+	ubx_data_t *buf[3];
+	unsigned long ver[3];
+	unsigned int mid;
+	unsigned int wr;
+	unsigned int rd;
+	unsigned long version;
+};
+
 /**
  * struct ubx_config - represents a block configuration
  * @name: name of config
@@ -202,6 +234,7 @@ typedef struct ubx_port {
  * @block: parent block owning this config
  * @type: type of configuration
  * @value: reference to data
+ * @live: live update state (allocated by the first ubx_config_publish)
  * @min: required minimum array length
  * @max: required maximum array length
  * @prev: linked list ptr
@@ -215,6 +248,7 @@ typedef struct ubx_config {
 
 	const ubx_type_t *type;
 	ubx_data_t *value;
+	struct ubx_config_live *live;
 
 	uint16_t min;
 	uint16_t max;
@@ -238,11 +272,17 @@ typedef struct ubx_config {
  * @CONFIG_ATTR_CHECKLATE: perform checking of min and max before
  *			   start instead of before init hook
  *
+ * @CONFIG_ATTR_LIVE: the block supports updating this config while
+ *		      running. Updates of active blocks are published
+ *		      with ubx_config_publish and picked up by the
+ *		      block via ubx_config_changed.
+ *
  * The first 8 bit are reserved, the others can be used freely.
  */
 enum {
 	CONFIG_ATTR_CLONED = 	1<<0,
 	CONFIG_ATTR_CHECKLATE = 1<<1,
+	CONFIG_ATTR_LIVE =	1<<2,
 	/* ... */
 	CONFIG_ATTR_RESERVED =	1<<7,
 };
@@ -301,7 +341,10 @@ enum {
  * @write: write hook (only BLOCK_TYPE_INTERACTION)
  * @stat_num_reads: read count statistics (only BLOCK_TYPE_INTERACTION)
  * @stat_num_writes: wrte count statistics (only BLOCK_TYPE_INTERACTION)
+ * @stat_num_overruns: overrun count statistics, to be incremented by
+ *                     buffering iblocks (only BLOCK_TYPE_INTERACTION)
  * @private_data: pointer to block instance state
+ * @priv_allocs: list of memory allocated with ubx_block_alloc_private
  * @hh UT_hash_handle
  */
 typedef struct ubx_block {
@@ -340,10 +383,12 @@ typedef struct ubx_block {
 				      const ubx_data_t *value);
 			unsigned long stat_num_reads;
 			unsigned long stat_num_writes;
+			unsigned long stat_num_overruns;
 		};
 	};
 
 	void *private_data;
+	struct ubx_priv_alloc *priv_allocs;
 	UT_hash_handle hh;
 
 } ubx_block_t;
@@ -372,6 +417,86 @@ typedef struct ubx_module {
 enum {
 	ND_MLOCK_ALL = 1 << 0,
 	ND_DUMPABLE =  1 << 1,
+	ND_ARENA =     1 << 2,
+	ND_POOL =      1 << 3,
+	ND_HEAP_RESERVE = 1 << 4,
+};
+
+/**
+ * struct ubx_arena - node memory arena
+ *
+ * A mlocked and prefaulted memory region from which block instances,
+ * their ports, configs and interaction arrays are bump-allocated if
+ * the node is created with ND_ARENA. The arena is only released as a
+ * whole in ubx_node_cleanup.
+ *
+ * @base: start of arena memory
+ * @size: size of arena in bytes. If ND_ARENA is set, this may be set
+ *        before ubx_node_init to override UBX_ARENA_SIZE_DEFAULT.
+ * @used: number of bytes allocated
+ * @num_allocs: number of allocations served
+ * @num_fallbacks: number of allocations that fell back to the heap
+ *                 because the arena was exhausted
+ */
+struct ubx_arena {
+	uint8_t *base;
+	size_t size;
+	size_t used;
+	unsigned long num_allocs;
+	unsigned long num_fallbacks;
+};
+
+/* data pool size classes: 32 bytes to 64 KiB */
+enum {
+	UBX_POOL_MIN_SHIFT = 5,
+	UBX_POOL_NUM_CLASSES = 12,
+};
+
+/**
+ * struct ubx_pool_class - a size class of a data pool
+ *
+ * @chunk_size: size of chunks in this class
+ * @start: first chunk
+ * @num_chunks: number of chunks
+ * @used: number of chunks currently allocated
+ * @high_water: maximum of used
+ * @num_fallbacks: allocations that fell back to the heap because the
+ *                 class was exhausted
+ * @free_head: lock-free free list head (ABA tag << 32 | index + 1)
+ */
+struct ubx_pool_class {
+	size_t chunk_size;
+	uint8_t *start;
+	unsigned long num_chunks;
+	unsigned long used;
+	unsigned long high_water;
+	unsigned long num_fallbacks;
+	uint64_t free_head;
+};
+
+/**
+ * struct ubx_pool - real-time safe size class pool for ubx_data
+ *
+ * The pool control struct is located at the start of its own mlocked
+ * mapping, so that it can outlive the node if data allocated from it
+ * is still referenced after ubx_node_cleanup.
+ *
+ * @size: size of the mapping in bytes
+ * @gen: unique generation number of this pool
+ * @zombie: set once the node released the pool
+ * @refcnt: number of allocated chunks plus one held by the node
+ * @used: total number of chunks currently allocated
+ * @num_fallbacks: allocations larger than the largest class
+ * @cls: size classes
+ */
+struct ubx_pool {
+	size_t size;
+	unsigned long gen;
+	int zombie;
+	unsigned long refcnt;
+	unsigned long used;
+	unsigned long num_fallbacks;
+	struct ubx_pool_class cls[UBX_POOL_NUM_CLASSES];
 };
 
 /**
@@ -388,6 +513,13 @@ enum {
  * @loglevel: global loglevel
  * @log: pointer to log function
  * @log_data: private state of log function
+ * @arena: node memory arena (only used with ND_ARENA)
+ * @pool: ubx_data pool (only used with ND_POOL)
+ * @pool_size: size of data pool. May be set before ubx_node_init to
+ *             override UBX_POOL_SIZE_DEFAULT.
+ * @heap_reserve: size of prefaulted heap reserve (ND_HEAP_RESERVE).
+ *                May be set before ubx_node_init to override
+ *                UBX_HEAP_RESERVE_DEFAULT.
  */
 typedef struct ubx_node {
 	const char name[UBX_NODE_NAME_MAXLEN + 1];
@@ -400,6 +532,10 @@ typedef struct ubx_node {
 	int loglevel;
 	void (*log)(const struct ubx_node *inf, const struct ubx_log_msg *msg);
 	void *log_data;
+	struct ubx_arena arena;
+	struct ubx_pool *pool;
+	size_t pool_size;
+	size_t heap_reserve;
 } ubx_node_t;
 
 
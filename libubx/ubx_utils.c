@@ -1,10 +1,17 @@
 /* miscellaneous */
 
+#define _GNU_SOURCE	/* pthread_getattr_np */
+
 #include <string.h>
 #include <signal.h>
 #include <unistd.h>
 #include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
 #include <errno.h>
+#include <malloc.h>
+#include <alloca.h>
+#include <pthread.h>
 
 /**
  * Wait for SIGINT for some time
@@ -33,6 +40,80 @@ int ubx_wait_sigint(unsigned int timeout_s)
 	return 0;
 }
 
+/**
+ * ubx_heap_reserve - prefault and retain a heap reserve
+ *
+ * Disable returning memory to the OS and serving large allocations
+ * via mmap, then allocate, touch and free a buffer of the given size.
+ * Subsequent mallocs up to this size are served from the prefaulted
+ * heap. Combine with mlockall to prevent the pages from being
+ * swapped.
+ *
+ * @param size size of reserve in bytes
+ * @return 0 if OK, -1 if the reserve could not be allocated
+ */
+int ubx_heap_reserve(size_t size)
+{
+	long pgsz = sysconf(_SC_PAGESIZE);
+	volatile uint8_t *buf;
+
+	mallopt(M_TRIM_THRESHOLD, -1);
+	mallopt(M_MMAP_MAX, 0);
+
+	buf = malloc(size);
+
+	if (buf == NULL)
+		return -1;
+
+	for (size_t off = 0; off < size; off += pgsz)
+		buf[off] = 0;
+
+	free((void *)buf);
+	return 0;
+}
+
+/**
+ * ubx_prefault_stack - prefault the stack of the calling thread
+ *
+ * Touch every page of the unused stack below the current frame,
+ * leaving a safety margin to the guard page.
+ *
+ * @return number of bytes prefaulted or -1 in case of error
+ */
+long ubx_prefault_stack(void)
+{
+	long pgsz = sysconf(_SC_PAGESIZE);
+	pthread_attr_t attr;
+	void *stack_addr;
+	size_t stack_size, len;
+	volatile uint8_t *buf;
+
+	if (pthread_getattr_np(pthread_self(), &attr) != 0)
+		return -1;
+
+	if (pthread_attr_getstack(&attr, &stack_addr, &stack_size) != 0) {
+		pthread_attr_destroy(&attr);
+		return -1;
+	}
+
+	pthread_attr_destroy(&attr);
+
+	/* bytes between the stack end and here, minus a margin for
+	 * this frame and the calls below */
+	len = (uintptr_t) &attr - (uintptr_t) stack_addr;
+
+	if (len <= (size_t) 4 * pgsz)
+		return 0;
+
+	len -= 4 * pgsz;
+	buf = alloca(len);
+
+	for (size_t off = 0; off < len; off += pgsz)
+		buf[off] = 0;
+
+	return len;
+}
+
 /**
  * replace char  in string
  */
@@ -1,7 +1,11 @@
 #ifndef UBX_UTILS_H
 #define UBX_UTILS_H
 
+#define UBX_HEAP_RESERVE_DEFAULT	(8 * 1024 * 1024)
+
 int ubx_wait_sigint(unsigned int timeout_s);
 void char_replace(char *s, const char find, const char rep);
+int ubx_heap_reserve(size_t size);
+long ubx_prefault_stack(void);
 
 #endif /* UBX_UTILS_H */
@@ -11,6 +11,7 @@
 local ubx = require "ubx"
 local umf = require "umf"
 local utils = require "utils"
+local ffi = require "ffi"
 local has_json, json = pcall(require, "cjson")
 local strict = require "strict"
 
@@ -78,9 +79,15 @@ local function err_exit(code, format, ...)
 end
 
 --- Return the block table identified by bfqn at the level of sys
+--
+-- If a cache table is given, the blocks of each visited system are
+-- indexed by name on first use, turning subsequent lookups into
+-- constant time. The cache must be discarded when the model changes.
+--
 -- @param sys system
 -- @param bfqn block fqn string
-local function blocktab_get(sys, bfqn)
+-- @param cache optional table { [system] = { [name] = blocktab } }
+local function blocktab_get(sys, bfqn, cache)
    local s = sys
 
    -- first index to the right subsystem
@@ -88,15 +95,27 @@ local function blocktab_get(sys, bfqn)
    local bname = elem[#elem]
 
    for i=1,#elem-1 do
-      s = s.subsystems[elem[i]]
+      s = s.subsystems and s.subsystems[elem[i]]
       if not M.is_system(s) then return false end
    end
 
    -- then locate the right block
-   for _,v in pairs(s.blocks) do
-      if v.name==bname then return v end
+   if not cache then
+      for _,v in pairs(s.blocks) do
+	 if v.name==bname then return v end
+      end
+      return false
    end
-   return false
+
+   local names = cache[s]
+   if not names then
+      names = {}
+      for _,v in pairs(s.blocks) do
+	 if v.name and names[v.name] == nil then names[v.name] = v end
+      end
+      cache[s] = names
+   end
+   return names[bname] or false
 end
 
 --- Check whether val is a nodeconfig reference
@@ -131,10 +150,12 @@ end
 local function mapobj_bf(func, root_sys, systab)
    local res = {}
    local queue = { root_sys }
+   local head = 1
 
    -- breadth first
-   while #queue > 0 do
-      local next_sys = table.remove(queue, 1) -- pop
+   while head <= #queue do
+      local next_sys = queue[head] -- pop
+      head = head + 1
 
       -- process all nc's of s
       foreach(
@@ -153,7 +174,6 @@ local function mapblocks(func, root_sys) return mapobj_bf(func, root_sys, 'block
 local function mapconns(func, root_sys) return mapobj_bf(func, root_sys, 'connections') end
 local function mapconfigs(func, root_sys) return mapobj_bf(func, root_sys, 'configurations') end
 local function mapndconfigs(func, root_sys) return mapobj_bf(func, root_sys, 'node_configurations') end
-local function mapimports(func, root_sys) return mapobj_bf(func, root_sys, 'imports') end
 
 ---
 --- Model
@@ -291,12 +311,13 @@ local subsystems_spec = TableSpec {
 -- Check that hash references are valid
 local function sys_check_block_ref(class, sys, vres)
    local res = true
+   local cache = {}
 
    local function check_config(c,_,s)
       local function check_hash(val, tab, key)
 	 local name = string.match(val, ".*#([%w_%-%/]+)")
 	 if not name then return end
-	 local bt = blocktab_get(s, name)
+	 local bt = blocktab_get(s, name, cache)
 	 if not bt then
 	    umf.add_msg(vres, "err", "unable to resolve block ref "..val)
 	    res = false
@@ -392,16 +413,18 @@ end
 -- @return block name
 -- @return port name
 local function resolve_refs(root_sys)
+   local cache = {}
+
    local function connref_resolve(sys, connref)
       if not connref then return false end
       local bref, portname = unpack(utils.split(connref, "%."))
-      local btab = blocktab_get(sys, bref)
+      local btab = blocktab_get(sys, bref, cache)
       return btab, portname
    end
 
    mapconfigs(
       function(c,_,p)
-	 c._tgt = blocktab_get(p, c.name)
+	 c._tgt = blocktab_get(p, c.name, cache)
       end, root_sys)
 
    mapconns(
@@ -636,41 +659,80 @@ end
 -- @param nd configuration table
 function system.pulldown(self, nd) ubx.node_rm(nd) end
 
---- Find and return ubx_block ptr
--- @param nd node_info
--- @param btab block table
--- @return bptr
-local function get_ubx_block(nd, btab)
-   assert(btab._fqn, "missing fqn entry of " .. ts(btab))
-   return ubx.block_get(nd, btab._fqn)
+--- Build a flat index of a system
+--
+-- The system tree is traversed once in the same breadth first order
+-- as mapobj_bf and all imports, blocks, configurations, connections
+-- and node configurations are collected into arrays. The launch
+-- phases then iterate over these instead of walking the tree
+-- again. The bptr table mapping block fqns to ubx_block_t ptrs is
+-- populated by create_blocks.
+--
+-- @param root_sys root system
+-- @return index table
+local function system_index(root_sys)
+   local idx = {
+      imports = {},	-- module names (without duplicates)
+      blocks = {},	-- block tables
+      configs = {},	-- configuration tables
+      cfgsys = {},	-- { [configtab] = parent system }
+      conns = {},	-- connection tables
+      ndcfgs = {},	-- { name=, cfg=, sys= } node configs
+      bptr = {},	-- { [block fqn] = ubx_block_t* }
+   }
+
+   local loaded = {}
+   local queue = { root_sys }
+   local head = 1
+
+   local function append(arr, objs)
+      for _,o in ipairs(objs or {}) do arr[#arr+1] = o end
+   end
+
+   while head <= #queue do
+      local s = queue[head]
+      head = head + 1
+
+      for _,m in ipairs(s.imports or {}) do
+	 if not loaded[m] then
+	    idx.imports[#idx.imports+1] = m
+	    loaded[m] = true
+	 end
+      end
+
+      append(idx.blocks, s.blocks)
+      for _,c in ipairs(s.configurations or {}) do
+	 idx.configs[#idx.configs+1] = c
+	 idx.cfgsys[c] = s
+      end
+      append(idx.conns, s.connections)
+
+      for name,nc in pairs(s.node_configurations or {}) do
+	 idx.ndcfgs[#idx.ndcfgs+1] = { name=name, cfg=nc, sys=s }
+      end
+
+      for _,subsys in pairs(s.subsystems or {}) do queue[#queue+1] = subsys end
+   end
+
+   return idx
 end
 
 --- load the systems modules
 -- ensure modules are only loaded once
 -- @param nd ubx_node into which to import
--- @param s system
-local function import_modules(nd, s)
-   local loaded = {}
-
-   mapimports(
-      function(m)
-	 if loaded[m] then return
-	 else
-	    ubx.load_module(nd, m)
-	    loaded[m]=true
-	 end
-      end, s)
+-- @param idx system index
+local function import_modules(nd, idx)
+   foreach(function(m) ubx.load_module(nd, m) end, idx.imports)
 end
 
 --- Instantiate blocks
 -- @param nd ubx_node into which to instantiate the blocks
--- @param root_sys system
-local function create_blocks(nd, root_sys)
-   mapblocks(
-      function(b,i,p)
-	 info("creating block %s [%s]", green(b._fqn), blue(b.type))
-	 ubx.block_create(nd, b.type, b._fqn)
-      end, root_sys)
+-- @param idx system index
+local function create_blocks(nd, idx)
+   for _,b in ipairs(idx.blocks) do
+      info("creating block %s [%s]", green(b._fqn), blue(b.type))
+      idx.bptr[b._fqn] = ubx.block_create(nd, b.type, b._fqn)
+   end
 end
 
 
@@ -680,9 +742,9 @@ end
 
 --- Instantiate ubx_data for all node configurations incl. subsystems
 -- NCs defined higher in the composition tree override lower ones.
--- @param root_sys root system
+-- @param idx system index
 -- @return table of initialized config-name=ubx_data tuples
-local function build_nodecfg_tab(nd, root_sys)
+local function build_nodecfg_tab(nd, idx)
    local NC = {}
 
    -- instantiate a node config and add it to global table. skip it if
@@ -701,7 +763,7 @@ local function build_nodecfg_tab(nd, root_sys)
 	   yellow(utils.tab2str(cfg.config)))
    end
 
-   mapndconfigs(create_nc, root_sys)
+   for _,nc in ipairs(idx.ndcfgs) do create_nc(nc.cfg, nc.name, nc.sys) end
    return NC
 end
 
@@ -735,11 +797,11 @@ end
 -- exists.
 --
 -- @param b ubx_block_t*
+-- @param blkcfg ubx_config_t* of b to apply to
 -- @param name configuration name
 -- @param val configuration value
 -- @param NC node configuration table
-local function apply_cfg_val(b, name, val, NC)
-   local blkcfg = ubx.block_config_get(b, name)
+local function apply_cfg_val(b, blkcfg, name, val, NC)
    local blkfqn = safets(b.name)
 
    -- check for references to node configs
@@ -762,7 +824,7 @@ local function apply_cfg_val(b, name, val, NC)
       end
    else -- regular config
       info("cfg %s.%s: %s", green(blkfqn), blue(name), yellow(utils.tab2str(val)))
-      ubx.set_config(b, name, val)
+      ubx.config_set(blkcfg, val)
    end
 end
 
@@ -777,8 +839,9 @@ local function apply_config(cfg, b, NC, configured, nonexist)
 
    for name,val in pairs(cfg.config) do
       local cfgfqn = cfg._tgt._fqn..'.'..name
+      local blkcfg = ubx.block_config_get(b, name)
 
-      if ubx.block_config_get(b, name) == nil then
+      if blkcfg == nil then
 	 nonexist[cfgfqn] = true
 	 goto continue
       end
@@ -788,7 +851,7 @@ local function apply_config(cfg, b, NC, configured, nonexist)
 	 goto continue
       end
 
-      apply_cfg_val(b, name, val, NC)
+      apply_cfg_val(b, blkcfg, name, val, NC)
       configured[cfgfqn] = true
 
       ::continue::
@@ -809,13 +872,16 @@ end
 local function reapply_config(cfg, b, NC, configured, nonexist)
    for name,val in pairs(cfg.config) do
       local cfgfqn = cfg._tgt._fqn..'.'..name
+      local blkcfg
 
       -- skip all but the previously non-existing. Don't exit for the
       -- previously configured ( nonexist[] = false ) so that we get
       -- the "skipping already configured" message
       if nonexist[cfgfqn] == nil then goto continue end
 
-      if ubx.block_config_get(b, name) == nil then
+      blkcfg = ubx.block_config_get(b, name)
+
+      if blkcfg == nil then
 	 err_exit(1, "block %s [%s] has no config '%s'",
 		  cfg._tgt._fqn, cfg._tgt.type, name)
 	 nonexist[cfgfqn] = false
@@ -829,7 +895,7 @@ local function reapply_config(cfg, b, NC, configured, nonexist)
 	 goto continue
       end
 
-      apply_cfg_val(b, name, val, NC)
+      apply_cfg_val(b, blkcfg, name, val, NC)
       configured[cfgfqn] = true
       ::continue::
    end
@@ -838,9 +904,12 @@ end
 
 --- configure all blocks
 -- @param nd node_info
--- @param root_sys root system
+-- @param idx system index
 -- @param NC
-local function configure_blocks(nd, root_sys, NC)
+-- @param lap optional function(phase) called after each sub-phase
+-- @return table of configs { [<blkfqn.config>] = true } applied after init
+local function configure_blocks(nd, idx, NC, lap, preinit)
+   lap = lap or function() end
 
    -- table of already configured configs
    -- { [<blkfqn.config>] = true }
@@ -854,70 +923,80 @@ local function configure_blocks(nd, root_sys, NC)
    local nonexist = {}
 
    -- substitue #blockname syntax
-   mapconfigs(function(c, i, s) preproc_configs(nd, c, s, i) end, root_sys)
+   for _,c in ipairs(idx.configs) do preproc_configs(nd, c, idx.cfgsys[c]) end
+   lap("preproc")
 
    -- apply configurations to blocks
-   mapconfigs(
-      function(cfg, i)
-	 local b = get_ubx_block(nd, cfg._tgt)
-	 if b == nil then
-	    err_exit(1, "error: config %s for block %s: no such block found",
-		     cfg._fqn, cfg.name)
-	 end
-
-	 local bstate = b:get_block_state()
-	 if bstate ~= 'preinit' then
-	    warn("applying configs: block %s not in state preinit but %s", cfg._tgt._fqn, bstate)
-	    return
-	 end
+   for _,cfg in ipairs(idx.configs) do
+      local b = idx.bptr[cfg._tgt._fqn]
+      if b == nil then
+	 err_exit(1, "error: config %s for block %s: no such block found",
+		  cfg._fqn, cfg.name)
+      end
 
+      local bstate = b:get_block_state()
+      if bstate ~= 'preinit' then
+	 warn("applying configs: block %s not in state preinit but %s", cfg._tgt._fqn, bstate)
+      else
 	 apply_config(cfg, b, NC, configured, nonexist)
-      end, root_sys)
+      end
+   end
+   lap("configure")
+
+   if preinit then preinit(nd, idx) end
 
    -- initialize all blocks (brings them to state 'inactive')
-   mapblocks(
-      function(btab,i,p)
-	 local b = get_ubx_block(nd, btab)
-	 info("initializing block %s", safets(b.name))
-	 local ret = ubx.block_init(b)
-	 if ret ~= 0 then
-	    err_exit(ret, "failed to initialize block %s: %d",
-		     btab.name, tonumber(ret))
-	 end
-      end, root_sys)
+   for _,btab in ipairs(idx.blocks) do
+      local b = idx.bptr[btab._fqn]
+      info("initializing block %s", safets(b.name))
+      local ret = ubx.block_init(b)
+      if ret ~= 0 then
+	 err_exit(ret, "failed to initialize block %s: %d",
+		  btab.name, tonumber(ret))
+      end
+   end
+   lap("init")
 
    -- reapply configurations to blocks
-   mapconfigs(
-      function(cfg, i)
-	 local b = get_ubx_block(nd, cfg._tgt)
-	 if b == nil then
-	    err_exit(1, "error: config %s for block %s: no such block found",
-		     cfg._fqn, cfg.name)
-	 end
+   for _,cfg in ipairs(idx.configs) do
+      local b = idx.bptr[cfg._tgt._fqn]
+      if b == nil then
+	 err_exit(1, "error: config %s for block %s: no such block found",
+		  cfg._fqn, cfg.name)
+      end
 
-	 local bstate = b:get_block_state()
-
-	 if bstate ~= 'inactive' then
-	    warn("reapplying configs: block %s not in state preinit but %s",
-		 cfg._tgt._fqn, bstate)
-	    return
-	 end
+      local bstate = b:get_block_state()
 
+      if bstate ~= 'inactive' then
+	 warn("reapplying configs: block %s not in state preinit but %s",
+	      cfg._tgt._fqn, bstate)
+      else
 	 reapply_config(cfg, b, NC, configured, nonexist)
-      end, root_sys)
+      end
+   end
 
    -- check that all initially non-existing configs were configured
    for cfgfqn, val in pairs(nonexist) do
       assert(val==true, fmt("unconfigured nonexist config %s reapply", cfgfqn))
    end
 
+   return nonexist
 end
 
 --- Connect blocks
+--
+-- If elide is set, connections without type and config between
+-- blocks triggered by the same thread are made via ubx/direct
+-- instead of ubx/lfds_cyclic (see ubx.trigger_roots).
+--
 -- @param nd node_info
--- @param root_sys root system
-local function connect_blocks(nd, root_sys)
-   local function do_connect(c, i, p)
+-- @param idx system index
+-- @param elide elide same thread connections
+local function connect_blocks(nd, idx, elide)
+   local roots = elide and ubx.trigger_roots(nd) or nil
+   local num_elided = 0
+
+   local function do_connect(c)
 
       local srcbn, srcpn, tgtbn, tgtpn
 
@@ -931,13 +1010,193 @@ local function connect_blocks(nd, root_sys)
 	 tgtpn = c._tgtpn
       end
 
-      local ret, msg = ubx.connect(nd, srcbn, srcpn, tgtbn, tgtpn, c.type, c.config)
+      local ret, msg = ubx.connect(nd, srcbn, srcpn, tgtbn, tgtpn, c.type, c.config, roots)
 
       if not ret then
 	 err_exit(1, "error: %s", msg)
       end
+
+      if roots and c.type == nil and msg == "ubx/direct" then
+	 notice("elided connection %s.%s -> %s.%s (trigger %s)",
+		green(srcbn), blue(srcpn), green(tgtbn), blue(tgtpn), roots[srcbn])
+	 num_elided = num_elided + 1
+      end
+   end
+   foreach(do_connect, idx.conns)
+
+   if roots then
+      notice("elided %d of %d connections", num_elided, #idx.conns)
+   end
+end
+
+--- Add a module to the imports of an index, unless already present
+-- @param idx system index
+-- @param m module name
+local function index_add_import(idx, m)
+   for _,i in ipairs(idx.imports) do
+      if i == m then return end
+   end
+   insert(idx.imports, m)
+end
+
+--- Fuse straight-line sequences of trigger chains
+--
+-- Two or more consecutive entries of a chain are fused if each block
+-- is connected to the next one by a default connection (without type
+-- and config), each is stepped once per trigger and neither these
+-- blocks nor the trigger are triggered by another chain. The entries
+-- are replaced by a single ubx/fused block that steps them in order
+-- and all default connections between them are made via ubx/direct
+-- iblocks. Only the index is modified, not the system.
+--
+-- @param idx system index
+-- @return number of fused sequences
+local function fuse_chains(idx)
+   local blocks = {}	-- { [fqn] = blocktab }
+   local refs = {}	-- { [fqn] = number of chain entries }
+   local hops = {}	-- { [srcfqn\0tgtfqn] = { conn index, ... } }
+   local chains = {}	-- { { ci=, name= }, ... }
+   local seen, copied = {}, {}
+   local num_fused = 0
+
+   for _,b in ipairs(idx.blocks) do blocks[b._fqn] = b end
+
+   local function entry_fqn(s, e)
+      if type(e) ~= 'table' or type(e.b) ~= 'string' then return end
+      local name = string.match(e.b, ".*#([%w_%-%/]+)")
+      return name and s._fqn..name
+   end
+
+   -- the first config of a chain wins as in configure_blocks
+   for ci,c in ipairs(idx.configs) do
+      for name,val in pairs(c.config) do
+	 local cfgfqn = c._tgt._fqn..'.'..name
+	 if string.match(name, "^chain%d+$") and not seen[cfgfqn] then
+	    seen[cfgfqn] = true
+	    if type(val) == 'table' then
+	       chains[#chains+1] = { ci=ci, name=name }
+	       for _,e in ipairs(val) do
+		  local fqn = entry_fqn(idx.cfgsys[c], e)
+		  if fqn then refs[fqn] = (refs[fqn] or 0) + 1 end
+	       end
+	    end
+	 end
+      end
+   end
+
+   for ci,c in ipairs(idx.conns) do
+      if c._src and c._tgt and c._srcpn and c._tgtpn and
+	 c.type == nil and c.config == nil then
+	 local key = c._src._fqn..'\0'..c._tgt._fqn
+	 hops[key] = hops[key] or {}
+	 insert(hops[key], ci)
+      end
+   end
+
+   local function fusable(fqn, e)
+      local num_steps, every = e.num_steps or 0, e.every or 0
+      return fqn and blocks[fqn] and refs[fqn] == 1 and
+	 num_steps >= 0 and num_steps <= 1 and every <= 1
+   end
+
+   -- shallow copy of a model table. The meta data (_fqn, _tgt, ...)
+   -- is in the shared metatable, so new keys must be set with rawset
+   local function copy(t)
+      local res = {}
+      for k,v in pairs(t) do res[k] = v end
+      return setmetatable(res, getmetatable(t))
+   end
+
+   local function config_copy(ci)
+      if copied[ci] then return idx.configs[ci] end
+      local c = idx.configs[ci]
+      local cc = copy(c)
+      cc.config = copy(c.config)
+      idx.configs[ci] = cc
+      idx.cfgsys[cc] = idx.cfgsys[c]
+      copied[ci] = true
+      return cc
+   end
+
+   local function fuse(c, name, run, k)
+      local s = idx.cfgsys[c]
+      local fqn = fmt("%s_%s_fused%d", c._tgt._fqn, name, k)
+      local lname = string.sub(fqn, #s._fqn + 1)
+      local members, names = {}, {}
+
+      if blocks[fqn] then
+	 err_exit(1, "fuse: block %s already exists", fqn)
+      end
+
+      for i,r in ipairs(run) do
+	 members[i] = { b=r.e.b, num_steps=r.e.num_steps, every=r.e.every }
+	 names[i] = r.fqn
+      end
+
+      local btab = { name=lname, type="ubx/fused", _fqn=fqn }
+      local cfg = { name=lname, config={ blocks=members }, _tgt=btab, _fqn=fqn }
+      blocks[fqn] = btab
+      insert(idx.blocks, btab)
+      insert(idx.configs, cfg)
+      idx.cfgsys[cfg] = s
+
+      info("fusing %s.%s: %s -> %s", green(c._tgt._fqn), blue(name),
+	   table.concat(names, ", "), green(fqn))
+
+      for _,src in ipairs(run) do
+	 for _,tgt in ipairs(run) do
+	    for _,hi in ipairs(hops[src.fqn..'\0'..tgt.fqn] or {}) do
+	       local hc = copy(idx.conns[hi])
+	       rawset(hc, 'type', "ubx/direct")
+	       idx.conns[hi] = hc
+	       info("fusing connection %s.%s -> %s.%s [ubx/direct]",
+		    src.fqn, hc._srcpn, tgt.fqn, hc._tgtpn)
+	    end
+	 end
+      end
+
+      return { b="#"..lname }
+   end
+
+   for _,ch in ipairs(chains) do
+      local c = idx.configs[ch.ci]
+      local s = idx.cfgsys[c]
+      local res, run, k = {}, {}, 0
+
+      local function flush()
+	 if #run >= 2 then
+	    k = k + 1
+	    res[#res+1] = fuse(c, ch.name, run, k)
+	 else
+	    for _,r in ipairs(run) do res[#res+1] = r.e end
+	 end
+	 run = {}
+      end
+
+      if (refs[c._tgt._fqn] or 0) > 1 then goto continue end
+
+      for _,e in ipairs(c.config[ch.name]) do
+	 local fqn = entry_fqn(s, e)
+	 if not fusable(fqn, e) then
+	    flush()
+	    res[#res+1] = e
+	 else
+	    if #run > 0 and not hops[run[#run].fqn..'\0'..fqn] then flush() end
+	    run[#run+1] = { e=e, fqn=fqn }
+	 end
+      end
+      flush()
+
+      if k > 0 then
+	 config_copy(ch.ci).config[ch.name] = res
+	 num_fused = num_fused + k
+      end
+      ::continue::
    end
-   mapconns(do_connect, root_sys)
+
+   if num_fused > 0 then index_add_import(idx, "fused") end
+
+   return num_fused
 end
 
 --- Merge one system into another
@@ -955,65 +1214,87 @@ function system.merge(self, sys, override)
 
    log(fmt("merging %s into parent (override: %s)", sys._srcfile, override))
 
+   -- index the existing entries of self by their merge keys. Only
+   -- the first match is indexed, as in a linear search.
+   local function index(arr, keyfun)
+      local res = {}
+      for i,o in ipairs(arr) do
+	 local k = keyfun(o)
+	 if k ~= nil and res[k] == nil then res[k] = i end
+      end
+      return res
+   end
+
+   local function conn_key(c) return ts(c.src)..'\0'..ts(c.tgt) end
+   local function name_key(o) return o.name end
+
+   local bidx = index(self.blocks, name_key)
+   local cidx = index(self.configurations, name_key)
+   local connidx = index(self.connections, conn_key)
+
    local function merge_block(x)
-      for i,b in ipairs(self.blocks) do
-	 if b.name == x.name then
-	    if override then
-	       log("  block: replacing %s with %s", tab2str(b), tab2str(x))
-	       self.blocks[i] = x
-	    else
-	       log("  block: skipping %s with %s", tab2str(b), tab2str(x))
-	    end
-	    return
+      local i = bidx[x.name]
+      if i then
+	 local b = self.blocks[i]
+	 if override then
+	    log("  block: replacing %s with %s", tab2str(b), tab2str(x))
+	    self.blocks[i] = x
+	 else
+	    log("  block: skipping %s with %s", tab2str(b), tab2str(x))
 	 end
+	 return
       end
       -- not match found, append it
       log("  block: appending %s", tab2str(x))
       insert(self.blocks, x)
+      if x.name ~= nil then bidx[x.name] = #self.blocks end
    end
 
    local function merge_config(x)
-      for _,c in ipairs(self.configurations) do
-
-	 -- if it exists, merge it config by config
-	 if c.name == x.name then
-	    local dest = c.config
-	    local src = x.config
-
-	    for k,v in pairs(src) do
-	       if dest[k] then
-		  if override then
-		     log("  config: replacing %s.%s with %s", c.name, k, tab2str(src[k]))
-		     dest[k] = src[k]
-		  else
-		     log("  config: skipping %s.%s with %s", c.name, k, tab2str(src[k]))
-		  end
-	       else
-		  log("  config: adding %s.%s with %s", c.name, k, tab2str(src[k]))
+      local i = cidx[x.name]
+
+      -- if it exists, merge it config by config
+      if i then
+	 local c = self.configurations[i]
+	 local dest = c.config
+	 local src = x.config
+
+	 for k,v in pairs(src) do
+	    if dest[k] then
+	       if override then
+		  log("  config: replacing %s.%s with %s", c.name, k, tab2str(src[k]))
 		  dest[k] = src[k]
+	       else
+		  log("  config: skipping %s.%s with %s", c.name, k, tab2str(src[k]))
 	       end
+	    else
+	       log("  config: adding %s.%s with %s", c.name, k, tab2str(src[k]))
+	       dest[k] = src[k]
 	    end
-	    return
 	 end
+	 return
       end
       log("  config: appending %s", tab2str(x))
       insert(self.configurations, x)
+      if x.name ~= nil then cidx[x.name] = #self.configurations end
    end
 
    local function merge_conn(x)
-      for i,c in ipairs(self.connections) do
-	 if c.src == x.src and c.tgt == x.tgt then
-	    if override then
-	       log("  conn: replacing %s with %s", tab2str(c), tab2str(x))
-	       self.connections[i] = x
-	    else
-	       log("  conn: skipping %s with %s", tab2str(c), tab2str(x))
-	    end
-	    return
+      local key = conn_key(x)
+      local i = connidx[key]
+      if i then
+	 local c = self.connections[i]
+	 if override then
+	    log("  conn: replacing %s with %s", tab2str(c), tab2str(x))
+	    self.connections[i] = x
+	 else
+	    log("  conn: skipping %s with %s", tab2str(c), tab2str(x))
 	 end
+	 return
       end
       log("  conn: appending %s", tab2str(x))
       insert(self.connections, x)
+      connidx[key] = #self.connections
    end
 
    local function merge_ndcfg(x, name)
@@ -1053,33 +1334,595 @@ function system.merge(self, sys, override)
 
 end
 
+--- Create a launch phase timer
+-- Each call of the returned lap function records the time passed
+-- since the previous call under the given phase name.
+-- @param enabled if false, lap is a no-op
+-- @return lap function(phase)
+-- @return result table { { phase=, dur= }, ... } with dur in seconds
+local function phase_timer(enabled)
+   local res = {}
+   if not enabled then return function() end, res end
+
+   local t0, t1 = ubx.clock_mono_gettime(), ubx.clock_mono_gettime()
+
+   local function lap(phase)
+      ubx.clock_mono_gettime(t1)
+      res[#res+1] = { phase=phase, dur=t1-t0 }
+      t0, t1 = t1, t0
+   end
+
+   return lap, res
+end
+
+--- Convert a launch profile to a printable string
+-- @param prof profile table as returned by launch
+-- @return string
+function M.profile_tostr(prof)
+   local res = { fmt("%-12s %12s %8s", "phase", "time [ms]", "%") }
+   local total = 0
+   for _,p in ipairs(prof) do total = total + p.dur end
+   for _,p in ipairs(prof) do
+      res[#res+1] = fmt("%-12s %12.3f %8.1f", p.phase, p.dur*1000,
+			total > 0 and p.dur/total*100 or 0)
+   end
+   res[#res+1] = fmt("%-12s %12.3f", "total", total*1000)
+   return table.concat(res, "\n")
+end
+
+--- Create a node for launching
+-- @param t launch configuration table
+-- @return nd
+local function launch_node_create(t)
+   t.nodename = t.nodename or "n"
+   M.LOG_STDERR = t.use_stderr or false
+
+   return ubx.node_create(t.nodename,
+			  { loglevel=t.loglevel,
+			    mlockall=t.mlockall,
+			    dumpable=t.dumpable,
+			    arena=t.arena,
+			    pool=t.pool,
+			    heap_reserve=t.heap_reserve })
+end
+
+--- Print a launch profile
+local function profile_print(prof, what, nblocks, nconfigs, nconns)
+   print(fmt("launch profile of %s (%d blocks, %d configs, %d connections)",
+	     what, nblocks, nconfigs, nconns))
+   print(M.profile_tostr(prof))
+end
+
+--- Launch a system up to the (optional) start
+-- @param self system
+-- @param t launch configuration table. t.preinit is an optional
+--        function(nd, idx) called after configuring and before
+--        initializing the blocks.
+-- @return nd node handle
+-- @return idx system index
+-- @return late table of configs applied after init
+-- @return prof profile table
+local function launch(self, t)
+   local lap, prof = phase_timer(t.profile)
+
+   if self:validate(false) > 0 then self:validate(true) os.exit(1) end
+   lap("validate")
+
+   local idx = system_index(self)
+   lap("index")
+
+   -- fire it up
+   local nd = launch_node_create(t)
+   lap("node_create")
+
+   def_loggers(nd, "launch")
+
+   if t.fuse then
+      fuse_chains(idx)
+      lap("fuse")
+   end
+
+   if t.elide then index_add_import(idx, "fused") end
+
+   import_modules(nd, idx)
+   lap("import")
+   create_blocks(nd, idx)
+   lap("create")
+   _NC = build_nodecfg_tab(nd, idx)
+   lap("nodecfg")
+   local late = configure_blocks(nd, idx, _NC, lap, t.preinit)
+   lap("reconfigure")
+   connect_blocks(nd, idx, t.elide)
+   lap("connect")
+   late_checks(t, nd)
+   lap("checks")
+
+   if not t.nostart then
+      system.startup(self, nd)
+      lap("start")
+   end
+
+   return nd, idx, late, prof
+end
+
 --- Launch a blockdiagram system
+--
+-- If t.profile is set, the time spent in each launch phase is
+-- measured, printed and returned as second value.
+--
 -- @param self system specification to load
 -- @param t configuration table
 -- @return nd node handle
+-- @return profile table { { phase=, dur= }, ... } if t.profile
 function system.launch(self, t)
+   t = t or {}
 
-   if self:validate(false) > 0 then self:validate(true) os.exit(1) end
+   local nd, idx, _, prof = launch(self, t)
 
-   -- fire it up
+   if t.profile then
+      profile_print(prof, ts(self._srcfile or t.nodename),
+		    #idx.blocks, #idx.configs, #idx.conns)
+      return nd, prof
+   end
+
+   return nd
+end
+
+---
+--- compiled models
+---
+
+local HASH_LEN = 16
+local MODEL_ALIGN = 8
+
+local model_sections = {
+   { name="deps", num="num_deps", ctype="struct ubx_model_dep" },
+   { name="modules", num="num_modules", ctype="uint32_t" },
+   { name="blocks", num="num_blocks", ctype="struct ubx_model_block" },
+   { name="ndcfgs", num="num_ndcfgs", ctype="struct ubx_model_ndcfg" },
+   { name="configs", num="num_configs", ctype="struct ubx_model_config" },
+   { name="relocs", num="num_relocs", ctype="struct ubx_model_reloc" },
+   { name="conns", num="num_conns", ctype="struct ubx_model_conn" },
+}
+
+local function align(n)
+   return math.ceil(n / MODEL_ALIGN) * MODEL_ALIGN
+end
+
+--- Compute the section offsets of a compiled model
+-- @param hdr table or struct ubx_model_hdr with the section counts
+-- @return table of section offsets, incl. strtab, blobs and size
+local function model_layout(hdr)
+   local res = {}
+   local off = align(ffi.sizeof("struct ubx_model_hdr"))
+
+   for _,sec in ipairs(model_sections) do
+      res[sec.name] = off
+      off = align(off + tonumber(hdr[sec.num]) * ffi.sizeof(sec.ctype))
+   end
+
+   res.strtab = off
+   off = align(off + tonumber(hdr.strtab_len))
+   res.blobs = off
+   res.size = off + tonumber(hdr.blob_len)
+   return res
+end
+
+local function hexstr_to_bin(hex)
+   return (string.gsub(hex, "..", function(cc) return string.char(tonumber(cc, 16)) end))
+end
+
+local function file_md5(fn)
+   local f = io.open(fn, "rb")
+   if not f then return false end
+   local data = f:read("*all")
+   f:close()
+   return hexstr_to_bin(ubx.md5(data))
+end
+
+--- Compute the cache key of a set of model files
+-- The key covers the microblx version and the file contents, hence
+-- it is independent of the location of the files.
+-- @param files list of model file names
+-- @param types optional list of the file types
+-- @return hex md5 string
+function M.model_hash(files, types)
+   local res = { safets(ubx.version()) }
+   types = types or {}
+   for i,fn in ipairs(files) do
+      local f = assert(io.open(fn, "rb"))
+      res[#res+1] = ts(types[i])
+      res[#res+1] = f:read("*all")
+      f:close()
+   end
+   return ubx.md5(table.concat(res, "\0"))
+end
+
+--- Compile a system into a binary model
+--
+-- The system is launched without starting it into a temporary node,
+-- and the resulting block instances (incl. the iblocks created for
+-- connections), config values, node configs and port connections are
+-- serialized. Note that this runs the init hooks of all blocks. The
+-- config values are captured before these run, since
+-- ubx_model_instantiate applies them before init too. Configs whose
+-- type contains pointers other than ubx_block_t* can not be compiled.
+--
+-- @param self system
+-- @param t table with launch options (loglevel, use_stderr, checks,
+--        werror, fuse, elide) and: src_hash (hex cache key, see model_hash), deps
+--        (list of source files to record in addition to the ones the
+--        system was loaded from).
+-- @return compiled model string
+function system.compile(self, t)
    t = t or {}
-   t.nodename = t.nodename or "n"
-   M.LOG_STDERR = t.use_stderr or false
 
-   local nd = ubx.node_create(t.nodename,
-			      { loglevel=t.loglevel,
-				mlockall=t.mlockall,
-				dumpable=t.dumpable })
+   -- the config values as applied before the init hooks ran
+   -- { [<blkfqn.config>] = { len=, data= } }
+   local pre = {}
+
+   local function preinit(_, idx)
+      for _,cfg in ipairs(idx.configs) do
+	 local b = idx.bptr[cfg._tgt._fqn]
+	 for name,_ in pairs(cfg.config) do
+	    local cfgfqn = cfg._tgt._fqn..'.'..name
+	    local c = ubx.config_get(b, name)
+	    if not pre[cfgfqn] and c ~= nil and c.value ~= nil then
+	       local len = tonumber(c.value.len)
+	       local size = len * tonumber(c.value.type.size)
+	       local data = ffi.new("uint8_t[?]", size)
+	       if size > 0 then ffi.copy(data, c.value.data, size) end
+	       pre[cfgfqn] = { len=len, data=data }
+	    end
+	 end
+      end
+   end
+
+   local nd, idx, late = launch(self, { nodename = "compile",
+					loglevel = t.loglevel,
+					use_stderr = t.use_stderr,
+					checks = t.checks,
+					werror = t.werror,
+					fuse = t.fuse,
+					elide = t.elide,
+					preinit = preinit,
+					nostart = true })
+
+   local strs, strtab_len, stroffs = { "" }, 1, { [""] = 0 }
+   local blobs, blob_len = {}, 0
+   local S = { deps={}, modules={}, blocks={}, ndcfgs={}, configs={}, relocs={}, conns={} }
+   local bptrs, bindex, ndindex = {}, {}, {}
+   local psize = ffi.sizeof("void*")
+
+   local function str(s)
+      if not stroffs[s] then
+	 stroffs[s] = strtab_len
+	 strs[#strs+1] = s
+	 strtab_len = strtab_len + #s + 1
+      end
+      return stroffs[s]
+   end
+
+   -- true if values of type t may contain pointers other than
+   -- ubx_block_t*, which are not relocated
+   local function has_foreign_ptrs(t)
+      if string.find(safets(t.name), "%*") then return true end
+      if t.type_class ~= ffi.C.TYPE_CLASS_STRUCT or t.private_data == nil then
+	 return false
+      end
+      local decl = ffi.string(t.private_data)
+      decl = decl:gsub("/%*.-%*/", ""):gsub("//[^\n]*", "")
+      decl = decl:gsub("ubx_block_t%s*%*", ""):gsub("struct%s+ubx_block%s*%*", "")
+      return string.find(decl, "%*") ~= nil
+   end
+
+   -- add the value of d (or of its snapshot pre) to the blobs
+   local function blob(d, what, snap)
+      if has_foreign_ptrs(d.type) then
+	 err_exit(1, "compile: %s of type %s contains pointers", what, safets(d.type.name))
+      end
+      local len = snap and snap.len or tonumber(d.len)
+      local size = len * tonumber(d.type.size)
+      local off = blob_len
+      blobs[#blobs+1] = { off=off, ptr=snap and snap.data or d.data, size=size }
+      blob_len = align(off + size)
+      return { hash=ffi.string(d.type.hash, HASH_LEN), len=len, size=size, blob=off }
+   end
+
+   -- collect the block pointers contained in a config value
+   local function blockrefs(val, res)
+      if type(val) == 'table' then
+	 for _,v in pairs(val) do res = blockrefs(v, res) end
+      elseif type(val) == 'cdata' and ffi.istype("ubx_block_t*", val) then
+	 res = res or {}
+	 res[#res+1] = val
+      end
+      return res
+   end
+
+   -- locate the pointers to the given blocks in the value of config ci
+   local function add_relocs(ci, rec, refs)
+      local p = ffi.cast("uintptr_t*", blobs[#blobs].ptr)
+      local n = math.floor(rec.size / psize)
+      for i=0,n-1 do
+	 for _,r in ipairs(refs) do
+	    if p[i] == ffi.cast("uintptr_t", r) then
+	       S.relocs[#S.relocs+1] = { config=ci, block=bindex[safets(r.name)], offset=i*psize }
+	       break
+	    end
+	 end
+      end
+   end
+
+   local function add_config(b, c, flags, ndcfg, refs)
+      local bname, cname = safets(b.name), safets(c.name)
+      local rec = { block=bindex[bname], name=str(cname),
+		    flags=flags, ndcfg=ndcfg or 0 }
+      if not ndcfg then
+	 rec.data = blob(c.value, "config "..bname.."."..cname, pre[bname.."."..cname])
+	 if refs then add_relocs(#S.configs, rec.data, refs) end
+      end
+      S.configs[#S.configs+1] = rec
+   end
+
+   -- dependencies
+   local deps, dep_seen = {}, {}
+   for _,fn in ipairs(t.deps or {}) do deps[#deps+1] = fn end
+   mapsys(function(s) if s._srcfile then deps[#deps+1] = s._srcfile end end, self)
+   for _,fn in ipairs(deps) do
+      if not dep_seen[fn] then
+	 dep_seen[fn] = true
+	 S.deps[#S.deps+1] = { hash=assert(file_md5(fn)), path=str(fn) }
+      end
+   end
+
+   foreach(function(m) S.modules[#S.modules+1] = str(m) end, idx.imports)
+
+   -- the blocks of the model and the iblocks created for connections
+   ubx.blocks_map(
+      nd,
+      function(b)
+	 local name = safets(b.name)
+	 if not idx.bptr[name] and not ubx.is_iblock_instance(b) then return end
+	 bindex[name] = #S.blocks
+	 bptrs[#bptrs+1] = b
+	 S.blocks[#S.blocks+1] = { name=str(name), type=str(ubx.block_prototype(b)) }
+      end, ubx.is_instance)
+
+   for _,nc in ipairs(idx.ndcfgs) do
+      if not ndindex[nc.name] then
+	 ndindex[nc.name] = #S.ndcfgs
+	 S.ndcfgs[#S.ndcfgs+1] = { name=str(nc.name),
+				   data=blob(_NC[nc.name], "node config "..nc.name) }
+      end
+   end
+
+   -- configs of the model. The first one wins as in configure_blocks
+   local seen = {}
+   for _,cfg in ipairs(idx.configs) do
+      local b = idx.bptr[cfg._tgt._fqn]
+      for name,val in pairs(cfg.config) do
+	 local cfgfqn = cfg._tgt._fqn..'.'..name
+	 local c = ubx.config_get(b, name)
+	 if not seen[cfgfqn] and c ~= nil then
+	    local flags = late[cfgfqn] and ffi.C.UBX_MODEL_CFG_LATE or 0
+	    local nodecfg = check_noderef(val)
+	    seen[cfgfqn] = true
+	    if nodecfg then
+	       add_config(b, c, bit.bor(flags, ffi.C.UBX_MODEL_CFG_NDCFG), ndindex[nodecfg])
+	    else
+	       add_config(b, c, flags, nil, blockrefs(val))
+	    end
+	 end
+      end
+   end
+
+   -- configs of the iblocks created for connections
+   for _,b in ipairs(bptrs) do
+      if not idx.bptr[safets(b.name)] then
+	 ubx.configs_map(b, function(c) add_config(b, c, 0) end,
+			 function(c) return c.value.len > 0 end)
+      end
+   end
+
+   -- connections
+   for bi,b in ipairs(bptrs) do
+      ubx.ports_foreach(
+	 b,
+	 function(p)
+	    local function add_conns(iacts, dir)
+	       if iacts == nil then return end
+	       local i = 0
+	       while iacts[i] ~= nil do
+		  local ib = bindex[safets(iacts[i].name)]
+		  if not ib then
+		     err_exit(1, "compile: %s.%s connected to unknown iblock %s",
+			      safets(b.name), safets(p.name), safets(iacts[i].name))
+		  end
+		  S.conns[#S.conns+1] = { block=bi-1, port=str(safets(p.name)), iblock=ib, dir=dir }
+		  i = i + 1
+	       end
+	    end
+	    add_conns(p.in_interaction, ffi.C.UBX_MODEL_CONN_IN)
+	    add_conns(p.out_interaction, ffi.C.UBX_MODEL_CONN_OUT)
+	 end)
+   end
+
+   -- serialize
+   local hdr = { strtab_len=strtab_len, blob_len=blob_len }
+   for _,sec in ipairs(model_sections) do hdr[sec.num] = #S[sec.name] end
+   local L = model_layout(hdr)
+   local buf = ffi.new("uint8_t[?]", L.size)
+
+   local function sec(name, ctype) return ffi.cast(ctype.."*", buf + L[name]) end
+
+   local function set_data(dst, rec)
+      ffi.copy(dst.type_hash, rec.hash, HASH_LEN)
+      dst.len, dst.size, dst.blob = rec.len, rec.size, rec.blob
+   end
+
+   local h = ffi.cast("struct ubx_model_hdr*", buf)
+   h.magic = ffi.C.UBX_MODEL_MAGIC
+   h.version = ffi.C.UBX_MODEL_VERSION
+   h.ptr_size = psize
+   if t.src_hash then ffi.copy(h.src_hash, hexstr_to_bin(t.src_hash), HASH_LEN) end
+   for k,v in pairs(hdr) do h[k] = v end
+   h.size = L.size
+
+   local deps_p = sec("deps", "struct ubx_model_dep")
+   for i,d in ipairs(S.deps) do
+      ffi.copy(deps_p[i-1].hash, d.hash, HASH_LEN)
+      deps_p[i-1].path = d.path
+   end
+
+   local mods_p = sec("modules", "uint32_t")
+   for i,m in ipairs(S.modules) do mods_p[i-1] = m end
+
+   local blocks_p = sec("blocks", "struct ubx_model_block")
+   for i,b in ipairs(S.blocks) do
+      blocks_p[i-1].name, blocks_p[i-1].type = b.name, b.type
+   end
+
+   local ndcfgs_p = sec("ndcfgs", "struct ubx_model_ndcfg")
+   for i,nc in ipairs(S.ndcfgs) do
+      ndcfgs_p[i-1].name = nc.name
+      set_data(ndcfgs_p[i-1].data, nc.data)
+   end
+
+   local configs_p = sec("configs", "struct ubx_model_config")
+   for i,c in ipairs(S.configs) do
+      local dst = configs_p[i-1]
+      dst.block, dst.name, dst.flags, dst.ndcfg = c.block, c.name, c.flags, c.ndcfg
+      if c.data then set_data(dst.data, c.data) end
+   end
+
+   local relocs_p = sec("relocs", "struct ubx_model_reloc")
+   for i,r in ipairs(S.relocs) do
+      relocs_p[i-1].config, relocs_p[i-1].block, relocs_p[i-1].offset = r.config, r.block, r.offset
+   end
+
+   local conns_p = sec("conns", "struct ubx_model_conn")
+   for i,c in ipairs(S.conns) do
+      local dst = conns_p[i-1]
+      dst.block, dst.port, dst.iblock, dst.dir = c.block, c.port, c.iblock, c.dir
+   end
+
+   ffi.copy(buf + L.strtab, table.concat(strs, "\0").."\0", strtab_len)
+
+   for _,b in ipairs(blobs) do
+      if b.size > 0 then ffi.copy(buf + L.blobs + b.off, b.ptr, b.size) end
+   end
+
+   local res = ffi.string(buf, L.size)
+   info("compiled %d blocks, %d configs, %d connections into %d bytes",
+	#S.blocks, #S.configs, #S.conns, L.size)
+   ubx.node_rm(nd)
+   return res
+end
+
+--- Check that a compiled model is well formed
+-- @param model compiled model string
+-- @return struct ubx_model_hdr* or false
+-- @return layout table or error message
+local function model_check(model)
+   if #model < ffi.sizeof("struct ubx_model_hdr") then
+      return false, "truncated model"
+   end
+
+   local hdr = ffi.cast("const struct ubx_model_hdr*", ffi.cast("const uint8_t*", model))
+
+   if hdr.magic ~= ffi.C.UBX_MODEL_MAGIC then
+      return false, "not a compiled model"
+   elseif hdr.version ~= ffi.C.UBX_MODEL_VERSION then
+      return false, fmt("unsupported model version %d", hdr.version)
+   elseif hdr.ptr_size ~= ffi.sizeof("void*") then
+      return false, fmt("model compiled for a %d bit host", hdr.ptr_size * 8)
+   end
+
+   local L = model_layout(hdr)
+
+   if L.size ~= tonumber(hdr.size) or L.size ~= #model then
+      return false, "corrupt model: invalid size"
+   end
+
+   return hdr, L
+end
+
+--- Launch a compiled model
+--
+-- Modules are loaded and the model is instantiated by
+-- ubx_model_instantiate, i.e. blocks are created, configs copied in
+-- as raw memory, blocks initialized and connected. Unless t.nostart
+-- the blocks are then started. No parsing or validation of the model
+-- takes place. The types of all config values are checked against
+-- the loaded ones by their hash.
+--
+-- Failures before the node is created (e.g. a changed source file)
+-- and instantiation errors such as type mismatches are returned as
+-- errors, so that the caller can fall back to a regular launch.
+--
+-- @param model compiled model string
+-- @param t launch configuration table as for launch, plus
+--        check_deps: if false, don't check the source files for changes
+-- @return nd node handle or false
+-- @return profile table if t.profile or error message
+function M.launch_compiled(model, t)
+   t = t or {}
+
+   local lap, prof = phase_timer(t.profile)
+   local hdr, msg = model_check(model)
+
+   if not hdr then return false, msg end
+
+   local m = ffi.new("struct ubx_model")
+
+   if ubx.model_open(m, model, #model) ~= 0 then
+      return false, "corrupt model"
+   end
+
+   local function str(off) return ffi.string(ubx.model_str(m, off)) end
+
+   if t.check_deps ~= false then
+      for i=0,hdr.num_deps-1 do
+	 local fn = str(m.deps[i].path)
+	 if file_md5(fn) ~= ffi.string(m.deps[i].hash, HASH_LEN) then
+	    return false, fmt("source file %s changed", fn)
+	 end
+      end
+   end
+   lap("check")
+
+   local nd = launch_node_create(t)
+   lap("node_create")
 
    def_loggers(nd, "launch")
-   import_modules(nd, self)
-   create_blocks(nd, self)
-   _NC = build_nodecfg_tab(nd, self)
-   configure_blocks(nd, self, _NC)
-   connect_blocks(nd, self)
+
+   -- modules are loaded from Lua to register their types with ffi
+   for i=0,hdr.num_modules-1 do ubx.load_module(nd, str(m.modules[i])) end
+   lap("import")
+
+   local ret = ubx.model_instantiate(nd, m)
+   ubx.model_close(m)
+
+   if ret ~= 0 then
+      ubx.node_rm(nd)
+      return false, fmt("failed to instantiate model: %s",
+			ubx.retval_tostr[ret] or ts(ret))
+   end
+   lap("instantiate")
+
    late_checks(t, nd)
+   lap("checks")
+
+   if not t.nostart then
+      system.startup(nil, nd)
+      lap("start")
+   end
 
-   if not t.nostart then system.startup(self, nd) end
+   if t.profile then
+      profile_print(prof, "compiled model", hdr.num_blocks, hdr.num_configs, hdr.num_conns)
+      return nd, prof
+   end
 
    return nd
 end
@@ -79,6 +79,194 @@ function M.tolua(cd, refct)
    return res
 end
 
+--
+-- Generated converters
+--
+-- tolua walks the reflected layout on every conversion and
+-- assigning tables to struct cdata uses the ffi table initializers,
+-- which LuaJIT can't compile. gen_tolua and gen_set instead generate
+-- flat functions for a given ctype once. Each nested struct, array
+-- and pointer type gets its own helper in the table F, so the
+-- generated code is free of recursion and helper order doesn't
+-- matter.
+--
+
+--- Return the helper name for a refct, generating it if necessary.
+-- @param ctx generator context
+-- @param refct reflect ctype (used as key via typeid)
+-- @param kind helper kind
+-- @param gen function(ctx, refct) returning the helper source
+-- @return helper name, e.g. "F[3]"
+local function gen_helper(ctx, refct, kind, gen)
+   local key = kind..":"..tostring(refct.typeid)
+   local name = ctx.ids[key]
+   if name then return name end
+
+   ctx.n = ctx.n + 1
+   name = "F["..ctx.n.."]"
+   ctx.ids[key] = name
+   ctx.src[#ctx.src+1] = name.." = "..gen(ctx, refct)
+   return name
+end
+
+--- Add a constant to the generated chunk.
+-- @return constant name, e.g. "H[1]"
+local function gen_const(ctx, val)
+   ctx.consts[#ctx.consts+1] = val
+   return "H["..#ctx.consts.."]"
+end
+
+local function is_string_arr(refct)
+   return refct.element_type.what=='int' and refct.element_type.size==1
+end
+
+local tolua_expr
+
+local function gen_tolua_struct(ctx, refct)
+   local res = { "function(x) return {" }
+   for f in refct:members() do
+      if f.name then
+	 res[#res+1] = ("   [%q] = %s,"):format(f.name, tolua_expr(ctx, f.type, ("x[%q]"):format(f.name)))
+      end
+   end
+   res[#res+1] = "} end"
+   return table.concat(res, "\n")
+end
+
+local function gen_tolua_array(ctx, refct)
+   local num_elem = refct.size/refct.element_type.size
+   return ([[
+function(x)
+   local r = {}
+   for i=0,%d do r[i+1] = %s end
+   return r
+end]]):format(num_elem-1, tolua_expr(ctx, refct.element_type, "x[i]"))
+end
+
+local function gen_tolua_ptr(ctx, refct)
+   local et = refct.element_type
+   local expr
+
+   -- as tolua, don't touch any char*, because we don't know if they
+   -- are zero terminated or not
+   if et.what=='void' then
+      expr = "tonumber(ffi_cast('intptr_t', ffi_cast('void *', x)))"
+   elseif et.what=='int' or et.what=='float' then
+      expr = "tonumber(x[0])"
+   elseif et.what=='struct' then
+      expr = tolua_expr(ctx, et, "x")
+   else
+      expr = tolua_expr(ctx, et, "x[0]")
+   end
+
+   return ("function(x) if x == nil then return 'NULL' end return %s end"):format(expr)
+end
+
+--- Generate an expression converting the value x of type refct.
+tolua_expr = function(ctx, refct, x)
+   local what = refct.what
+
+   if what=='int' and refct.bool then return x
+   elseif what=='int' or what=='float' or what=='enum' then
+      return "tonumber("..x..")"
+   elseif what=='struct' then
+      local fun = refct.name and M.struct2tab['struct '..refct.name]
+      if fun then return ("%s(%s)"):format(gen_const(ctx, fun), x) end
+      return ("%s(%s)"):format(gen_helper(ctx, refct, "tolua", gen_tolua_struct), x)
+   elseif what=='array' then
+      if is_string_arr(refct) then return "ffi_string("..x..")" end
+      if type(refct.size)~='number' then return "nil" end -- VLA
+      return ("%s(%s)"):format(gen_helper(ctx, refct, "tolua", gen_tolua_array), x)
+   elseif what=='ptr' then
+      return ("%s(%s)"):format(gen_helper(ctx, refct, "tolua", gen_tolua_ptr), x)
+   end
+
+   print("can't handle "..what..", ignoring.")
+   return "nil"
+end
+
+--- Generate a setter assigning a keyed table to a struct.
+-- Like the ffi table initializers, missing fields are zeroed.
+-- Positional tables and non-table values are assigned natively. Keys
+-- which are not named members are assigned natively too, which sets
+-- the fields of anonymous members and raises the ffi "no member"
+-- error for unknown keys.
+local function gen_set_struct(ctx, refct)
+   local res = { "function(p, v)" }
+   local names = {}
+   local function add(...) res[#res+1] = string.format(...) end
+
+   for f in refct:members() do
+      local n, ft = f.name, f.type
+      if n then names[n] = true end
+      if n == nil then
+	 -- anonymous members can't be addressed
+      elseif ft.what=='int' and ft.bool then
+	 add("   p[%q] = v[%q] or false", n, n)
+      elseif ft.what=='int' or ft.what=='float' or ft.what=='enum' then
+	 add("   p[%q] = v[%q] or 0", n, n)
+      elseif ft.what=='ptr' then
+	 add("   p[%q] = v[%q]", n, n)
+      elseif ft.what=='struct' and not (ft.name and M.struct2tab['struct '..ft.name]) then
+	 add("   do local x = v[%q]", n)
+	 add("      if x == nil or (type(x) == 'table' and x[1] == nil) then %s(p[%q], x or EMPTY)",
+	     gen_helper(ctx, ft, "set", gen_set_struct), n)
+	 add("      else p[%q] = x end end", n)
+      else
+	 add("   p[%q] = v[%q] or EMPTY", n, n)
+      end
+   end
+
+   add("   for k, x in next, v do if %s[k] == nil then p[k] = x end end", gen_const(ctx, names))
+   res[#res+1] = "end"
+   return table.concat(res, "\n")
+end
+
+--- Compile the generated helpers and root function.
+local function gen_compile(ctx, root, name)
+   local src = "local F, H, EMPTY, tonumber, type, ffi_string, ffi_cast = ...\n"..
+      table.concat(ctx.src, "\n").."\n"..
+      "return "..root.."\n"
+
+   local chunk, err = loadstring(src, "="..name)
+   if not chunk then error(name..": "..err.."\n"..src) end
+   return chunk({}, ctx.consts, {}, tonumber, type, ffi.string, ffi.cast)
+end
+
+local function gen_ctx() return { src={}, ids={}, consts={}, n=0 } end
+
+--- Generate a specialized cdata to Lua converter for a ctype.
+-- The returned function accepts a value of ctype (numbers as Lua
+-- numbers, structs as cdata or reference/pointer) and returns the same
+-- result as tolua.
+-- @param ctype ffi ctype
+-- @return function(x)
+function M.gen_tolua(ctype)
+   local ctx = gen_ctx()
+   local refct = reflect.typeof(ctype)
+   local root = ("function(x) return %s end"):format(tolua_expr(ctx, refct, "x"))
+   return gen_compile(ctx, root, "tolua:"..tostring(ctype))
+end
+
+--- Generate a specialized table to cdata setter for a struct ctype.
+-- The returned function assigns v to the struct pointed to by p. Keyed
+-- tables are assigned field by field, all other values (positional
+-- tables, cdata) are assigned natively.
+-- @param ctype ffi ctype of a struct
+-- @return function(p, v) or nil if ctype is not a struct
+function M.gen_set(ctype)
+   local refct = reflect.typeof(ctype)
+   if refct.what~='struct' then return end
+
+   local ctx = gen_ctx()
+   local root = ([[
+function(p, v)
+   if type(v) ~= 'table' or v[1] ~= nil then p[0] = v return end
+   %s(p, v)
+end]]):format(gen_helper(ctx, refct, "set", gen_set_struct))
+   return gen_compile(ctx, root, "set:"..tostring(ctype))
+end
+
 --- Destructure a refct into a Lua table.
 -- @param refct reflect ctype
 -- @result lua table
@@ -70,6 +70,27 @@ function M.md5(str)
    return utils.str_to_hexstr(ffi.string(res, 16))
 end
 
+--- Create a directory and its parents (like mkdir -p)
+-- @param path directory to create
+-- @param mode optional permissions (default 0755)
+-- @return true or false and error message
+function M.mkdir_p(path, mode)
+   local EEXIST = 17
+   local cur = string.sub(path, 1, 1) == "/" and "" or "."
+   mode = mode or tonumber("755", 8)
+
+   for comp in string.gmatch(path, "[^/]+") do
+      cur = cur.."/"..comp
+      if ffi.C.mkdir(cur, mode) ~= 0 then
+	 local err = ffi.errno()
+	 if err ~= EEXIST then
+	    return false, "mkdir "..cur..": "..ffi.string(ffi.C.strerror(err))
+	 end
+      end
+   end
+   return true
+end
+
 --- Setup Enums
 -- called internally after loading libubx
 local function setup_enums()
@@ -129,6 +150,10 @@ local ubx_ffi_headers = {
    "include/ubx/ubx_time.h",
    "include/ubx/md5.h",
    "include/ubx/ubx_utils.h",
+   "include/ubx/ubx_arena.h",
+   "include/ubx/ubx_pool.h",
+   "include/ubx/ubx_numa.h",
+   "include/ubx/ubx_model.h",
 }
 
 local ubx_ffi_lib = nil
@@ -172,6 +197,8 @@ local function load_ubx_ffi()
    void free(void *ptr);
    void *calloc(size_t nmemb, size_t size);
    void *realloc(void *ptr, size_t size);
+   int mkdir(const char *pathname, unsigned int mode);
+   char *strerror(int errnum);
    ]]
 
    -- load headers and ubx lib
@@ -306,14 +333,15 @@ ffi.metatype("struct ubx_timespec", ubx_timespec_mt)
 -- @param nd
 function M.node_rm(nd)
    ffi.gc(nd, nil)
+   collectgarbage("collect") -- return unreferenced data to the pool
    ubx.ubx_node_rm(nd)
 end
 
 --- Create and initalize a new node_info struct
 -- gc via ubx_node_rm and ffi.new set finalizer
 -- @param name name of node
--- @param loglevel desired default loglevel
--- @param attrs node attributes
+-- @param params table of node parameters: loglevel, mlockall,
+--        dumpable, arena, pool and heap_reserve (true or size in bytes)
 -- @return ubx_node_t
 function M.node_create(name, params)
    local nd = ffi.gc(ffi.new("ubx_node_t"), ubx.ubx_node_cleanup)
@@ -322,6 +350,18 @@ function M.node_create(name, params)
    if params.mlockall then attrs = bit.bor(attrs, ffi.C.ND_MLOCK_ALL) end
    if params.dumpable then attrs = bit.bor(attrs, ffi.C.ND_DUMPABLE) end
    if params.loglevel then nd.loglevel = params.loglevel end
+   if params.arena then
+      attrs = bit.bor(attrs, ffi.C.ND_ARENA)
+      if type(params.arena) == 'number' then nd.arena.size = params.arena end
+   end
+   if params.pool then
+      attrs = bit.bor(attrs, ffi.C.ND_POOL)
+      if type(params.pool) == 'number' then nd.pool_size = params.pool end
+   end
+   if params.heap_reserve then
+      attrs = bit.bor(attrs, ffi.C.ND_HEAP_RESERVE)
+      if type(params.heap_reserve) == 'number' then nd.heap_reserve = params.heap_reserve end
+   end
    assert(ubx.ubx_node_init(nd, name, attrs)==0, "node_create failed")
    return nd
 end
@@ -472,6 +512,24 @@ function M.num_types(nd) return ubx.ubx_num_types(nd) end
 function M.node_pp(nd)
    print(green(M.safe_tostr(nd.name), true))
 
+   if nd.arena.base ~= nil then
+      print(fmt("  arena: used %d/%d bytes, %d allocs, %d heap fallbacks",
+		tonumber(nd.arena.used), tonumber(nd.arena.size),
+		tonumber(nd.arena.num_allocs), tonumber(nd.arena.num_fallbacks)))
+   end
+
+   if nd.pool ~= nil then
+      print(fmt("  data pool: %d bytes, %d chunks used, %d oversized heap fallbacks",
+		tonumber(nd.pool.size), tonumber(nd.pool.used),
+		tonumber(nd.pool.num_fallbacks)))
+      for i=0,ffi.C.UBX_POOL_NUM_CLASSES-1 do
+	 local c = nd.pool.cls[i]
+	 print(fmt("    %6d: used %d/%d, high water %d, heap fallbacks %d",
+		   tonumber(c.chunk_size), tonumber(c.used), tonumber(c.num_chunks),
+		   tonumber(c.high_water), tonumber(c.num_fallbacks)))
+      end
+   end
+
    print("  modules:", true)
    M.modules_foreach(nd,
 		     function (m)
@@ -597,6 +655,7 @@ function M.block_totab(b)
    elseif M.is_iblock(b) then
       res.stat_num_reads = tonumber(b.stat_num_reads)
       res.stat_num_writes = tonumber(b.stat_num_writes)
+      res.stat_num_overruns = tonumber(b.stat_num_overruns)
    end
 
    return res
@@ -684,6 +743,7 @@ local ubx_block_mt = {
       pp = M.block_pp,
       p = M.block_port_get,
       port_get = M.block_port_get,
+      port_handle = function(b, n) return M.port_handle(b, n) end,
       port_add = ubx.ubx_port_add,
       inport_add = ubx.ubx_inport_add,
       outport_add = ubx.ubx_outport_add,
@@ -783,43 +843,70 @@ function M.ffi_load_types(nd)
 end
 
 
+-- per type converter cache, see type_conv
+local type_conv_cache = {}
+
+--- Get the converters of a ubx_type.
+-- The converters are generated once per type from the reflected
+-- layout (see cdata.gen_tolua and cdata.gen_set) and cached by type
+-- address. The seqid detects stale entries of types that were
+-- unregistered, should another type be registered at the same
+-- address.
+-- @param t ubx_type_t
+-- @return table with ptrct (pointer ctype), is_char, tolua and set
+local function type_conv(t)
+   local key = tonumber(ffi.cast("intptr_t", t))
+   local tc = type_conv_cache[key]
+
+   if tc and tc.seqid == t.seqid then return tc end
+
+   if not(t.type_class==ubx.TYPE_CLASS_BASIC or
+	  t.type_class==ubx.TYPE_CLASS_STRUCT) then
+      error("can currently only convert TYPE_CLASS_BASIC or TYPE_CLASS_STRUCT types")
+   end
+
+   local name = ffi.string(t.name)
+   local ok, ctype = pcall(ffi.typeof, name)
+
+   if not ok then
+      error(fmt("type %s unknown to ffi (missing ffi_load_types?): %s", name, ctype))
+   end
+
+   tc = {
+      seqid = t.seqid,
+      ptrct = ffi.typeof("$*", ctype),
+      is_char = name == 'char',
+      tolua = cdata.gen_tolua(ctype),
+      set = cdata.gen_set(ctype),
+   }
+
+   type_conv_cache[key] = tc
+   return tc
+end
+
 --- Convert a ubx_data_t to a plain Lua representation.
--- requires cdata.tolua
+-- Uses the generated converters of the data type.
 -- @param d ubx_data_t type
 -- @return Lua data
 function M.data_tolua(d)
    if d==nil then error("ubx_data_t argument is nil") end
    if M.data_isnull(d) then return nil end
 
-   if not(d.type.type_class==ubx.TYPE_CLASS_BASIC or
-	  d.type.type_class==ubx.TYPE_CLASS_STRUCT) then
-      error("can currently only print TYPE_CLASS_BASIC or TYPE_CLASS_STRUCT types")
-   end
-
-   local res
-   local len=tonumber(d.len)
+   local tc = type_conv(d.type)
+   local len = tonumber(d.len)
 
    -- detect char arrays
-   if d.type.type_class==ubx.TYPE_CLASS_BASIC and len>1 and M.safe_tostr(d.type.name)=='char' then
-      res=M.safe_tostr(d.data)
-   else
-      local ptrname
-      -- TODO: simplify this and pcall ffi.new. If it fails, the type
-      -- is probably unknown, and running ubx.ffi_load_types may help.
-
-      if d.type.type_class==ubx.TYPE_CLASS_STRUCT then
-	 ptrname = ffi.string(d.type.name).."*"
-      else -- BASIC:
-	 ptrname = ffi.string(d.type.name).."*"
-      end
-      local dptr = ffi.new(ptrname, d.data)
+   if tc.is_char and len>1 then return M.safe_tostr(d.data) end
+
+   local dptr = ffi.cast(tc.ptrct, d.data)
 
-      if len>1 then
-	 res = {}
-	 for i=0,len-1 do res[i+1]=cdata.tolua(dptr[i]) end
-      else res=cdata.tolua(dptr) end
+   if len>1 then
+      local res = {}
+      for i=0,len-1 do res[i+1] = tc.tolua(dptr[i]) end
+      return res
    end
-   return res
+
+   return tc.tolua(dptr[0])
 end
 
 --- Convert a ubx_data_t to a simple string representation.
@@ -876,13 +963,10 @@ end
 -- @param d ubx_data_t pointer
 -- @return ffi cdata
 function M.data_to_cdata(d, uselen)
-   local ctp
    if uselen then
-      ctp = M.type_to_ctype(d.type, true, tonumber(d.len))
-   else
-      ctp = M.type_to_ctype(d.type, true)
+      return ffi.cast(M.type_to_ctype(d.type, true, tonumber(d.len)), d.data)
    end
-   return ffi.cast(ctp, d.data)
+   return ffi.cast(type_conv(d.type).ptrct, d.data)
 end
 
 function M.data_resize(d, newlen)
@@ -900,6 +984,7 @@ function M.data_set(d, val, resize)
 
    -- find cdata of the target ubx_data
    local d_cdata = M.data_to_cdata(d)
+   local set = type_conv(d.type).set
    local val_type=type(val)
 
    if val_type=='table' then
@@ -923,7 +1008,7 @@ function M.data_set(d, val, resize)
 	       M.data_resize(d, idx+1)
 	       d_cdata = M.data_to_cdata(d) -- pointer could have changed in realloc!
 	    end
-	    d_cdata[idx]=v
+	    if set then set(d_cdata + idx, v) else d_cdata[idx]=v end
 	 end
       end
    elseif val_type=='string' then
@@ -1013,10 +1098,34 @@ function M.config_isnull(c)
    return M.data_isnull(c.value)
 end
 
+--- Check if a config must be updated via ubx_config_publish.
+-- This is the case for configs with CONFIG_ATTR_LIVE of active blocks.
+-- @param c config
+-- @return true or false
+function M.config_is_live(c)
+   return bit.band(c.attrs, ffi.C.CONFIG_ATTR_LIVE) ~= 0 and
+      c.block.block_state == ffi.C.BLOCK_STATE_ACTIVE
+end
+
+--- Publish a new value of a live config.
+-- The value is picked up by the block via ubx_config_changed. The
+-- array length of the config can not be changed.
+-- @param c config
+-- @param val value to assign (must follow luajit FFI initialization rules)
+function M.config_publish(c, val)
+   local d = M.__data_alloc(c.type, tonumber(c.value.len))
+   M.data_set(d, val, true)
+   local ret = ubx.ubx_config_publish(c, d)
+   if ret ~= 0 then
+      error("config_publish: "..M.safe_tostr(c.name)..": "..M.retval_tostr[ret])
+   end
+end
+
 --- Set a configuration value
 -- @param c config
 -- @param val value to assign (must follow luajit FFI initialization rules)
 function M.config_set(c, val)
+   if M.config_is_live(c) then return M.config_publish(c, val) end
    return M.data_set(c.value, val, true)
 end
 
@@ -1026,10 +1135,10 @@ end
 -- @param name name of configuration value
 -- @param val value to assign (must follow luajit FFI initialization rules)
 function M.set_config(b, name, val)
-   local d = ubx.ubx_config_get_data(b, name)
-   if d == nil then error("set_config: unknown config '"..name.."'") end
+   local c = ubx.ubx_config_get(b, name)
+   if c == nil then error("set_config: unknown config '"..name.."'") end
    -- print("configuring ".. ffi.string(b.name).."."..name.." with value "..utils.tab2str(val))
-   return M.data_set(d, val, true)
+   return M.config_set(c, val)
 end
 
 --- Configure a block with a table of configuration values.
@@ -1261,6 +1370,86 @@ function M.port_write_read(p, wdat, rdat)
    return M.port_read(p, rdat)
 end
 
+--- Compute the trigger roots of the blocks of a node
+--
+-- The trigger relation is taken from all configs of type struct
+-- ubx_triggee (e.g. the chains of trig and ptrig). The root of a
+-- block is the trigger at the top of its trigger tree. Blocks that
+-- are triggered by more than one block may run in different threads
+-- and have no root, and neither have the blocks they trigger.
+-- Blocks which are neither triggered nor triggers have no root.
+--
+-- The chains of triggers which step these concurrently from several
+-- threads (a num_threads config > 1, e.g. ubx/rt_executor) each form
+-- a separate tree, whose root is named "<trigger>.<chain config>".
+--
+-- Blocks with the same root are stepped sequentially by the same
+-- thread as long as the trigger configs are not changed and no
+-- block is stepped in another way.
+--
+-- @param nd node
+-- @return table { [block name] = root block name or false }
+function M.trigger_roots(nd)
+   local parents = {}	-- { [name] = { [parent name] = true } }
+   local triggers = {}	-- { [name] = true }
+   local roots = {}
+   local triggee_ptr = ffi.typeof("struct ubx_triggee*")
+
+   local function is_triggee_cfg(c)
+      return c.value ~= nil and c.type ~= nil and
+	 M.safe_tostr(c.type.name) == "struct ubx_triggee"
+   end
+
+   -- does b trigger its chains concurrently from multiple threads?
+   local function is_concurrent(b)
+      local c = M.config_get(b, "num_threads")
+      if c == nil or c.value == nil or M.data_isnull(c.value) then return false end
+      local num = M.data_tolua(c.value)
+      return type(num) == 'number' and num > 1
+   end
+
+   M.blocks_map(
+      nd,
+      function(b)
+	 local bname = M.safe_tostr(b.name)
+	 local concurrent = is_concurrent(b)
+	 M.configs_map(
+	    b,
+	    function(c)
+	       local t = ffi.cast(triggee_ptr, c.value.data)
+	       local pname = bname
+	       triggers[bname] = true
+	       if concurrent then
+		  pname = bname.."."..M.safe_tostr(c.name)
+		  triggers[pname] = true
+	       end
+	       for i=0,tonumber(c.value.len)-1 do
+		  if t[i].b ~= nil then
+		     local n = M.safe_tostr(t[i].b.name)
+		     parents[n] = parents[n] or {}
+		     parents[n][pname] = true
+		  end
+	       end
+	    end, is_triggee_cfg)
+      end, M.is_instance)
+
+   local function root(n)
+      if roots[n] ~= nil then return roots[n] end
+      roots[n] = false -- breaks cycles
+      local ps = parents[n]
+      if ps == nil then
+	 roots[n] = triggers[n] and n or false
+      else
+	 local p = next(ps)
+	 if next(ps, p) == nil then roots[n] = root(p) end
+      end
+      return roots[n]
+   end
+
+   M.blocks_map(nd, function(b) root(M.safe_tostr(b.name)) end, M.is_instance)
+   return roots
+end
+
 function M.port_out_size(p)
    if p==nil then error("port_out_size: port is nil") end
    if not M.is_outport(p) then error("port "..M.safe_tostr(p.name).." is not an outport") end
@@ -1343,6 +1532,82 @@ function M.port_tostr(port)
    return M.port_tabtostr(p)
 end
 
+------------------------------------------------------------------------------
+--                   Port handles
+------------------------------------------------------------------------------
+
+--- Port handles provide cached, allocation free port access.
+-- A handle resolves the port once and preallocates a read and a write
+-- sample together with typed cdata views of their data. Reading and
+-- writing through a handle creates no garbage and is compiled by the
+-- JIT to plain FFI calls. The views are owned by the handle and are
+-- overwritten by the next read or write.
+local port_handle = {}
+port_handle.__index = port_handle
+
+--- Read from the port into the preallocated sample.
+-- @param h port handle
+-- @return number of elements read (0 if no data, <0 in case of error)
+-- @return typed view of the read sample data
+function port_handle.read(h)
+   return tonumber(ubx.__port_read(h.port, h.rsample)), h.rview
+end
+
+--- Write to the port from the preallocated sample.
+-- If val is given, it is copied into the write view first. Otherwise
+-- the current content of the write view (h.wview) is written.
+-- @param h port handle
+-- @param val optional number, struct initializer or array table
+-- @param len number of elements to write (default: #val or data_len)
+function port_handle.write(h, val, len)
+   local wview = h.wview
+
+   if type(val) == 'table' and #val > 0 then
+      if #val > h.wlen then
+	 error(fmt("port_handle.write: %s: array length %d exceeds %d",
+		   M.safe_tostr(h.port.name), #val, h.wlen))
+      end
+      for i=1,#val do wview[i-1] = val[i] end
+      len = len or #val
+   elseif val ~= nil then
+      wview[0] = val
+      len = len or 1
+   end
+
+   h.wsample.len = len or h.wlen
+   ubx.__port_write(h.port, h.wsample)
+end
+
+function port_handle.__tostring(h)
+   return "port_handle: "..M.port_tostr(h.port)
+end
+
+--- Create a port handle.
+-- @param b block (or port, in which case pname is ignored)
+-- @param pname name of port
+-- @return port handle
+function M.port_handle(b, pname)
+   local p = b
+
+   if M.is_block(b) then p = M.port_get(b, pname) end
+   if not M.is_port(p) then error("port_handle: invalid port") end
+
+   local h = setmetatable({ port = p }, port_handle)
+
+   if M.is_inport(p) then
+      h.rsample = M.port_alloc_read_sample(p)
+      h.rview = M.data_to_cdata(h.rsample)
+   end
+
+   if M.is_outport(p) then
+      h.wsample = M.port_alloc_write_sample(p)
+      h.wview = M.data_to_cdata(h.wsample)
+      h.wlen = tonumber(p.out_data_len)
+   end
+
+   return h
+end
+
 -- add Lua OO methods
 local ubx_port_mt = {
    __tostring = M.port_tostr,
@@ -1357,6 +1622,7 @@ local ubx_port_mt = {
       read = M.port_read,
       write_read = M.port_write_read,
       read_timed = M.port_read_timed,
+      handle = M.port_handle,
    },
 }
 ffi.metatype("struct ubx_port", ubx_port_mt)
@@ -1701,13 +1967,19 @@ end
 -- @param tgtpn target (in-) port name
 -- @param ibtype iblock type to use for connection
 -- @param ibconfig iblock configuration table
+-- @param roots optional trigger roots (see trigger_roots). If given,
+--        port-port connections without ibtype and ibconfig between
+--        blocks with the same root are made via ubx/direct, if that
+--        is registered.
 -- @return true if OK, false otherwise
--- @return msg in case of error, error message.
+-- @return msg in case of error, error message. If OK, the ibtype
+--         of port-port connections.
 --
-function M.connect(nd, srcbn, srcpn, tgtbn, tgtpn, ibtype, ibconfig)
+function M.connect(nd, srcbn, srcpn, tgtbn, tgtpn, ibtype, ibconfig, roots)
    local tgtb, srcb
    local tgtp, srcp
    local ibproto
+   local elide = false
 
    -- check: invalid if block name is nil but port isn't
    if srcbn == nil and srcpn ~= nil then
@@ -1807,6 +2079,12 @@ function M.connect(nd, srcbn, srcpn, tgtbn, tgtpn, ibtype, ibconfig)
       end
    end
 
+   if roots and not ibtype and not ibconfig and
+      roots[srcbn] and roots[srcbn] == roots[tgtbn] and
+      ubx.ubx_block_get(nd, "ubx/direct") ~= nil then
+      elide = true
+   end
+
    ibconfig = ibconfig or {}
 
    -- creating src iblock
@@ -1854,6 +2132,12 @@ function M.connect(nd, srcbn, srcpn, tgtbn, tgtpn, ibtype, ibconfig)
    -- connect!
    if srcp and tgtp then
       -- block.port -> block.port
+      if elide then
+	 info(nd, "connect", fmt("eliding %s.%s -> %s.%s: same trigger root %s",
+				 srcbn, srcpn, tgtbn, tgtpn, roots[srcbn]))
+	 ibtype = "ubx/direct"
+      end
+
       ibtype = ibtype or "ubx/lfds_cyclic"
       ibconfig.data_len = ibconfig.data_len or tonumber(srcp.out_data_len)
       ibconfig.type_name = ibconfig.type_name or M.safe_tostr(srcp.out_type.name)
@@ -1873,6 +2157,7 @@ function M.connect(nd, srcbn, srcpn, tgtbn, tgtpn, ibtype, ibconfig)
 			      srcbn, srcpn,
 			      ibname, ibconfig.type_name, ibconfig.data_len,
 			      tgtbn, tgtpn, ibtype))
+      return true, ibtype
 
    elseif srcp and not tgtp then
       -- block.port -> iblock
@@ -46,7 +46,7 @@ static int const_init(ubx_block_t *b)
 	const char *type_name;
 	struct const_info *inf;
 
-	b->private_data = calloc(1, sizeof(struct const_info));
+	b->private_data = ubx_block_alloc_private(b, sizeof(struct const_info));
 
 	if (b->private_data == NULL) {
 		ubx_err(b, "EOUTOFMEM: failed to alloc const_infoo");
@@ -97,7 +97,7 @@ static int const_init(ubx_block_t *b)
 	goto out;
 
 out_free:
-	free(b->private_data);
+	ubx_block_free_private(b, b->private_data);
 out:
 	return ret;
 }
@@ -156,7 +156,7 @@ void const_cleanup(ubx_block_t *b)
 	ubx_port_rm(b, OUT);
 #endif
 	ubx_config_rm(b, VALUE);
-	free(b->private_data);
+	ubx_block_free_private(b, b->private_data);
 }
 
 /* put everything together */
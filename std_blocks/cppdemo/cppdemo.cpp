@@ -1,11 +1,15 @@
 /*
  * A demo C++ block
+ *
+ * This block uses the typed C++ layer (ubx.hpp): it reads unsigned
+ * ints from port "foo", multiplies them by the config "gain" and
+ * writes the result to "bar".
  */
 
 #undef UBX_DEBUG
 
 #include <iostream>
-#include <ubx.h>
+#include <ubx.hpp>
 
 #include "types/cpp_demo_type.h"
 #include "types/cpp_demo_type.h.hexarr"
@@ -18,13 +22,13 @@ char cppdemo_meta[] =
     "}";
 
 ubx_proto_config_t cppdemo_config[] = {
-    { .name="test_conf", .type_name="double", .doc="a test config value" },
+    { .name="gain", .type_name="unsigned int", .max=1, .doc="gain to apply (default: 1)" },
     { 0 },
 };
 
 ubx_proto_port_t cppdemo_ports[] = {
-    { .name="foo", .in_type_name="unsigned int", .doc="Out port writing foo unsigned ints" },
-    { .name="bar", .out_type_name="unsigned int", .doc="In port reading bar unsigned ints" },
+    { .name="foo", .in_type_name="unsigned int", .doc="In port reading foo unsigned ints" },
+    { .name="bar", .out_type_name="unsigned int", .doc="Out port writing bar unsigned ints" },
     { 0 },
 };
 
@@ -32,31 +36,54 @@ ubx_proto_port_t cppdemo_ports[] = {
 ubx_type_t cpp_demo_type =
     def_struct_type(struct cpp_demo_type, &cpp_demo_type_h);
 
-static int cppdemo_init(ubx_block_t *c)
-{
-    cout << "cppdemo_init: hi from " << c->name << endl;
-    return 0;
-}
-static void cppdemo_cleanup(ubx_block_t *c)
-{
-    cout << "cppdemo_cleanup: hi from " << c->name << endl;
-}
-
-static int cppdemo_start(ubx_block_t *c)
-{
-    cout << "cppdemo_start: hi from " << c->name << endl;
-    return 0;
-}
+UBX_CPP_TYPE(struct cpp_demo_type, "struct cpp_demo_type");
 
-static void cppdemo_stop(ubx_block_t *c)
+class CppDemo : public ubx::Block<CppDemo>
 {
-    cout << "cppdemo_stop: hi from " << c->name << endl;
-}
-
-static void cppdemo_step(ubx_block_t *c) {
-    cout << "cppdemo_step: hi from " << c->name << endl;
-}
-
+    ubx::InPort<unsigned int> foo;
+    ubx::OutPort<unsigned int> bar;
+    ubx::Config<unsigned int> gain;
+
+public:
+    CppDemo(ubx_block_t *b) : Block(b)
+    {
+        add(foo, "foo");
+        add(bar, "bar");
+        add(gain, "gain");
+    }
+
+    int init()
+    {
+        cout << "cppdemo_init: hi from " << block->name << endl;
+        return 0;
+    }
+
+    int start()
+    {
+        cout << "cppdemo_start: hi from " << block->name << endl;
+        return 0;
+    }
+
+    void step()
+    {
+        unsigned int val;
+
+        if (foo.read(val) <= 0)
+            return;
+
+        bar.write(val * gain.value(1));
+    }
+
+    void stop()
+    {
+        cout << "cppdemo_stop: hi from " << block->name << endl;
+    }
+
+    void cleanup()
+    {
+        cout << "cppdemo_cleanup: hi from " << block->name << endl;
+    }
+};
 
 ubx_proto_block_t cppdemo_comp =
 {
@@ -64,11 +91,12 @@ ubx_proto_block_t cppdemo_comp =
     .meta_data = cppdemo_meta,
     .type = BLOCK_TYPE_COMPUTATION,
     .configs = cppdemo_config,
-    .init = cppdemo_init,
-    .start = cppdemo_start,
-    .stop = cppdemo_stop,
-    .cleanup = cppdemo_cleanup,
-    .step = cppdemo_step,
+    .ports = cppdemo_ports,
+    .init = ubx::hooks<CppDemo>::init,
+    .start = ubx::hooks<CppDemo>::start,
+    .stop = ubx::hooks<CppDemo>::stop,
+    .cleanup = ubx::hooks<CppDemo>::cleanup,
+    .step = ubx::hooks<CppDemo>::step,
 };
 
 static int cppdemo_init(ubx_node_t* nd)
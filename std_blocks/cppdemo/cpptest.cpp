@@ -0,0 +1,106 @@
+/*
+ * A C++ block for testing ubx.hpp
+ *
+ * This block multiplies the doubles read from port "in" by the
+ * config "gain" (default: 2) and writes the result to "out". If the
+ * config "throw_in" is set to the name of a hook (or "ctor"), an
+ * exception is thrown from there.
+ */
+
+#undef UBX_DEBUG
+
+#include <stdexcept>
+#include <string>
+#include <ubx.hpp>
+
+char cpptest_meta[] =
+    "{ doc='C++ block for testing ubx.hpp',"
+    "  realtime=false,"
+    "}";
+
+ubx_proto_config_t cpptest_config[] = {
+    { .name="gain", .type_name="double", .max=1, .doc="gain to apply (default: 2)" },
+    { .name="throw_in", .type_name="char", .doc="hook to throw an exception in" },
+    { 0 },
+};
+
+ubx_proto_port_t cpptest_ports[] = {
+    { .name="in", .in_type_name="double", .doc="input value" },
+    { .name="out", .out_type_name="double", .doc="in * gain" },
+    { 0 },
+};
+
+class CppTest : public ubx::Block<CppTest>
+{
+    ubx::InPort<double> in;
+    ubx::OutPort<double> out;
+    ubx::Config<double> gain;
+    std::string throw_in;
+
+    void maybe_throw(const char *hook)
+    {
+        if (throw_in == hook)
+            throw std::runtime_error(std::string("thrown in ") + hook);
+    }
+
+public:
+    CppTest(ubx_block_t *b) : Block(b)
+    {
+        const char *s;
+
+        add(in, "in");
+        add(out, "out");
+        add(gain, "gain");
+
+        if (cfg_getptr_char(b, "throw_in", &s) > 0)
+            throw_in = s;
+
+        maybe_throw("ctor");
+    }
+
+    int init() { maybe_throw("init"); return 0; }
+    int start() { maybe_throw("start"); return 0; }
+
+    void step()
+    {
+        double val;
+
+        maybe_throw("step");
+
+        if (in.read(val) <= 0)
+            return;
+
+        out.write(val * gain.value(2));
+    }
+
+    void stop() { maybe_throw("stop"); }
+    void cleanup() { maybe_throw("cleanup"); }
+};
+
+ubx_proto_block_t cpptest_comp =
+{
+    .name = "ubx/cpptest",
+    .meta_data = cpptest_meta,
+    .type = BLOCK_TYPE_COMPUTATION,
+    .configs = cpptest_config,
+    .ports = cpptest_ports,
+    .init = ubx::hooks<CppTest>::init,
+    .start = ubx::hooks<CppTest>::start,
+    .stop = ubx::hooks<CppTest>::stop,
+    .cleanup = ubx::hooks<CppTest>::cleanup,
+    .step = ubx::hooks<CppTest>::step,
+};
+
+static int cpptest_init(ubx_node_t* nd)
+{
+    return ubx_block_register(nd, &cpptest_comp);
+}
+
+static void cpptest_cleanup(ubx_node_t *nd)
+{
+    ubx_block_unregister(nd, "ubx/cpptest");
+}
+
+UBX_MODULE_INIT(cpptest_init)
+UBX_MODULE_CLEANUP(cpptest_cleanup)
+UBX_MODULE_LICENSE_SPDX(BSD-3-Clause)
@@ -0,0 +1,205 @@
+/*
+ * A single slot, non-atomic interaction
+ *
+ * This iblock behaves like ubx/lfds_cyclic with buffer_len 1: a write
+ * stores the sample, overwriting (and counting) a sample that was not
+ * read, and a read returns and consumes the stored sample or 0 if
+ * empty. It uses no atomic operations and may thus only be used if
+ * all readers and writers are triggered by the same thread, e.g. for
+ * connections between blocks of one trigger chain.
+ */
+
+#undef UBX_DEBUG
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ubx.h"
+#include "fused.h"
+
+char direct_meta[] =
+	"{ doc='single slot, non-atomic interaction for blocks triggered by the same thread',"
+	"  realtime=true,"
+	"}";
+
+ubx_proto_config_t direct_config[] = {
+	{ .name = "type_name", .type_name = "char", .min = 1, .doc = "name of registered microblx type to transport" },
+	{ .name = "data_len", .type_name = "uint32_t", .max = 1, .doc = "array length (multiplier) of data (default: 1)" },
+	{ .name = "allow_partial", .type_name = "int", .min = 0, .max = 1, .doc = "allow msgs with len<data_len. def: 0 (no)" },
+	{ .name = "loglevel_overruns", .type_name = "int", .min = 0, .max = 1, .doc = "loglevel for reporting overflows (default: NOTICE, -1 to disable)" },
+	{ 0 },
+};
+
+ubx_proto_port_t direct_ports[] = {
+	{ .name = "overruns", .out_type_name = "unsigned long", .doc = "Number of buffer overruns. Value is output only upon change." },
+	{ 0 },
+};
+
+struct direct_info {
+	const ubx_type_t *type;
+	long data_len;
+	int allow_partial;
+
+	int full;			/* slot holds an unread sample */
+	long len;			/* array length of the sample */
+	uint8_t *data;
+
+	unsigned long overruns;
+	ubx_port_t *p_overruns;
+	int loglevel_overruns;
+};
+
+int direct_init(ubx_block_t *i)
+{
+	int ret = -1;
+	long len;
+	const int *ival;
+	const uint32_t *val;
+	const char *type_name;
+	struct direct_info *inf;
+
+	i->private_data = ubx_block_alloc_private(i, sizeof(struct direct_info));
+
+	if (i->private_data == NULL) {
+		ubx_err(i, "failed to alloc direct_info");
+		ret = EOUTOFMEM;
+		goto out;
+	}
+
+	inf = (struct direct_info *)i->private_data;
+
+	len = cfg_getptr_int(i, "loglevel_overruns", &ival);
+	assert(len >= 0);
+	inf->loglevel_overruns = (len == 0) ? UBX_LOGLEVEL_NOTICE : *ival;
+
+	if (inf->loglevel_overruns < -1 || inf->loglevel_overruns > UBX_LOGLEVEL_DEBUG) {
+		ubx_err(i, "EINVALID_CONFIG: loglevel_overruns: %i",
+			inf->loglevel_overruns);
+		ret = EINVALID_CONFIG;
+		goto out_free_priv_data;
+	}
+
+	len = cfg_getptr_uint32(i, "data_len", &val);
+	if (len < 0)
+		goto out_free_priv_data;
+
+	inf->data_len = (len > 0) ? *val : 1;
+
+	len = cfg_getptr_char(i, "type_name", &type_name);
+
+	inf->type = ubx_type_get(i->nd, type_name);
+
+	if (inf->type == NULL) {
+		ubx_err(i, "EINVALID_CONFIG: unknown type %s", type_name);
+		ret = EINVALID_CONFIG;
+		goto out_free_priv_data;
+	}
+
+	inf->data = ubx_block_alloc_private(i, inf->data_len * inf->type->size);
+
+	if (inf->data == NULL) {
+		ubx_err(i, "EOUTOFMEM: slot of %s [%lu]", type_name, inf->data_len);
+		ret = EOUTOFMEM;
+		goto out_free_priv_data;
+	}
+
+	len = cfg_getptr_int(i, "allow_partial", &ival);
+	assert(len >= 0);
+	inf->allow_partial = (len > 0) ? *ival : 0;
+
+	inf->p_overruns = ubx_port_get(i, "overruns");
+	assert(inf->p_overruns);
+
+	ret = 0;
+	goto out;
+
+ out_free_priv_data:
+	ubx_block_free_private(i, i->private_data);
+ out:
+	return ret;
+}
+
+void direct_cleanup(ubx_block_t *i)
+{
+	struct direct_info *inf = (struct direct_info *)i->private_data;
+
+	ubx_block_free_private(i, inf->data);
+	ubx_block_free_private(i, inf);
+}
+
+void direct_write(ubx_block_t *i, const ubx_data_t *msg)
+{
+	struct direct_info *inf = (struct direct_info *)i->private_data;
+
+	if (inf->type != msg->type) {
+		ubx_err(i, "invalid message type %s", msg->type->name);
+		return;
+	}
+
+	if (inf->allow_partial) {
+		if (msg->len > inf->data_len) {
+			ubx_err(i, "msg array len too large: is: %lu, capacity: %lu",
+				msg->len, inf->data_len);
+			return;
+		}
+	} else if (msg->len != inf->data_len) {
+		ubx_err(i, "EINVALID_DATA_LEN: msg len %lu != data_len %lu",
+			msg->len, inf->data_len);
+		return;
+	}
+
+	if (inf->full) {
+		inf->overruns++;
+		i->stat_num_overruns++;
+
+		write_ulong(inf->p_overruns, &inf->overruns);
+
+		if (inf->loglevel_overruns >= 0) {
+			ubx_block_log(inf->loglevel_overruns, i,
+				      "buffer overrun: #%ld", inf->overruns);
+		}
+	}
+
+	memcpy(inf->data, msg->data, data_size(msg));
+	inf->len = msg->len;
+	inf->full = 1;
+}
+
+long direct_read(ubx_block_t *i, ubx_data_t *msg)
+{
+	long readlen;
+	struct direct_info *inf = (struct direct_info *)i->private_data;
+
+	if (inf->type != msg->type) {
+		ubx_err(i, "invalid message type %s", msg->type->name);
+		return EINVALID_TYPE;
+	}
+
+	if (!inf->full)
+		return 0;
+
+	if (msg->len < inf->len) {
+		ubx_err(i, "only copying %lu array elements of %lu",
+			msg->len, inf->len);
+	}
+
+	readlen = MIN(msg->len, inf->len);
+	memcpy(msg->data, inf->data, inf->type->size * readlen);
+	inf->full = 0;
+
+	return readlen;
+}
+
+ubx_proto_block_t direct_comp = {
+	.name = "ubx/direct",
+	.type = BLOCK_TYPE_INTERACTION,
+	.meta_data = direct_meta,
+	.configs = direct_config,
+	.ports = direct_ports,
+
+	.init = direct_init,
+	.cleanup = direct_cleanup,
+
+	.write = direct_write,
+	.read = direct_read,
+};
@@ -0,0 +1,137 @@
+/*
+ * A cblock that steps a sequence of blocks as one
+ *
+ * ubx/fused replaces a straight-line sequence of blocks in a trigger
+ * chain (see the blockdiagram launch option "fuse"). The members are
+ * stepped back to back in the order of the "blocks" config, so they
+ * form a single entry of the chain (and a single entry of its per
+ * block timing statistics). The connections between the members are
+ * made via ubx/direct iblocks, which are safe to use because all
+ * members run in the thread of the fused block.
+ */
+
+#undef UBX_DEBUG
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ubx.h"
+#include "trig_utils.h"
+#include "fused.h"
+
+char fused_meta[] =
+	"{ doc='step a sequence of blocks as one',"
+	"  realtime=true,"
+	"}";
+
+ubx_proto_config_t fused_config[] = {
+	{ .name = "blocks", .type_name = "struct ubx_triggee", .min = 1, .doc = "blocks to step in this order (every must be 0 or 1)" },
+	{ 0 },
+};
+
+struct fused_info {
+	const struct ubx_triggee *blocks;
+	long num_blocks;
+};
+
+int fused_init(ubx_block_t *b)
+{
+	long len;
+	struct fused_info *inf;
+
+	b->private_data = ubx_block_alloc_private(b, sizeof(struct fused_info));
+
+	if (b->private_data == NULL) {
+		ubx_err(b, "failed to alloc fused_info");
+		return EOUTOFMEM;
+	}
+
+	inf = (struct fused_info *)b->private_data;
+
+	len = cfg_getptr_triggee(b, "blocks", &inf->blocks);
+
+	if (len <= 0) {
+		ubx_err(b, "EINVALID_CONFIG: no blocks configured");
+		goto out_err;
+	}
+
+	for (long i = 0; i < len; i++) {
+		const struct ubx_triggee *t = &inf->blocks[i];
+
+		if (t->b == NULL || t->b->type != BLOCK_TYPE_COMPUTATION) {
+			ubx_err(b, "EINVALID_CONFIG: blocks[%li] is not a cblock", i);
+			goto out_err;
+		}
+
+		if (t->every > 1) {
+			ubx_err(b, "EINVALID_CONFIG: blocks[%li] (%s): every not supported",
+				i, t->b->name);
+			goto out_err;
+		}
+	}
+
+	inf->num_blocks = len;
+	return 0;
+
+out_err:
+	ubx_block_free_private(b, inf);
+	return EINVALID_CONFIG;
+}
+
+void fused_cleanup(ubx_block_t *b)
+{
+	ubx_block_free_private(b, b->private_data);
+}
+
+void fused_step(ubx_block_t *b)
+{
+	int num_steps;
+	struct fused_info *inf = (struct fused_info *)b->private_data;
+
+	for (long i = 0; i < inf->num_blocks; i++) {
+		const struct ubx_triggee *t = &inf->blocks[i];
+
+		num_steps = (t->num_steps == 0) ? 1 : t->num_steps;
+
+		for (int s = 0; s < num_steps; s++) {
+			if (ubx_cblock_step(t->b) != 0)
+				break;
+		}
+	}
+}
+
+ubx_proto_block_t fused_comp = {
+	.name = "ubx/fused",
+	.type = BLOCK_TYPE_COMPUTATION,
+	.meta_data = fused_meta,
+	.configs = fused_config,
+
+	.init = fused_init,
+	.cleanup = fused_cleanup,
+	.step = fused_step,
+};
+
+int fused_mod_init(ubx_node_t *nd)
+{
+	int ret;
+
+	ret = ubx_block_register(nd, &fused_comp);
+	if (ret != 0)
+		return ret;
+
+	ret = ubx_block_register(nd, &direct_comp);
+	if (ret != 0)
+		ubx_block_unregister(nd, "ubx/fused");
+
+	return ret;
+}
+
+void fused_mod_cleanup(ubx_node_t *nd)
+{
+	ubx_block_unregister(nd, "ubx/direct");
+	ubx_block_unregister(nd, "ubx/fused");
+}
+
+UBX_MODULE_INIT(fused_mod_init)
+UBX_MODULE_CLEANUP(fused_mod_cleanup)
+UBX_MODULE_LICENSE_SPDX(BSD-3-Clause)
@@ -0,0 +1,14 @@
+/*
+ * Fused stepping of block sequences
+ *
+ * See fused.c and direct.c
+ */
+
+#ifndef _FUSED_H
+#define _FUSED_H
+
+#include "ubx.h"
+
+extern ubx_proto_block_t direct_comp;
+
+#endif /* _FUSED_H */
@@ -45,6 +45,10 @@ struct cyclic_block_info {
 
 	struct lfds611_ringbuffer_state *rbs;
 
+	uint8_t *elems;			/* storage of all elements */
+	size_t elem_size;		/* size of one element */
+	long num_elems;			/* number of elements handed out */
+
 	int allow_partial;
 	unsigned long overruns;		/* stats */
 	ubx_port_t *p_overruns;
@@ -60,16 +64,20 @@ int cyclic_data_elem_init(void **user_data, void *user_state)
 {
 	struct cyclic_block_info *inf = (struct cyclic_block_info *)user_state;
 
-	*user_data = calloc(1, inf->data_len * inf->type->size +
-			    sizeof(struct cyclic_elem_header));
+	if (inf->num_elems >= inf->buffer_len)
+		return 0;
+
+	*user_data = inf->elems + inf->num_elems * inf->elem_size;
+	inf->num_elems++;
 
-	return (*user_data == NULL) ? 0 : 1;
+	return 1;
 }
 
 void cyclic_data_elem_del(void *user_data, void *user_state)
 {
+	/* elements are freed at once in cyclic_cleanup */
+	(void) user_data;
 	(void) user_state;
-	free(user_data);
 }
 
 
@@ -83,7 +91,7 @@ int cyclic_init(ubx_block_t *i)
 	const char *type_name;
 	struct cyclic_block_info *inf;
 
-	i->private_data = calloc(1, sizeof(struct cyclic_block_info));
+	i->private_data = ubx_block_alloc_private(i, sizeof(struct cyclic_block_info));
 	if (i->private_data == NULL) {
 		ubx_err(i, "failed to alloc cyclic_block_info");
 		ret = EOUTOFMEM;
@@ -137,12 +145,25 @@ int cyclic_init(ubx_block_t *i)
 	ubx_debug(i, "alloc ringbuf of %lu x %s [%lu]",
 		  inf->buffer_len, type_name, inf->data_len);
 
+	/* allocate all elements as one cacheline aligned chunk */
+	inf->elem_size = inf->data_len * inf->type->size +
+		sizeof(struct cyclic_elem_header);
+	inf->elem_size = (inf->elem_size + UBX_CACHELINE_SIZE - 1) &
+		~(UBX_CACHELINE_SIZE - 1);
+
+	inf->elems = ubx_block_alloc_private(i, inf->buffer_len * inf->elem_size);
+
+	if (inf->elems == NULL) {
+		ret = EOUTOFMEM;
+		goto out_free_priv_data;
+	}
+
 	if (lfds611_ringbuffer_new(&inf->rbs, inf->buffer_len,
 				   cyclic_data_elem_init, inf) == 0) {
 		ubx_err(i, "EOUTOFMEM: ringbuf of %lu x %s [%lu]",
 			inf->buffer_len, type_name, inf->data_len);
 		ret = EOUTOFMEM;
-		goto out_free_priv_data;
+		goto out_free_elems;
 	}
 
 	/* read allow_partial */
@@ -157,8 +178,10 @@ int cyclic_init(ubx_block_t *i)
 	ret = 0;
 	goto out;
 
+ out_free_elems:
+	ubx_block_free_private(i, inf->elems);
  out_free_priv_data:
-	free(i->private_data);
+	ubx_block_free_private(i, i->private_data);
  out:
 	return ret;
 }
@@ -170,7 +193,8 @@ void cyclic_cleanup(ubx_block_t *i)
 
 	inf = (struct cyclic_block_info *)i->private_data;
 	lfds611_ringbuffer_delete(inf->rbs, cyclic_data_elem_del, inf);
-	free(inf);
+	ubx_block_free_private(i, inf->elems);
+	ubx_block_free_private(i, inf);
 }
 
 /* write */
@@ -207,6 +231,7 @@ void cyclic_write(ubx_block_t *i, const ubx_data_t *msg)
 
 	if (ret) {
 		inf->overruns++;
+		i->stat_num_overruns++;
 
 		write_ulong(inf->p_overruns, &inf->overruns);
 
@@ -10,13 +10,23 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <inttypes.h>
 
 #include "ubx.h"
 
 #define EXEC_STR_BUFF_SIZE	(16 * 1024 * 1024)
 
+/* GC policies */
+enum {
+	GC_MODE_AUTO = 0,	/* LuaJIT default incremental GC */
+	GC_MODE_STEP,		/* stopped, bounded GC step after each step hook */
+	GC_MODE_MANUAL,		/* stopped while active, full cycle in stop */
+};
+
 ubx_proto_port_t lua_ports[] = {
 	{ .name = "exec_str", .in_type_name = "char", .out_type_name = "int", .in_data_len = 16777216 },
+	{ .name = "lua_mem", .out_type_name = "unsigned long", .doc = "Lua memory in use after step [bytes]" },
+	{ .name = "gc_dur", .out_type_name = "uint64_t", .doc = "duration of the GC step after step [ns] (gc_mode 1 only)" },
 	{ 0 }
 };
 
@@ -24,6 +34,8 @@ ubx_proto_config_t lua_conf[] = {
 	{ .name = "lua_file", .type_name = "char" },
 	{ .name = "lua_str", .type_name = "char" },
 	{ .name = "loglevel", .type_name = "int" },
+	{ .name = "gc_mode", .type_name = "int", .max = 1, .doc = "0: auto (def), 1: GC stopped, step after each step hook, 2: GC stopped while active" },
+	{ .name = "gc_step_size", .type_name = "int", .max = 1, .doc = "GC step size in KiB for gc_mode 1 (def: 0, basic step)" },
 	{ 0 }
 };
 
@@ -32,10 +44,34 @@ char luablock_meta[] =
 	"  realtime=false,"
 	"}";
 
+/* hooks resolved to registry refs */
+enum {
+	HOOK_INIT = 0,
+	HOOK_START,
+	HOOK_STEP,
+	HOOK_STOP,
+	HOOK_CLEANUP,
+	HOOK_NUM,
+};
+
+static const char *hook_names[HOOK_NUM] = {
+	"init", "start", "step", "stop", "cleanup",
+};
+
 struct luablock_info {
 	struct ubx_node *ni;
 	struct lua_State *L;
 	ubx_data_t *exec_str_buff;
+
+	int hook_refs[HOOK_NUM];
+
+	int gc_mode;
+	int gc_step_size;
+	uint64_t gc_dur_max;
+
+	ubx_port_t *p_exec_str;
+	ubx_port_t *p_lua_mem;
+	ubx_port_t *p_gc_dur;
 };
 
 const char *predef_hooks =
@@ -46,34 +82,60 @@ const char *predef_hooks =
 	"function cleanup(b) end\n";
 
 /**
- * @brief: call a hook with fname.
+ * resolve_hooks - lookup the global hook functions and store them as
+ * registry refs.
+ *
+ * This avoids looking up the hooks by name on every call. It must be
+ * called again whenever the global hook functions may have changed
+ * (i.e. after executing exec_str).
+ *
+ * @param inf
+ */
+static void resolve_hooks(struct luablock_info *inf)
+{
+	for (int i = 0; i < HOOK_NUM; i++) {
+		luaL_unref(inf->L, LUA_REGISTRYINDEX, inf->hook_refs[i]);
+		lua_getglobal(inf->L, hook_names[i]);
+
+		if (lua_isfunction(inf->L, -1)) {
+			inf->hook_refs[i] = luaL_ref(inf->L, LUA_REGISTRYINDEX);
+		} else {
+			lua_pop(inf->L, 1);
+			inf->hook_refs[i] = LUA_NOREF;
+		}
+	}
+}
+
+/**
+ * @brief: call a hook.
  *
  * @param block (is passed on a first arg)
- * @param fname name of function to call
- * @param require_fun raise an error if function fname does not exist.
+ * @param hook hook id (HOOK_INIT, ...)
+ * @param require_fun raise an error if the hook function does not exist.
  * @param require_res if 1, require a boolean valued result.
  * @return -1 in case of error, 0 otherwise.
  */
-int call_hook(ubx_block_t *b, const char *fname, int require_fun, int require_res)
+int call_hook(ubx_block_t *b, int hook, int require_fun, int require_res)
 {
 	int ret = 0;
 	struct luablock_info *inf = (struct luablock_info *)b->private_data;
 	int num_res = (require_res != 0) ? 1 : 0;
 
-	lua_getglobal(inf->L, fname);
-
-	if (lua_isnil(inf->L, -1)) {
-		lua_pop(inf->L, 1);
-		if (require_fun)
-			ubx_err(b, "%s: no (required) Lua function %s", b->name, fname);
-		else
-			goto out;
+	if (inf->hook_refs[hook] == LUA_NOREF) {
+		if (require_fun) {
+			ubx_err(b, "%s: no (required) Lua function %s",
+				b->name, hook_names[hook]);
+			ret = -1;
+		}
+		goto out;
 	}
 
+	lua_rawgeti(inf->L, LUA_REGISTRYINDEX, inf->hook_refs[hook]);
 	lua_pushlightuserdata(inf->L, (void *)b);
 
 	if (lua_pcall(inf->L, 1, num_res, 0) != 0) {
-		ubx_err(b, "calling fun %s: %s", fname, lua_tostring(inf->L, -1));
+		ubx_err(b, "calling fun %s: %s", hook_names[hook], lua_tostring(inf->L, -1));
+		lua_pop(inf->L, 1); /* pop error */
 		ret = -1;
 		goto out;
 	}
@@ -81,7 +143,8 @@ int call_hook(ubx_block_t *b, const char *fname, int require_fun, int require_re
 	if (require_res) {
 		if (!lua_isboolean(inf->L, -1)) {
 			ubx_err(b, "%s: %s must return a bool but returned a %s",
-				b->name, fname, lua_typename(inf->L, lua_type(inf->L, -1)));
+				b->name, hook_names[hook], lua_typename(inf->L, lua_type(inf->L, -1)));
+			lua_pop(inf->L, 1); /* pop result */
 			ret = -1;
 			goto out;
 		}
@@ -92,6 +155,13 @@ int call_hook(ubx_block_t *b, const char *fname, int require_fun, int require_re
 	return ret;
 }
 
+/* return the memory in use by the Lua state in bytes */
+static unsigned long lua_mem(lua_State *L)
+{
+	return (unsigned long)lua_gc(L, LUA_GCCOUNT, 0) * 1024 +
+		lua_gc(L, LUA_GCCOUNTB, 0);
+}
+
 
 /**
  * init_lua_state - initalize lua_State and execute lua_file.
@@ -138,6 +208,8 @@ int init_lua_state(struct ubx_block *b,
 		}
 	}
 
+	resolve_hooks(inf);
+
 	ret = 0;
  out:
 	return ret;
@@ -148,6 +220,7 @@ int luablock_init(ubx_block_t *b)
 {
 	const char *lua_file = NULL;
 	const char *lua_str = NULL;
+	const int *val;
 	long len;
 
 	int ret = -EOUTOFMEM;
@@ -159,6 +232,31 @@ int luablock_init(ubx_block_t *b)
 
 	b->private_data = inf;
 
+	for (int i = 0; i < HOOK_NUM; i++)
+		inf->hook_refs[i] = LUA_NOREF;
+
+	len = cfg_getptr_int(b, "gc_mode", &val);
+	if (len < 0)
+		goto out_free1;
+
+	inf->gc_mode = (len > 0) ? *val : GC_MODE_AUTO;
+
+	if (inf->gc_mode < GC_MODE_AUTO || inf->gc_mode > GC_MODE_MANUAL) {
+		ubx_err(b, "EINVALID_CONFIG: gc_mode %d", inf->gc_mode);
+		ret = EINVALID_CONFIG;
+		goto out_free1;
+	}
+
+	len = cfg_getptr_int(b, "gc_step_size", &val);
+	if (len < 0)
+		goto out_free1;
+
+	inf->gc_step_size = (len > 0) ? *val : 0;
+
+	inf->p_exec_str = ubx_port_get(b, "exec_str");
+	inf->p_lua_mem = ubx_port_get(b, "lua_mem");
+	inf->p_gc_dur = ubx_port_get(b, "gc_dur");
+
 	len = cfg_getptr_char(b, "lua_file", &lua_file);
 	if (len < 0)
 		goto out_free1;
@@ -180,7 +278,7 @@ int luablock_init(ubx_block_t *b)
 	if (init_lua_state(b, lua_file, lua_str) != 0)
 		goto out_free2;
 
-	ret = call_hook(b, "init", 0, 1);
+	ret = call_hook(b, HOOK_INIT, 0, 1);
 	if (ret != 0)
 		goto out_free2;
 
@@ -198,7 +296,38 @@ int luablock_init(ubx_block_t *b)
 
 int luablock_start(ubx_block_t *b)
 {
-	return call_hook(b, "start", 0, 1);
+	struct luablock_info *inf = (struct luablock_info *)b->private_data;
+
+	inf->gc_dur_max = 0;
+
+	if (inf->gc_mode != GC_MODE_AUTO) {
+		/* start with a clean heap */
+		lua_gc(inf->L, LUA_GCCOLLECT, 0);
+		lua_gc(inf->L, LUA_GCSTOP, 0);
+	}
+
+	return call_hook(b, HOOK_START, 0, 1);
+}
+
+/* perform a bounded GC step and report its duration */
+static void gc_step(struct luablock_info *inf)
+{
+	uint64_t dur;
+	struct ubx_timespec ts_start, ts_end;
+
+	ubx_gettime(&ts_start);
+	lua_gc(inf->L, LUA_GCSTEP, inf->gc_step_size);
+	/* stepping resets the GC threshold, so stop it again */
+	lua_gc(inf->L, LUA_GCSTOP, 0);
+	ubx_gettime(&ts_end);
+
+	ubx_ts_sub(&ts_end, &ts_start, &ts_end);
+	dur = ubx_ts_to_ns(&ts_end);
+
+	if (dur > inf->gc_dur_max)
+		inf->gc_dur_max = dur;
+
+	write_uint64(inf->p_gc_dur, &dur);
 }
 
 /**
@@ -209,38 +338,59 @@ int luablock_start(ubx_block_t *b)
 void luablock_step(ubx_block_t *b)
 {
 	int len = 0, ret;
+	unsigned long mem;
 	struct luablock_info *inf = (struct luablock_info *)b->private_data;
 
 	/* any lua code to execute */
-	ubx_port_t *p_exec_str = ubx_port_get(b, "exec_str");
-
-	len = __port_read(p_exec_str, inf->exec_str_buff);
+	len = __port_read(inf->p_exec_str, inf->exec_str_buff);
 	if (len > 0) {
 		ret = luaL_dostring(inf->L, inf->exec_str_buff->data);
 		if (ret != 0) {
 			ubx_err(b, "Failed to exec_str: %s", lua_tostring(inf->L, -1));
+			lua_pop(inf->L, 1);
 			goto out;
 		}
+		/* exec_str may have redefined hooks */
+		resolve_hooks(inf);
 	}
-	call_hook(b, "step", 0, 0);
+	call_hook(b, HOOK_STEP, 0, 0);
+
+	if (inf->gc_mode == GC_MODE_STEP)
+		gc_step(inf);
+
+	mem = lua_mem(inf->L);
+	write_ulong(inf->p_lua_mem, &mem);
  out:
 	/* TODO: fix this. realloc could have changed port addr */
 	if (len > 0) {
-		p_exec_str = ubx_port_get(b, "exec_str");
-		write_int(p_exec_str, &ret);
+		inf->p_exec_str = ubx_port_get(b, "exec_str");
+		write_int(inf->p_exec_str, &ret);
 	}
 }
 
 void luablock_stop(ubx_block_t *b)
 {
-	call_hook(b, "stop", 0, 0);
+	struct luablock_info *inf = (struct luablock_info *)b->private_data;
+
+	call_hook(b, HOOK_STOP, 0, 0);
+
+	if (inf->gc_mode == GC_MODE_AUTO)
+		return;
+
+	ubx_info(b, "gc: mode %d, max step duration %" PRIu64 " ns, mem %lu bytes",
+		 inf->gc_mode, inf->gc_dur_max, lua_mem(inf->L));
+
+	lua_gc(inf->L, LUA_GCRESTART, 0);
+
+	if (inf->gc_mode == GC_MODE_MANUAL)
+		lua_gc(inf->L, LUA_GCCOLLECT, 0);
 }
 
 void luablock_cleanup(ubx_block_t *b)
 {
 	struct luablock_info *inf = (struct luablock_info *)b->private_data;
 
-	call_hook(b, "cleanup", 0, 0);
+	call_hook(b, HOOK_CLEANUP, 0, 0);
 	lua_close(inf->L);
 	ubx_data_free(inf->exec_str_buff);
 	free(b->private_data);
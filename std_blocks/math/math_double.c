@@ -1,5 +1,11 @@
 /*
  * math double function block
+ *
+ * The function, mul and add are applied in a single pass over the
+ * data. For common functions vectorized kernels (see math_kernels.h)
+ * are used, which are selected at init for the instruction set
+ * supported by the CPU (SSE2 or AVX2+FMA). All other functions are
+ * computed with libm.
  */
 
 #undef UBX_DEBUG
@@ -8,6 +14,10 @@
 #include <math.h>
 #include "ubx.h"
 
+#ifdef __x86_64__
+#include <immintrin.h>
+#endif
+
 char math_meta[] =
 	" { doc='math functions from math.h',"
 	"   realtime=true,"
@@ -20,6 +30,37 @@ struct mathfunc  {
 	double (*f) (double);
 };
 
+/* y = f(x) * mul + add, mul and add may be NULL */
+typedef void (*math_vfunc_t)(double *y, const double *x,
+			     const double *mul, const double *add, long n);
+
+struct math_kernel {
+	char name[MATHFUNC_MAXLEN];
+	math_vfunc_t vf;
+};
+
+#ifdef __x86_64__
+/* SSE2 is part of the x86_64 baseline */
+#define VLEN		2
+#define SFX		sse2
+#define VSQRT(v)	_mm_sqrt_pd(v)
+#include "math_kernels.h"
+#undef VLEN
+#undef SFX
+#undef VSQRT
+
+#pragma GCC push_options
+#pragma GCC target("avx2,fma")
+#define VLEN		4
+#define SFX		avx2
+#define VSQRT(v)	_mm256_sqrt_pd(v)
+#include "math_kernels.h"
+#undef VLEN
+#undef SFX
+#undef VSQRT
+#pragma GCC pop_options
+#endif
+
 #define _FUNC(FNAME) { .name=QUOTE(FNAME), .f=FNAME }
 
 const struct mathfunc functions [] = {
@@ -47,12 +88,14 @@ const struct mathfunc functions [] = {
 #define CDATA_LEN	"data_len"
 #define CMUL		"mul"
 #define CADD		"add"
+#define CSIMD		"simd"
 
 ubx_proto_config_t math_config[] = {
 	{ .name = CFUNC, .type_name = "char", .doc = "math function to compute", .min=1 },
 	{ .name = CDATA_LEN, .type_name = "long", .doc = "length of output data (def: 1)" },
 	{ .name = CMUL, .type_name = "double", .doc = "optional factor to multiply with y (def: 1)" },
 	{ .name = CADD, .type_name = "double", .doc = "optional offset to add to y after mul (def: 0)" },
+	{ .name = CSIMD, .type_name = "int", .max=1, .doc = "use vectorized kernels if available (def: 1)" },
 	{ 0 },
 };
 
@@ -65,8 +108,10 @@ ubx_proto_port_t math_ports[] = {
 struct math_info {
 
 	const struct mathfunc *func;
+	math_vfunc_t vf;	/* vectorized kernel or NULL */
 	const double *mul;
 	const double *add;
+	double *data;		/* preallocated data_len buffer */
 
 	ubx_port_t *p_x;
 	ubx_port_t *p_y;
@@ -93,14 +138,40 @@ int parse_func(ubx_block_t *b, struct math_info *inf)
 	return -1;
 }
 
+/* lookup the vectorized kernel of func for the CPU */
+static math_vfunc_t kernel_get(ubx_block_t *b, const char *func)
+{
+#ifdef __x86_64__
+	const char *isa = "sse2";
+	const struct math_kernel *k = math_kernels_sse2;
+
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+		isa = "avx2";
+		k = math_kernels_avx2;
+	}
+
+	for (; k->vf != NULL; k++) {
+		if (strcmp(k->name, func) == 0) {
+			ubx_info(b, "using %s kernel for %s", isa, func);
+			return k->vf;
+		}
+	}
+#endif
+	ubx_debug(b, "no vectorized kernel for %s", func);
+	return NULL;
+}
+
 int math_init(ubx_block_t *b)
 {
 	int ret = -1;
 	long len;
 	const long *data_len;
+	const int *simd;
 	struct math_info *inf;
 
-	inf = calloc(1, sizeof(struct math_info));
+	inf = ubx_block_alloc_private(b, sizeof(struct math_info));
 
 	if (inf == NULL) {
 		ubx_err(b, "math: failed to alloc memory");
@@ -123,8 +194,22 @@ int math_init(ubx_block_t *b)
 	    ubx_outport_resize(inf->p_y, inf->data_len))
 		return -1;
 
+	inf->data = ubx_block_alloc_private(b, inf->data_len * sizeof(double));
+
+	if (inf->data == NULL) {
+		ubx_err(b, "math: failed to alloc data buffer");
+		return EOUTOFMEM;
+	}
+
 	ret = parse_func(b, inf);
 
+	/* simd */
+	len = cfg_getptr_int(b, CSIMD, &simd);
+	assert(len>=0);
+
+	if (ret == 0 && (len == 0 || *simd))
+		inf->vf = kernel_get(b, inf->func->name);
+
 	/* mul */
 	len = cfg_getptr_double(b, CMUL, &inf->mul);
 	assert(len>=0);
@@ -154,7 +239,10 @@ int math_init(ubx_block_t *b)
 /* cleanup */
 void math_cleanup(ubx_block_t *b)
 {
-	free(b->private_data);
+	struct math_info *inf = (struct math_info *)b->private_data;
+
+	ubx_block_free_private(b, inf->data);
+	ubx_block_free_private(b, inf);
 }
 
 /* step */
@@ -163,7 +251,7 @@ void math_step(ubx_block_t *b)
 	long len;
 	struct math_info *inf = (struct math_info *)b->private_data;
 
-	double data[inf->data_len];
+	double *data = inf->data;
 
 	len = read_double_array(inf->p_x, data, inf->data_len);
 
@@ -178,17 +266,19 @@ void math_step(ubx_block_t *b)
 		return;
 	}
 
-	for (long i=0; i<inf->data_len; i++)
-		data[i] = inf->func->f(data[i]);
+	if (inf->vf) {
+		inf->vf(data, data, inf->mul, inf->add, len);
+	} else {
+		for (long i=0; i<len; i++) {
+			double y = inf->func->f(data[i]);
 
-	if (inf->mul){
-		for (long i=0; i<inf->data_len; i++)
-			data[i] *= inf->mul[i];
-	}
+			if (inf->mul)
+				y *= inf->mul[i];
+			if (inf->add)
+				y += inf->add[i];
 
-	if (inf->add){
-		for (long i=0; i<inf->data_len; i++)
-			data[i] += inf->add[i];
+			data[i] = y;
+		}
 	}
 
 	write_double_array(inf->p_y, data, inf->data_len);
@@ -0,0 +1,348 @@
+/*
+ * Vectorized math kernels for math_double
+ *
+ * This file is included once per instruction set with the following
+ * macros defined:
+ *
+ *   VLEN	number of doubles per vector
+ *   SFX	suffix for the generated symbols (e.g. avx2)
+ *   VSQRT(v)	vector square root
+ *
+ * and generates the kernels math_v_<func>_<SFX> and the table
+ * math_kernels_<SFX>. Each kernel computes y = f(x) * mul + add for
+ * n elements in a single pass; mul and add may be NULL. The
+ * transcendental functions are based on the Cephes library and lanes
+ * outside of the reduced range are computed with libm, so the results
+ * are within a few ulp of libm.
+ */
+
+#define KCAT_(a, b)	a ## _ ## b
+#define KCAT(a, b)	KCAT_(a, b)
+#define K(name)		KCAT(name, SFX)
+
+typedef double K(vd) __attribute__((vector_size(VLEN * 8)));
+typedef int64_t K(vi) __attribute__((vector_size(VLEN * 8)));
+
+#define VD	K(vd)
+#define VI	K(vi)
+#define KINL	static inline __attribute__((always_inline))
+
+KINL VD K(vload)(const double *p)
+{
+	VD v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+KINL void K(vstore)(double *p, VD v)
+{
+	memcpy(p, &v, sizeof(v));
+}
+
+KINL VD K(vsplat)(double c)
+{
+	return (VD){ 0 } + c;
+}
+
+/* m ? a : b for masks m of all ones or zeros */
+KINL VD K(vsel)(VI m, VD a, VD b)
+{
+	return (VD)(((VI)a & m) | ((VI)b & ~m));
+}
+
+KINL VD K(vfabs)(VD x)
+{
+	return (VD)((VI)x & 0x7fffffffffffffffL);
+}
+
+KINL VD K(vcopysign)(VD x, VD s)
+{
+	return (VD)(((VI)x & 0x7fffffffffffffffL) | ((VI)s & (int64_t)0x8000000000000000UL));
+}
+
+/* round to integer in the current rounding mode: adding and
+ * subtracting 2^52 drops the fraction of |x| < 2^52. Larger values,
+ * infinities and NaNs are returned unchanged. */
+KINL VD K(vrint)(VD x)
+{
+	VD ax = K(vfabs)(x);
+	VD r = (ax + 0x1p52) - 0x1p52;
+
+	return K(vsel)(ax < 0x1p52, K(vcopysign)(r, x), x);
+}
+
+KINL VD K(vfloor)(VD x)
+{
+	VD r = K(vrint)(x);
+	return K(vsel)(r > x, r - 1.0, r);
+}
+
+KINL VD K(vceil)(VD x)
+{
+	VD r = K(vrint)(x);
+	return K(vsel)(r < x, r + 1.0, r);
+}
+
+KINL VD K(vtrunc)(VD x)
+{
+	return K(vcopysign)(K(vfloor)(K(vfabs)(x)), x);
+}
+
+/* round half away from zero */
+KINL VD K(vround)(VD x)
+{
+	VD t = K(vtrunc)(x);
+	VD d = K(vfabs)(x - t);
+
+	return K(vsel)(d >= 0.5, t + K(vcopysign)(K(vsplat)(1.0), x), t);
+}
+
+KINL VD K(vsqrt)(VD x)
+{
+	return VSQRT(x);
+}
+
+/* 2^k for -1022 <= k <= 1023 */
+KINL VD K(vpow2i)(VI k)
+{
+	return (VD)((k + 1023) << 52);
+}
+
+/* true if all lanes of mask m are set */
+KINL int K(vall)(VI m)
+{
+	for (int i = 0; i < VLEN; i++)
+		if (!m[i])
+			return 0;
+	return 1;
+}
+
+/* apply the libm function f to all lanes */
+KINL VD K(vlibm)(double (*f)(double), VD x)
+{
+	double tmp[VLEN];
+
+	K(vstore)(tmp, x);
+	for (int i = 0; i < VLEN; i++)
+		tmp[i] = f(tmp[i]);
+
+	return K(vload)(tmp);
+}
+
+/* exp: Cephes exp.c (Pade approximation) */
+KINL VD K(vexp)(VD x)
+{
+	VD px, qx, xx, r;
+	VI k, k1;
+
+	px = K(vfloor)(x * 1.4426950408889634073599 + 0.5);
+	k = __builtin_convertvector(px, VI);
+
+	r = x - px * 6.93145751953125E-1;
+	r = r - px * 1.42860682030941723212E-6;
+
+	xx = r * r;
+	px = r * ((1.26177193074810590878E-4 * xx + 3.02994407707441961300E-2) * xx +
+		  9.99999999999999999910E-1);
+	qx = ((3.00198505138664455042E-6 * xx + 2.52448340349684104192E-3) * xx +
+	      2.27265548208155028766E-1) * xx + 2.00000000000000000009E0;
+	r = px / (qx - px);
+	r = 1.0 + 2.0 * r;
+
+	/* scale in two steps to allow for subnormal results */
+	k1 = k >> 1;
+	r = r * K(vpow2i)(k1) * K(vpow2i)(k - k1);
+
+	r = K(vsel)(x > 7.09782712893383996843E2, K(vsplat)(__builtin_inf()), r);
+	r = K(vsel)(x < -7.45133219101941108420E2, K(vsplat)(0.0), r);
+
+	return r;
+}
+
+/* log: Cephes log.c */
+KINL VD K(vlog)(VD x)
+{
+	VD m, y, z, p, q, fe;
+	VI bits, e, sub, lt;
+
+	/* scale subnormals */
+	sub = (x < 0x1p-1022) & (x > 0.0);
+	m = K(vsel)(sub, x * 0x1p54, x);
+
+	bits = (VI)m;
+	e = ((bits >> 52) & 0x7ff) - 1022 - (sub & 54);
+	m = (VD)((bits & 0x000fffffffffffffL) | 0x3fe0000000000000L);
+
+	/* m in [0.5, 1): shift to [sqrt(0.5), sqrt(2)) */
+	lt = m < 7.07106781186547524401E-1;
+	e = e + lt;	/* lt is -1 or 0 */
+	m = K(vsel)(lt, m + m - 1.0, m - 1.0);
+	fe = __builtin_convertvector(e, VD);
+
+	z = m * m;
+	p = ((((1.01875663804580931796E-4 * m + 4.97494994976747001425E-1) * m +
+	       4.70579119878881725854E0) * m + 1.44989225341610930846E1) * m +
+	     1.79368678507819816313E1) * m + 7.70838733755885391666E0;
+	q = ((((m + 1.12873587189167450590E1) * m + 4.52279145837532221105E1) * m +
+	      8.29875266912776603211E1) * m + 7.11544750618563894466E1) * m +
+	    2.31251620126765340583E1;
+
+	y = m * (z * p / q);
+	y = y - fe * 2.121944400546905827679e-4;
+	y = y - 0.5 * z;
+	y = m + y;
+	y = y + fe * 0.693359375;
+
+	/* special values */
+	y = K(vsel)(x == 0.0, K(vsplat)(-__builtin_inf()), y);
+	y = K(vsel)(x < 0.0, K(vsplat)(__builtin_nan("")), y);
+	y = K(vsel)((x == __builtin_inf()) | (x != x), x, y);
+
+	return y;
+}
+
+#define SIN_MAXARG	1.0e8
+
+KINL VD K(vsin_poly)(VD z, VD zz)
+{
+	return z + z * zz * (((((1.58962301576546568060E-10 * zz - 2.50507477628578072866E-8) * zz +
+				 2.75573136213857245213E-6) * zz - 1.98412698295895385996E-4) * zz +
+			       8.33333333332211858878E-3) * zz - 1.66666666666666307295E-1);
+}
+
+KINL VD K(vcos_poly)(VD zz)
+{
+	return 1.0 - 0.5 * zz + zz * zz * (((((-1.13585365213876817300E-11 * zz + 2.08757008419747316778E-9) * zz -
+					      2.75573141792967388112E-7) * zz + 2.48015872888517045348E-5) * zz -
+					    1.38888888888730564116E-3) * zz + 4.16666666666665929218E-2);
+}
+
+/* reduce |x| by multiples of pi/4 to z in [-pi/4, pi/4], j is the octant */
+KINL VD K(vreduce_pio4)(VD ax, VI *j)
+{
+	VD y = K(vfloor)(ax * 1.27323954473516268615);	/* 4/pi */
+	VI jj = __builtin_convertvector(y, VI);
+	VI odd = -(jj & 1);
+
+	jj = (jj - odd) & 7;
+	y = K(vsel)(odd, y + 1.0, y);
+	*j = jj;
+
+	return ((ax - y * 7.85398125648498535156E-1) - y * 3.77489470793079817668E-8) -
+		y * 2.69515142907905952645E-15;
+}
+
+/* sin: Cephes sin.c */
+KINL VD K(vsin)(VD x)
+{
+	VD ax = K(vfabs)(x), z, zz, r;
+	VI j, neg;
+
+	/* large or non-finite arguments (incl. NaN) */
+	if (!K(vall)(ax < SIN_MAXARG))
+		return K(vlibm)(sin, x);
+
+	z = K(vreduce_pio4)(ax, &j);
+	neg = (j > 3);
+	j = j - (neg & 4);
+	zz = z * z;
+
+	r = K(vsel)((j == 1) | (j == 2), K(vcos_poly)(zz), K(vsin_poly)(z, zz));
+	r = (VD)((VI)r ^ (neg & (int64_t)0x8000000000000000UL));
+
+	return K(vcopysign)(K(vsplat)(1.0), x) * r;
+}
+
+/* cos: Cephes sin.c */
+KINL VD K(vcos)(VD x)
+{
+	VD ax = K(vfabs)(x), z, zz, r;
+	VI j, neg;
+
+	if (!K(vall)(ax < SIN_MAXARG))
+		return K(vlibm)(cos, x);
+
+	z = K(vreduce_pio4)(ax, &j);
+	neg = (j > 3);
+	j = j - (neg & 4);
+	neg = neg ^ (j > 1);
+	zz = z * z;
+
+	r = K(vsel)((j == 1) | (j == 2), K(vsin_poly)(z, zz), K(vcos_poly)(zz));
+
+	return (VD)((VI)r ^ (neg & (int64_t)0x8000000000000000UL));
+}
+
+/* y = f(x) * mul + add for n elements */
+#define MATH_KERNEL(NAME, VF)						\
+static void K(math_v_ ## NAME)(double *y, const double *x,		\
+			       const double *mul, const double *add,	\
+			       long n)					\
+{									\
+	long i, j;							\
+	VD v;								\
+	double tmp[3][VLEN];						\
+									\
+	for (i = 0; i + VLEN <= n; i += VLEN) {				\
+		v = VF(K(vload)(x + i));				\
+		if (mul)						\
+			v = v * K(vload)(mul + i);			\
+		if (add)						\
+			v = v + K(vload)(add + i);			\
+		K(vstore)(y + i, v);					\
+	}								\
+									\
+	if (i == n)							\
+		return;							\
+									\
+	/* tail: pad with 1 (a valid argument for all functions) */	\
+	for (j = 0; j < VLEN; j++) {					\
+		tmp[0][j] = (i + j < n) ? x[i + j] : 1.0;		\
+		tmp[1][j] = (mul && i + j < n) ? mul[i + j] : 1.0;	\
+		tmp[2][j] = (add && i + j < n) ? add[i + j] : 0.0;	\
+	}								\
+									\
+	v = VF(K(vload)(tmp[0])) * K(vload)(tmp[1]) + K(vload)(tmp[2]); \
+	K(vstore)(tmp[0], v);						\
+									\
+	for (j = 0; i + j < n; j++)					\
+		y[i + j] = tmp[0][j];					\
+}
+
+MATH_KERNEL(sin, K(vsin))
+MATH_KERNEL(cos, K(vcos))
+MATH_KERNEL(exp, K(vexp))
+MATH_KERNEL(log, K(vlog))
+MATH_KERNEL(sqrt, K(vsqrt))
+MATH_KERNEL(fabs, K(vfabs))
+MATH_KERNEL(floor, K(vfloor))
+MATH_KERNEL(ceil, K(vceil))
+MATH_KERNEL(trunc, K(vtrunc))
+MATH_KERNEL(round, K(vround))
+MATH_KERNEL(rint, K(vrint))
+MATH_KERNEL(nearbyint, K(vrint))
+
+static const struct math_kernel K(math_kernels)[] = {
+	{ "sin", K(math_v_sin) },
+	{ "cos", K(math_v_cos) },
+	{ "exp", K(math_v_exp) },
+	{ "log", K(math_v_log) },
+	{ "sqrt", K(math_v_sqrt) },
+	{ "fabs", K(math_v_fabs) },
+	{ "floor", K(math_v_floor) },
+	{ "ceil", K(math_v_ceil) },
+	{ "trunc", K(math_v_trunc) },
+	{ "round", K(math_v_round) },
+	{ "rint", K(math_v_rint) },
+	{ "nearbyint", K(math_v_nearbyint) },
+	{ { 0 }, NULL },
+};
+
+#undef MATH_KERNEL
+#undef SIN_MAXARG
+#undef KINL
+#undef VD
+#undef VI
+#undef K
+#undef KCAT
+#undef KCAT_
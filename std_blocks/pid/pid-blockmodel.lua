@@ -9,10 +9,12 @@ return block
       },
 
       configurations= {
-	 { name="Kp", type_name="double", doc="P-gain (def: 0)" },
-	 { name="Ki", type_name="double", doc="I-gain (def: 0)" },
-	 { name="Kd", type_name="double", doc="D-gain (def: 0)" },
+	 { name="Kp", type_name="double", live=true, doc="P-gain (def: 0)" },
+	 { name="Ki", type_name="double", live=true, doc="I-gain (def: 0)" },
+	 { name="Kd", type_name="double", live=true, doc="D-gain (def: 0)" },
 	 { name="data_len", type_name="unsigned int", doc="length of signal array (def: 1)" },
+	 { name="out_min", type_name="double", doc="per channel lower output limit (def: -inf)" },
+	 { name="out_max", type_name="double", doc="per channel upper output limit (def: +inf)" },
       },
 
       ports = {
@@ -6,22 +6,85 @@
 
 #undef UBX_DEBUG
 
+#include <math.h>
 #include "pid.h"
 
+/* arguments of the single pass PID kernel, all arrays are data_len */
+struct pid_kernel_args {
+	const double *msr, *des;
+	const double *kp, *ki, *kd;
+	const double *out_min, *out_max;
+	double *integ, *err_prev, *out;
+	double d_enable;	/* 0 on the first step, else 1 */
+	long n;
+};
+
+/* 16 byte vectors: SSE2 on x86_64, the default elsewhere */
+#define VLEN	2
+#define SFX	v16
+#include "pid_kernel.h"
+#undef VLEN
+#undef SFX
+
+#ifdef __x86_64__
+#pragma GCC push_options
+#pragma GCC target("avx2,fma")
+#define VLEN	4
+#define SFX	avx2
+#include "pid_kernel.h"
+#undef VLEN
+#undef SFX
+#pragma GCC pop_options
+#endif
+
 /* block local state */
 struct pid_info
 {
 	long data_len;	/* array length of in and out data */
 
+	/* per channel state and buffers */
 	double *out, *msr, *des;
-	double *err, *err_prev, *integ, *deriv;
+	double *integ, *err_prev;
+	double *zeros, *neg_inf, *pos_inf;
 
 	int has_err_prev;
 
 	const double *kp, *ki, *kd;
+	const double *out_min, *out_max;
+	ubx_config_t *c_kp, *c_ki, *c_kd;	/* for live gain updates */
 	struct pid_port_cache ports;
+
+	void (*kernel)(const struct pid_kernel_args *a);
 };
 
+/* refresh a cached gain pointer if a new value was published */
+static inline void update_gain(ubx_config_t *c, const double **gain)
+{
+	if (ubx_config_changed(c))
+		*gain = (const double *)c->value->data;
+}
+
+/* get an optional per channel double config, default to def */
+static int cfg_getptr_channels(ubx_block_t *b, struct pid_info *inf, const char *name,
+			       const double **ptr, const double *def)
+{
+	long len = cfg_getptr_double(b, name, ptr);
+
+	if (len < 0)
+		return -1;
+
+	if (len > 0 && len != inf->data_len) {
+		ubx_err(b, "EINVALID_CONFIG_LEN: %s: actual: %lu, expected %lu",
+			name, len, inf->data_len);
+		return -1;
+	}
+
+	if (len == 0)
+		*ptr = def;
+
+	return 0;
+}
+
 /* init */
 int pid_init(ubx_block_t *b)
 {
@@ -32,7 +95,7 @@ int pid_init(ubx_block_t *b)
 	struct pid_info *inf;
 
 	/* allocate memory for the block local state */
-	if ((inf = calloc(1, sizeof(struct pid_info)))==NULL) {
+	if ((inf = ubx_block_alloc_private(b, sizeof(struct pid_info)))==NULL) {
 		ubx_err(b, "pid: failed to alloc pid_info");
 		ret=EOUTOFMEM;
 		goto out;
@@ -54,65 +117,49 @@ int pid_init(ubx_block_t *b)
 		goto out;
 	}
 
-	/* Kp */
-	len = cfg_getptr_double(b, "Kp", &inf->kp);
-	if (len < 0)
-		goto out;
+	/* allocate buffers in one chunk to keep them close together */
+	inf->out = ubx_block_alloc_private(b, 8 * inf->data_len * sizeof(double));
 
-	if (len > 0 && len != inf->data_len) {
-		ubx_err(b, "EINVALID_CONFIG_LEN: Kp: actual: %lu, expected %lu",
-			len, inf->data_len);
+	if (inf->out == NULL) {
+		ubx_err(b, "EOUTOFMEM: failed to allocate buffers");
 		goto out;
 	}
 
-	/* Ki */
-	len = cfg_getptr_double(b, "Ki", &inf->ki);
-	if (len < 0)
-		goto out;
-
-	if (len > 0 && len != inf->data_len) {
-		ubx_err(b, "EINVALID_CONFIG_LEN: Ki: actual: %lu, expected %lu",
-			len, inf->data_len);
-		goto out;
+	inf->msr = inf->out + inf->data_len;
+	inf->des = inf->msr + inf->data_len;
+	inf->integ = inf->des + inf->data_len;
+	inf->err_prev = inf->integ + inf->data_len;
+	inf->zeros = inf->err_prev + inf->data_len;
+	inf->neg_inf = inf->zeros + inf->data_len;
+	inf->pos_inf = inf->neg_inf + inf->data_len;
+
+	for (long i=0; i<inf->data_len; i++) {
+		inf->neg_inf[i] = -INFINITY;
+		inf->pos_inf[i] = INFINITY;
 	}
 
-	/* Kd */
-	len = cfg_getptr_double(b, "Kd", &inf->kd);
-	if (len < 0)
+	/* unset gains and limits point to zeros and +/-inf respectively */
+	if (cfg_getptr_channels(b, inf, "Kp", &inf->kp, inf->zeros) ||
+	    cfg_getptr_channels(b, inf, "Ki", &inf->ki, inf->zeros) ||
+	    cfg_getptr_channels(b, inf, "Kd", &inf->kd, inf->zeros) ||
+	    cfg_getptr_channels(b, inf, "out_min", &inf->out_min, inf->neg_inf) ||
+	    cfg_getptr_channels(b, inf, "out_max", &inf->out_max, inf->pos_inf))
 		goto out;
 
-	if (len > 0 && len != inf->data_len) {
-		ubx_err(b, "EINVALID_CONFIG_LEN: Kd: actual: %lu, expected %lu",
-			len, inf->data_len);
-		goto out;
-	}
+	inf->c_kp = ubx_config_get(b, "Kp");
+	inf->c_ki = ubx_config_get(b, "Ki");
+	inf->c_kd = ubx_config_get(b, "Kd");
 
-	/* allocate buffers */
-	inf->out = calloc(inf->data_len, sizeof(double));
-	inf->msr = calloc(inf->data_len, sizeof(double));
-	inf->des = calloc(inf->data_len, sizeof(double));
-	inf->err = calloc(inf->data_len, sizeof(double));
-	inf->err_prev = calloc(inf->data_len, sizeof(double));
-	inf->integ = calloc(inf->data_len, sizeof(double));
-	inf->deriv = calloc(inf->data_len, sizeof(double));
-
-	if (! (inf->out && inf->msr && inf->des && inf->err &&
-	       inf->err_prev && inf->integ && inf->deriv)) {
-		ubx_err(b, "EOUTOFMEM: failed to allocate buffers");
-		goto out_err;
-	}
+	inf->kernel = pid_kernel_v16;
+
+#ifdef __x86_64__
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+		inf->kernel = pid_kernel_avx2;
+#endif
 
 	ret=0;
-	goto out;
-
-out_err:
-	if (inf->out) free(inf->out);
-	if (inf->msr) free(inf->msr);
-	if (inf->des) free(inf->des);
-	if (inf->err) free(inf->err);
-	if (inf->err_prev) free(inf->err_prev);
-	if (inf->integ) free(inf->integ);
-	if (inf->deriv) free(inf->deriv);
 out:
 	return ret;
 }
@@ -122,14 +169,8 @@ void pid_cleanup(ubx_block_t *b)
 {
 	struct pid_info *inf = (struct pid_info*) b->private_data;
 
-	free(inf->out);
-	free(inf->msr);
-	free(inf->des);
-	free(inf->err);
-	free(inf->err_prev);
-	free(inf->integ);
-	free(inf->deriv);
-	free(b->private_data);
+	ubx_block_free_private(b, inf->out);
+	ubx_block_free_private(b, b->private_data);
 }
 
 /* step */
@@ -138,6 +179,10 @@ void pid_step(ubx_block_t *b)
 	long len_msr, len_des;
 	struct pid_info *inf = (struct pid_info*) b->private_data;
 
+	update_gain(inf->c_kp, &inf->kp);
+	update_gain(inf->c_ki, &inf->ki);
+	update_gain(inf->c_kd, &inf->kd);
+
 	len_msr = read_double_array(inf->ports.msr, inf->msr, inf->data_len);
 	len_des = read_double_array(inf->ports.des, inf->des, inf->data_len);
 
@@ -168,39 +213,18 @@ void pid_step(ubx_block_t *b)
 		goto out;
 	}
 
-	/* compute error and reset output */
-	for (int i=0; i<inf->data_len; i++) {
-		inf->out[i] = 0;
-		inf->err[i] = inf->des[i] - inf->msr[i];
-	}
-
-	/* compute proportional component */
-	if (inf->kp) {
-		for (int i=0; i<inf->data_len; i++)
-			inf->out[i] = inf->kp[i] * inf->err[i];
-	}
+	struct pid_kernel_args a = {
+		.msr = inf->msr, .des = inf->des,
+		.kp = inf->kp, .ki = inf->ki, .kd = inf->kd,
+		.out_min = inf->out_min, .out_max = inf->out_max,
+		.integ = inf->integ, .err_prev = inf->err_prev, .out = inf->out,
+		.d_enable = inf->has_err_prev ? 1 : 0,
+		.n = inf->data_len,
+	};
 
-	/* add integral component */
-	if (inf->ki) {
-		for (int i=0; i<inf->data_len; i++) {
-			inf->integ[i] += inf->err[i];
-			inf->out[i] += inf->ki[i] * inf->integ[i];
-		}
-
-	}
-
-	/* add derivative component */
-	if (inf->kd && inf->has_err_prev) {
-		for (int i=0; i<inf->data_len; i++) {
-			inf->deriv[i] = inf->err[i] - inf->err_prev[i];
-			inf->out[i] += inf->kd[i] * inf->deriv[i];
-		}
-	}
+	inf->kernel(&a);
 
 	write_double_array(inf->ports.out, inf->out, inf->data_len);
-
-	/* swap ptrs */
-	SWAP(inf->err, inf->err_prev);
 	inf->has_err_prev = 1;
 out:
 	return;
@@ -14,10 +14,12 @@ char pid_meta[] =
 
 /* declaration of block configuration */
 ubx_proto_config_t pid_config[] = {
-	{ .name="Kp", .type_name = "double", .doc="P-gain (def: 0)" },
-	{ .name="Ki", .type_name = "double", .doc="I-gain (def: 0)" },
-	{ .name="Kd", .type_name = "double", .doc="D-gain (def: 0)" },
+	{ .name="Kp", .type_name = "double", .attrs=CONFIG_ATTR_LIVE, .doc="P-gain (def: 0)" },
+	{ .name="Ki", .type_name = "double", .attrs=CONFIG_ATTR_LIVE, .doc="I-gain (def: 0)" },
+	{ .name="Kd", .type_name = "double", .attrs=CONFIG_ATTR_LIVE, .doc="D-gain (def: 0)" },
 	{ .name="data_len", .type_name = "long", .doc="length of signal array (def: 1)" },
+	{ .name="out_min", .type_name = "double", .doc="per channel lower output limit (def: -inf)" },
+	{ .name="out_max", .type_name = "double", .doc="per channel upper output limit (def: +inf)" },
 	{ 0 },
 };
 
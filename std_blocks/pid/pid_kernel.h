@@ -0,0 +1,98 @@
+/*
+ * Vectorized single pass PID kernel
+ *
+ * This file is included once per instruction set with VLEN (number of
+ * doubles per vector) and SFX (symbol suffix) defined and generates
+ * pid_kernel_<SFX>. All state is kept in per channel arrays, so that
+ * VLEN channels are computed at once.
+ */
+
+#define KCAT_(a, b)	a ## _ ## b
+#define KCAT(a, b)	KCAT_(a, b)
+#define K(name)		KCAT(name, SFX)
+
+typedef double K(pid_vd) __attribute__((vector_size(VLEN * 8)));
+typedef int64_t K(pid_vi) __attribute__((vector_size(VLEN * 8)));
+
+#define VD	K(pid_vd)
+#define VI	K(pid_vi)
+#define KINL	static inline __attribute__((always_inline))
+
+KINL VD K(pid_sel)(VI m, VD a, VD b)
+{
+	return (VD)(((VI)a & m) | ((VI)b & ~m));
+}
+
+/* load rem < VLEN elements, padding with pad */
+KINL VD K(pid_load)(const double *p, long rem, double pad)
+{
+	double tmp[VLEN];
+	VD v;
+
+	if (rem == VLEN) {
+		memcpy(&v, p, sizeof(v));
+		return v;
+	}
+
+	for (long j = 0; j < VLEN; j++)
+		tmp[j] = (j < rem) ? p[j] : pad;
+
+	memcpy(&v, tmp, sizeof(v));
+	return v;
+}
+
+KINL void K(pid_store)(double *p, VD v, long rem)
+{
+	if (rem == VLEN)
+		memcpy(p, &v, sizeof(v));
+	else
+		memcpy(p, &v, rem * sizeof(double));
+}
+
+/* compute rem <= VLEN channels starting at i */
+KINL void K(pid_channels)(const struct pid_kernel_args *a, long i, long rem)
+{
+	VD e, d, u, us, in, integ, ki;
+	VI wind;
+
+	ki = K(pid_load)(a->ki + i, rem, 0);
+	integ = K(pid_load)(a->integ + i, rem, 0);
+
+	e = K(pid_load)(a->des + i, rem, 0) - K(pid_load)(a->msr + i, rem, 0);
+	d = (e - K(pid_load)(a->err_prev + i, rem, 0)) * a->d_enable;
+
+	/* channels with Ki == 0 do not integrate */
+	in = integ + (VD)((VI)e & (ki != 0.0));
+
+	u = K(pid_load)(a->kp + i, rem, 0) * e + ki * in +
+		K(pid_load)(a->kd + i, rem, 0) * d;
+
+	/* saturate and stop integrating while driving into the limit */
+	us = K(pid_sel)(u > K(pid_load)(a->out_max + i, rem, 0), K(pid_load)(a->out_max + i, rem, 0), u);
+	us = K(pid_sel)(us < K(pid_load)(a->out_min + i, rem, 0), K(pid_load)(a->out_min + i, rem, 0), us);
+	wind = (u - us) * (ki * e) > 0.0;
+	in = K(pid_sel)(wind, integ, in);
+
+	K(pid_store)(a->integ + i, in, rem);
+	K(pid_store)(a->err_prev + i, e, rem);
+	K(pid_store)(a->out + i, us, rem);
+}
+
+static void K(pid_kernel)(const struct pid_kernel_args *args)
+{
+	long i;
+	const struct pid_kernel_args a = *args;	/* not aliased by the stores */
+
+	for (i = 0; i + VLEN <= a.n; i += VLEN)
+		K(pid_channels)(&a, i, VLEN);
+
+	if (i < a.n)
+		K(pid_channels)(&a, i, a.n - i);
+}
+
+#undef KINL
+#undef VI
+#undef VD
+#undef K
+#undef KCAT
+#undef KCAT_
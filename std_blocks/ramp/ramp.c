@@ -25,7 +25,7 @@ int ramp_init(ubx_block_t *b)
 	struct ramp_info *inf;
 
 	/* allocate memory for the block local state */
-	inf = calloc(1, sizeof(struct ramp_info));
+	inf = ubx_block_alloc_private(b, sizeof(struct ramp_info));
 	if (inf == NULL) {
 		ubx_err(b, "ramp: failed to alloc memory");
 		ret = EOUTOFMEM;
@@ -45,7 +45,7 @@ int ramp_init(ubx_block_t *b)
 	if (ubx_outport_resize(inf->ports.out, inf->data_len) != 0)
 		goto out;
 
-	inf->cur = calloc(inf->data_len, sizeof(RAMP_T));
+	inf->cur = ubx_block_alloc_private(b, inf->data_len * sizeof(RAMP_T));
 
 	if (inf->cur == NULL) {
 		ubx_err(b, "EOUTOFMEM: failed to alloc buffer");
@@ -86,7 +86,7 @@ int ramp_init(ubx_block_t *b)
 	goto out;
 
 out_free:
-	free(inf->cur);
+	ubx_block_free_private(b, inf->cur);
 out:
 	return ret;
 }
@@ -108,8 +108,8 @@ int ramp_start(ubx_block_t *b)
 void ramp_cleanup(ubx_block_t *b)
 {
 	struct ramp_info *inf = (struct ramp_info *)b->private_data;
-	free(inf->cur);
-	free(b->private_data);
+	ubx_block_free_private(b, inf->cur);
+	ubx_block_free_private(b, b->private_data);
 }
 
 /* step */
@@ -1,29 +1,64 @@
 /*
  * rand microblx function block
+ *
+ * Each block has its own xoshiro256++ state, which is seeded from the
+ * seed config with splitmix64. Thus blocks do not share state and the
+ * output of a block is reproducible for a given seed and data_len.
+ * The random numbers for all data_len elements are generated in bulk
+ * by a vectorized generator (see rand_kernel.h), which is selected at
+ * init for the instruction set supported by the CPU.
  */
 
 #if RAND_FLOAT_T == 1
 # define RAND_T float
+# define RAND_TNAME float
+# define RAND_REAL 1
 #elif RAND_DOUBLE_T == 1
 # define RAND_T double
+# define RAND_TNAME double
+# define RAND_REAL 1
 #elif RAND_UINT32_T == 1
 # define RAND_T uint32_t
-# define BLOCK_NAME "ubx/rand_uint32"
+# define RAND_TNAME uint32
 #elif RAND_INT32_T == 1
 # define RAND_T int32_t
-# define BLOCK_NAME "ubx/rand_int32"
+# define RAND_TNAME int32
 #else
 # error "no type defined"
 #endif
 
-#ifndef BLOCK_NAME
-# define BLOCK_NAME "ubx/rand_" QUOTE(RAND_T)
-#endif
+#define BLOCK_NAME "ubx/rand_" QUOTE(RAND_TNAME)
 
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
 #include <ubx.h>
 
+#define RAND_CAT_(a, b, c)	a ## b ## c
+#define RAND_CAT(a, b, c)	RAND_CAT_(a, b, c)
+#define RAND_WRITE		RAND_CAT(write_, RAND_TNAME, _array)
+
+/* number of interleaved generators */
+#define RAND_LANES	4
+
+struct rand_state {
+	uint64_t s[4][RAND_LANES];
+};
+
+/* default variant */
+#define SFX	v
+#include "rand_kernel.h"
+#undef SFX
+
+#ifdef __x86_64__
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#define SFX	avx2
+#include "rand_kernel.h"
+#undef SFX
+#pragma GCC pop_options
+#endif
+
 /* block meta information */
 char rand_meta[] =
 	" { doc='" QUOTE(RAND_T) " random number generator block',"
@@ -31,10 +66,20 @@ char rand_meta[] =
 	"}";
 
 /* declaration of block configuration */
-#define SEED 	"seed"
+#define SEED 		"seed"
+#define DATA_LEN	"data_len"
+#define DIST		"dist"
+#define MEAN		"mean"
+#define STDDEV		"stddev"
 
 ubx_proto_config_t rand_config[] = {
-	{ .name = SEED, .type_name = "long", .doc = "seed to initialize with" },
+	{ .name = SEED, .type_name = "long", .max = 1, .doc = "seed to initialize with (def: 0)" },
+	{ .name = DATA_LEN, .type_name = "long", .max = 1, .doc = "length of output array (def: 1)" },
+#ifdef RAND_REAL
+	{ .name = DIST, .type_name = "char", .doc = "distribution: uniform in [0,1) or normal (def: uniform)" },
+	{ .name = MEAN, .type_name = "double", .max = 1, .doc = "mean of the normal distribution (def: 0)" },
+	{ .name = STDDEV, .type_name = "double", .max = 1, .doc = "standard deviation of the normal distribution (def: 1)" },
+#endif
 	{ 0 },
 };
 
@@ -45,24 +90,83 @@ ubx_proto_port_t rand_ports[] = {
 	{ 0 },
 };
 
-/* define a structure for holding the block local state. By assigning an
- * instance of this struct to the block private_data pointer (see init), this
- * information becomes accessible within the hook functions.
- */
+/* block local state */
 struct rand_info {
+	struct rand_state st;
+	void (*fill)(struct rand_state *st, uint64_t *buf, long n);
+
+	long data_len;
+	long raw_len;		/* data_len rounded up to RAND_LANES */
+	uint64_t *raw;
+	RAND_T *val;
+
+	int normal;
+	double mean;
+	double stddev;
+
 	ubx_port_t *p_out;
 };
 
+static uint64_t splitmix64(uint64_t *x)
+{
+	uint64_t z = (*x += 0x9e3779b97f4a7c15ULL);
+
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+static void rand_seed(struct rand_info *inf, uint64_t seed)
+{
+	for (int l = 0; l < RAND_LANES; l++)
+		for (int i = 0; i < 4; i++)
+			inf->st.s[i][l] = splitmix64(&seed);
+}
+
+#ifdef RAND_REAL
+static int parse_dist(ubx_block_t *b, struct rand_info *inf)
+{
+	long len;
+	const char *dist;
+	const double *val;
+
+	len = cfg_getptr_char(b, DIST, &dist);
+	if (len < 0)
+		return -1;
+
+	if (len == 0 || strcmp(dist, "uniform") == 0) {
+		inf->normal = 0;
+	} else if (strcmp(dist, "normal") == 0) {
+		inf->normal = 1;
+	} else {
+		ubx_err(b, "EINVALID_CONFIG: unknown distribution %s", dist);
+		return -1;
+	}
+
+	len = cfg_getptr_double(b, MEAN, &val);
+	if (len < 0)
+		return -1;
+	inf->mean = (len > 0) ? *val : 0;
+
+	len = cfg_getptr_double(b, STDDEV, &val);
+	if (len < 0)
+		return -1;
+	inf->stddev = (len > 0) ? *val : 1;
+
+	return 0;
+}
+#endif
 
 /* init */
 int rand_init(ubx_block_t *b)
 {
+	int ret = EINVALID_CONFIG;
 	long len;
-	const long *seed;
+	const long *val;
 	struct rand_info *inf;
 
 	/* allocate memory for the block local state */
-	b->private_data = calloc(1, sizeof(struct rand_info));
+	b->private_data = ubx_block_alloc_private(b, sizeof(struct rand_info));
 	inf = (struct rand_info *)b->private_data;
 
 	if (b->private_data == NULL) {
@@ -71,44 +175,129 @@ int rand_init(ubx_block_t *b)
 	}
 
 	/* seed */
-	len = cfg_getptr_long(b, SEED, &seed);
-	assert(len >= 0);
-	srand48((len > 0) ? *seed : 0);
+	len = cfg_getptr_long(b, SEED, &val);
+	if (len < 0)
+		goto out_free;
+	rand_seed(inf, (len > 0) ? *val : 0);
+
+	/* data_len */
+	len = cfg_getptr_long(b, DATA_LEN, &val);
+	if (len < 0)
+		goto out_free;
+	inf->data_len = (len > 0) ? *val : 1;
+
+	if (inf->data_len <= 0) {
+		ubx_err(b, "EINVALID_CONFIG: data_len must be > 0");
+		goto out_free;
+	}
+
+#ifdef RAND_REAL
+	if (parse_dist(b, inf))
+		goto out_free;
+#endif
+
+	inf->raw_len = (inf->data_len + RAND_LANES - 1) / RAND_LANES * RAND_LANES;
+	inf->raw = ubx_block_alloc_private(b, inf->raw_len * sizeof(uint64_t));
+	inf->val = ubx_block_alloc_private(b, inf->data_len * sizeof(RAND_T));
+
+	if (inf->raw == NULL || inf->val == NULL) {
+		ubx_err(b, "rand: failed to alloc buffers");
+		ret = EOUTOFMEM;
+		goto out_free_bufs;
+	}
+
+	inf->fill = rand_fill_v;
+
+#ifdef __x86_64__
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("avx2"))
+		inf->fill = rand_fill_avx2;
+#endif
 
 	inf->p_out = ubx_port_get(b, OUT);
 	assert(inf->p_out);
 
+	ret = ubx_outport_resize(inf->p_out, inf->data_len);
+	if (ret != 0)
+		goto out_free_bufs;
+
 	return 0;
+
+out_free_bufs:
+	ubx_block_free_private(b, inf->raw);
+	ubx_block_free_private(b, inf->val);
+out_free:
+	ubx_block_free_private(b, inf);
+	b->private_data = NULL;
+	return ret;
 }
 
 
 /* cleanup */
 void rand_cleanup(ubx_block_t *b)
 {
-	free(b->private_data);
+	struct rand_info *inf = (struct rand_info *)b->private_data;
+
+	ubx_block_free_private(b, inf->raw);
+	ubx_block_free_private(b, inf->val);
+	ubx_block_free_private(b, inf);
+}
+
+#ifdef RAND_REAL
+/* uniform in [0,1) with 53 bits */
+static inline double u64_to_double(uint64_t x)
+{
+	return (double)(x >> 11) * 0x1p-53;
+}
+
+/* normal distribution via the Box-Muller transform */
+static void rand_normal(struct rand_info *inf)
+{
+	long i;
+	double r, phi;
+
+	for (i = 0; i < inf->data_len; i += 2) {
+		/* (0,1] to avoid log(0) */
+		r = sqrt(-2.0 * log(1.0 - u64_to_double(inf->raw[i])));
+		phi = 2.0 * M_PI * u64_to_double(inf->raw[i + 1]);
+
+		inf->val[i] = inf->mean + inf->stddev * r * cos(phi);
+
+		if (i + 1 < inf->data_len)
+			inf->val[i + 1] = inf->mean + inf->stddev * r * sin(phi);
+	}
 }
+#endif
 
 /* step */
 void rand_step(ubx_block_t *b)
 {
 	struct rand_info *inf = (struct rand_info *)b->private_data;
+
+	inf->fill(&inf->st, inf->raw, inf->raw_len);
+
+#ifdef RAND_REAL
+	if (inf->normal) {
+		rand_normal(inf);
+		goto out;
+	}
+#endif
+
+	for (long i = 0; i < inf->data_len; i++) {
 #if RAND_FLOAT_T == 1
-	RAND_T val = drand48();
-	write_float(inf->p_out,	&val);
+		inf->val[i] = (float)(inf->raw[i] >> 40) * 0x1p-24f;
 #elif RAND_DOUBLE_T == 1
-	double val = drand48();
-	write_double(inf->p_out, &val);
-#elif RAND_UINT32_T == 1
-	uint32_t val = lrand48();
-	write_uint32(inf->p_out, &val);
-#elif RAND_INT32_T == 1
-	int32_t val = mrand48();
-	write_int32(inf->p_out, &val);
+		inf->val[i] = u64_to_double(inf->raw[i]);
 #else
-# error "unsupported type " QUOTE(RAND_T)
+		inf->val[i] = (RAND_T)(inf->raw[i] >> 32);
 #endif
+	}
 
-
+#ifdef RAND_REAL
+out:
+#endif
+	RAND_WRITE(inf->p_out, inf->val, inf->data_len);
 }
 
 
@@ -0,0 +1,52 @@
+/*
+ * Bulk xoshiro256++ generator
+ *
+ * This file is included once per instruction set with SFX (symbol
+ * suffix) defined and generates rand_fill_<SFX>. RAND_LANES
+ * independent xoshiro256++ generators are advanced in parallel, so
+ * the output only depends on the seed and not on the instruction set.
+ */
+
+#define KCAT_(a, b)	a ## _ ## b
+#define KCAT(a, b)	KCAT_(a, b)
+#define K(name)		KCAT(name, SFX)
+
+typedef uint64_t K(rand_vu) __attribute__((vector_size(RAND_LANES * 8)));
+
+#define VU		K(rand_vu)
+#define ROTL(x, k)	(((x) << (k)) | ((x) >> (64 - (k))))
+
+/* fill buf with n random numbers, n must be a multiple of RAND_LANES */
+static void K(rand_fill)(struct rand_state *st, uint64_t *buf, long n)
+{
+	VU s0, s1, s2, s3, r, t;
+
+	memcpy(&s0, st->s[0], sizeof(s0));
+	memcpy(&s1, st->s[1], sizeof(s1));
+	memcpy(&s2, st->s[2], sizeof(s2));
+	memcpy(&s3, st->s[3], sizeof(s3));
+
+	for (long i = 0; i < n; i += RAND_LANES) {
+		r = ROTL(s0 + s3, 23) + s0;
+		memcpy(buf + i, &r, sizeof(r));
+
+		t = s1 << 17;
+		s2 ^= s0;
+		s3 ^= s1;
+		s1 ^= s2;
+		s0 ^= s3;
+		s2 ^= t;
+		s3 = ROTL(s3, 45);
+	}
+
+	memcpy(st->s[0], &s0, sizeof(s0));
+	memcpy(st->s[1], &s1, sizeof(s1));
+	memcpy(st->s[2], &s2, sizeof(s2));
+	memcpy(st->s[3], &s3, sizeof(s3));
+}
+
+#undef ROTL
+#undef VU
+#undef K
+#undef KCAT
+#undef KCAT_
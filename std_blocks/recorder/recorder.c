@@ -0,0 +1,322 @@
+/*
+ * An interaction block that records the written samples to a file.
+ *
+ * The segment files are created, reserved and mapped in init, so
+ * that writing a sample only requires copying it to the mapping. No
+ * syscalls are made on the write path. When all segments are full,
+ * further samples are dropped and counted in stat_num_overruns.
+ * Stopping and starting the recorder continues the recording, a new
+ * recording is started by init.
+ *
+ * Writes must not be concurrent, i.e. all ports writing to a
+ * recorder must be triggered by the same thread.
+ */
+
+#undef UBX_DEBUG
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <limits.h>
+
+#include "ubx.h"
+#include "recorder.h"
+
+#define REC_DEFAULT_SEG_SIZE	(16 * 1024 * 1024)
+#define REC_DEFAULT_NUM_SEGS	4
+
+char recorder_meta[] =
+	"{ doc='port data recorder interaction',"
+	"  realtime=true,"
+	"}";
+
+ubx_proto_config_t recorder_config[] = {
+	{ .name = "path", .type_name = "char", .min = 1, .doc = "base path of the segment files (PATH.0000, ...)" },
+	{ .name = "type_name", .type_name = "char", .min = 1, .doc = "name of registered microblx type to record" },
+	{ .name = "data_len", .type_name = "long", .max = 1, .doc = "max array length of samples (default: 1)" },
+	{ .name = "segment_size", .type_name = "long", .max = 1, .doc = "size of each segment file in bytes (default: 16MiB)" },
+	{ .name = "num_segments", .type_name = "long", .max = 1, .doc = "number of segments to create (default: 4)" },
+	{ 0 }
+};
+
+struct recorder_info {
+	const ubx_type_t *type;
+	long data_len;
+
+	char path[PATH_MAX];
+	long seg_size;
+	long num_segs;
+	struct rec_hdr **segs;		/* segment mappings */
+	long cur;			/* current segment */
+};
+
+/* create, reserve and map a segment */
+static struct rec_hdr *seg_create(ubx_block_t *i, struct recorder_info *inf, unsigned int seg)
+{
+	int fd, ret;
+	char fn[PATH_MAX];
+	struct rec_hdr *hdr = NULL;
+
+	snprintf(fn, sizeof(fn), REC_SEG_FMT, inf->path, seg);
+
+	fd = open(fn, O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+	if (fd < 0) {
+		ubx_err(i, "failed to create %s: %m", fn);
+		goto out;
+	}
+
+	/* reserve the space to avoid SIGBUS when the disk is full */
+	ret = posix_fallocate(fd, 0, inf->seg_size);
+
+	if (ret != 0) {
+		ubx_err(i, "failed to allocate %ld bytes for %s: %s",
+			inf->seg_size, fn, strerror(ret));
+		goto out_close;
+	}
+
+	hdr = mmap(NULL, inf->seg_size, PROT_READ | PROT_WRITE,
+		   MAP_SHARED | MAP_POPULATE, fd, 0);
+
+	if (hdr == MAP_FAILED) {
+		ubx_err(i, "failed to map %s: %m", fn);
+		hdr = NULL;
+		goto out_close;
+	}
+
+	/* not fatal, as the pages are already populated */
+	if (mlock(hdr, inf->seg_size) != 0)
+		ubx_warn(i, "failed to mlock %s: %m", fn);
+
+	hdr->magic = REC_MAGIC;
+	hdr->version = REC_VERSION;
+	hdr->segment = seg;
+	memcpy(hdr->type_hash, inf->type->hash, UBX_TYPE_HASH_LEN);
+	hdr->type_size = inf->type->size;
+	hdr->data_len = inf->data_len;
+	hdr->size = inf->seg_size;
+	hdr->used = REC_ALIGNED(sizeof(struct rec_hdr));
+
+out_close:
+	close(fd);
+out:
+	return hdr;
+}
+
+/* unmap a segment and truncate it to the used size. Empty segments
+ * except the first are removed. */
+static void seg_close(ubx_block_t *i, struct recorder_info *inf, unsigned int seg)
+{
+	char fn[PATH_MAX];
+	struct rec_hdr *hdr = inf->segs[seg];
+	uint64_t used = hdr->used;
+
+	munmap(hdr, inf->seg_size);
+	snprintf(fn, sizeof(fn), REC_SEG_FMT, inf->path, seg);
+
+	if (seg > 0 && used == REC_ALIGNED(sizeof(struct rec_hdr))) {
+		unlink(fn);
+		return;
+	}
+
+	if (truncate(fn, used) != 0)
+		ubx_err(i, "failed to truncate %s: %m", fn);
+}
+
+int recorder_init(ubx_block_t *i)
+{
+	int ret = EINVALID_CONFIG;
+	long len, seg;
+	uint64_t max_sample;
+	const long *val;
+	const char *chrptr;
+	char fn[PATH_MAX];
+	struct recorder_info *inf;
+
+	inf = ubx_block_alloc_private(i, sizeof(struct recorder_info));
+
+	if (inf == NULL) {
+		ubx_err(i, "failed to alloc recorder_info");
+		ret = EOUTOFMEM;
+		goto out;
+	}
+
+	i->private_data = inf;
+
+	/* path */
+	len = cfg_getptr_char(i, "path", &chrptr);
+	if (len <= 0) {
+		ubx_err(i, "EINVALID_CONFIG: mandatory config path unset");
+		goto out_free;
+	}
+
+	if (snprintf(inf->path, sizeof(inf->path), "%s", chrptr) >= (int)sizeof(inf->path) - 5) {
+		ubx_err(i, "EINVALID_CONFIG: path too long");
+		goto out_free;
+	}
+
+	/* type_name */
+	len = cfg_getptr_char(i, "type_name", &chrptr);
+	if (len <= 0) {
+		ubx_err(i, "EINVALID_CONFIG: mandatory config type_name unset");
+		goto out_free;
+	}
+
+	inf->type = ubx_type_get(i->nd, chrptr);
+
+	if (inf->type == NULL) {
+		ubx_err(i, "EINVALID_CONFIG: unknown type %s", chrptr);
+		goto out_free;
+	}
+
+	/* data_len, segment_size, num_segments */
+	len = cfg_getptr_long(i, "data_len", &val);
+	if (len < 0)
+		goto out_free;
+	inf->data_len = (len > 0) ? *val : 1;
+
+	len = cfg_getptr_long(i, "segment_size", &val);
+	if (len < 0)
+		goto out_free;
+	inf->seg_size = (len > 0) ? *val : REC_DEFAULT_SEG_SIZE;
+
+	len = cfg_getptr_long(i, "num_segments", &val);
+	if (len < 0)
+		goto out_free;
+	inf->num_segs = (len > 0) ? *val : REC_DEFAULT_NUM_SEGS;
+
+	max_sample = sizeof(struct rec_sample) + REC_ALIGNED(inf->type->size * inf->data_len);
+
+	if (inf->data_len <= 0 || inf->num_segs <= 0 || inf->num_segs > UINT16_MAX ||
+	    inf->seg_size < 0 ||
+	    (uint64_t)inf->seg_size < REC_ALIGNED(sizeof(struct rec_hdr)) + max_sample) {
+		ubx_err(i, "EINVALID_CONFIG: invalid data_len, segment_size or num_segments");
+		goto out_free;
+	}
+
+	/* remove stale segments of a previous recording */
+	for (seg = inf->num_segs; seg <= UINT16_MAX; seg++) {
+		snprintf(fn, sizeof(fn), REC_SEG_FMT, inf->path, (unsigned int)seg);
+		if (unlink(fn) != 0)
+			break;
+	}
+
+	inf->segs = ubx_block_alloc_private(i, inf->num_segs * sizeof(struct rec_hdr *));
+
+	if (inf->segs == NULL) {
+		ret = EOUTOFMEM;
+		goto out_free;
+	}
+
+	for (seg = 0; seg < inf->num_segs; seg++) {
+		inf->segs[seg] = seg_create(i, inf, seg);
+
+		if (inf->segs[seg] == NULL) {
+			ret = -1;
+			goto out_unmap;
+		}
+	}
+
+	ubx_info(i, "recording %s[%ld] to %s (%ld x %ld bytes)",
+		 inf->type->name, inf->data_len, inf->path,
+		 inf->num_segs, inf->seg_size);
+
+	ret = 0;
+	goto out;
+
+out_unmap:
+	while (--seg >= 0)
+		seg_close(i, inf, seg);
+	ubx_block_free_private(i, inf->segs);
+out_free:
+	ubx_block_free_private(i, inf);
+	i->private_data = NULL;
+out:
+	return ret;
+}
+
+void recorder_cleanup(ubx_block_t *i)
+{
+	struct recorder_info *inf = (struct recorder_info *)i->private_data;
+
+	for (long seg = 0; seg < inf->num_segs; seg++)
+		seg_close(i, inf, seg);
+
+	if (i->stat_num_overruns > 0)
+		ubx_notice(i, "dropped %lu samples", i->stat_num_overruns);
+
+	ubx_block_free_private(i, inf->segs);
+	ubx_block_free_private(i, inf);
+}
+
+void recorder_write(ubx_block_t *i, const ubx_data_t *data)
+{
+	uint64_t dsize, size;
+	struct ubx_timespec now;
+	struct rec_sample *s;
+	struct rec_hdr *hdr;
+	struct recorder_info *inf = (struct recorder_info *)i->private_data;
+
+	if (data->type != inf->type || data->len > inf->data_len || data->len <= 0) {
+		ubx_err(i, "invalid sample %s[%ld]", get_typename(data), data->len);
+		return;
+	}
+
+	dsize = data_size(data);
+	size = sizeof(struct rec_sample) + REC_ALIGNED(dsize);
+	hdr = inf->segs[inf->cur];
+
+	if (hdr->used + size > hdr->size) {
+		if (inf->cur + 1 >= inf->num_segs) {
+			i->stat_num_overruns++;
+			return;
+		}
+		hdr = inf->segs[++inf->cur];
+	}
+
+	ubx_clock_mono_gettime(&now);
+
+	s = (struct rec_sample *)((uint8_t *)hdr + hdr->used);
+	s->ts = ubx_ts_to_ns(&now);
+	s->len = data->len;
+	s->size = size;
+	memcpy(s + 1, data->data, dsize);
+
+	__atomic_store_n(&hdr->used, hdr->used + size, __ATOMIC_RELEASE);
+}
+
+ubx_proto_block_t recorder_comp = {
+	.name = "ubx/recorder",
+	.type = BLOCK_TYPE_INTERACTION,
+	.meta_data = recorder_meta,
+	.configs = recorder_config,
+
+	.init = recorder_init,
+	.cleanup = recorder_cleanup,
+	.write = recorder_write,
+};
+
+int recorder_mod_init(ubx_node_t *nd)
+{
+	int ret;
+
+	ret = ubx_block_register(nd, &recorder_comp);
+	if (ret != 0)
+		return ret;
+
+	ret = ubx_block_register(nd, &replay_comp);
+	if (ret != 0)
+		ubx_block_unregister(nd, "ubx/recorder");
+
+	return ret;
+}
+
+void recorder_mod_cleanup(ubx_node_t *nd)
+{
+	ubx_block_unregister(nd, "ubx/replay");
+	ubx_block_unregister(nd, "ubx/recorder");
+}
+
+UBX_MODULE_INIT(recorder_mod_init)
+UBX_MODULE_CLEANUP(recorder_mod_cleanup)
+UBX_MODULE_LICENSE_SPDX(BSD-3-Clause)
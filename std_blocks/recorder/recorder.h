@@ -0,0 +1,61 @@
+/*
+ * Port data recording file format
+ *
+ * A recording consists of one or more segment files PATH.0000,
+ * PATH.0001, ... Each segment starts with a struct rec_hdr, which is
+ * followed by the samples. Each sample consists of a struct
+ * rec_sample and the raw data, padded to REC_ALIGN bytes.
+ *
+ * The recording is only portable between hosts of the same ABI.
+ */
+
+#ifndef _RECORDER_H
+#define _RECORDER_H
+
+#include <stdint.h>
+
+#include "ubx.h"
+
+#define REC_MAGIC		0x52584255	/* "UBXR" */
+#define REC_VERSION		1
+#define REC_ALIGN		8
+#define REC_SEG_FMT		"%s.%04u"
+#define REC_ALIGNED(x)		(((x) + REC_ALIGN - 1) & ~((uint64_t)REC_ALIGN - 1))
+
+/**
+ * struct rec_hdr - segment header
+ * @magic: REC_MAGIC
+ * @version: REC_VERSION
+ * @segment: index of this segment
+ * @type_hash: binary hash of the recorded type
+ * @type_size: size of the recorded type
+ * @data_len: max array length of the samples
+ * @size: size of the segment file
+ * @used: bytes used including this header, updated after each sample
+ */
+struct rec_hdr {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t segment;
+	uint8_t type_hash[UBX_TYPE_HASH_LEN];
+	uint64_t type_size;
+	uint64_t data_len;
+	uint64_t size;
+	uint64_t used;
+};
+
+/**
+ * struct rec_sample - sample header
+ * @ts: CLOCK_MONOTONIC time of the write in ns
+ * @len: array length of the sample
+ * @size: size of sample including this header and padding
+ */
+struct rec_sample {
+	uint64_t ts;
+	uint32_t len;
+	uint32_t size;
+};
+
+extern ubx_proto_block_t replay_comp;
+
+#endif /* _RECORDER_H */
@@ -0,0 +1,362 @@
+/*
+ * A computation block that replays recordings of ubx/recorder.
+ *
+ * The type and array length of the "out" port are taken from the
+ * recording. The samples are written directly from the read-only
+ * mapping of the segments. With speed > 0, each step writes all
+ * samples that are due according to their (scaled) recording time
+ * relative to the start of the block. With speed = 0, each step
+ * writes exactly one sample, which replays the data as fast as the
+ * block is triggered.
+ */
+
+#undef UBX_DEBUG
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/stat.h>
+
+#include "ubx.h"
+#include "recorder.h"
+
+char replay_meta[] =
+	"{ doc='replay port data recorded with ubx/recorder',"
+	"  realtime=true,"
+	"}";
+
+ubx_proto_config_t replay_config[] = {
+	{ .name = "path", .type_name = "char", .min = 1, .doc = "base path of the recording (without .0000)" },
+	{ .name = "speed", .type_name = "double", .max = 1, .doc = "replay speed factor, 0 for one sample per step (default: 1)" },
+	{ .name = "loop", .type_name = "int", .max = 1, .doc = "restart at the end of the recording (default: 0)" },
+	{ 0 }
+};
+
+struct replay_seg {
+	const struct rec_hdr *hdr;
+	size_t size;			/* mapping size */
+};
+
+struct replay_info {
+	const ubx_type_t *type;
+	const ubx_port_t *out;
+
+	char path_base[PATH_MAX];
+	double speed;
+	int loop;
+
+	struct replay_seg *segs;
+	long num_segs;
+	unsigned long num_samples;
+
+	/* cursor */
+	long seg;
+	uint64_t off;
+
+	uint64_t rec_t0;		/* time of the first sample */
+	uint64_t t0;			/* start of the replay */
+};
+
+/* map a segment read-only and validate it against the first one */
+static int seg_open(ubx_block_t *b, struct replay_info *inf, long seg)
+{
+	int fd, ret = -1;
+	char fn[PATH_MAX];
+	struct stat st;
+	const struct rec_hdr *hdr, *hdr0;
+	const struct rec_sample *s;
+	uint64_t off;
+
+	snprintf(fn, sizeof(fn), REC_SEG_FMT, inf->path_base, (unsigned int)seg);
+	fd = open(fn, O_RDONLY);
+
+	if (fd < 0) {
+		ret = (errno == ENOENT) ? 1 : -1;
+		if (ret < 0)
+			ubx_err(b, "failed to open %s: %m", fn);
+		goto out;
+	}
+
+	if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(struct rec_hdr)) {
+		ubx_err(b, "%s: invalid segment", fn);
+		goto out_close;
+	}
+
+	hdr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+
+	if (hdr == MAP_FAILED) {
+		ubx_err(b, "failed to map %s: %m", fn);
+		goto out_close;
+	}
+
+	inf->segs[seg].hdr = hdr;
+	inf->segs[seg].size = st.st_size;
+	hdr0 = inf->segs[0].hdr;
+
+	if (hdr->magic != REC_MAGIC || hdr->version != REC_VERSION ||
+	    hdr->segment != seg || hdr->used > (uint64_t)st.st_size ||
+	    hdr->used < REC_ALIGNED(sizeof(struct rec_hdr)) ||
+	    hdr->type_size == 0 || hdr->data_len == 0 ||
+	    hdr->data_len > LONG_MAX / hdr->type_size ||
+	    memcmp(hdr->type_hash, hdr0->type_hash, UBX_TYPE_HASH_LEN) != 0 ||
+	    hdr->type_size != hdr0->type_size || hdr->data_len != hdr0->data_len) {
+		ubx_err(b, "%s: invalid or inconsistent segment header", fn);
+		goto out_unmap;
+	}
+
+	/* validate all samples, so step can trust them */
+	for (off = REC_ALIGNED(sizeof(struct rec_hdr)); off < hdr->used; off += s->size) {
+		s = (const struct rec_sample *)((const uint8_t *)hdr + off);
+
+		if (hdr->used - off < sizeof(struct rec_sample) ||
+		    s->len == 0 || s->len > hdr->data_len ||
+		    s->size != sizeof(struct rec_sample) + REC_ALIGNED(s->len * hdr->type_size) ||
+		    s->size > hdr->used - off) {
+			ubx_err(b, "%s: invalid sample at offset %lu", fn, off);
+			goto out_unmap;
+		}
+		inf->num_samples++;
+	}
+
+	ret = 0;
+	goto out_close;
+
+out_unmap:
+	munmap((void *)hdr, st.st_size);
+	inf->segs[seg].hdr = NULL;
+out_close:
+	close(fd);
+out:
+	return ret;
+}
+
+static void segs_close(struct replay_info *inf)
+{
+	for (long seg = 0; seg < inf->num_segs; seg++)
+		munmap((void *)inf->segs[seg].hdr, inf->segs[seg].size);
+
+	free(inf->segs);
+	inf->segs = NULL;
+	inf->num_segs = 0;
+}
+
+int replay_init(ubx_block_t *b)
+{
+	int ret = EINVALID_CONFIG;
+	long len;
+	const char *path;
+	const double *speed;
+	const int *loop;
+	struct replay_seg *tmp;
+	struct replay_info *inf;
+
+	inf = ubx_block_alloc_private(b, sizeof(struct replay_info));
+
+	if (inf == NULL) {
+		ubx_err(b, "failed to alloc replay_info");
+		ret = EOUTOFMEM;
+		goto out;
+	}
+
+	b->private_data = inf;
+
+	len = cfg_getptr_char(b, "path", &path);
+	if (len <= 0) {
+		ubx_err(b, "EINVALID_CONFIG: mandatory config path unset");
+		goto out_free;
+	}
+
+	if (snprintf(inf->path_base, sizeof(inf->path_base), "%s", path) >= (int)sizeof(inf->path_base) - 5) {
+		ubx_err(b, "EINVALID_CONFIG: path too long");
+		goto out_free;
+	}
+
+	len = cfg_getptr_double(b, "speed", &speed);
+	if (len < 0)
+		goto out_free;
+	inf->speed = (len > 0) ? *speed : 1;
+
+	if (inf->speed < 0) {
+		ubx_err(b, "EINVALID_CONFIG: speed must be >= 0");
+		goto out_free;
+	}
+
+	len = cfg_getptr_int(b, "loop", &loop);
+	if (len < 0)
+		goto out_free;
+	inf->loop = (len > 0) ? *loop : 0;
+
+	/* map all segments */
+	while (1) {
+		tmp = realloc(inf->segs, (inf->num_segs + 1) * sizeof(struct replay_seg));
+
+		if (tmp == NULL) {
+			ret = EOUTOFMEM;
+			goto out_close;
+		}
+
+		inf->segs = tmp;
+		ret = seg_open(b, inf, inf->num_segs);
+
+		if (ret < 0)
+			goto out_close;
+		else if (ret > 0)
+			break;
+
+		inf->num_segs++;
+	}
+
+	if (inf->num_segs == 0) {
+		ubx_err(b, "EINVALID_CONFIG: no recording found at %s", inf->path_base);
+		ret = EINVALID_CONFIG;
+		goto out_close;
+	}
+
+	inf->type = ubx_type_get_by_hash(b->nd, inf->segs[0].hdr->type_hash);
+
+	if (inf->type == NULL || inf->type->size != (long)inf->segs[0].hdr->type_size) {
+		ubx_err(b, "ETYPE_MISMATCH: recorded type is not registered");
+		ret = ETYPE_MISMATCH;
+		goto out_close;
+	}
+
+	ret = ubx_outport_add(b, "out", "replayed samples", 0,
+			      inf->type->name, inf->segs[0].hdr->data_len);
+
+	if (ret != 0)
+		goto out_close;
+
+	ubx_info(b, "replaying %lu samples of %s[%lu] from %ld segment(s) at speed %g",
+		 inf->num_samples, inf->type->name,
+		 inf->segs[0].hdr->data_len, inf->num_segs, inf->speed);
+
+	ret = 0;
+	goto out;
+
+out_close:
+	segs_close(inf);
+out_free:
+	ubx_block_free_private(b, inf);
+	b->private_data = NULL;
+out:
+	return ret;
+}
+
+/* rewind the cursor to the first sample */
+static void replay_rewind(struct replay_info *inf)
+{
+	struct ubx_timespec now;
+	const struct rec_hdr *hdr = inf->segs[0].hdr;
+	const struct rec_sample *s;
+
+	inf->seg = 0;
+	inf->off = REC_ALIGNED(sizeof(struct rec_hdr));
+
+	s = (const struct rec_sample *)((const uint8_t *)hdr + inf->off);
+	inf->rec_t0 = (inf->off < hdr->used) ? s->ts : 0;
+
+	ubx_clock_mono_gettime(&now);
+	inf->t0 = ubx_ts_to_ns(&now);
+}
+
+int replay_start(ubx_block_t *b)
+{
+	struct replay_info *inf = (struct replay_info *)b->private_data;
+
+	inf->out = ubx_port_get(b, "out");
+	replay_rewind(inf);
+
+	return 0;
+}
+
+void replay_cleanup(ubx_block_t *b)
+{
+	struct replay_info *inf = (struct replay_info *)b->private_data;
+
+	ubx_port_rm(b, "out");
+	segs_close(inf);
+	ubx_block_free_private(b, inf);
+}
+
+/* return the next sample or NULL at the end */
+static const struct rec_sample *replay_next(struct replay_info *inf)
+{
+	const struct rec_hdr *hdr;
+
+	while (inf->seg < inf->num_segs) {
+		hdr = inf->segs[inf->seg].hdr;
+
+		if (inf->off < hdr->used)
+			return (const struct rec_sample *)((const uint8_t *)hdr + inf->off);
+
+		inf->seg++;
+		inf->off = REC_ALIGNED(sizeof(struct rec_hdr));
+	}
+
+	return NULL;
+}
+
+static void replay_emit(struct replay_info *inf, const struct rec_sample *s)
+{
+	ubx_data_t data;
+
+	data.type = inf->type;
+	data.len = s->len;
+	data.data = (void *)(s + 1);
+
+	if (inf->out->attrs & PORT_ATTR_VERIFIED)
+		__port_write_unchecked(inf->out, &data);
+	else
+		__port_write(inf->out, &data);
+
+	inf->off += s->size;
+}
+
+void replay_step(ubx_block_t *b)
+{
+	uint64_t elapsed;
+	struct ubx_timespec now;
+	const struct rec_sample *s;
+	struct replay_info *inf = (struct replay_info *)b->private_data;
+
+	s = replay_next(inf);
+
+	if (s == NULL) {
+		if (!inf->loop)
+			return;
+
+		replay_rewind(inf);
+		s = replay_next(inf);
+
+		if (s == NULL)
+			return;
+	}
+
+	if (inf->speed == 0) {
+		replay_emit(inf, s);
+		return;
+	}
+
+	ubx_clock_mono_gettime(&now);
+	elapsed = ubx_ts_to_ns(&now) - inf->t0;
+
+	for (; s != NULL; s = replay_next(inf)) {
+		if ((double)(s->ts - inf->rec_t0) / inf->speed > (double)elapsed)
+			break;
+
+		replay_emit(inf, s);
+	}
+}
+
+ubx_proto_block_t replay_comp = {
+	.name = "ubx/replay",
+	.type = BLOCK_TYPE_COMPUTATION,
+	.meta_data = replay_meta,
+	.configs = replay_config,
+
+	.init = replay_init,
+	.start = replay_start,
+	.cleanup = replay_cleanup,
+	.step = replay_step,
+};
@@ -0,0 +1,51 @@
+/*
+ * Vectorized saturation kernel
+ *
+ * This file is included once per instruction set with SAT_T, VBYTES
+ * (the vector size in bytes) and SFX (the symbol suffix) defined and
+ * generates sat_clamp_<SFX>. The result is identical to sat_clamp1, so
+ * NaNs are passed through and lo wins if lo > hi.
+ */
+
+#define KCAT_(a, b)	a ## _ ## b
+#define KCAT(a, b)	KCAT_(a, b)
+#define K(name)		KCAT(name, SFX)
+
+typedef SAT_T K(sat_vt) __attribute__((vector_size(VBYTES)));
+typedef __typeof__((K(sat_vt)){ 0 } < (K(sat_vt)){ 0 }) K(sat_vm);
+
+#define VT	K(sat_vt)
+#define VM	K(sat_vm)
+#define VLEN	((long)(sizeof(VT) / sizeof(SAT_T)))
+
+/* y = clamp(x, lo, hi) for n elements, y may be equal to x */
+static void K(sat_clamp)(SAT_T *y, const SAT_T *x, const SAT_T *lo,
+			 const SAT_T *hi, long n)
+{
+	long i;
+	VT v, l, h;
+	VM m;
+
+	for (i = 0; i + VLEN <= n; i += VLEN) {
+		memcpy(&v, x + i, sizeof(v));
+		memcpy(&l, lo + i, sizeof(l));
+		memcpy(&h, hi + i, sizeof(h));
+
+		m = v > h;
+		v = (VT)(((VM)h & m) | ((VM)v & ~m));
+		m = v < l;
+		v = (VT)(((VM)l & m) | ((VM)v & ~m));
+
+		memcpy(y + i, &v, sizeof(v));
+	}
+
+	for (; i < n; i++)
+		y[i] = sat_clamp1(x[i], lo[i], hi[i]);
+}
+
+#undef VLEN
+#undef VM
+#undef VT
+#undef K
+#undef KCAT
+#undef KCAT_
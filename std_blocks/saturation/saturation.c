@@ -1,31 +1,67 @@
 /*
  * saturation function block
+ *
+ * This file is compiled once per type. The clamping is done in place
+ * in the buffer the input is read into by a vectorized kernel (see
+ * sat_kernels.h), which is selected at init for the instruction set
+ * supported by the CPU.
  */
 
-#define SAT_DOUBLE_T 1
-
-#if SAT_FLOAT_T == 1
+#if SATURATION_FLOAT_T == 1
 # define SAT_T float
-#elif SAT_DOUBLE_T == 1
+# define SAT_TNAME float
+#elif SATURATION_DOUBLE_T == 1
 # define SAT_T double
-#elif SAT_INT32_T == 1
+# define SAT_TNAME double
+#elif SATURATION_INT32_T == 1
 # define SAT_T int32_t
-# define BLOCK_NAME "ubx/sat_int32"
-#elif SAT_INT64_T == 1
+# define SAT_TNAME int32
+#elif SATURATION_INT64_T == 1
 # define SAT_T int64_t
-# define BLOCK_NAME "ubx/sat_int64"
+# define SAT_TNAME int64
 #else
 # error "unknown or missing type"
 #endif
 
-#ifndef BLOCK_NAME
-# define BLOCK_NAME "ubx/saturation_" QUOTE(SAT_T)
-#endif
+#define BLOCK_NAME "ubx/saturation_" QUOTE(SAT_TNAME)
 
 #include <stdlib.h>
 #include <string.h>
 #include "ubx.h"
 
+#define SAT_CAT_(a, b, c)	a ## b ## c
+#define SAT_CAT(a, b, c)	SAT_CAT_(a, b, c)
+#define SAT_READ		SAT_CAT(read_, SAT_TNAME, _array)
+#define SAT_WRITE		SAT_CAT(write_, SAT_TNAME, _array)
+
+/* clamp to hi first, so that lo wins if lo > hi */
+static inline SAT_T sat_clamp1(SAT_T x, SAT_T lo, SAT_T hi)
+{
+	x = (x > hi) ? hi : x;
+	return (x < lo) ? lo : x;
+}
+
+typedef void (*sat_clamp_t)(SAT_T *y, const SAT_T *x, const SAT_T *lo,
+			    const SAT_T *hi, long n);
+
+/* 16 byte vectors: SSE2 on x86_64, the default elsewhere */
+#define VBYTES	16
+#define SFX	v16
+#include "sat_kernels.h"
+#undef VBYTES
+#undef SFX
+
+#ifdef __x86_64__
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#define VBYTES	32
+#define SFX	avx2
+#include "sat_kernels.h"
+#undef VBYTES
+#undef SFX
+#pragma GCC pop_options
+#endif
+
 #define DATA_LEN 	"data_len"
 #define LOWER_LIMITS 	"lower_limits"
 #define UPPER_LIMITS 	"upper_limits"
@@ -54,6 +90,7 @@ struct sat_info {
 	const SAT_T *upper_lim;
 
 	SAT_T *val;
+	sat_clamp_t clamp;
 
 	ubx_port_t *pout;
 	ubx_port_t *pin;
@@ -67,7 +104,7 @@ int sat_init(ubx_block_t *b)
 	const long *ltmp;
 	struct sat_info *inf;
 
-	b->private_data = calloc(1, sizeof(struct sat_info));
+	b->private_data = ubx_block_alloc_private(b, sizeof(struct sat_info));
 	inf = (struct sat_info *)b->private_data;
 
 	if (b->private_data == NULL) {
@@ -101,13 +138,22 @@ int sat_init(ubx_block_t *b)
 	}
 
 	/* allocate memory for out value */
-	inf->val = calloc(inf->data_len, sizeof(SAT_T));
+	inf->val = ubx_block_alloc_private(b, inf->data_len * sizeof(SAT_T));
 
 	if (inf->val == NULL) {
 		ubx_err(b, "EOUTOFMEM: allocating 'value' failed");
 		goto out_free;
 	}
 
+	inf->clamp = sat_clamp_v16;
+
+#ifdef __x86_64__
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("avx2"))
+		inf->clamp = sat_clamp_avx2;
+#endif
+
 	inf->pin =  ubx_port_get(b, PIN);
 	inf->pout = ubx_port_get(b, POUT);
 
@@ -120,7 +166,7 @@ int sat_init(ubx_block_t *b)
 	goto out;
 
 out_free:
-	free(b->private_data);
+	ubx_block_free_private(b, b->private_data);
 out:
 	return ret;
 }
@@ -128,8 +174,8 @@ out:
 void sat_cleanup(ubx_block_t *b)
 {
 	struct sat_info *inf = (struct sat_info *)b->private_data;
-	free(inf->val);
-	free(inf);
+	ubx_block_free_private(b, inf->val);
+	ubx_block_free_private(b, inf);
 }
 
 void sat_step(ubx_block_t *b)
@@ -137,15 +183,7 @@ void sat_step(ubx_block_t *b)
 	long len;
 	struct sat_info *inf = (struct sat_info *)b->private_data;
 
-#if SAT_FLOAT_T == 1
-	len = read_float_array(inf->pin, inf->val, inf->data_len);
-#elif SAT_DOUBLE_T == 1
-	len = read_double_array(inf->pin, inf->val, inf->data_len);
-#elif SAT_INT32_T == 1
-	len = read_int32_array(inf->pin, inf->val, inf->data_len);
-#elif SAT_INT64_T == 1
-	len = read_int64_array(inf->pin, inf->val, inf->data_len);
-#endif
+	len = SAT_READ(inf->pin, inf->val, inf->data_len);
 
 	if (len	== 0) {
 		ubx_notice(b, "unexpected NODATA on port 'in'");
@@ -158,21 +196,9 @@ void sat_step(ubx_block_t *b)
 		return;
 	}
 
-	for(long i=0; i<inf->data_len; i++) {
-		inf->val[i] = (inf->val[i] > inf->upper_lim[i]) ? inf->upper_lim[i] : inf->val[i];
-		inf->val[i] = (inf->val[i] < inf->lower_lim[i]) ? inf->lower_lim[i] : inf->val[i];
-	}
-
-#if SAT_FLOAT_T == 1
-	write_float_array(inf->pout, inf->val, inf->data_len);
-#elif SAT_DOUBLE_T == 1
-	write_double_array(inf->pout, inf->val, inf->data_len);
-#elif SAT_UINT32_T == 1
-	write_uint32_array(inf->pout, inf->val, inf->data_len);
-#elif SAT_INT32_T == 1
-	write_int32_array(inf->pout, inf->val, inf->data_len);
-#endif
+	inf->clamp(inf->val, inf->val, inf->lower_lim, inf->upper_lim, inf->data_len);
 
+	SAT_WRITE(inf->pout, inf->val, inf->data_len);
 }
 
 ubx_proto_block_t sat_block = {
@@ -126,7 +126,7 @@ int common_config_chains(const ubx_block_t *b, struct ubx_chain *chain, int num_
 	const int *tint;
 	const double *tdbl;
 
-	int tstats_mode, tstats_skip_first;
+	int tstats_mode, tstats_skip_first, tstats_faults;
 	double output_rate;
 
 	ubx_port_t *p_tstats;
@@ -147,6 +147,11 @@ int common_config_chains(const ubx_block_t *b, struct ubx_chain *chain, int num_
 	assert(len >= 0);
 	tstats_skip_first = (len > 0) ? *tint : 0;
 
+	/* tstats_faults */
+	len = cfg_getptr_int(b, "tstats_faults", &tint);
+	assert(len >= 0);
+	tstats_faults = (len > 0) ? *tint : 0;
+
 	/* tstats port */
 	p_tstats = ubx_port_get(b, "tstats");
 	assert(p_tstats);
@@ -155,6 +160,7 @@ int common_config_chains(const ubx_block_t *b, struct ubx_chain *chain, int num_
 	for (i = 0; i < num_chains; i++) {
 		chain[i].tstats_mode = tstats_mode;
 		chain[i].tstats_skip_first = tstats_skip_first;
+		chain[i].tstats_faults = tstats_faults;
 		chain[i].p_tstats = p_tstats;
 
 		snprintf(chain_id, UBX_BLOCK_NAME_MAXLEN, CHAIN_NAME_FMT, i);
@@ -166,8 +172,14 @@ int common_config_chains(const ubx_block_t *b, struct ubx_chain *chain, int num_
 
 		if (ubx_chain_init(&chain[i], chain_id, output_rate) != 0)
 			goto out_fail;
+
+		if (ubx_chain_mon_register(b, &chain[i]) != 0)
+			goto out_fail_cleanup;
 	}
 	return 0;
+
+out_fail_cleanup:
+	ubx_chain_cleanup(&chain[i]);
 out_fail:
 	ubx_err(b, "failed to configure chain%i", i);
 
@@ -225,6 +237,8 @@ void common_cleanup(ubx_block_t *b, struct ubx_chain **chains)
 			ubx_config_rm(b, c->name);
 	}
 
+	ubx_chain_mon_unregister_block(b);
+
 	free(*chains);
 	*chains = NULL;
 }
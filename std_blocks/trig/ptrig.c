@@ -17,10 +17,12 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <inttypes.h>
 #include <time.h>
 
 #include <pthread.h>
 #include <limits.h>	/* PTHREAD_STACK_MIN */
+#include <sys/syscall.h>
 
 #include "ubx.h"
 #include "trig_utils.h"
@@ -28,6 +30,19 @@
 
 #include "types/ptrig_period.h"
 #include "types/ptrig_period.h.hexarr"
+#include "types/ptrig_jitter.h"
+#include "types/ptrig_jitter.h.hexarr"
+
+#ifndef SCHED_DEADLINE
+# define SCHED_DEADLINE	6
+#endif
+
+/* spin window autotuning */
+#define SPIN_HIST_BINS		512	/* wakeup latency histogram */
+#define SPIN_HIST_BIN_NS	1000
+#define SPIN_TUNE_CYCLES	1024	/* samples per tuning round */
+#define SPIN_TUNE_PERMILLE	999	/* share of wakeups to cover */
+#define SPIN_TUNE_MARGIN_NS	2000
 
 /* wait 1 second for thread to stop */
 #define	THREAD_STOP_TIMEOUT_US	50000
@@ -42,26 +57,37 @@ ubx_proto_port_t ptrig_ports[] = {
 	{ .name = "active_chain", .in_type_name = "int", .doc = "switch the active trigger chain" },
 	{ .name = "tstats", .out_type_name = "struct ubx_tstat", .doc = "out port for timing statistics" },
 	{ .name = "shutdown", .in_type_name = "int", .doc = "input port for stopping ptrig" },
+	{ .name = "jitter", .out_type_name = "struct ptrig_jitter", .doc = "wakeup latency and release jitter statistics (output on stop with jitter_stats or spin_autotune)" },
 	{ 0 },
 };
 
 ubx_type_t ptrig_types[] = {
 	def_struct_type(struct ptrig_period, &ptrig_period_h),
+	def_struct_type(struct ptrig_jitter, &ptrig_jitter_h),
 };
 
 def_cfg_getptr_fun(cfg_getptr_ptrig_period, struct ptrig_period);
+def_port_writers(write_ptrig_jitter, struct ptrig_jitter);
 
 static void __ptrig_stop(ubx_block_t *b);
 
 ubx_proto_config_t ptrig_config[] = {
 	{ .name = "period", .type_name = "struct ptrig_period", .doc = "trigger period in { sec, ns }", },
 	{ .name = "stacksize", .type_name = "size_t", .doc = "stacksize as per pthread_attr_setstacksize(3)" },
+	{ .name = "prefault_stack", .type_name = "int", .max = 1, .doc = "if 1, prefault the thread stack before the first cycle (def: 0)" },
 	{ .name = "sched_priority", .type_name = "int", .doc = "pthread priority" },
-	{ .name = "sched_policy", .type_name = "char", .doc = "pthread scheduling policy" },
+	{ .name = "sched_policy", .type_name = "char", .doc = "pthread scheduling policy (SCHED_OTHER, SCHED_FIFO, SCHED_RR or SCHED_DEADLINE)" },
+	{ .name = "sched_runtime_ns", .type_name = "uint64_t", .max = 1, .doc = "SCHED_DEADLINE runtime budget per period" },
+	{ .name = "sched_deadline_ns", .type_name = "uint64_t", .max = 1, .doc = "SCHED_DEADLINE relative deadline (def: sched_period_ns)" },
+	{ .name = "sched_period_ns", .type_name = "uint64_t", .max = 1, .doc = "SCHED_DEADLINE period (def: period)" },
 #ifdef CONFIG_PTHREAD_SETAFFINITY
 	{ .name = "affinity", .type_name = "int", .doc = "list of CPUs to set the pthread CPU affinity to" },
 #endif
 	{ .name = "thread_name", .type_name = "char", .doc = "thread name (for dbg), default is block name" },
+	{ .name = "numa_node", .type_name = "int", .max = 1, .doc = "NUMA node to place triggees and their iblocks on (def: node of thread)" },
+	{ .name = "spin_ns", .type_name = "uint64_t", .max = 1, .doc = "busy poll the clock for this window before each release (def: 0, off)" },
+	{ .name = "spin_autotune", .type_name = "int", .max = 1, .doc = "if 1, tune the spin window to the p99.9 wakeup latency (def: 0)" },
+	{ .name = "jitter_stats", .type_name = "int", .max = 1, .doc = "if 1, measure and log wakeup latency and release jitter (def: 0)" },
 	{ .name = "autostop_steps", .type_name = "int64_t", .doc = "if set and > 0, block stops itself after X steps", .max=1 },
 	{ .name = "num_chains", .type_name = "int", .max = 1, .doc = "number of trigger chains (def: 1)" },
 
@@ -69,6 +95,7 @@ ubx_proto_config_t ptrig_config[] = {
 	{ .name = "tstats_profile_path", .type_name = "char", .doc = "directory to write the timing stats file to" },
 	{ .name = "tstats_output_rate", .type_name = "double", .max = 1, .doc = "throttle output on tstats port" },
 	{ .name = "tstats_skip_first", .type_name = "int", .max=1, .doc = "skip N steps before acquiring stats" },
+	{ .name = "tstats_faults", .type_name = "int", .max=1, .doc = "if 1, sample the page faults of the thread in the tstats (def: 0)" },
 	{ .name = "loglevel", .type_name = "int" },
 	{ 0 },
 };
@@ -88,11 +115,63 @@ const char* schedpol_tostr(unsigned int schedpol)
 	case SCHED_RR: return "SCHED_RR";
 	case SCHED_IDLE: return "SCHED_IDLE";
 	case SCHED_BATCH: return "SCHED_BATCH";
+	case SCHED_DEADLINE: return "SCHED_DEADLINE";
 	default:
 		return "unknown";
 	}
 }
 
+/* see sched_setattr(2), not provided by older glibc versions */
+struct ptrig_sched_attr {
+	uint32_t size;
+	uint32_t sched_policy;
+	uint64_t sched_flags;
+	int32_t sched_nice;
+	uint32_t sched_priority;
+	uint64_t sched_runtime;
+	uint64_t sched_deadline;
+	uint64_t sched_period;
+};
+
+/* min, max and sum of a series of durations in ns */
+struct ptrig_lstat {
+	uint64_t min;
+	uint64_t max;
+	uint64_t sum;
+	uint64_t cnt;
+};
+
+/**
+ * struct ptrig_spin - spin window and wakeup statistics
+ *
+ * @window: current spin window in ns
+ * @cfg_window: configured spin window, restored on start
+ * @max_window: upper limit of the window (half a period)
+ * @autotune: tune the window from the wakeup latency histogram
+ * @measure: record the statistics below
+ * @lat: wakeup latency of nanosleep, i.e. the jitter without spinning
+ * @jit: release jitter after spinning
+ * @spin: time spent spinning
+ * @late: wakeups after the release, i.e. the window was too short
+ * @hist: wakeup latency histogram of the current tuning round
+ * @hist_cnt: number of samples in hist
+ */
+struct ptrig_spin {
+	uint64_t window;
+	uint64_t cfg_window;
+	uint64_t max_window;
+	int autotune;
+	int measure;
+
+	struct ptrig_lstat lat;
+	struct ptrig_lstat jit;
+	struct ptrig_lstat spin;
+	unsigned long late;
+
+	uint32_t hist[SPIN_HIST_BINS];
+	uint32_t hist_cnt;
+};
+
 /**
  * block info
  */
@@ -113,8 +192,18 @@ struct ptrig_inf {
 	int actchain;
 
 	int64_t autostop_steps;
+	int prefault_stack;
+	int numa_node;
+
+	/* SCHED_DEADLINE */
+	struct ptrig_sched_attr dl;	/* sched_policy is 0 if unused */
+	int dl_status;			/* 1 if applied, <0 on error */
+	unsigned long dl_overruns;
+
+	struct ptrig_spin spin;
 
 	ubx_port_t *p_actchain;
+	ubx_port_t *p_jitter;
 };
 
 
@@ -127,19 +216,254 @@ inline void tsnorm(struct timespec *ts)
 	}
 }
 
+/*
+ * place ptrig, all triggees and the iblocks these exclusively write
+ * to on the NUMA node of the thread or on the configured numa_node
+ */
+static void ptrig_migrate(ubx_block_t *b, struct ptrig_inf *inf)
+{
+	int ret, node;
+	struct ubx_chain_placement pl;
+
+	node = (inf->numa_node >= 0) ? inf->numa_node : ubx_numa_cur_node();
+
+	if (node < 0) {
+		ubx_err(b, "failed to determine NUMA node: %s", strerror(-node));
+		return;
+	}
+
+	ret = ubx_chains_place(b, inf->chains, inf->num_chains, node, &pl);
+
+	if (ret < 0) {
+		ubx_err(b, "placing triggees on node %i failed: %s",
+			node, strerror(-ret));
+		return;
+	}
+
+	ubx_info(b, "NUMA node %i (thread on node %i): placed %ld blocks, "
+		 "%ld iblocks, %ld shared iblocks not moved, %ld pages failed",
+		 pl.node, ubx_numa_cur_node(), pl.num_blocks, pl.num_iblocks,
+		 pl.num_shared, pl.failed);
+}
+
+static void lstat_reset(struct ptrig_lstat *ls)
+{
+	ls->min = UINT64_MAX;
+	ls->max = 0;
+	ls->sum = 0;
+	ls->cnt = 0;
+}
+
+static void lstat_update(struct ptrig_lstat *ls, uint64_t val)
+{
+	if (val < ls->min)
+		ls->min = val;
+
+	if (val > ls->max)
+		ls->max = val;
+
+	ls->sum += val;
+	ls->cnt++;
+}
+
+static void spin_reset(struct ptrig_spin *s)
+{
+	s->window = s->cfg_window;
+	lstat_reset(&s->lat);
+	lstat_reset(&s->jit);
+	lstat_reset(&s->spin);
+	s->late = 0;
+	memset(s->hist, 0, sizeof(s->hist));
+	s->hist_cnt = 0;
+}
+
+static inline void cpu_relax(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#elif defined(__aarch64__)
+	__asm__ __volatile__("yield");
+#endif
+}
+
+static uint64_t ptrig_now(void)
+{
+	struct ubx_timespec ts;
+
+	ubx_gettime(&ts);
+	return ubx_ts_to_ns(&ts);
+}
+
+/* set the window to cover SPIN_TUNE_PERMILLE of the last wakeups */
+static void spin_tune(struct ptrig_spin *s)
+{
+	int i;
+	uint64_t window, sum = 0;
+	uint64_t thresh = ((uint64_t)s->hist_cnt * SPIN_TUNE_PERMILLE + 999) / 1000;
+
+	for (i = 0; i < SPIN_HIST_BINS - 1; i++) {
+		sum += s->hist[i];
+
+		if (sum >= thresh)
+			break;
+	}
+
+	window = (uint64_t)(i + 1) * SPIN_HIST_BIN_NS + SPIN_TUNE_MARGIN_NS;
+	s->window = (window > s->max_window) ? s->max_window : window;
+	memset(s->hist, 0, sizeof(s->hist));
+	s->hist_cnt = 0;
+}
+
+/*
+ * sleep until next. With a spin window, sleep until next - window
+ * and then busy poll the clock until next to hide the wakeup latency.
+ */
+static int ptrig_sleep(struct ptrig_spin *s, struct ubx_timespec *next)
+{
+	int ret;
+	struct ubx_timespec wake;
+	uint64_t next_ns, wake_ns, woke_ns, now_ns, lat;
+
+	if (s->window == 0 && !s->measure)
+		return ubx_nanosleep(TIMER_ABSTIME, next);
+
+	next_ns = ubx_ts_to_ns(next);
+	wake_ns = next_ns - s->window;
+	wake.sec = wake_ns / NSEC_PER_SEC;
+	wake.nsec = wake_ns % NSEC_PER_SEC;
+
+	ret = ubx_nanosleep(TIMER_ABSTIME, &wake);
+
+	if (ret)
+		return ret;
+
+	woke_ns = now_ns = ptrig_now();
+
+	while (now_ns < next_ns) {
+		cpu_relax();
+		now_ns = ptrig_now();
+	}
+
+	if (!s->measure)
+		return 0;
+
+	lat = (woke_ns > wake_ns) ? woke_ns - wake_ns : 0;
+
+	lstat_update(&s->lat, lat);
+	lstat_update(&s->jit, now_ns - next_ns);
+	lstat_update(&s->spin, now_ns - woke_ns);
+
+	if (s->window > 0 && woke_ns > next_ns)
+		s->late++;
+
+	if (s->autotune) {
+		s->hist[MIN(lat / SPIN_HIST_BIN_NS, SPIN_HIST_BINS - 1)]++;
+
+		if (++s->hist_cnt == SPIN_TUNE_CYCLES)
+			spin_tune(s);
+	}
+
+	return 0;
+}
+
+static void spin_log(ubx_block_t *b, const struct ptrig_spin *s)
+{
+	if (!s->measure || s->lat.cnt == 0)
+		return;
+
+	ubx_info(b, "wakeup latency (jitter w/o spinning): min %.1f, avg %.1f, max %.1f us",
+		 s->lat.min / 1e3, (double)s->lat.sum / s->lat.cnt / 1e3, s->lat.max / 1e3);
+
+	ubx_info(b, "release jitter with %.1f us spin window: min %.1f, avg %.1f, max %.1f us, "
+		 "%lu late wakeups, avg spin %.1f us",
+		 s->window / 1e3, s->jit.min / 1e3,
+		 (double)s->jit.sum / s->jit.cnt / 1e3, s->jit.max / 1e3,
+		 s->late, (double)s->spin.sum / s->spin.cnt / 1e3);
+}
+
+static void spin_output(ubx_port_t *p, const struct ptrig_spin *s)
+{
+	struct ptrig_jitter jit;
+
+	if (!s->measure || s->lat.cnt == 0)
+		return;
+
+	jit.cnt = s->lat.cnt;
+	jit.window = s->window;
+	jit.late = s->late;
+	jit.lat_min = s->lat.min;
+	jit.lat_max = s->lat.max;
+	jit.lat_avg = s->lat.sum / s->lat.cnt;
+	jit.jit_min = s->jit.min;
+	jit.jit_max = s->jit.max;
+	jit.jit_avg = s->jit.sum / s->jit.cnt;
+	jit.spin_avg = s->spin.sum / s->spin.cnt;
+
+	write_ptrig_jitter(p, &jit);
+}
+
+/*
+ * switch the calling thread to SCHED_DEADLINE and report the result
+ * to ptrig_init, which waits for it
+ */
+static int ptrig_set_deadline(ubx_block_t *b, struct ptrig_inf *inf)
+{
+	int ret = 0;
+
+	if (syscall(SYS_sched_setattr, 0, &inf->dl, 0) != 0) {
+		ret = -errno;
+		ubx_err(b, "sched_setattr SCHED_DEADLINE failed: %s%s", strerror(errno),
+			(errno == EBUSY) ? " (admission control rejected bandwidth)" : "");
+	}
+
+	pthread_mutex_lock(&inf->mutex);
+	inf->dl_status = (ret == 0) ? 1 : ret;
+	pthread_cond_signal(&inf->active_cond);
+	pthread_mutex_unlock(&inf->mutex);
+
+	return ret;
+}
+
+/* CPU time consumed by the calling thread, i.e. the CBS runtime */
+static uint64_t thread_cputime_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return (uint64_t)ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
 /* thread entry */
 void *thread_startup(void *arg)
 {
-	int ret;
+	int ret, migrate = 0;
 	ubx_block_t *b;
 	struct ptrig_inf *inf;
-	struct ubx_timespec next, period;
+	struct ubx_timespec next, period = { 0 };
+	uint64_t cpu_start = 0;
+	int deadline;
 
 	b = (ubx_block_t *) arg;
 	inf = (struct ptrig_inf *)b->private_data;
 
-	period.sec = inf->period->sec;
-	period.nsec = inf->period->usec * NSEC_PER_USEC;
+	deadline = (inf->dl.sched_policy == SCHED_DEADLINE);
+
+	if (inf->period != NULL) {
+		period.sec = inf->period->sec;
+		period.nsec = inf->period->usec * NSEC_PER_USEC;
+	}
+
+	if (inf->prefault_stack) {
+		long len = ubx_prefault_stack();
+
+		if (len < 0)
+			ubx_err(b, "failed to prefault stack");
+		else
+			ubx_info(b, "prefaulted %ld bytes of stack", len);
+	}
+
+	if (deadline && ptrig_set_deadline(b, inf) != 0)
+		goto out;
 
 	while (1) {
 
@@ -155,12 +479,25 @@ void *thread_startup(void *arg)
 			if (ret)
 				ubx_err(b, "failed to write tstats to profile_path: %d", ret);
 
+			if (inf->dl_overruns > 0)
+				ubx_warn(b, "SCHED_DEADLINE: %lu runtime overruns",
+					 inf->dl_overruns);
+
+			spin_log(b, &inf->spin);
+			spin_output(inf->p_jitter, &inf->spin);
+
 			inf->thread_state = THREAD_INACTIVE;
+			migrate = 1;
 			pthread_cond_wait(&inf->active_cond, &inf->mutex);
 		}
 		inf->thread_state = THREAD_ACTIVE;
 		pthread_mutex_unlock(&inf->mutex);
 
+		if (migrate && ubx_numa_num_nodes() > 1)
+			ptrig_migrate(b, inf);
+
+		migrate = 0;
+
 		ret = ubx_gettime(&next);
 
 		if (ret) {
@@ -168,11 +505,19 @@ void *thread_startup(void *arg)
 			goto out;
 		}
 
+		if (deadline)
+			cpu_start = thread_cputime_ns();
+
 		common_read_actchain(b, inf->p_actchain, inf->num_chains, &inf->actchain);
 
 		if (ubx_chain_trigger(&inf->chains[inf->actchain]) != 0)
 			ubx_err(b, "ubx_chain_trigger failed for chain%i", inf->actchain);
 
+		if (deadline && thread_cputime_ns() - cpu_start > inf->dl.sched_runtime) {
+			ubx_chain_account_overrun(&inf->chains[inf->actchain]);
+			inf->dl_overruns++;
+		}
+
 		ubx_ts_add(&next, &period, &next);
 
 		/* check autostop_steps */
@@ -190,7 +535,13 @@ void *thread_startup(void *arg)
 			}
 		}
 
-		ret = ubx_nanosleep(TIMER_ABSTIME, &next);
+		/* signal the end of the job, the CBS wakes us next period */
+		if (deadline) {
+			sched_yield();
+			continue;
+		}
+
+		ret = ptrig_sleep(&inf->spin, &next);
 
 		if (ret) {
 			ubx_err(b, "clock_nanosleep failed: %s", strerror(errno));
@@ -203,13 +554,115 @@ void *thread_startup(void *arg)
 	pthread_exit(NULL);
 }
 
+/* fill the sched_attr for SCHED_DEADLINE */
+static int ptrig_handle_deadline_config(ubx_block_t *b, struct ptrig_inf *inf)
+{
+	long len;
+	const uint64_t *val;
+	struct ptrig_sched_attr *dl = &inf->dl;
+
+	memset(dl, 0, sizeof(*dl));
+	dl->size = sizeof(*dl);
+	dl->sched_policy = SCHED_DEADLINE;
+
+	len = cfg_getptr_uint64(b, "sched_period_ns", &val);
+	assert(len >= 0);
+
+	if (len > 0)
+		dl->sched_period = *val;
+	else if (inf->period != NULL)
+		dl->sched_period = inf->period->sec * NSEC_PER_SEC +
+			inf->period->usec * NSEC_PER_USEC;
+
+	len = cfg_getptr_uint64(b, "sched_deadline_ns", &val);
+	assert(len >= 0);
+	dl->sched_deadline = (len > 0) ? *val : dl->sched_period;
+
+	len = cfg_getptr_uint64(b, "sched_runtime_ns", &val);
+	assert(len >= 0);
+	dl->sched_runtime = (len > 0) ? *val : 0;
+
+	if (dl->sched_runtime == 0 || dl->sched_period == 0) {
+		ubx_err(b, "SCHED_DEADLINE requires sched_runtime_ns and "
+			"sched_period_ns or period");
+		return EINVALID_CONFIG;
+	}
+
+	if (dl->sched_runtime > dl->sched_deadline ||
+	    dl->sched_deadline > dl->sched_period) {
+		ubx_err(b, "SCHED_DEADLINE requires runtime (%" PRIu64 ") <= "
+			"deadline (%" PRIu64 ") <= period (%" PRIu64 ")",
+			dl->sched_runtime, dl->sched_deadline, dl->sched_period);
+		return EINVALID_CONFIG;
+	}
+
+	ubx_info(b, "SCHED_DEADLINE: runtime %" PRIu64 " us, deadline %" PRIu64
+		 " us, period %" PRIu64 " us",
+		 dl->sched_runtime / NSEC_PER_USEC,
+		 dl->sched_deadline / NSEC_PER_USEC,
+		 dl->sched_period / NSEC_PER_USEC);
+
+	return 0;
+}
+
+/* read the spin window configs */
+static int ptrig_handle_spin_config(ubx_block_t *b, struct ptrig_inf *inf,
+				    unsigned int schedpol)
+{
+	long len;
+	const int *tint;
+	const uint64_t *spin_ns;
+	struct ptrig_spin *s = &inf->spin;
+
+	len = cfg_getptr_uint64(b, "spin_ns", &spin_ns);
+	assert(len >= 0);
+	s->cfg_window = (len > 0) ? *spin_ns : 0;
+	s->window = s->cfg_window;
+
+	len = cfg_getptr_int(b, "spin_autotune", &tint);
+	assert(len >= 0);
+	s->autotune = (len > 0) ? *tint : 0;
+
+	len = cfg_getptr_int(b, "jitter_stats", &tint);
+	assert(len >= 0);
+	s->measure = ((len > 0) ? *tint : 0) || s->autotune;
+
+	if (s->window == 0 && !s->measure)
+		return 0;
+
+	if (schedpol == SCHED_DEADLINE) {
+		ubx_err(b, "EINVALID_CONFIG: spin_ns, spin_autotune and jitter_stats "
+			"are not supported with SCHED_DEADLINE");
+		return EINVALID_CONFIG;
+	}
+
+	s->max_window = (inf->period->sec * NSEC_PER_SEC +
+			 inf->period->usec * NSEC_PER_USEC) / 2;
+
+	if (s->window > s->max_window) {
+		ubx_err(b, "EINVALID_CONFIG: spin_ns %" PRIu64 " exceeds half the period",
+			s->window);
+		return EINVALID_CONFIG;
+	}
+
+	spin_reset(s);
+
+	ubx_info(b, "spin window %" PRIu64 " ns%s", s->window,
+		 (s->autotune) ? ", autotuned" : "");
+
+	return 0;
+}
+
 int ptrig_handle_config(ubx_block_t *b)
 {
 	long len;
 	int ret = -EINVALID_CONFIG;
 	unsigned int schedpol;
 	const int64_t *autostop_steps;
+	const int *prefault_stack;
+	const int *numa_node;
 	const char *schedpol_str;
+	const struct ptrig_period no_period = { 0 }, *period;
 	const size_t *stacksize = NULL;
 	const int *prio;
 	struct sched_param sched_param; /* prio */
@@ -221,15 +674,32 @@ int ptrig_handle_config(ubx_block_t *b)
 
 	inf->autostop_steps = (len > 0) ? *autostop_steps : -1;
 
-	/* period */
-	len = cfg_getptr_ptrig_period(b, "period", &inf->period);
+	/* prefault_stack */
+	len = cfg_getptr_int(b, "prefault_stack", &prefault_stack);
 	assert(len >= 0);
 
-	if (len == 0) {
-		ubx_err(b, "mandatory config 'period' unconfigured");
+	inf->prefault_stack = (len > 0) ? *prefault_stack : 0;
+
+	/* numa_node */
+	len = cfg_getptr_int(b, "numa_node", &numa_node);
+	assert(len >= 0);
+
+	inf->numa_node = (len > 0) ? *numa_node : -1;
+
+	if (inf->numa_node >= ubx_numa_num_nodes()) {
+		ubx_err(b, "numa_node %i invalid, system has %i nodes",
+			inf->numa_node, ubx_numa_num_nodes());
 		goto out;
 	}
 
+	/* period */
+	len = cfg_getptr_ptrig_period(b, "period", &inf->period);
+	assert(len >= 0);
+
+	/* optional with SCHED_DEADLINE, checked below */
+	if (len == 0)
+		inf->period = NULL;
+
 	/* stacksize */
 	len = cfg_getptr_size_t(b, "stacksize", &stacksize);
 	assert(len >= 0);
@@ -259,6 +729,8 @@ int ptrig_handle_config(ubx_block_t *b)
 			schedpol = SCHED_FIFO;
 		} else if (strncmp(schedpol_str, "SCHED_RR", len) == 0) {
 			schedpol = SCHED_RR;
+		} else if (strncmp(schedpol_str, "SCHED_DEADLINE", len) == 0) {
+			schedpol = SCHED_DEADLINE;
 		} else {
 			ubx_err(b, "sched_policy config: illegal value %s",
 				schedpol_str);
@@ -268,7 +740,33 @@ int ptrig_handle_config(ubx_block_t *b)
 		schedpol = SCHED_OTHER;
 	}
 
-	if (pthread_attr_setschedpolicy(&inf->attr, schedpol))
+	if (schedpol == SCHED_DEADLINE) {
+		if (ptrig_handle_deadline_config(b, inf) != 0)
+			goto out;
+	} else if (inf->period == NULL) {
+		ubx_err(b, "mandatory config 'period' unconfigured");
+		goto out;
+	}
+
+	if (ptrig_handle_spin_config(b, inf, schedpol) != 0)
+		goto out;
+
+#ifdef CONFIG_PTHREAD_SETAFFINITY
+	/* the kernel rejects affinities narrower than the root domain
+	 * for SCHED_DEADLINE tasks (use an exclusive cpuset instead) */
+	const int *aff;
+	len = cfg_getptr_int(b, "affinity", &aff);
+	assert(len >= 0);
+
+	if (schedpol == SCHED_DEADLINE && len > 0) {
+		ubx_err(b, "EINVALID_CONFIG: affinity is not supported with SCHED_DEADLINE");
+		goto out;
+	}
+#endif
+
+	/* the thread switches itself to SCHED_DEADLINE when started */
+	if (pthread_attr_setschedpolicy(&inf->attr,
+					(schedpol == SCHED_DEADLINE) ? SCHED_OTHER : schedpol))
 		ubx_err(b, "pthread_attr_setschedpolicy failed");
 
 	/* see PTHREAD_ATTR_SETSCHEDPOLICY(3) */
@@ -291,6 +789,12 @@ int ptrig_handle_config(ubx_block_t *b)
 			sched_param.sched_priority, schedpol_tostr(schedpol));
 	}
 
+	if (schedpol == SCHED_DEADLINE && sched_param.sched_priority != 0) {
+		ubx_err(b, "EINVALID_CONFIG: sched_priority must be 0 with SCHED_DEADLINE");
+		ret = EINVALID_CONFIG;
+		goto out;
+	}
+
 	ret = pthread_attr_setschedparam(&inf->attr, &sched_param);
 
 	if (ret != 0) {
@@ -300,16 +804,18 @@ int ptrig_handle_config(ubx_block_t *b)
 		goto out;
 	}
 
-	/* log */
+	/* log, period is unset if SCHED_DEADLINE uses sched_period_ns */
+	period = (inf->period != NULL) ? inf->period : &no_period;
+
 	if (stacksize != NULL)
 		ubx_info(b, "period: %lus:%luus, policy %s, prio %d, stacksize 0x%zu",
-			 inf->period->sec, inf->period->usec,
+			 period->sec, period->usec,
 			 schedpol_tostr(schedpol),
 			 sched_param.sched_priority,
 			 *stacksize);
 	else
 		ubx_info(b, "period %lus:%luus, policy %s, prio %d, stacksize default",
-			 inf->period->sec, inf->period->usec,
+			 period->sec, period->usec,
 			 schedpol_tostr(schedpol),
 			 sched_param.sched_priority);
 
@@ -326,7 +832,7 @@ int ptrig_init(ubx_block_t *b)
 	const char *threadname;
 	struct ptrig_inf *inf;
 
-	b->private_data = calloc(1, sizeof(struct ptrig_inf));
+	b->private_data = ubx_block_alloc_private(b, sizeof(struct ptrig_inf));
 
 	if (b->private_data == NULL) {
 		ubx_err(b, "failed to alloc");
@@ -338,6 +844,9 @@ int ptrig_init(ubx_block_t *b)
 	inf->p_actchain = ubx_port_get(b, "active_chain");
 	assert(inf->p_actchain != NULL);
 
+	inf->p_jitter = ubx_port_get(b, "jitter");
+	assert(inf->p_jitter != NULL);
+
 	/* initialize chains and add configs */
 	inf->num_chains = common_init_chains(b, &inf->chains);
 
@@ -365,6 +874,22 @@ int ptrig_init(ubx_block_t *b)
 		goto out_err;
 	}
 
+	/* wait for the thread to switch to SCHED_DEADLINE */
+	if (inf->dl.sched_policy == SCHED_DEADLINE) {
+		pthread_mutex_lock(&inf->mutex);
+
+		while (inf->dl_status == 0)
+			pthread_cond_wait(&inf->active_cond, &inf->mutex);
+
+		pthread_mutex_unlock(&inf->mutex);
+
+		/* the thread exits if this failed */
+		if (inf->dl_status < 0) {
+			ret = EINVALID_CONFIG;
+			goto out_join;
+		}
+	}
+
 #ifdef CONFIG_PTHREAD_SETNAME
 	/* pthread_setname_np */
 	len = cfg_getptr_char(b, "thread_name", &threadname);
@@ -396,7 +921,7 @@ int ptrig_init(ubx_block_t *b)
 		if (ret != 0) {
 			ubx_err(b, "pthread_setaffinity_np failed: %s", strerror(ret));
 			ret = -1;
-			goto out_err;
+			goto out_thread;
 		}
 	} else {
 		ubx_debug(b, "setting no thread affinity");
@@ -407,8 +932,13 @@ int ptrig_init(ubx_block_t *b)
 	ret = 0;
 	goto out;
 
+ out_thread:
+	/* the thread waits on inf->active_cond */
+	pthread_cancel(inf->tid);
+ out_join:
+	pthread_join(inf->tid, NULL);
  out_err:
-	free(b->private_data);
+	ubx_block_free_private(b, b->private_data);
  out:
 	return ret;
 }
@@ -425,6 +955,9 @@ int ptrig_start(ubx_block_t *b)
 	if (ret != 0)
 		goto out;
 
+	spin_reset(&inf->spin);
+	inf->dl_overruns = 0;
+
 	pthread_mutex_lock(&inf->mutex);
 	inf->state = BLOCK_STATE_ACTIVE;
 	pthread_cond_signal(&inf->active_cond);
@@ -486,7 +1019,7 @@ void ptrig_cleanup(ubx_block_t *b)
 	 * this in cleanup only since start calls realloc which will
 	 * just resize to the current size */
 	common_cleanup(b, &inf->chains);
-	free(b->private_data);
+	ubx_block_free_private(b, b->private_data);
 }
 
 /* put everything together */
@@ -0,0 +1,829 @@
+/*
+ * An EDF executor for periodic trigger chains
+ *
+ * Runs many periodic chains on a small pool of worker threads. Each
+ * chain is a periodic job with a period, a release offset (phase), a
+ * relative deadline and a priority. Whenever a worker is free, it
+ * runs the released chain with the earliest absolute deadline
+ * (global EDF). Ties are broken by the higher chain priority and
+ * then by the lower chain index.
+ */
+
+#undef UBX_DEBUG
+
+#define _GNU_SOURCE
+
+#ifdef HAVE_CONFIG_H
+ #include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <time.h>
+
+#include <pthread.h>
+#include <limits.h>	/* PTHREAD_STACK_MIN */
+
+#include "ubx.h"
+#include "trig_utils.h"
+#include "common.h"
+
+#include "types/rt_executor_stat.h"
+#include "types/rt_executor_stat.h.hexarr"
+
+/* wait 1 second for the workers to stop */
+#define	THREAD_STOP_TIMEOUT_US	50000
+#define	THREAD_STOP_RETRIES	20
+
+/* max length of pthread names including the terminating zero */
+#define THREAD_NAME_MAXLEN	16
+
+char rtx_meta[] =
+	"{ doc='EDF executor for periodic trigger chains on a thread pool',"
+	"  realtime=true,"
+	"}";
+
+ubx_proto_port_t rtx_ports[] = {
+	{ .name = "tstats", .out_type_name = "struct ubx_tstat", .doc = "out port for timing statistics" },
+	{ .name = "chain_stats", .out_type_name = "struct rt_executor_stat", .doc = "per chain deadline and utilization statistics (output on stop)" },
+	{ 0 },
+};
+
+ubx_type_t rtx_types[] = {
+	def_struct_type(struct rt_executor_stat, &rt_executor_stat_h),
+};
+
+def_port_writers(write_rtx_stat, struct rt_executor_stat);
+
+ubx_proto_config_t rtx_config[] = {
+	{ .name = "num_chains", .type_name = "int", .max = 1, .doc = "number of trigger chains (def: 1)" },
+	{ .name = "period_ns", .type_name = "uint64_t", .min = 1, .doc = "period of each chain in ns" },
+	{ .name = "phase_ns", .type_name = "uint64_t", .doc = "release offset of each chain in ns (def: 0)" },
+	{ .name = "deadline_ns", .type_name = "uint64_t", .doc = "relative deadline of each chain in ns (def: period)" },
+	{ .name = "priority", .type_name = "int", .doc = "priority of each chain, breaks deadline ties (higher first, def: 0)" },
+	{ .name = "num_threads", .type_name = "int", .max = 1, .doc = "number of worker threads (def: 1)" },
+	{ .name = "stacksize", .type_name = "size_t", .max = 1, .doc = "worker stacksize as per pthread_attr_setstacksize(3)" },
+	{ .name = "sched_priority", .type_name = "int", .max = 1, .doc = "worker pthread priority" },
+	{ .name = "sched_policy", .type_name = "char", .doc = "worker pthread scheduling policy" },
+	{ .name = "affinity", .type_name = "int", .doc = "CPUs to pin the workers to, worker i is pinned to affinity[i % len]" },
+	{ .name = "thread_name", .type_name = "char", .doc = "worker thread name prefix, default is block name" },
+
+	{ .name = "tstats_mode", .type_name = "int", .max = 1, .doc = "0: off (def), 1: global only, 2: per block", },
+	{ .name = "tstats_profile_path", .type_name = "char", .doc = "directory to write the timing stats file to" },
+	{ .name = "tstats_output_rate", .type_name = "double", .max = 1, .doc = "throttle output on tstats port" },
+	{ .name = "tstats_skip_first", .type_name = "int", .max=1, .doc = "skip N steps before acquiring stats" },
+	{ .name = "tstats_faults", .type_name = "int", .max=1, .doc = "if 1, sample the page faults of the thread in the tstats (def: 0)" },
+	{ .name = "loglevel", .type_name = "int" },
+	{ 0 },
+};
+
+/**
+ * struct rtx_job - scheduling state of a chain
+ *
+ * @period: period in ns
+ * @phase: offset of the first release from start in ns
+ * @deadline: relative deadline in ns
+ * @prio: priority for breaking deadline ties
+ * @release: absolute time of the next release
+ * @abs_deadline: absolute deadline of the next release
+ * @running: set while a worker executes this chain
+ * @stat: deadline and utilization statistics
+ */
+struct rtx_job {
+	uint64_t period;
+	uint64_t phase;
+	uint64_t deadline;
+	int prio;
+
+	uint64_t release;
+	uint64_t abs_deadline;
+	int running;
+
+	struct rt_executor_stat stat;
+};
+
+struct rtx_worker {
+	pthread_t tid;
+	ubx_block_t *b;
+};
+
+/**
+ * block info
+ *
+ * @mutex protects the jobs array, state and num_running. It is only
+ * held for dispatching and accounting, never while a chain runs.
+ */
+struct rtx_inf {
+	pthread_mutex_t mutex;
+	pthread_cond_t active_cond;	/* signalled upon start and cleanup */
+	pthread_cond_t idle_cond;	/* signalled upon job completion */
+	pthread_attr_t attr;
+
+	uint32_t state;		/* desired state requested by main */
+	int num_running;	/* number of chains being executed */
+	int stop_pending;	/* chains still configured after a stop timeout */
+
+	struct rtx_worker *workers;
+	int num_threads;
+
+	struct ubx_chain *chains;
+	struct rtx_job *jobs;
+	int num_chains;
+
+	uint64_t start;
+	ubx_port_t *p_chain_stats;
+};
+
+/* the condition variables use CLOCK_MONOTONIC, so always use it */
+static uint64_t rtx_now(void)
+{
+	struct ubx_timespec ts;
+
+	ubx_clock_mono_gettime(&ts);
+	return ubx_ts_to_ns(&ts);
+}
+
+static void rtx_ns_to_timespec(uint64_t ns, struct timespec *ts)
+{
+	ts->tv_sec = ns / NSEC_PER_SEC;
+	ts->tv_nsec = ns % NSEC_PER_SEC;
+}
+
+/*
+ * pick the released, idle job with the earliest absolute deadline.
+ * If none is released, *wakeup is set to the earliest release of an
+ * idle job (UINT64_MAX if all are running). The linear scan is
+ * cheap compared to a chain and keeps the jobs in one array.
+ */
+static int rtx_pick(const struct rtx_inf *inf, uint64_t now, uint64_t *wakeup)
+{
+	int best = -1;
+	const struct rtx_job *j, *jbest = NULL;
+
+	*wakeup = UINT64_MAX;
+
+	for (int i = 0; i < inf->num_chains; i++) {
+		j = &inf->jobs[i];
+
+		if (j->running)
+			continue;
+
+		if (j->release > now) {
+			if (j->release < *wakeup)
+				*wakeup = j->release;
+			continue;
+		}
+
+		if (jbest == NULL ||
+		    j->abs_deadline < jbest->abs_deadline ||
+		    (j->abs_deadline == jbest->abs_deadline && j->prio > jbest->prio)) {
+			best = i;
+			jbest = j;
+		}
+	}
+
+	return best;
+}
+
+/* account a finished job and compute its next release */
+static void rtx_complete(struct rtx_job *j, uint64_t start, uint64_t end)
+{
+	uint64_t lateness;
+
+	j->stat.releases++;
+	j->stat.busy_ns += end - start;
+
+	if (end > j->abs_deadline) {
+		lateness = end - j->abs_deadline;
+		j->stat.misses++;
+
+		if (lateness > j->stat.max_lateness_ns)
+			j->stat.max_lateness_ns = lateness;
+	}
+
+	j->release += j->period;
+
+	/* drop releases whose deadline has already passed */
+	while (j->release + j->deadline < end) {
+		j->release += j->period;
+		j->stat.skipped++;
+	}
+
+	j->abs_deadline = j->release + j->deadline;
+	j->running = 0;
+}
+
+/* worker thread */
+static void *rtx_worker_run(void *arg)
+{
+	int i;
+	uint64_t now, end, wakeup;
+	struct timespec ts;
+	struct rtx_worker *w = (struct rtx_worker *)arg;
+	ubx_block_t *b = w->b;
+	struct rtx_inf *inf = (struct rtx_inf *)b->private_data;
+
+	pthread_mutex_lock(&inf->mutex);
+
+	while (1) {
+		while (inf->state == BLOCK_STATE_INACTIVE)
+			pthread_cond_wait(&inf->active_cond, &inf->mutex);
+
+		if (inf->state != BLOCK_STATE_ACTIVE)
+			break;
+
+		now = rtx_now();
+		i = rtx_pick(inf, now, &wakeup);
+
+		if (i < 0) {
+			if (wakeup == UINT64_MAX) {
+				pthread_cond_wait(&inf->idle_cond, &inf->mutex);
+			} else {
+				rtx_ns_to_timespec(wakeup, &ts);
+				pthread_cond_timedwait(&inf->idle_cond, &inf->mutex, &ts);
+			}
+			continue;
+		}
+
+		inf->jobs[i].running = 1;
+		inf->num_running++;
+		pthread_mutex_unlock(&inf->mutex);
+
+		if (ubx_chain_trigger(&inf->chains[i]) != 0)
+			ubx_err(b, "ubx_chain_trigger failed for chain%i", i);
+
+		end = rtx_now();
+
+		pthread_mutex_lock(&inf->mutex);
+		rtx_complete(&inf->jobs[i], now, end);
+		inf->num_running--;
+
+		/* the next release may be earlier than an idle worker's wakeup */
+		pthread_cond_signal(&inf->idle_cond);
+	}
+
+	pthread_mutex_unlock(&inf->mutex);
+	return NULL;
+}
+
+/*
+ * read an optional per chain config of num_chains elements
+ *
+ * @return 0 if unset, 1 if set, <0 if the length is invalid
+ */
+static int rtx_chain_cfg_len(const ubx_block_t *b, const char *name, long len, int num_chains)
+{
+	if (len == 0)
+		return 0;
+
+	if (len != num_chains) {
+		ubx_err(b, "EINVALID_CONFIG_LEN: %s has %li elements but num_chains is %i",
+			name, len, num_chains);
+		return EINVALID_CONFIG_LEN;
+	}
+
+	return 1;
+}
+
+/* read the per chain timing configs into the jobs */
+static int rtx_config_jobs(ubx_block_t *b, struct rtx_inf *inf)
+{
+	long len;
+	int ret;
+	const uint64_t *period, *phase, *deadline;
+	const int *prio;
+
+	len = cfg_getptr_uint64(b, "period_ns", &period);
+	assert(len >= 0);
+
+	if (rtx_chain_cfg_len(b, "period_ns", len, inf->num_chains) <= 0) {
+		ubx_err(b, "EINVALID_CONFIG: period_ns must be set for all chains");
+		return EINVALID_CONFIG;
+	}
+
+	len = cfg_getptr_uint64(b, "phase_ns", &phase);
+	assert(len >= 0);
+	ret = rtx_chain_cfg_len(b, "phase_ns", len, inf->num_chains);
+
+	if (ret < 0)
+		return ret;
+
+	if (ret == 0)
+		phase = NULL;
+
+	len = cfg_getptr_uint64(b, "deadline_ns", &deadline);
+	assert(len >= 0);
+	ret = rtx_chain_cfg_len(b, "deadline_ns", len, inf->num_chains);
+
+	if (ret < 0)
+		return ret;
+
+	if (ret == 0)
+		deadline = NULL;
+
+	len = cfg_getptr_int(b, "priority", &prio);
+	assert(len >= 0);
+	ret = rtx_chain_cfg_len(b, "priority", len, inf->num_chains);
+
+	if (ret < 0)
+		return ret;
+
+	if (ret == 0)
+		prio = NULL;
+
+	for (int i = 0; i < inf->num_chains; i++) {
+		struct rtx_job *j = &inf->jobs[i];
+
+		if (period[i] == 0) {
+			ubx_err(b, "EINVALID_CONFIG: period_ns of chain%i is 0", i);
+			return EINVALID_CONFIG;
+		}
+
+		j->period = period[i];
+		j->phase = (phase) ? phase[i] : 0;
+		j->deadline = (deadline && deadline[i] > 0) ? deadline[i] : period[i];
+		j->prio = (prio) ? prio[i] : 0;
+	}
+
+	return 0;
+}
+
+/*
+ * chains executed by different workers may run concurrently, so a
+ * block must not be triggered by more than one chain, neither
+ * directly nor via a nested trigger such as ubx/fused
+ */
+static int rtx_check_disjoint(ubx_block_t *b, struct rtx_inf *inf)
+{
+	int ret;
+	struct ubx_chain_overlap ov;
+
+	if (inf->num_threads == 1)
+		return 0;
+
+	ret = ubx_chains_check_disjoint(inf->chains, inf->num_chains, &ov);
+
+	if (ret < 0) {
+		ubx_err(b, "failed to check chains: %s", strerror(-ret));
+		return EOUTOFMEM;
+	}
+
+	if (ret > 0) {
+		ubx_err(b, "EINVALID_CONFIG: block %s is triggered by chain%i and chain%i, "
+			"which may run concurrently with num_threads > 1",
+			ov.b->name, ov.chain_a, ov.chain_b);
+		return EINVALID_CONFIG;
+	}
+
+	return 0;
+}
+
+static int rtx_handle_thread_config(ubx_block_t *b, struct rtx_inf *inf)
+{
+	long len;
+	int ret;
+	unsigned int schedpol = SCHED_OTHER;
+	const int *tint;
+	const char *schedpol_str;
+	const size_t *stacksize;
+	struct sched_param sched_param = { 0 };
+
+	/* num_threads */
+	len = cfg_getptr_int(b, "num_threads", &tint);
+	assert(len >= 0);
+
+	inf->num_threads = (len > 0) ? *tint : 1;
+
+	if (inf->num_threads < 1) {
+		ubx_err(b, "EINVALID_CONFIG: num_threads must be >= 1 but is %i",
+			inf->num_threads);
+		return EINVALID_CONFIG;
+	}
+
+	/* stacksize */
+	len = cfg_getptr_size_t(b, "stacksize", &stacksize);
+	assert(len >= 0);
+
+	if (len > 0) {
+		if (*stacksize < (size_t)PTHREAD_STACK_MIN) {
+			ubx_err(b, "stacksize (%zd) less than PTHREAD_STACK_MIN (%ld)",
+				*stacksize, (long)PTHREAD_STACK_MIN);
+			return EINVALID_CONFIG;
+		}
+
+		ret = pthread_attr_setstacksize(&inf->attr, *stacksize);
+
+		if (ret != 0) {
+			ubx_err(b, "pthread_attr_setstacksize failed: %s", strerror(ret));
+			return EINVALID_CONFIG;
+		}
+	}
+
+	/* sched_policy */
+	len = cfg_getptr_char(b, "sched_policy", &schedpol_str);
+	assert(len >= 0);
+
+	if (len == 0) {
+		schedpol_str = "SCHED_OTHER";
+	} else {
+		if (strncmp(schedpol_str, "SCHED_OTHER", len) == 0) {
+			schedpol = SCHED_OTHER;
+		} else if (strncmp(schedpol_str, "SCHED_FIFO", len) == 0) {
+			schedpol = SCHED_FIFO;
+		} else if (strncmp(schedpol_str, "SCHED_RR", len) == 0) {
+			schedpol = SCHED_RR;
+		} else {
+			ubx_err(b, "sched_policy config: illegal value %s", schedpol_str);
+			return EINVALID_CONFIG;
+		}
+	}
+
+	/* sched_priority */
+	len = cfg_getptr_int(b, "sched_priority", &tint);
+	assert(len >= 0);
+
+	sched_param.sched_priority = (len > 0) ? *tint : 0;
+
+	if (((schedpol == SCHED_FIFO || schedpol == SCHED_RR) &&
+	     sched_param.sched_priority == 0) ||
+	    (schedpol == SCHED_OTHER && sched_param.sched_priority > 0)) {
+		ubx_err(b, "invalid sched_priority %d with policy %s",
+			sched_param.sched_priority, schedpol_str);
+		return EINVALID_CONFIG;
+	}
+
+	ret = pthread_attr_setschedpolicy(&inf->attr, schedpol);
+	ret = ret ? ret : pthread_attr_setinheritsched(&inf->attr, PTHREAD_EXPLICIT_SCHED);
+	ret = ret ? ret : pthread_attr_setschedparam(&inf->attr, &sched_param);
+
+	if (ret != 0) {
+		ubx_err(b, "failed to set scheduling attributes: %s", strerror(ret));
+		return EINVALID_CONFIG;
+	}
+
+	ubx_info(b, "%i workers, prio %d, %i chains", inf->num_threads,
+		 sched_param.sched_priority, inf->num_chains);
+
+	return 0;
+}
+
+/*
+ * create, name and pin num workers. inf->num_threads is the number
+ * of workers created, so that cleanup joins only these.
+ */
+static int rtx_create_workers(ubx_block_t *b, struct rtx_inf *inf, int num)
+{
+	int ret;
+	long len, aff_len;
+	const int *aff;
+	const char *prefix;
+	char name[THREAD_NAME_MAXLEN];
+	cpu_set_t cpuset;
+
+	len = cfg_getptr_char(b, "thread_name", &prefix);
+	assert(len >= 0);
+	prefix = (len > 0) ? prefix : b->name;
+
+	aff_len = cfg_getptr_int(b, "affinity", &aff);
+	assert(aff_len >= 0);
+
+	inf->num_threads = 0;
+
+	for (int i = 0; i < num; i++) {
+		inf->workers[i].b = b;
+
+		ret = pthread_create(&inf->workers[i].tid, &inf->attr,
+				     rtx_worker_run, &inf->workers[i]);
+
+		if (ret != 0) {
+			ubx_err(b, "pthread_create of worker %i failed: %s", i, strerror(ret));
+			return -1;
+		}
+
+		inf->num_threads++;
+
+		snprintf(name, THREAD_NAME_MAXLEN, "%.12s/%i", prefix, i);
+
+		if (pthread_setname_np(inf->workers[i].tid, name))
+			ubx_err(b, "failed to set thread_name to %s", name);
+
+		if (aff_len == 0)
+			continue;
+
+		CPU_ZERO(&cpuset);
+		CPU_SET(aff[i % aff_len], &cpuset);
+
+		ret = pthread_setaffinity_np(inf->workers[i].tid, sizeof(cpu_set_t), &cpuset);
+
+		if (ret != 0) {
+			ubx_err(b, "pthread_setaffinity_np of worker %i failed: %s",
+				i, strerror(ret));
+			return -1;
+		}
+
+		ubx_info(b, "pinned worker %i to CPU %i", i, aff[i % aff_len]);
+	}
+
+	return 0;
+}
+
+static void rtx_join_workers(ubx_block_t *b, struct rtx_inf *inf)
+{
+	int ret;
+
+	pthread_mutex_lock(&inf->mutex);
+	inf->state = BLOCK_STATE_PREINIT;
+	pthread_cond_broadcast(&inf->active_cond);
+	pthread_cond_broadcast(&inf->idle_cond);
+	pthread_mutex_unlock(&inf->mutex);
+
+	for (int i = 0; i < inf->num_threads; i++) {
+		ret = pthread_join(inf->workers[i].tid, NULL);
+
+		if (ret != 0)
+			ubx_err(b, "pthread_join of worker %i failed: %s", i, strerror(ret));
+	}
+}
+
+/* init */
+int rtx_init(ubx_block_t *b)
+{
+	int ret = EOUTOFMEM;
+	pthread_condattr_t cattr;
+	struct rtx_inf *inf;
+
+	b->private_data = ubx_block_alloc_private(b, sizeof(struct rtx_inf));
+
+	if (b->private_data == NULL) {
+		ubx_err(b, "failed to alloc");
+		goto out;
+	}
+
+	inf = (struct rtx_inf *)b->private_data;
+
+	inf->p_chain_stats = ubx_port_get(b, "chain_stats");
+	assert(inf->p_chain_stats != NULL);
+
+	/* initialize chains and add configs */
+	inf->num_chains = common_init_chains(b, &inf->chains);
+
+	if (inf->num_chains <= 0) {
+		ret = EINVALID_CONFIG;
+		goto out_free;
+	}
+
+	inf->jobs = ubx_block_alloc_private(b, inf->num_chains * sizeof(struct rtx_job));
+
+	if (inf->jobs == NULL)
+		goto out_cleanup_chains;
+
+	inf->state = BLOCK_STATE_INACTIVE;
+
+	pthread_mutex_init(&inf->mutex, NULL);
+	pthread_condattr_init(&cattr);
+	pthread_condattr_setclock(&cattr, CLOCK_MONOTONIC);
+	pthread_cond_init(&inf->active_cond, &cattr);
+	pthread_cond_init(&inf->idle_cond, &cattr);
+	pthread_condattr_destroy(&cattr);
+	pthread_attr_init(&inf->attr);
+	pthread_attr_setdetachstate(&inf->attr, PTHREAD_CREATE_JOINABLE);
+
+	if (rtx_handle_thread_config(b, inf) != 0) {
+		ret = EINVALID_CONFIG;
+		goto out_destroy;
+	}
+
+	inf->workers = ubx_block_alloc_private(b, inf->num_threads * sizeof(struct rtx_worker));
+
+	if (inf->workers == NULL) {
+		ret = EOUTOFMEM;
+		goto out_destroy;
+	}
+
+	if (rtx_create_workers(b, inf, inf->num_threads) != 0) {
+		ret = -1;
+		goto out_join;
+	}
+
+	ret = 0;
+	goto out;
+
+out_join:
+	rtx_join_workers(b, inf);
+	ubx_block_free_private(b, inf->workers);
+out_destroy:
+	pthread_attr_destroy(&inf->attr);
+	pthread_cond_destroy(&inf->idle_cond);
+	pthread_cond_destroy(&inf->active_cond);
+	pthread_mutex_destroy(&inf->mutex);
+	ubx_block_free_private(b, inf->jobs);
+out_cleanup_chains:
+	common_cleanup(b, &inf->chains);
+out_free:
+	ubx_block_free_private(b, b->private_data);
+out:
+	return ret;
+}
+
+int rtx_start(ubx_block_t *b)
+{
+	int ret, running;
+	struct rtx_inf *inf = (struct rtx_inf *)b->private_data;
+
+	pthread_mutex_lock(&inf->mutex);
+	running = inf->num_running;
+	pthread_mutex_unlock(&inf->mutex);
+
+	if (running > 0) {
+		ubx_err(b, "EWRONG_STATE: %d chains of the last run still executing", running);
+		return EWRONG_STATE;
+	}
+
+	/* finish a stop that timed out */
+	if (inf->stop_pending) {
+		common_unconfig(inf->chains, inf->num_chains);
+		inf->stop_pending = 0;
+	}
+
+	ret = common_config_chains(b, inf->chains, inf->num_chains);
+
+	if (ret != 0)
+		goto out;
+
+	ret = rtx_config_jobs(b, inf);
+
+	if (ret != 0)
+		goto out_unconfig;
+
+	ret = rtx_check_disjoint(b, inf);
+
+	if (ret != 0)
+		goto out_unconfig;
+
+	pthread_mutex_lock(&inf->mutex);
+
+	inf->start = rtx_now();
+
+	for (int i = 0; i < inf->num_chains; i++) {
+		struct rtx_job *j = &inf->jobs[i];
+
+		memset(&j->stat, 0, sizeof(j->stat));
+		snprintf(j->stat.id, sizeof(j->stat.id), "chain%i", i);
+
+		j->release = inf->start + j->phase;
+		j->abs_deadline = j->release + j->deadline;
+		j->running = 0;
+	}
+
+	inf->state = BLOCK_STATE_ACTIVE;
+	pthread_cond_broadcast(&inf->active_cond);
+	pthread_mutex_unlock(&inf->mutex);
+
+	ret = 0;
+	goto out;
+
+out_unconfig:
+	common_unconfig(inf->chains, inf->num_chains);
+out:
+	return ret;
+}
+
+/* log and output the per chain statistics */
+static void rtx_output_stats(ubx_block_t *b, struct rtx_inf *inf)
+{
+	double total = 0;
+	uint64_t now = rtx_now();
+	struct rt_executor_stat *s;
+
+	for (int i = 0; i < inf->num_chains; i++) {
+		s = &inf->jobs[i].stat;
+		s->elapsed_ns = now - inf->start;
+		s->utilization = (s->elapsed_ns > 0) ?
+			(double)s->busy_ns / s->elapsed_ns : 0;
+		total += s->utilization;
+
+		ubx_info(b, "%s: period %" PRIu64 " us, releases %" PRIu64
+			 ", misses %" PRIu64 ", skipped %" PRIu64
+			 ", max lateness %" PRIu64 " us, utilization %.2f%%",
+			 s->id, inf->jobs[i].period / NSEC_PER_USEC, s->releases,
+			 s->misses, s->skipped, s->max_lateness_ns / NSEC_PER_USEC,
+			 s->utilization * 100);
+
+		write_rtx_stat(inf->p_chain_stats, s);
+	}
+
+	ubx_info(b, "total utilization %.2f%% on %i workers",
+		 total * 100, inf->num_threads);
+}
+
+void rtx_stop(ubx_block_t *b)
+{
+	int i;
+	struct rtx_inf *inf = (struct rtx_inf *)b->private_data;
+
+	pthread_mutex_lock(&inf->mutex);
+	inf->state = BLOCK_STATE_INACTIVE;
+	pthread_cond_broadcast(&inf->idle_cond);
+	pthread_mutex_unlock(&inf->mutex);
+
+	/* wait for the running chains to complete */
+	for (i = THREAD_STOP_RETRIES; i >= 0; i--) {
+		pthread_mutex_lock(&inf->mutex);
+		int running = inf->num_running;
+		pthread_mutex_unlock(&inf->mutex);
+
+		if (running == 0)
+			break;
+
+		usleep(THREAD_STOP_TIMEOUT_US);
+	}
+
+	/* the chains are unconfigured by the next start or cleanup */
+	if (i < 0) {
+		ubx_warn(b, "timeout waiting for workers to stop");
+		inf->stop_pending = 1;
+		return;
+	}
+
+	rtx_output_stats(b, inf);
+
+	common_output_stats(b, inf->chains, inf->num_chains);
+	common_log_stats(b, inf->chains, inf->num_chains);
+
+	if (common_write_stats(b, inf->chains, inf->num_chains) != 0)
+		ubx_err(b, "failed to write tstats to profile_path");
+
+	common_unconfig(inf->chains, inf->num_chains);
+}
+
+void rtx_cleanup(ubx_block_t *b)
+{
+	struct rtx_inf *inf = (struct rtx_inf *)b->private_data;
+
+	rtx_join_workers(b, inf);
+
+	if (inf->stop_pending)
+		common_unconfig(inf->chains, inf->num_chains);
+
+	pthread_attr_destroy(&inf->attr);
+	pthread_cond_destroy(&inf->idle_cond);
+	pthread_cond_destroy(&inf->active_cond);
+	pthread_mutex_destroy(&inf->mutex);
+
+	common_cleanup(b, &inf->chains);
+	ubx_block_free_private(b, inf->workers);
+	ubx_block_free_private(b, inf->jobs);
+	ubx_block_free_private(b, b->private_data);
+}
+
+ubx_proto_block_t rtx_comp = {
+	.name = "ubx/rt_executor",
+	.type = BLOCK_TYPE_COMPUTATION,
+	.attrs = BLOCK_ATTR_TRIGGER | BLOCK_ATTR_ACTIVE,
+	.meta_data = rtx_meta,
+
+	.configs = rtx_config,
+	.ports = rtx_ports,
+
+	.init = rtx_init,
+	.start = rtx_start,
+	.stop = rtx_stop,
+	.cleanup = rtx_cleanup
+};
+
+int rtx_mod_init(ubx_node_t *nd)
+{
+	int ret;
+
+	for (unsigned int i=0; i<ARRAY_SIZE(rtx_types); i++) {
+		ret = ubx_type_register(nd, &rtx_types[i]);
+		if (ret != 0) {
+			ubx_log(UBX_LOGLEVEL_ERR, nd, __func__,
+				"failed to register type %s",
+				rtx_types[i].name);
+			goto out;
+		}
+	}
+
+	ret = ubx_block_register(nd, &rtx_comp);
+
+	if (ret != 0) {
+		ubx_log(UBX_LOGLEVEL_ERR, nd, __func__,
+			"failed to register rt_executor block");
+	}
+ out:
+	return ret;
+}
+
+void rtx_mod_cleanup(ubx_node_t *nd)
+{
+	for (unsigned int i=0; i<ARRAY_SIZE(rtx_types); i++)
+		ubx_type_unregister(nd, rtx_types[i].name);
+
+	ubx_block_unregister(nd, "ubx/rt_executor");
+}
+
+UBX_MODULE_INIT(rtx_mod_init)
+UBX_MODULE_CLEANUP(rtx_mod_cleanup)
+UBX_MODULE_LICENSE_SPDX(BSD-3-Clause)
@@ -30,6 +30,7 @@ ubx_proto_config_t trig_config[] = {
 	{ .name = "tstats_profile_path", .type_name = "char", .doc = "directory to write the timing stats file to" },
 	{ .name = "tstats_output_rate", .type_name = "double", .max = 1, .doc = "throttle output on tstats port" },
 	{ .name = "tstats_skip_first", .type_name = "int", .max=1, .doc = "skip N steps before acquiring stats" },
+	{ .name = "tstats_faults", .type_name = "int", .max=1, .doc = "if 1, sample the page faults of the thread in the tstats (def: 0)" },
 	{ .name = "loglevel", .type_name = "int" },
 	{ 0 },
 };
@@ -64,7 +65,7 @@ void trig_step(ubx_block_t *b)
 /* init */
 int trig_init(ubx_block_t *b)
 {
-	b->private_data = calloc(1, sizeof(struct block_info));
+	b->private_data = ubx_block_alloc_private(b, sizeof(struct block_info));
 
 	if (b->private_data == NULL) {
 		ubx_err(b, "failed to alloc ubx_chain");
@@ -106,7 +107,7 @@ void trig_cleanup(ubx_block_t *b)
 {
 	struct block_info *inf = (struct block_info *)b->private_data;
 	common_cleanup(b, &inf->chains);
-	free(b->private_data);
+	ubx_block_free_private(b, b->private_data);
 }
 
 
@@ -0,0 +1,18 @@
+#ifndef _PTRIG_JITTER
+#define _PTRIG_JITTER
+
+/* wakeup latency and release jitter statistics of ptrig */
+struct ptrig_jitter {
+	uint64_t cnt;			/* number of releases */
+	uint64_t window;		/* spin window at stop [ns] */
+	uint64_t late;			/* wakeups after the release */
+	uint64_t lat_min;		/* wakeup latency w/o spinning [ns] */
+	uint64_t lat_max;
+	uint64_t lat_avg;
+	uint64_t jit_min;		/* release jitter with spinning [ns] */
+	uint64_t jit_max;
+	uint64_t jit_avg;
+	uint64_t spin_avg;		/* time spent spinning [ns] */
+};
+
+#endif /* _PTRIG_JITTER */
@@ -0,0 +1,16 @@
+#ifndef _RT_EXECUTOR_STAT
+#define _RT_EXECUTOR_STAT
+
+/* per chain accounting of the rt_executor */
+struct rt_executor_stat {
+	char id[UBX_TSTAT_ID_MAXLEN + 1];
+	uint64_t releases;		/* number of jobs executed */
+	uint64_t misses;		/* jobs completed after their deadline */
+	uint64_t skipped;		/* releases dropped due to lateness */
+	uint64_t max_lateness_ns;	/* max completion after the deadline */
+	uint64_t busy_ns;		/* accumulated execution time */
+	uint64_t elapsed_ns;		/* time since start */
+	double utilization;		/* busy_ns / elapsed_ns */
+};
+
+#endif /* _RT_EXECUTOR_STAT */
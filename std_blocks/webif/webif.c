@@ -1,13 +1,22 @@
 /*
  * A system monitoring web-interface function block.
+ *
+ * Besides the Lua based web-interface, the block serves a monitoring
+ * snapshot of the block and chain statistics as JSON (/mon) and as a
+ * stream of Server-Sent Events (/mon/stream?rate=HZ). These are
+ * generated in C from the block counters and the seqlocked chain
+ * snapshots (see ubx_chain_mon_register), hence they neither take
+ * the Lua lock nor interfere with the trigger threads.
  */
 
 #undef DEBUG
 #define WEBIF_RELOAD			1
 #define COMPILE_IN_WEBIF_LUA_FILE	1
 
-#define MONGOOSE_NR_THREADS		"1"	/* don't change. */
 #define WEBIF_DEFAULT_PORT		"8080"
+#define WEBIF_MON_MAX_RATE		50	/* Hz */
+#define WEBIF_MON_DEFAULT_RATE		10	/* Hz */
+#define WEBIF_MON_DEFAULT_STREAMS	2
 
 #include <lauxlib.h>
 #include <lualib.h>
@@ -15,10 +24,13 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdarg.h>
+#include <inttypes.h>
 #include <pthread.h>
 
 #include "mongoose.h"
 #include "ubx.h"
+#include "trig_utils.h"
 
 UBX_MODULE_LICENSE_SPDX(GPL-2.0)
 
@@ -31,6 +43,8 @@ UBX_MODULE_LICENSE_SPDX(GPL-2.0)
 ubx_proto_config_t webif_conf[] = {
 	{ .name = "port", .type_name = "char",
 	  .doc = "Port to listen on (default: " WEBIF_DEFAULT_PORT ")" },
+	{ .name = "mon_max_streams", .type_name = "int", .max = 1,
+	  .doc = "max number of concurrent /mon/stream clients (default: 2)" },
 	{ 0 }
 };
 
@@ -45,8 +59,242 @@ struct webif_info {
 	struct mg_callbacks callbacks;
 	struct lua_State *L;
 	pthread_mutex_t mutex;
+
+	int mon_max_streams;
+	int mon_streams;	/* active streams (atomic) */
+	int mon_stop;		/* terminate streams (atomic) */
+};
+
+/*
+ * monitoring
+ */
+
+/* growable string buffer */
+struct mon_buf {
+	char *s;
+	size_t len;
+	size_t size;
 };
 
+static int mon_printf(struct mon_buf *mb, const char *fmt, ...)
+{
+	int n;
+	char *tmp;
+	va_list ap;
+
+	while (1) {
+		va_start(ap, fmt);
+		n = vsnprintf(mb->s + mb->len, mb->size - mb->len, fmt, ap);
+		va_end(ap);
+
+		if (n < 0)
+			return -1;
+
+		if (mb->len + n < mb->size)
+			break;
+
+		tmp = realloc(mb->s, (mb->size + n + 1) * 2);
+
+		if (tmp == NULL)
+			return -1;
+
+		mb->s = tmp;
+		mb->size = (mb->size + n + 1) * 2;
+	}
+
+	mb->len += n;
+	return 0;
+}
+
+/* append str as a JSON string */
+static void mon_puts_json(struct mon_buf *mb, const char *str)
+{
+	mon_printf(mb, "\"");
+
+	for (; *str != '\0'; str++) {
+		if (*str == '"' || *str == '\\')
+			mon_printf(mb, "\\%c", *str);
+		else if ((unsigned char) *str < 0x20)
+			mon_printf(mb, "\\u%04x", *str);
+		else
+			mon_printf(mb, "%c", *str);
+	}
+
+	mon_printf(mb, "\"");
+}
+
+static void mon_tstat_json(struct mon_buf *mb, const struct ubx_tstat *ts)
+{
+	struct ubx_timespec avg = { 0 };
+
+	if (ts->cnt > 0)
+		ubx_ts_div(&ts->total, ts->cnt, &avg);
+
+	mon_printf(mb, "{\"id\":");
+	mon_puts_json(mb, ts->id);
+	mon_printf(mb, ",\"cnt\":%lu,\"min_us\":%" PRIu64 ",\"max_us\":%" PRIu64
+		   ",\"avg_us\":%" PRIu64 ",\"minflt\":%lu,\"majflt\":%lu"
+		   ",\"overruns\":%lu}",
+		   ts->cnt,
+		   (ts->cnt > 0) ? ubx_ts_to_us(&ts->min) : 0,
+		   ubx_ts_to_us(&ts->max),
+		   ubx_ts_to_us(&avg),
+		   ts->minflt, ts->majflt, ts->overruns);
+}
+
+static void mon_chain_json(const ubx_block_t *b,
+			   const struct ubx_tstat *global,
+			   const struct ubx_tstat *blk,
+			   long len, void *arg)
+{
+	struct mon_buf *mb = arg;
+
+	if (mb->s[mb->len - 1] != '[')
+		mon_printf(mb, ",");
+
+	mon_printf(mb, "{\"block\":");
+	mon_puts_json(mb, b->name);
+	mon_printf(mb, ",\"global\":");
+	mon_tstat_json(mb, global);
+	mon_printf(mb, ",\"blocks\":[");
+
+	for (long i = 0; i < len; i++) {
+		if (i > 0)
+			mon_printf(mb, ",");
+		mon_tstat_json(mb, &blk[i]);
+	}
+
+	mon_printf(mb, "]}");
+}
+
+/**
+ * mon_snapshot - generate the JSON monitoring snapshot
+ *
+ * The block counters are read without locking, which is fine since
+ * these are only incremented by a single thread. The block list is
+ * protected against concurrent block creation and removal by
+ * ubx_blocks_lock.
+ */
+static int mon_snapshot(const struct webif_info *inf, struct mon_buf *mb)
+{
+	int ret, first = 1;
+	ubx_block_t *b, *btmp;
+	struct ubx_timespec now;
+	const ubx_node_t *nd = inf->block->nd;
+
+	mb->len = 0;
+	ubx_clock_mono_gettime(&now);
+
+	mon_printf(mb, "{\"node\":");
+	mon_puts_json(mb, nd->name);
+	mon_printf(mb, ",\"ts\":%.6f,\"blocks\":[", ubx_ts_to_double(&now));
+
+	ubx_blocks_lock();
+
+	HASH_ITER(hh, nd->blocks, b, btmp) {
+		mon_printf(mb, "%s{\"name\":", first ? "" : ",");
+		mon_puts_json(mb, b->name);
+		mon_printf(mb, ",\"state\":\"%s\"", block_state_tostr(b->block_state));
+
+		if (b->type == BLOCK_TYPE_COMPUTATION) {
+			mon_printf(mb, ",\"steps\":%lu}",
+				   __atomic_load_n(&b->stat_num_steps, __ATOMIC_RELAXED));
+		} else {
+			mon_printf(mb, ",\"reads\":%lu,\"writes\":%lu,\"overruns\":%lu}",
+				   __atomic_load_n(&b->stat_num_reads, __ATOMIC_RELAXED),
+				   __atomic_load_n(&b->stat_num_writes, __ATOMIC_RELAXED),
+				   __atomic_load_n(&b->stat_num_overruns, __ATOMIC_RELAXED));
+		}
+		first = 0;
+	}
+
+	mon_printf(mb, "],\"chains\":[");
+
+	ret = ubx_chain_mon_foreach(nd, mon_chain_json, mb);
+
+	ubx_blocks_unlock();
+
+	if (ret < 0)
+		return -1;
+
+	return mon_printf(mb, "]}");
+}
+
+/* serve a single snapshot */
+static void mon_serve_json(struct webif_info *inf, struct mg_connection *conn)
+{
+	struct mon_buf mb = { 0 };
+
+	if (mon_snapshot(inf, &mb) != 0) {
+		mg_printf(conn, "HTTP/1.1 500 Internal Server Error\r\n"
+			  "Content-Length: 0\r\n\r\n");
+		goto out;
+	}
+
+	mg_printf(conn,
+		  "HTTP/1.1 200 OK\r\n"
+		  "Content-Type: application/json\r\n"
+		  "Cache-Control: no-cache\r\n"
+		  "Content-Length: %zu\r\n"
+		  "\r\n", mb.len);
+	mg_write(conn, mb.s, mb.len);
+out:
+	free(mb.s);
+}
+
+/* stream snapshots as Server-Sent Events until the client disconnects */
+static void mon_serve_stream(struct webif_info *inf, struct mg_connection *conn,
+			     const struct mg_request_info *ri)
+{
+	int rate = WEBIF_MON_DEFAULT_RATE;
+	char val[16];
+	struct mon_buf mb = { 0 };
+	struct ubx_timespec next, period;
+
+	if (__atomic_add_fetch(&inf->mon_streams, 1, __ATOMIC_ACQ_REL) > inf->mon_max_streams) {
+		mg_printf(conn, "HTTP/1.1 503 Service Unavailable\r\n"
+			  "Content-Length: 0\r\n\r\n");
+		goto out;
+	}
+
+	if (ri->query_string != NULL &&
+	    mg_get_var(ri->query_string, strlen(ri->query_string), "rate", val, sizeof(val)) > 0)
+		rate = atoi(val);
+
+	rate = (rate < 1) ? 1 : (rate > WEBIF_MON_MAX_RATE) ? WEBIF_MON_MAX_RATE : rate;
+
+	period.sec = 0;
+	period.nsec = NSEC_PER_SEC / rate;
+
+	ubx_info(inf->block, "starting monitoring stream at %d Hz", rate);
+
+	mg_printf(conn,
+		  "HTTP/1.1 200 OK\r\n"
+		  "Content-Type: text/event-stream\r\n"
+		  "Cache-Control: no-cache\r\n"
+		  "\r\n");
+
+	ubx_clock_mono_gettime(&next);
+
+	while (!__atomic_load_n(&inf->mon_stop, __ATOMIC_RELAXED)) {
+		if (mon_snapshot(inf, &mb) != 0)
+			break;
+
+		if (mg_printf(conn, "data: ") <= 0 ||
+		    mg_write(conn, mb.s, mb.len) <= 0 ||
+		    mg_printf(conn, "\n\n") <= 0)
+			break;
+
+		ubx_ts_add(&next, &period, &next);
+		ubx_clock_mono_nanosleep(TIMER_ABSTIME, &next);
+	}
+
+	ubx_info(inf->block, "monitoring stream terminated");
+out:
+	__atomic_sub_fetch(&inf->mon_streams, 1, __ATOMIC_ACQ_REL);
+	free(mb.s);
+}
+
 
 int init_lua(struct webif_info *inf);
 
@@ -59,6 +307,17 @@ int begin_request_handler(struct mg_connection *conn)
 	const struct mg_request_info *request_info = mg_get_request_info(conn);
 	struct webif_info *inf = (struct webif_info *) request_info->user_data;
 
+	/* monitoring requests don't need the Lua state */
+	if (strcmp(request_info->uri, "/mon") == 0) {
+		mon_serve_json(inf, conn);
+		goto out;
+	}
+
+	if (strcmp(request_info->uri, "/mon/stream") == 0) {
+		mon_serve_stream(inf, conn, request_info);
+		goto out;
+	}
+
 	if (pthread_mutex_lock(&inf->mutex) != 0) {
 		ubx_err(inf->block, "failed to aquire mutex");
 		goto out;
@@ -192,6 +451,8 @@ void wi_cleanup(ubx_block_t *c)
 int wi_start(ubx_block_t *c)
 {
 	const char *port_num;
+	const int *max_streams;
+	char num_threads[16];
 	long len;
 	struct webif_info *inf;
 
@@ -204,11 +465,29 @@ int wi_start(ubx_block_t *c)
 
 	port_num = (len > 0) ? port_num : WEBIF_DEFAULT_PORT;
 
+	len = cfg_getptr_int(c, "mon_max_streams", &max_streams);
+	if (len < 0)
+		goto out_err;
+
+	inf->mon_max_streams = (len > 0) ? *max_streams : WEBIF_MON_DEFAULT_STREAMS;
+
+	if (inf->mon_max_streams < 0) {
+		ubx_err(c, "EINVALID_CONFIG: mon_max_streams must be >= 0");
+		goto out_err;
+	}
+
+	inf->mon_streams = 0;
+	inf->mon_stop = 0;
+
+	/* one thread for the regular requests plus one per stream,
+	 * since each stream occupies a thread until it terminates */
+	snprintf(num_threads, sizeof(num_threads), "%d", inf->mon_max_streams + 1);
+
 	ubx_info(c, "starting mongoose on port %s using %s thread(s)",
-		 port_num, MONGOOSE_NR_THREADS);
+		 port_num, num_threads);
 
 	/* List of options. Last element must be NULL. */
-	const char *options[] = { "listening_ports", port_num, "num_threads", MONGOOSE_NR_THREADS, NULL};
+	const char *options[] = { "listening_ports", port_num, "num_threads", num_threads, NULL};
 
 	inf->ctx = mg_start(&inf->callbacks, inf, options);
 	if (inf->ctx == NULL) {
@@ -226,6 +505,7 @@ void wi_stop(ubx_block_t *c)
 	struct webif_info *inf;
 
 	inf = (struct webif_info *)c->private_data;
+	__atomic_store_n(&inf->mon_stop, 1, __ATOMIC_RELAXED);
 	mg_stop(inf->ctx);
 }
 
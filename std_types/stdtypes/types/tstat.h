@@ -8,6 +8,9 @@ struct ubx_tstat
 	struct ubx_timespec max;
 	struct ubx_timespec total;
 	unsigned long cnt;
+	unsigned long minflt;	/* minor page faults of the thread */
+	unsigned long majflt;	/* major page faults of the thread */
+	unsigned long overruns;	/* runtime overruns (SCHED_DEADLINE) */
 };
 
 #endif /* TSTAT_H */
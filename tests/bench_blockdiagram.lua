@@ -0,0 +1,57 @@
+-- Benchmark of loading and launching large blockdiagram models
+--
+-- usage: luajit tests/bench_blockdiagram.lua [NUM_BLOCKS,...] [BLOCKS_PER_SUBSYS]
+--
+-- Synthetic models are generated with tools/ubx-genmodel. The
+-- default sizes scale up to 10000 blocks. The models are launched
+-- with nostart, so only loading, validation, instantiation,
+-- configuration and connection are measured.
+--
+-- This is not run by run_tests.sh.
+
+local ubx = require("ubx")
+local utils = require("utils")
+local bd = require("blockdiagram")
+local ffi = require("ffi")
+
+local fmt = string.format
+
+local SIZES = { 1000, 2500, 5000, 10000 }
+local PER_SUBSYS = tonumber(arg[2]) or 100
+
+if arg[1] then
+   SIZES = {}
+   for _,n in ipairs(utils.split(arg[1], ",")) do SIZES[#SIZES+1] = tonumber(n) end
+end
+
+local res = {}
+
+for _,n in ipairs(SIZES) do
+   local fn = fmt("/tmp/bench_blockdiagram_%d.usc", n)
+   local cmd = fmt("luajit tools/ubx-genmodel -n %d -s %d -o %s", n, PER_SUBSYS, fn)
+   local ret = os.execute(cmd)
+   assert(ret == 0 or ret == true, "failed to generate model: "..cmd)
+
+   collectgarbage("collect")
+   local t0 = ubx.clock_mono_gettime()
+   local sys = bd.load(fn)
+   local t1 = ubx.clock_mono_gettime()
+
+   print(fmt("\n### %d blocks (load: %.3f ms)", n, (t1 - t0) * 1000))
+   local nd, prof = sys:launch{ nodename = fmt("bench%d", n),
+				loglevel = ffi.C.UBX_LOGLEVEL_WARN,
+				nostart = true, profile = true }
+
+   local total = t1 - t0
+   for _,p in ipairs(prof) do total = total + p.dur end
+   res[#res+1] = { n = n, total = total }
+
+   ubx.node_rm(nd)
+   os.remove(fn)
+end
+
+print("\n### summary")
+print(fmt("%8s %12s %12s", "blocks", "total [ms]", "us/block"))
+for _,r in ipairs(res) do
+   print(fmt("%8d %12.3f %12.3f", r.n, r.total * 1000, r.total / r.n * 1e6))
+end
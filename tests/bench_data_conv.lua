@@ -0,0 +1,69 @@
+-- Benchmark of ubx_data to Lua conversion and vice versa
+--
+-- usage: luajit tests/bench_data_conv.lua [ITERATIONS] [ARRAY_LEN]
+--
+-- Compares the generated per type converters used by data_tolua and
+-- data_set with the generic reflection based cdata.tolua and the ffi
+-- table initializers on an array of struct kdl_frame.
+--
+-- This is not run by run_tests.sh.
+
+local ubx = require("ubx")
+local cdata = require("cdata")
+local ffi = require("ffi")
+
+local ITER = tonumber(arg[1]) or 1000
+local LEN = tonumber(arg[2]) or 100
+
+local nd = ubx.node_create("bench_data_conv", { loglevel = ffi.C.UBX_LOGLEVEL_WARN })
+ubx.load_module(nd, "stdtypes")
+ubx.load_module(nd, "testtypes")
+
+local d = ubx.data_alloc(nd, "struct kdl_frame", LEN)
+local val = {}
+
+for i=1,LEN do
+   val[i] = { M={ data = { i, 0, 0, 0, i, 0, 0, 0, i } }, p={ x=i, y=-i, z=i/2 } }
+end
+
+-- run fn ITER times and print the duration and Lua heap growth
+local function bench(name, fn)
+   collectgarbage("collect")
+   collectgarbage("stop")
+   local mem0 = collectgarbage("count")
+   local t0 = ubx.clock_mono_gettime()
+   fn()
+   local t1 = ubx.clock_mono_gettime()
+   local mem1 = collectgarbage("count")
+   collectgarbage("restart")
+   local dur = t1 - t0
+   print(string.format("%-28s %8.3f s  %10.1f frames/s  %10.1f KiB garbage",
+		       name, dur, ITER * LEN / dur, mem1 - mem0))
+end
+
+print(string.format("%d iterations of struct kdl_frame[%d]", ITER, LEN))
+
+bench("data_set (generated)", function()
+	 for _=1,ITER do ubx.data_set(d, val) end
+end)
+
+bench("ffi table initializers", function()
+	 local p = ffi.cast("struct kdl_frame*", d.data)
+	 for _=1,ITER do
+	    for i=1,LEN do p[i-1] = val[i] end
+	 end
+end)
+
+bench("data_tolua (generated)", function()
+	 for _=1,ITER do ubx.data_tolua(d) end
+end)
+
+bench("cdata.tolua (reflect)", function()
+	 local p = ffi.cast("struct kdl_frame*", d.data)
+	 for _=1,ITER do
+	    local res = {}
+	    for i=0,LEN-1 do res[i+1] = cdata.tolua(p[i]) end
+	 end
+end)
+
+ubx.node_rm(nd)
@@ -0,0 +1,89 @@
+-- Cost of connections between blocks triggered by the same thread
+--
+-- usage: luajit tests/bench_elide.lua [ITERATIONS] [NUM_BLOCKS] [DATA_LEN]
+--
+-- Steps the root trigger of
+-- examples/usc/composition/deep_composition.usc and of a chain of a
+-- cconst and NUM_BLOCKS math_double blocks of DATA_LEN, each
+-- connected to the next. Each system is launched with lfds_cyclic
+-- connections (default), with same thread connections elided
+-- (elide) and with the chain fused (fuse). This is not run by
+-- run_tests.sh.
+
+local ubx = require("ubx")
+local u = require("utils")
+local ffi = require("ffi")
+
+-- the usc files expect a global bd
+bd = require("blockdiagram")
+
+local fmt = string.format
+
+local ITER = tonumber(arg[1]) or 100000
+local NUM_BLOCKS = tonumber(arg[2]) or 8
+local DATA_LEN = tonumber(arg[3]) or 64
+
+local MODES = {
+   { name = "lfds_cyclic", opts = {} },
+   { name = "elide", opts = { elide = true } },
+   { name = "fuse", opts = { fuse = true } },
+   { name = "fuse+elide", opts = { fuse = true, elide = true } },
+}
+
+local function pipeline()
+   local blocks = {
+      { name = "trig", type = "ubx/trig" },
+      { name = "c", type = "ubx/cconst" },
+   }
+   local configs = {
+      { name = "c", config = { type_name = "double", data_len = DATA_LEN,
+			       value = u.fill(-1, DATA_LEN) } },
+   }
+   local conns, chain = {}, { { b = "#c" } }
+   local prev = "c.out"
+
+   for i=1,NUM_BLOCKS do
+      local name = "m"..i
+      blocks[#blocks+1] = { name = name, type = "ubx/math_double" }
+      configs[#configs+1] = { name = name, config = { func = "fabs", data_len = DATA_LEN } }
+      conns[#conns+1] = { src = prev, tgt = name..".x" }
+      chain[#chain+1] = { b = "#"..name }
+      prev = name..".y"
+   end
+
+   configs[#configs+1] = { name = "trig", config = { chain0 = chain } }
+
+   return bd.system {
+      imports = { "stdtypes", "lfds_cyclic", "trig", "cconst", "math_double" },
+      blocks = blocks,
+      configurations = configs,
+      connections = conns,
+   }
+end
+
+-- a new system is loaded for each launch, as launching resolves the
+-- #block references in place
+local function bench(what, load, trig)
+   for _,m in ipairs(MODES) do
+      local t = { nodename = "bench", loglevel = ffi.C.UBX_LOGLEVEL_WARN }
+      for k,v in pairs(m.opts) do t[k] = v end
+
+      local ni = load():launch(t)
+      local b = ni:b(trig)
+
+      for _=1,ITER/10 do b:do_step() end
+
+      local t0 = ubx.clock_mono_gettime()
+      for _=1,ITER do b:do_step() end
+      local dur = (ubx.clock_mono_gettime() - t0) / ITER * 1e9
+
+      ubx.node_rm(ni)
+      print(fmt("%-24s %-12s %10.1f ns/step", what, m.name, dur))
+   end
+end
+
+bench("deep_composition",
+      function() return bd.load("examples/usc/composition/deep_composition.usc") end,
+      "trig")
+
+bench(fmt("cconst+math_double x%d [%d]", NUM_BLOCKS, DATA_LEN), pipeline, "trig")
@@ -0,0 +1,61 @@
+-- Throughput benchmark of the math_double functions
+--
+-- usage: luajit tests/bench_math_double.lua [ITERATIONS] [DATA_LEN]
+--
+-- Each function is run with the vectorized kernel (if any) and with
+-- libm (simd=0). The time per element includes the port read and
+-- write. This is not run by run_tests.sh.
+
+local ubx = require("ubx")
+local u = require("utils")
+local bd = require("blockdiagram")
+local ffi = require("ffi")
+
+local ITER = tonumber(arg[1]) or 10000
+local DATA_LEN = tonumber(arg[2]) or 1024
+
+local FUNCS = {
+   "sin", "cos", "tan", "exp", "log", "sqrt", "fabs",
+   "floor", "ceil", "trunc", "round", "rint", "nearbyint"
+}
+
+local x = {}
+for i=1,DATA_LEN do x[i] = (i / DATA_LEN) * 10 end
+
+local function bench(func, simd)
+   local sys = bd.system {
+      imports = { "stdtypes", "lfds_cyclic", "math_double" },
+      blocks = { { name = "math1", type = "ubx/math_double" } },
+      configurations = {
+	 { name = "math1", config = {
+	      func = func, data_len = DATA_LEN, simd = simd,
+	      mul = u.fill(2, DATA_LEN), add = u.fill(1, DATA_LEN) } }
+      },
+   }
+
+   local ni = sys:launch({ nodename = "bench", loglevel = ffi.C.UBX_LOGLEVEL_WARN })
+   local math1 = ni:b("math1")
+   local pin = ubx.port_clone_conn(math1, "x", 1, nil, -1, 0)
+   local pout = ubx.port_clone_conn(math1, "y", nil, 1, -1, 0)
+   local wd = ubx.port_alloc_write_sample(pin)
+   local rd = ubx.port_alloc_read_sample(pout)
+   wd:set(x)
+
+   local t0 = ubx.clock_mono_gettime()
+   for _=1,ITER do
+      ubx.port_write(pin, wd)
+      math1:do_step()
+      ubx.port_read(pout, rd)
+   end
+   local dur = ubx.clock_mono_gettime() - t0
+
+   ubx.node_rm(ni)
+   return dur / (ITER * DATA_LEN) * 1e9
+end
+
+print(string.format("%-12s %12s %12s %8s", "func", "simd ns/el", "libm ns/el", "speedup"))
+
+for _,func in ipairs(FUNCS) do
+   local tv, ts = bench(func, 1), bench(func, 0)
+   print(string.format("%-12s %12.2f %12.2f %7.1fx", func, tv, ts, ts / tv))
+end
@@ -0,0 +1,120 @@
+-- Cost of remote NUMA placement of triggered blocks and their iblocks
+--
+-- usage: luajit tests/bench_numa.lua [DURATION_S] [NUM_BLOCKS] [DATA_LEN]
+--
+-- Runs a ptrig pinned to the first CPU of node 0 that triggers a
+-- cconst and NUM_BLOCKS math_double blocks of DATA_LEN, each
+-- connected to the next. The private data of the blocks and the
+-- lfds_cyclic buffers between them are placed on the local node 0
+-- and on each remote node via the ptrig numa_node config. Reports
+-- the average duration of a chain trigger from the ptrig tstats.
+-- Requires a machine with at least two NUMA nodes. This is not run
+-- by run_tests.sh.
+
+local ubx = require("ubx")
+local u = require("utils")
+local bd = require("blockdiagram")
+local ffi = require("ffi")
+
+local fmt = string.format
+
+local DURATION = tonumber(arg[1]) or 5
+local NUM_BLOCKS = tonumber(arg[2]) or 8
+local DATA_LEN = tonumber(arg[3]) or 4096
+local PERIOD_US = 1000
+
+local function read_file(path)
+   local f = io.open(path, "r")
+   if not f then return nil end
+   local s = f:read("*a")
+   f:close()
+   return s
+end
+
+local function num_nodes()
+   local possible = read_file("/sys/devices/system/node/possible") or "0"
+   return tonumber(string.match(possible, "(%d+)$")) + 1
+end
+
+local function first_cpu(node)
+   local cpus = read_file(fmt("/sys/devices/system/node/node%d/cpulist", node))
+   return cpus and tonumber(string.match(cpus, "^(%d+)"))
+end
+
+local function make_sys(cpu, node)
+   local blocks = {
+      { name = "trig", type = "ubx/ptrig" },
+      { name = "c", type = "ubx/cconst" },
+   }
+   local configs = {
+      { name = "c", config = { type_name = "double", data_len = DATA_LEN,
+			       value = u.fill(-1, DATA_LEN) } },
+   }
+   local conns, chain = {}, { { b = "#c" } }
+   local prev = "c.out"
+
+   for i=1,NUM_BLOCKS do
+      local name = "m"..i
+      blocks[#blocks+1] = { name = name, type = "ubx/math_double" }
+      configs[#configs+1] = { name = name, config = { func = "fabs", data_len = DATA_LEN } }
+      conns[#conns+1] = { src = prev, tgt = name..".x" }
+      chain[#chain+1] = { b = "#"..name }
+      prev = name..".y"
+   end
+
+   configs[#configs+1] = {
+      name = "trig", config = { period = { sec = 0, usec = PERIOD_US },
+				affinity = { cpu },
+				numa_node = node,
+				tstats_mode = 1,
+				chain0 = chain } }
+
+   return bd.system {
+      imports = { "stdtypes", "lfds_cyclic", "ptrig", "cconst", "math_double" },
+      blocks = blocks,
+      configurations = configs,
+      connections = conns,
+   }
+end
+
+-- run and return the average chain duration in us
+local function bench(cpu, node)
+   local sys = make_sys(cpu, node)
+   local ni = sys:launch({ nodename = "bench", nostart = true,
+			   loglevel = ffi.C.UBX_LOGLEVEL_INFO })
+   local p_tstats = ubx.port_clone_conn(ni:b("trig"), "tstats", 4)
+
+   sys:startup(ni)
+   ubx.clock_mono_sleep(DURATION)
+   ni:b("trig"):do_stop()
+
+   local ts
+   while true do
+      local cnt, res = p_tstats:read()
+      if cnt <= 0 then break end
+      ts = res:tolua()
+   end
+
+   ubx.node_rm(ni)
+
+   local total_us = ts.total.sec * 1e6 + ts.total.nsec / 1e3
+   return total_us / ts.cnt, ts.cnt
+end
+
+local nodes = num_nodes()
+local cpu = first_cpu(0)
+
+if nodes < 2 or not cpu then
+   print(fmt("bench_numa: need at least 2 NUMA nodes, found %d", nodes))
+   os.exit(0)
+end
+
+print(fmt("ptrig on cpu %d (node 0), %d x math_double [%d]", cpu, NUM_BLOCKS, DATA_LEN))
+
+for node=0,nodes-1 do
+   if first_cpu(node) then
+      local avg, cnt = bench(cpu, node)
+      print(fmt("data on node %d %-8s %10.2f us/cycle (%d cycles)",
+		node, node == 0 and "(local)" or "(remote)", avg, cnt))
+   end
+end
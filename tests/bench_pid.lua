@@ -0,0 +1,54 @@
+-- Per channel cost of the PID block
+--
+-- usage: luajit tests/bench_pid.lua [ITERATIONS] [DATA_LEN]
+--
+-- Runs the PID with and without output limits. The time per step
+-- includes the port reads and write. This is not run by run_tests.sh.
+
+local ubx = require("ubx")
+local u = require("utils")
+local bd = require("blockdiagram")
+local ffi = require("ffi")
+
+local ITER = tonumber(arg[1]) or 100000
+local DATA_LEN = tonumber(arg[2]) or 2000
+
+local function bench(name, config)
+   config.data_len = DATA_LEN
+   config.Kp = u.fill(1.2, DATA_LEN)
+   config.Ki = u.fill(0.1, DATA_LEN)
+   config.Kd = u.fill(0.01, DATA_LEN)
+
+   local sys = bd.system {
+      imports = { "stdtypes", "lfds_cyclic", "pid" },
+      blocks = { { name = "pid1", type = "ubx/pid" } },
+      configurations = { { name = "pid1", config = config } },
+   }
+
+   local ni = sys:launch({ nodename = "bench", loglevel = ffi.C.UBX_LOGLEVEL_WARN })
+   local pid1 = ni:b("pid1")
+   local pmsr = ubx.port_clone_conn(pid1, "msr", 1, nil, -1, 0)
+   local pdes = ubx.port_clone_conn(pid1, "des", 1, nil, -1, 0)
+   local pout = ubx.port_clone_conn(pid1, "out", nil, 1, -1, 0)
+   local wmsr = ubx.port_alloc_write_sample(pmsr)
+   local wdes = ubx.port_alloc_write_sample(pdes)
+   local rd = ubx.port_alloc_read_sample(pout)
+   wmsr:set(u.fill(0.5, DATA_LEN))
+   wdes:set(u.fill(1, DATA_LEN))
+
+   local t0 = ubx.clock_mono_gettime()
+   for _=1,ITER do
+      ubx.port_write(pmsr, wmsr)
+      ubx.port_write(pdes, wdes)
+      pid1:do_step()
+      ubx.port_read(pout, rd)
+   end
+   local dur = (ubx.clock_mono_gettime() - t0) / ITER * 1e9
+
+   ubx.node_rm(ni)
+   print(string.format("%-16s %8d channels %10.1f ns/step %8.3f ns/channel",
+		       name, DATA_LEN, dur, dur / DATA_LEN))
+end
+
+bench("unlimited", {})
+bench("limited", { out_min = u.fill(-1, DATA_LEN), out_max = u.fill(1, DATA_LEN) })
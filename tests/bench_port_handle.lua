@@ -0,0 +1,77 @@
+-- Benchmark of port access via port handles vs. port_read/port_write
+--
+-- usage: luajit tests/bench_port_handle.lua [ITERATIONS] [DATA_LEN]
+--
+-- This is not run by run_tests.sh.
+
+local ubx = require("ubx")
+local u = require("utils")
+local bd = require("blockdiagram")
+local ffi = require("ffi")
+
+local ITER = tonumber(arg[1]) or 1000000
+local DATA_LEN = tonumber(arg[2]) or 6
+
+local sys = bd.system {
+   imports = { "stdtypes", "lfds_cyclic", "saturation_double" },
+   blocks = { { name = "sat1", type = "ubx/saturation_double" } },
+   configurations = {
+      { name = "sat1", config = {
+	   data_len = DATA_LEN,
+	   lower_limits = u.fill(-1, DATA_LEN),
+	   upper_limits = u.fill(1, DATA_LEN), } }
+   },
+}
+
+local ni = sys:launch({ nodename = "bench", loglevel = ffi.C.UBX_LOGLEVEL_WARN })
+local sat1 = ni:b("sat1")
+local pout = ubx.port_clone_conn(sat1, "in", 1, nil, -1, 0)
+local pin = sat1:p("in")
+local val = u.fill(0.5, DATA_LEN)
+
+-- run fn ITER times and print the duration and Lua heap growth
+local function bench(name, fn)
+   collectgarbage("collect")
+   collectgarbage("stop")
+   local mem0 = collectgarbage("count")
+   local t0 = ubx.clock_mono_gettime()
+   fn()
+   local t1 = ubx.clock_mono_gettime()
+   local mem1 = collectgarbage("count")
+   collectgarbage("restart")
+   local dur = t1 - t0
+   print(string.format("%-28s %8.3f s  %8.1f ns/iter  %10.1f KiB garbage",
+		       name, dur, dur / ITER * 1e9, mem1 - mem0))
+end
+
+bench("port_write/port_read", function()
+	 for _=1,ITER do
+	    ubx.port_write(pout, val)
+	    local _, d = ubx.port_read(pin)
+	    local _ = d:tolua()
+	 end
+end)
+
+bench("port_write/port_read sample", function()
+	 local wd = ubx.port_alloc_write_sample(pout)
+	 local rd = ubx.port_alloc_read_sample(pin)
+	 for _=1,ITER do
+	    wd:set(val)
+	    ubx.port_write(pout, wd)
+	    ubx.port_read(pin, rd)
+	    local _ = rd:tolua()
+	 end
+end)
+
+bench("port_handle", function()
+	 local hw = ubx.port_handle(pout)
+	 local hr = ubx.port_handle(pin)
+	 local sum = 0
+	 for _=1,ITER do
+	    hw:write(val)
+	    local len, v = hr:read()
+	    for i=0,len-1 do sum = sum + v[i] end
+	 end
+end)
+
+ubx.node_rm(ni)
@@ -0,0 +1,60 @@
+-- Throughput benchmark of the saturation blocks
+--
+-- usage: luajit tests/bench_saturation.lua [ITERATIONS]
+--
+-- Runs each saturation type for several data lengths. The time per
+-- step includes the port read and write. This is not run by
+-- run_tests.sh.
+
+local ubx = require("ubx")
+local u = require("utils")
+local bd = require("blockdiagram")
+local ffi = require("ffi")
+
+local ITER = tonumber(arg[1]) or 100000
+
+local TYPES = { "float", "double", "int32", "int64" }
+local DATA_LENS = { 1, 8, 64, 512, 4096 }
+
+local function bench(t, data_len)
+   local sys = bd.system {
+      imports = { "stdtypes", "lfds_cyclic", "saturation_"..t },
+      blocks = { { name = "sat1", type = "ubx/saturation_"..t } },
+      configurations = {
+	 { name = "sat1", config = {
+	      data_len = data_len,
+	      lower_limits = u.fill(-10, data_len),
+	      upper_limits = u.fill(10, data_len) } }
+      },
+   }
+
+   local ni = sys:launch({ nodename = "bench", loglevel = ffi.C.UBX_LOGLEVEL_WARN })
+   local sat1 = ni:b("sat1")
+   local pin = ubx.port_clone_conn(sat1, "in", 1, nil, -1, 0)
+   local pout = ubx.port_clone_conn(sat1, "out", nil, 1, -1, 0)
+   local wd = ubx.port_alloc_write_sample(pin)
+   local rd = ubx.port_alloc_read_sample(pout)
+   local val = {}
+   for i=1,data_len do val[i] = (i % 40) - 20 end
+   wd:set(val)
+
+   local t0 = ubx.clock_mono_gettime()
+   for _=1,ITER do
+      ubx.port_write(pin, wd)
+      sat1:do_step()
+      ubx.port_read(pout, rd)
+   end
+   local dur = ubx.clock_mono_gettime() - t0
+
+   ubx.node_rm(ni)
+   return dur / ITER * 1e9
+end
+
+print(string.format("%-8s %8s %12s %12s", "type", "data_len", "ns/step", "ns/element"))
+
+for _,t in ipairs(TYPES) do
+   for _,len in ipairs(DATA_LENS) do
+      local ns = bench(t, len)
+      print(string.format("%-8s %8d %12.1f %12.3f", t, len, ns, ns / len))
+   end
+end
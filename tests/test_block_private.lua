@@ -0,0 +1,102 @@
+--
+-- Test the block private data allocation
+--
+
+local lu = require("luaunit")
+local ubx = require("ubx")
+local ffi = require("ffi")
+
+local assert_equals = lu.assert_equals
+local assert_true = lu.assert_true
+
+local nd = ubx.node_create("test_block_private", { loglevel = ffi.C.UBX_LOGLEVEL_WARN })
+
+ubx.load_module(nd, "stdtypes")
+ubx.load_module(nd, "random")
+
+local b
+
+local function is_zero(p, size)
+   local bp = ffi.cast("uint8_t*", p)
+   for i=0,size-1 do
+      if bp[i] ~= 0 then return false end
+   end
+   return true
+end
+
+TestBlockPrivate = {}
+
+function TestBlockPrivate:setup()
+   b = ubx.block_create(nd, "ubx/random", "b1")
+end
+
+function TestBlockPrivate:teardown()
+   if b then ubx.block_rm(nd, "b1") end
+   b = nil
+end
+
+function TestBlockPrivate:TestAllocFree()
+   local p1 = ubx.block_alloc_private(b, 100)
+   local p2 = ubx.block_alloc_private(b, 4096)
+   lu.assert_not_nil(p1)
+   lu.assert_not_nil(p2)
+   assert_equals(tonumber(ffi.cast("uintptr_t", p1)) % ffi.C.UBX_CACHELINE_SIZE, 0)
+   assert_equals(tonumber(ffi.cast("uintptr_t", p2)) % ffi.C.UBX_CACHELINE_SIZE, 0)
+   assert_true(is_zero(p1, 100))
+   assert_true(is_zero(p2, 4096))
+   ffi.fill(p1, 100, 0xff)
+
+   ubx.block_free_private(b, p1)
+   assert_true(b.priv_allocs ~= nil)
+   ubx.block_free_private(b, p2)
+   assert_true(b.priv_allocs == nil)
+
+   -- NULL is ignored
+   ubx.block_free_private(b, nil)
+end
+
+-- allocations not freed by the block are freed with a warning
+function TestBlockPrivate:TestFreeOnRemove()
+   local warnings = {}
+   local log_orig = nd.log
+   local log = ffi.cast("void (*)(const struct ubx_node*, const struct ubx_log_msg*)",
+			function(_, msg)
+			   local s = ffi.string(msg.msg)
+			   if s:find("block b1: private data", 1, true) then
+			      warnings[#warnings+1] = s
+			   end
+			end)
+
+   lu.assert_not_nil(ubx.block_alloc_private(b, 100))
+   lu.assert_not_nil(ubx.block_alloc_private(b, 200))
+
+   nd.log = log
+   local ret = ubx.block_rm(nd, "b1")
+   nd.log = log_orig
+   log:free()
+   b = nil
+
+   assert_equals(ret, 0)
+   assert_equals(#warnings, 2)
+end
+
+-- migrating is a no-op on single node systems
+function TestBlockPrivate:TestMigrate()
+   local p = ffi.cast("uint32_t*", ubx.block_alloc_private(b, 64))
+   p[0] = 0xdeadbeef
+
+   local ret = tonumber(ubx.block_migrate_private(b, 0))
+
+   if ubx.numa_num_nodes() == 1 then
+      assert_equals(ret, 0)
+   else
+      assert_true(ret >= 0)
+   end
+
+   assert_equals(p[0], 0xdeadbeef)
+   ubx.block_free_private(b, p)
+end
+
+local ret = lu.LuaUnit.run()
+ubx.node_rm(nd)
+os.exit(ret)
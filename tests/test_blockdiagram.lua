@@ -2,6 +2,7 @@ local luaunit=require("luaunit")
 local utils=require("utils")
 local ubx=require("ubx")
 local bd = require("blockdiagram")
+local ffi = require("ffi")
 
 ubx.color=false
 
@@ -76,6 +77,183 @@ function test_launch()
    ubx.node_cleanup(nd)
 end
 
+--- Test that a profiled launch reports all phases
+function test_launch_profile()
+   local nd, prof = sys1:launch{ nodename="sys1_prof", nostart=true, profile=true }
+   assert_not_nil(nd)
+   local phases = {}
+   for _,p in ipairs(prof) do
+      phases[#phases+1] = p.phase
+      luaunit.assert_true(p.dur >= 0)
+   end
+   assert_equals(phases, { "validate", "index", "node_create", "import",
+			   "create", "nodecfg", "preproc", "configure", "init",
+			   "reconfigure", "connect", "checks" })
+   ubx.node_cleanup(nd)
+end
+
+--- Test compiling a system and launching the compiled model
+function test_compile()
+   local model = sys1:compile()
+   local nd, err = bd.launch_compiled(model, { nodename="sys1_compiled", nostart=true })
+   assert_not_nil(nd or nil, err)
+
+   for i=1,NUM_BLOCKS do
+      local r = ubx.block_get(nd, "uint32_ramp"..tostring(i))
+      local c = ubx.config_get(r, "slope")
+      assert_equals(ubx.data_tolua(c.value), 1)
+
+      local p = ubx.port_get(ubx.block_get(nd, "sink"..tostring(i)), "in")
+      luaunit.assert_true(p.in_interaction ~= nil and p.in_interaction[0] ~= nil)
+   end
+   ubx.node_cleanup(nd)
+end
+
+--- Test that block refs in compiled configs are relocated
+function test_compile_block_hash()
+   local sys = bd.system {
+      imports = { "stdtypes", "ramp_int32", "trig" },
+      blocks = {
+	 { name = "r1", type = "ubx/ramp_int32" },
+	 { name = "t1", type = "ubx/trig" }
+      },
+      node_configurations = { foo = { type="int32_t", config = 33 } },
+      configurations = {
+	 { name = "r1", config = { start=0, slope="&foo" } },
+	 { name="t1",
+	    config = {
+	       chain0 = {
+		  { b="#r1", num_steps=1, measure=0 } } } } } }
+
+   local nd, err = bd.launch_compiled(sys:compile(), { nodename="test_compile_block_hash",
+							 nostart=true })
+   assert_not_nil(nd or nil, err)
+
+   local r1 = ubx.block_get(nd, "r1")
+   local chain0 = ubx.config_get(ubx.block_get(nd, "t1"), "chain0")
+   local trig = ffi.cast("struct ubx_triggee*", chain0.value.data)
+   luaunit.assert_true(trig[0].b == r1)
+   assert_equals(ubx.data_tolua(ubx.config_get(r1, "slope").value), 33)
+   ubx.node_cleanup(nd)
+end
+
+--- Test that a compiled model with a changed source file is rejected
+function test_compile_stale()
+   local fn = os.tmpname()
+   local f = assert(io.open(fn, "w"))
+   f:write("-- v1")
+   f:close()
+
+   local model = sys1:compile{ deps = { fn } }
+
+   f = assert(io.open(fn, "w"))
+   f:write("-- v2")
+   f:close()
+
+   local nd, err = bd.launch_compiled(model, { nodename="test_compile_stale" })
+   os.remove(fn)
+   assert_equals(nd, false)
+   assert_equals(err, "source file "..fn.." changed")
+end
+
+--- Test that truncated and corrupted models are rejected
+local model_sections = {
+   { "num_deps", "struct ubx_model_dep" }, { "num_modules", "uint32_t" },
+   { "num_blocks", "struct ubx_model_block" }, { "num_ndcfgs", "struct ubx_model_ndcfg" },
+   { "num_configs", "struct ubx_model_config" }, { "num_relocs", "struct ubx_model_reloc" },
+   { "num_conns", "struct ubx_model_conn" },
+}
+
+local function model_align(n) return math.ceil(n / 8) * 8 end
+
+-- return a writable copy of model with len bytes and its header
+local function model_copy(model, len)
+   len = len or #model
+   local buf = ffi.new("uint8_t[?]", len)
+   ffi.copy(buf, model, math.min(len, #model))
+   return buf, ffi.cast("struct ubx_model_hdr*", buf)
+end
+
+-- return the offset of the section counted by num or of the strtab
+local function model_sec_off(hdr, num)
+   local off = model_align(ffi.sizeof("struct ubx_model_hdr"))
+   for _,sec in ipairs(model_sections) do
+      if sec[1] == num then return off end
+      off = model_align(off + hdr[sec[1]] * ffi.sizeof(sec[2]))
+   end
+   return off
+end
+
+local function model_open(buf, len)
+   return ubx.model_open(ffi.new("struct ubx_model"), buf, len)
+end
+
+function test_compile_corrupt()
+   local model = sys1:compile()
+   local buf, hdr
+
+   assert_equals(model_open(model, #model), 0)
+
+   -- truncated
+   for _,len in ipairs{ 0, 8, ffi.sizeof("struct ubx_model_hdr"),
+			   math.floor(#model / 2), #model - 1 } do
+      assert_equals(model_open(model, len), ffi.C.EINVALID_ARG)
+      buf, hdr = model_copy(model, len)
+      if len >= ffi.sizeof("struct ubx_model_hdr") then hdr.size = len end
+      assert_equals(model_open(buf, len), ffi.C.EINVALID_ARG)
+      assert_equals(bd.launch_compiled(ffi.string(buf, len),
+				       { nodename="test_compile_corrupt" }), false)
+   end
+
+   -- corrupted header fields
+   local corrupt = {
+      function(h) h.magic = h.magic + 1 end,
+      function(h) h.num_blocks = 0xffffffff end,
+      function(h) h.num_configs = h.num_configs + 1000 end,
+      function(h) h.strtab_len = 0xffffffff end,
+      function(h) h.blob_len = h.blob_len + 1 end,
+      function(h) h.blob_len = 0ULL - 1 end,
+   }
+
+   for _,fun in ipairs(corrupt) do
+      buf, hdr = model_copy(model)
+      fun(hdr)
+      assert_equals(model_open(buf, #model), ffi.C.EINVALID_ARG)
+   end
+
+   -- strtab ending unaligned at the end of the model and a blob_len
+   -- for which the blob offset plus blob_len wraps around to the size
+   buf, hdr = model_copy(model)
+   local off = model_sec_off(hdr)
+   local pad = (off + hdr.strtab_len) % 8 == 0 and 1 or 0
+   local len = off + hdr.strtab_len + pad
+   buf, hdr = model_copy(model, len)
+   hdr.strtab_len = hdr.strtab_len + pad
+   hdr.size = len
+   hdr.blob_len = 0ULL - (model_align(len) - len)
+   assert_equals(model_open(buf, len), ffi.C.EINVALID_ARG)
+
+   -- reloc offsets beyond the config value, including one for which
+   -- offset plus the pointer size wraps around
+   local sys_reloc = bd.system {
+      imports = { "stdtypes", "ramp_int32", "trig" },
+      blocks = {
+	 { name = "r1", type = "ubx/ramp_int32" },
+	 { name = "t1", type = "ubx/trig" } },
+      configurations = {
+	 { name = "t1", config = { chain0 = { { b="#r1" } } } } } }
+
+   model = sys_reloc:compile()
+   assert_equals(model_open(model, #model), 0)
+
+   for _,roff in ipairs{ 1000000ULL, 0ULL - 1, 0ULL - 4 } do
+      buf, hdr = model_copy(model)
+      luaunit.assert_true(hdr.num_relocs > 0)
+      local relocs = ffi.cast("struct ubx_model_reloc*", buf + model_sec_off(hdr, "num_relocs"))
+      relocs[0].offset = roff
+      assert_equals(model_open(buf, #model), ffi.C.EINVALID_ARG)
+   end
+end
 
 --- Test resolving a node config
 local sys_ndcfg_res = bd.system {
@@ -13,6 +13,7 @@ local assert_true = lu.assert_true
 local assert_false = lu.assert_false
 local assert_equals = lu.assert_equals
 local assert_not_equals = lu.assert_not_equals
+local assert_error_msg_contains = lu.assert_error_msg_contains
 
 local nd=ubx.node_create("cdata_tolua_test")
 
@@ -148,4 +149,67 @@ function test_void_pointer_to_prim()
    assert_equals(init, val, "L: mismatch after converting from cdata")
 end
 
+function test_gen_tolua_frame()
+   local init = {
+      M={ data = { 1, 0, 0, 0, 1, 0, 0, 0, 1 } },
+      p={ x=1.2, y=2.2, z=3.2 }
+   }
+   local f1 = ffi.new("struct kdl_frame", init)
+   local tolua = cdata.gen_tolua(ffi.typeof("struct kdl_frame"))
+   assert_equals(tolua(f1), cdata.tolua(f1))
+   assert_true(utils.table_cmp(tolua(f1), init), "gen_tolua frame roundtrip failed")
+end
+
+function test_gen_tolua_char()
+   local init = { name="Frodo Baggins", benchmark=993 }
+   local c = ffi.new("struct test_trig_conf", init)
+   local tolua = cdata.gen_tolua(ffi.typeof("struct test_trig_conf"))
+   assert_equals(tolua(c), init)
+end
+
+function test_gen_set_frame()
+   local set = cdata.gen_set(ffi.typeof("struct kdl_frame"))
+   local f = ffi.new("struct kdl_frame[1]")
+   local init = {
+      M={ data = { 1, 2, 3, 4, 5, 6, 7, 8, 9 } },
+      p={ x=1.2, y=2.2, z=3.2 }
+   }
+
+   set(f, init)
+   assert_equals(cdata.tolua(f[0]), init)
+
+   -- missing fields are zeroed like with the ffi table initializers
+   set(f, { p = { y=5 } })
+   assert_equals(cdata.tolua(f[0]), cdata.tolua(ffi.new("struct kdl_frame", { p = { y=5 } })))
+
+   -- positional tables are assigned natively
+   set(f, { { 1, 2, 3 } })
+   assert_equals(cdata.tolua(f[0].p), { x=1, y=2, z=3 })
+
+   assert_equals(cdata.gen_set(ffi.typeof("double")), nil)
+end
+
+function test_gen_set_unknown_member()
+   local set = cdata.gen_set(ffi.typeof("struct kdl_frame"))
+   local f = ffi.new("struct kdl_frame[1]")
+
+   assert_error_msg_contains("no member named 'q'", set, f, { q = { x=1 } })
+end
+
+function test_ubx_data_frame_arr()
+   local d = ubx.data_alloc(nd, "struct kdl_frame", 1)
+   local init = {}
+   for i=1,10 do
+      init[i] = { M={ data = { i, 0, 0, 0, i, 0, 0, 0, i } }, p={ x=i, y=-i, z=i*2 } }
+   end
+   ubx.data_set(d, init, true)
+   assert_equals(#d, 10)
+   assert_equals(ubx.data_tolua(d), init)
+
+   -- assigning a single element zeroes its missing fields
+   ubx.data_set(d, { [3] = { p = { x=33 } } })
+   init[3] = { M={ data = { 0, 0, 0, 0, 0, 0, 0, 0, 0 } }, p={ x=33, y=0, z=0 } }
+   assert_equals(ubx.data_tolua(d), init)
+end
+
 os.exit( lu.LuaUnit.run() )
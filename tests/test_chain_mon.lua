@@ -0,0 +1,115 @@
+local lu = require("luaunit")
+local ubx = require("ubx")
+local bd = require("blockdiagram")
+local ffi = require("ffi")
+local cdata = require("cdata")
+
+local LOGLEVEL = ffi.C.UBX_LOGLEVEL_INFO
+local WEBIF_PORT = "8897"
+local NUM_STEPS = 10
+
+ffi.cdef [[
+typedef void (*ubx_chain_mon_fn)(const ubx_block_t *b,
+				 const struct ubx_tstat *global,
+				 const struct ubx_tstat *blk,
+				 long len, void *arg);
+int ubx_chain_mon_foreach(const ubx_node_t *nd, ubx_chain_mon_fn fn, void *arg);
+]]
+
+local sys = bd.system {
+   imports = { "stdtypes", "lfds_cyclic", "trig", "cconst" },
+   blocks = {
+      { name = "c0", type = "ubx/cconst" },
+      { name = "c1", type = "ubx/cconst" },
+      { name = "trig", type = "ubx/trig" },
+   },
+   configurations = {
+      { name = "c0", config = { type_name = "int", value = 0 } },
+      { name = "c1", config = { type_name = "int", value = 1 } },
+      { name = "trig", config = { tstats_mode = 2,
+				  chain0 = { { b = "#c0" }, { b = "#c1" } } } },
+   },
+}
+
+-- read the monitoring snapshots via the seqlock
+local function mon_read(nd)
+   local res = {}
+   local cb = ffi.cast("ubx_chain_mon_fn",
+		      function(b, global, blk, len)
+			 local r = { block = ubx.safe_tostr(b.name),
+				     global = cdata.tolua(global[0]), blocks = {} }
+			 for i=0,tonumber(len)-1 do r.blocks[i+1] = cdata.tolua(blk[i]) end
+			 res[#res+1] = r
+		      end)
+   local cnt = ubx.ubx.ubx_chain_mon_foreach(nd, cb, nil)
+   cb:free()
+   return cnt, res
+end
+
+-- step the chain NUM_STEPS times and once more after the
+-- publishing period has passed
+local function step_chain(trig)
+   for _=1,NUM_STEPS-1 do trig:do_step() end
+   ubx.clock_mono_sleep(0, 50 * 1000^2)
+   trig:do_step()
+end
+
+local ni
+
+TestChainMon = {}
+
+function TestChainMon:teardown()
+   if ni then ubx.node_rm(ni) end
+   ni = nil
+end
+
+function TestChainMon:TestSnapshot()
+   ni = sys:launch{ loglevel = LOGLEVEL, nodename = "TestChainMon" }
+   step_chain(ni:b("trig"))
+
+   local cnt, res = mon_read(ni)
+   lu.assert_equals(cnt, 1)
+   lu.assert_equals(res[1].block, "trig")
+   lu.assert_equals(res[1].global.id, "chain0,#total#")
+   lu.assert_equals(tonumber(res[1].global.cnt), NUM_STEPS)
+   lu.assert_equals(#res[1].blocks, 2)
+   lu.assert_equals(res[1].blocks[1].id, "chain0,c0")
+   lu.assert_equals(res[1].blocks[2].id, "chain0,c1")
+   lu.assert_equals(tonumber(res[1].blocks[2].cnt), NUM_STEPS)
+
+   -- chains are unregistered on cleanup
+   ni:b("trig"):do_stop()
+   ni:b("trig"):do_cleanup()
+   cnt = mon_read(ni)
+   lu.assert_equals(cnt, 0)
+end
+
+function TestChainMon:TestJson()
+   local curl = io.popen("command -v curl"):read("*l")
+
+   if not curl then
+      print("curl not found, skipping /mon test")
+      return
+   end
+
+   ni = sys:launch{ loglevel = LOGLEVEL, nodename = "TestChainMonJson" }
+   ubx.load_module(ni, "webif")
+   local webif = ubx.block_create(ni, "ubx/webif", "webif1", { port = WEBIF_PORT })
+   lu.assert_equals(ubx.block_init(webif), 0)
+   lu.assert_equals(ubx.block_start(webif), 0)
+
+   step_chain(ni:b("trig"))
+
+   local f = io.popen(curl.." -s -m 5 http://127.0.0.1:"..WEBIF_PORT.."/mon")
+   local json = f:read("*a")
+   f:close()
+
+   lu.assert_str_contains(json, '{"node":"TestChainMonJson"')
+   lu.assert_str_contains(json, '{"name":"c0","state":"active","steps":'..NUM_STEPS..'}')
+   lu.assert_str_contains(json, '"chains":[{"block":"trig","global":{"id":"chain0,#total#","cnt":'..NUM_STEPS..',')
+   lu.assert_str_contains(json, '{"id":"chain0,c1","cnt":'..NUM_STEPS..',')
+
+   ubx.block_stop(webif)
+end
+
+os.exit( lu.LuaUnit.run() )
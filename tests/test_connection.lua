@@ -154,4 +154,134 @@ function TestConnection:Test_04_MQNonExisting()
    lu.assert_equals(conntab_act, conntab_exp)
 end
 
+function TestConnection:Test_05_Arena()
+   local DATA_LEN = 3
+   local NUM_TGT = 5 -- more than the reserved arena slots
+   local blocks = { { name = "src", type = "ubx/saturation_double" } }
+   local configs = {}
+   local conns = {}
+
+   for i=1,NUM_TGT do
+      blocks[#blocks+1] = { name = "sat"..i, type = "ubx/saturation_double" }
+      conns[#conns+1] = { src="src.out", tgt="sat"..i..".in" }
+   end
+
+   for _,b in ipairs(blocks) do
+      configs[#configs+1] = { name = b.name, config = {
+				 data_len=DATA_LEN,
+				 lower_limits = u.fill(-1, DATA_LEN),
+				 upper_limits = u.fill(1, DATA_LEN), } }
+   end
+
+   local sys = bd.system {
+      imports = { "stdtypes", "lfds_cyclic", "saturation_double" },
+      blocks = blocks,
+      configurations = configs,
+      connections = conns,
+   }
+
+   local num_err = sys:validate(CHECK_VERBOSE)
+   lu.assert_equals(num_err, 0)
+   ni = sys:launch({nodename = "Arena", loglevel=LOGLEVEL, arena=true })
+   lu.assert_not_nil(ni);
+   lu.assert_true(ni.arena.base ~= nil)
+   lu.assert_true(tonumber(ni.arena.used) > 0)
+
+   local conntab = ubx.build_conntab(ni)
+   lu.assert_equals(conntab.src[2].out.outgoing,
+		    { "i_00000001", "i_00000002", "i_00000003", "i_00000004", "i_00000005" })
+   lu.assert_equals(conntab.sat5[1]['in'].incoming, { "i_00000005" })
+end
+
+function TestConnection:Test_06_PortHandle()
+   local DATA_LEN = 3
+   local sys = bd.system {
+      imports = { "stdtypes", "lfds_cyclic", "saturation_double" },
+      blocks = { { name = "sat1", type = "ubx/saturation_double" } },
+      configurations = {
+	 { name = "sat1", config = {
+	      data_len=DATA_LEN,
+	      lower_limits = u.fill(-1, DATA_LEN),
+	      upper_limits = u.fill(1, DATA_LEN), } }
+      },
+   }
+
+   lu.assert_equals(sys:validate(CHECK_VERBOSE), 0)
+   ni = sys:launch({nodename = "PortHandle", loglevel=LOGLEVEL })
+   lu.assert_not_nil(ni);
+
+   local sat1 = ni:b("sat1")
+   local pin = ubx.port_clone_conn(sat1, "in", 4, nil, 7, 1)
+   local pout = ubx.port_clone_conn(sat1, "out", nil, 4, 7, 1)
+
+   local hin = pin:handle()
+   local hout = ubx.port_handle(pout)
+   local hsat = sat1:port_handle("in")
+
+   lu.assert_nil(hin.rview)
+   lu.assert_nil(hout.wview)
+
+   -- nothing to read yet
+   lu.assert_equals(hout:read(), 0)
+
+   -- write a table and read it back via the block inport
+   hin:write({ 0.5, 2, -3 })
+   local len, val = hsat:read()
+   lu.assert_equals(len, DATA_LEN)
+   lu.assert_equals({ val[0], val[1], val[2] }, { 0.5, 2, -3 })
+
+   -- write the view contents directly, then step and read the output
+   hin.wview[0], hin.wview[1], hin.wview[2] = 3, -0.25, -7
+   hin:write()
+   sat1:do_step()
+   len, val = hout:read()
+   lu.assert_equals(len, DATA_LEN)
+   lu.assert_equals({ val[0], val[1], val[2] }, { 1, -0.25, -1 })
+
+   -- partial write
+   hin:write(0.75)
+   len, val = hsat:read()
+   lu.assert_equals(len, 1)
+   lu.assert_equals(val[0], 0.75)
+
+   lu.assert_error(hin.write, hin, { 1, 2, 3, 4 })
+end
+
+function TestConnection:Test_07_Verified()
+   local sys = bd.system {
+      imports = { "stdtypes", "lfds_cyclic", "saturation_double" },
+      blocks = {
+	 { name = "sat1", type = "ubx/saturation_double" },
+	 { name = "sat2", type = "ubx/saturation_double" }
+      },
+      configurations = {
+	 { name = "sat1", config = { data_len = 1, lower_limits = -1, upper_limits = 1 } },
+	 { name = "sat2", config = { data_len = 1, lower_limits = -1, upper_limits = 1 } },
+      },
+      connections = {
+	 { src="sat1.out", tgt="sat2.in" }
+      },
+   }
+
+   lu.assert_equals(sys:validate(CHECK_VERBOSE), 0)
+   ni = sys:launch({nodename = "Verified", loglevel=LOGLEVEL })
+   lu.assert_not_nil(ni);
+
+   local function verified(b, p)
+      return bit.band(ni:b(b):p(p).attrs, ffi.C.PORT_ATTR_VERIFIED) ~= 0
+   end
+
+   -- connected and unconnected ports are verified
+   lu.assert_true(verified("sat1", "out"))
+   lu.assert_true(verified("sat2", "in"))
+   lu.assert_true(verified("sat1", "in"))
+
+   -- ... and remain so after disconnecting
+   lu.assert_equals(ubx.ports_disconnect(ni:b("sat1"):p("out"),
+					 ni:b("sat2"):p("in"),
+					 ni:b("i_00000001")), 0)
+   lu.assert_true(verified("sat1", "out"))
+   lu.assert_true(verified("sat2", "in"))
+end
+
 os.exit( lu.LuaUnit.run() )
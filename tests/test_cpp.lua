@@ -0,0 +1,121 @@
+--
+-- Test the C++ block layer (ubx.hpp) using the ubx/cpptest block
+--
+-- The cpptest module is only built with --enable-cpp-demo, the tests
+-- are skipped otherwise.
+--
+
+local lu = require("luaunit")
+local ubx = require("ubx")
+local ffi = require("ffi")
+local bit = require("bit")
+
+local LOGLEVEL = ffi.C.UBX_LOGLEVEL_CRIT
+
+local nd = ubx.node_create("TestCpp", { loglevel = LOGLEVEL })
+ubx.load_module(nd, "stdtypes")
+ubx.load_module(nd, "lfds_cyclic")
+ubx.load_module(nd, "recorder")
+local have_cpp = pcall(ubx.load_module, nd, "cpptest")
+
+local rec_path = "/tmp/ubx_test_cpp_rec"
+local b
+local num_blocks = 0
+
+-- blocks are left to the final node_rm, as their ports are connected
+local function create(conf)
+   num_blocks = num_blocks + 1
+   b = ubx.block_create(nd, "ubx/cpptest", "cpp"..num_blocks, conf)
+   return b
+end
+
+TestCpp = {}
+
+-- step once with val on "in" and return the value read from "out"
+local function step(val)
+   local pin = ubx.port_clone_conn(b, "in", 1, nil, 7, 0)
+   local pout = ubx.port_clone_conn(b, "out", nil, 1, 7, 0)
+   pin:write(val)
+   b:do_step()
+   local len, res = pout:read()
+   lu.assert_equals(tonumber(len), 1)
+   return res:tolua()
+end
+
+function TestCpp:TestGainDefault()
+   create()
+   lu.assert_equals(ubx.block_tostate(b, 'active'), 0)
+   lu.assert_equals(step(3), 6)
+end
+
+function TestCpp:TestGain()
+   create({ gain = 3 })
+   lu.assert_equals(ubx.block_tostate(b, 'active'), 0)
+   lu.assert_equals(step(3), 9)
+end
+
+-- a port connected to an iblock without read hook is not verified,
+-- hence read must not take the fast path
+function TestCpp:TestUnverifiedPort()
+   local rec = ubx.block_create(nd, "ubx/recorder", "rec1",
+				{ path = rec_path, type_name = "double",
+				  segment_size = 4096, num_segments = 1 })
+   lu.assert_equals(ubx.block_tostate(rec, 'active'), 0)
+
+   create()
+   local p_in = ubx.port_get(b, "in")
+   lu.assert_equals(ubx.port_connect_in(p_in, rec), 0)
+   lu.assert_equals(bit.band(p_in.attrs, ffi.C.PORT_ATTR_VERIFIED), 0)
+
+   local pout = ubx.port_clone_conn(b, "out", nil, 1, 7, 0)
+   lu.assert_equals(ubx.block_tostate(b, 'active'), 0)
+   b:do_step()
+   lu.assert_equals(tonumber(pout:read()), 0)
+end
+
+-- exceptions in init and start must fail the transition
+function TestCpp:TestThrowCtor()
+   create({ throw_in = "ctor" })
+   lu.assert_not_equals(ubx.block_init(b), 0)
+   lu.assert_equals(b.block_state, ffi.C.BLOCK_STATE_PREINIT)
+end
+
+function TestCpp:TestThrowInit()
+   create({ throw_in = "init" })
+   lu.assert_not_equals(ubx.block_init(b), 0)
+   lu.assert_equals(b.block_state, ffi.C.BLOCK_STATE_PREINIT)
+end
+
+function TestCpp:TestThrowStart()
+   create({ throw_in = "start" })
+   lu.assert_equals(ubx.block_init(b), 0)
+   lu.assert_not_equals(ubx.block_start(b), 0)
+   lu.assert_equals(b.block_state, ffi.C.BLOCK_STATE_INACTIVE)
+end
+
+-- exceptions in the void hooks are logged and ignored
+function TestCpp:TestThrowStep()
+   create({ throw_in = "step" })
+   lu.assert_equals(ubx.block_tostate(b, 'active'), 0)
+   b:do_step()
+   lu.assert_equals(b.block_state, ffi.C.BLOCK_STATE_ACTIVE)
+end
+
+function TestCpp:TestThrowStopCleanup()
+   for _,hook in ipairs{ "stop", "cleanup" } do
+      create({ throw_in = hook })
+      lu.assert_equals(ubx.block_tostate(b, 'active'), 0)
+      lu.assert_equals(ubx.block_tostate(b, 'preinit'), 0)
+      lu.assert_equals(b.block_state, ffi.C.BLOCK_STATE_PREINIT)
+   end
+end
+
+if not have_cpp then
+   print("cpptest module not found, skipping C++ tests")
+   TestCpp = nil
+end
+
+local ret = lu.LuaUnit.run()
+ubx.node_rm(nd)
+os.remove(rec_path..".0000")
+os.exit(ret)
@@ -169,4 +169,38 @@ function test_data_resize()
    -- ubx.data_free(d)
 end
 
+function test_data_pool()
+   local pnd = ubx.node_create("data_pool_test", { pool=1024*1024 })
+   ubx.load_module(pnd, "stdtypes")
+   ubx.load_module(pnd, "testtypes")
+
+   local used0 = tonumber(pnd.pool.used)
+   local d = ubx.data_alloc(pnd, "double", 10)
+   -- one chunk for ubx_data_t and one for the data
+   assert_equals(tonumber(pnd.pool.used), used0 + 2)
+   lu.assert_true(ubx.ubx_pool_find(d) == pnd.pool)
+   lu.assert_true(ubx.ubx_pool_find(d.data) == pnd.pool)
+
+   ubx.data_set(d, { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10 })
+   assert_equals(ubx.data_tolua(d), { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10 })
+
+   -- grow beyond chunk size and check data was preserved
+   lu.assert_true(ubx.data_resize(d, 100))
+   assert_equals(tonumber(d.len), 100)
+   assert_equals(ffi.cast("double*", d.data)[9], 10)
+   assert_equals(tonumber(pnd.pool.used), used0 + 2)
+
+   -- oversized allocations fall back to the heap
+   local big = ubx.data_alloc(pnd, "char", 1024*1024)
+   lu.assert_true(ubx.ubx_pool_find(big.data) == nil)
+   lu.assert_true(tonumber(pnd.pool.num_fallbacks) > 0)
+
+   d = nil
+   big = nil
+   collectgarbage("collect")
+   assert_equals(tonumber(pnd.pool.used), used0)
+   lu.assert_true(tonumber(pnd.pool.cls[0].high_water) > 0)
+   ubx.node_rm(pnd)
+end
+
 os.exit( lu.LuaUnit.run() )
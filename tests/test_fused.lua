@@ -0,0 +1,169 @@
+local lu = require("luaunit")
+local ubx = require("ubx")
+local u = require("utils")
+local bd = require("blockdiagram")
+local ffi = require("ffi")
+
+local LOGLEVEL = ffi.C.UBX_LOGLEVEL_INFO
+local CHECK_VERBOSE = false
+local DATA_LEN = 13
+local NUM_STEPS = 50
+
+-- sin -> exp -> saturation -> log, the last one every second step. A
+-- new system is needed for each launch, as the launch replaces the
+-- #block references in the configs with block pointers.
+local function make_sys()
+   return bd.system {
+      imports = { "stdtypes", "lfds_cyclic", "trig", "math_double", "saturation_double" },
+      blocks = {
+	 { name = "trig", type = "ubx/trig" },
+	 { name = "m1", type = "ubx/math_double" },
+	 { name = "m2", type = "ubx/math_double" },
+	 { name = "sat", type = "ubx/saturation_double" },
+	 { name = "m3", type = "ubx/math_double" },
+      },
+      configurations = {
+	 { name = "m1", config = { func = "sin", data_len = DATA_LEN } },
+	 { name = "m2", config = { func = "exp", data_len = DATA_LEN, mul = u.fill(3, DATA_LEN) } },
+	 { name = "sat", config = { data_len = DATA_LEN,
+				    lower_limits = u.fill(0.5, DATA_LEN),
+				    upper_limits = u.fill(2.5, DATA_LEN) } },
+	 { name = "m3", config = { func = "log", data_len = DATA_LEN } },
+	 { name = "trig", config = { chain0 = {
+					{ b = "#m1" }, { b = "#m2" }, { b = "#sat" },
+					{ b = "#m3", every = 2 } } } },
+      },
+      connections = {
+	 { src = "m1.y", tgt = "m2.x" },
+	 { src = "m2.y", tgt = "sat.in" },
+	 { src = "sat.out", tgt = "m3.x" },
+      },
+   }
+end
+
+local ni
+
+TestFused = {}
+
+function TestFused:teardown()
+   if ni then ubx.node_rm(ni) end
+   ni = nil
+end
+
+local function in_iblock(b, pname)
+   local p = ubx.port_get(b, pname)
+   return ubx.block_prototype(p.in_interaction[0])
+end
+
+function TestFused:TestStructure()
+   local sys = make_sys()
+   lu.assert_equals(sys:validate(CHECK_VERBOSE), 0)
+   ni = sys:launch({ nodename = "TestFusedStructure", loglevel = LOGLEVEL,
+		     fuse = true, nostart = true })
+
+   local fused = ni:b("trig_chain0_fused1")
+   lu.assert_not_nil(fused)
+   lu.assert_equals(ubx.block_prototype(fused), "ubx/fused")
+
+   -- the fused block and m3
+   local chain0 = ubx.config_get(ni:b("trig"), "chain0")
+   lu.assert_equals(tonumber(chain0.value.len), 2)
+
+   local members = ubx.config_get(fused, "blocks")
+   lu.assert_equals(tonumber(members.value.len), 3)
+
+   lu.assert_equals(in_iblock(ni:b("m2"), "x"), "ubx/direct")
+   lu.assert_equals(in_iblock(ni:b("sat"), "in"), "ubx/direct")
+   lu.assert_equals(in_iblock(ni:b("m3"), "x"), "ubx/lfds_cyclic")
+end
+
+-- all connections are within the chain of trig
+function TestFused:TestElide()
+   ni = make_sys():launch({ nodename = "TestFusedElide", loglevel = LOGLEVEL,
+		     elide = true, nostart = true })
+
+   local roots = ubx.trigger_roots(ni)
+   lu.assert_equals(roots["m1"], "trig")
+   lu.assert_equals(roots["m3"], "trig")
+   lu.assert_equals(roots["trig"], "trig")
+
+   lu.assert_equals(in_iblock(ni:b("m2"), "x"), "ubx/direct")
+   lu.assert_equals(in_iblock(ni:b("sat"), "in"), "ubx/direct")
+   lu.assert_equals(in_iblock(ni:b("m3"), "x"), "ubx/direct")
+end
+
+-- blocks triggered by two triggers may run in different threads
+function TestFused:TestElideTwoTriggers()
+   local sys2 = bd.system {
+      imports = { "stdtypes", "lfds_cyclic", "trig", "math_double" },
+      blocks = {
+	 { name = "t1", type = "ubx/trig" },
+	 { name = "t2", type = "ubx/trig" },
+	 { name = "m1", type = "ubx/math_double" },
+	 { name = "m2", type = "ubx/math_double" },
+      },
+      configurations = {
+	 { name = "m1", config = { func = "sin" } },
+	 { name = "m2", config = { func = "cos" } },
+	 { name = "t1", config = { chain0 = { { b = "#m1" }, { b = "#m2" } } } },
+	 { name = "t2", config = { chain0 = { { b = "#m2" } } } },
+      },
+      connections = { { src = "m1.y", tgt = "m2.x" } },
+   }
+
+   ni = sys2:launch({ nodename = "TestFusedTwoTriggers", loglevel = LOGLEVEL,
+		      elide = true, nostart = true })
+
+   local roots = ubx.trigger_roots(ni)
+   lu.assert_equals(roots["m1"], "t1")
+   lu.assert_false(roots["m2"])
+   lu.assert_equals(in_iblock(ni:b("m2"), "x"), "ubx/lfds_cyclic")
+end
+
+-- run the system and return the outputs of sat and m3
+local function run(opts)
+   ni = make_sys():launch({ nodename = "TestFusedRun", loglevel = LOGLEVEL,
+		     fuse = opts.fuse, elide = opts.elide })
+
+   local trig = ni:b("trig")
+   local pin = ubx.port_clone_conn(ni:b("m1"), "x", 1, nil, 7, 0)
+   local psat = ubx.port_clone_conn(ni:b("sat"), "out", nil, 1, 7, 0)
+   local pm3 = ubx.port_clone_conn(ni:b("m3"), "y", nil, 1, 7, 0)
+   local res = { sat = {}, m3 = {} }
+
+   math.randomseed(7)
+
+   for i=1,NUM_STEPS do
+      local x = {}
+      for j=1,DATA_LEN do x[j] = (math.random() - 0.5) * 10 end
+      pin:write(x)
+      trig:do_step()
+
+      local len, val = psat:read()
+      lu.assert_equals(tonumber(len), DATA_LEN)
+      res.sat[i] = val:tolua()
+
+      len, val = pm3:read()
+      res.m3[i] = (tonumber(len) > 0) and val:tolua() or false
+   end
+
+   ubx.node_rm(ni)
+   ni = nil
+   return res
+end
+
+-- fused and elided systems must compute exactly the same results
+function TestFused:TestIdentical()
+   local ref = run({})
+
+   for _,opts in ipairs{ { fuse = true }, { elide = true }, { fuse = true, elide = true } } do
+      local res = run(opts)
+
+      for i=1,NUM_STEPS do
+	 lu.assert_equals(res.sat[i], ref.sat[i])
+	 lu.assert_equals(res.m3[i], ref.m3[i])
+      end
+   end
+end
+
+os.exit( lu.LuaUnit.run() )
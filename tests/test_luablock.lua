@@ -0,0 +1,133 @@
+--
+-- Test the luablock GC policies and hook references
+--
+
+local lu = require("luaunit")
+local ubx = require("ubx")
+local ffi = require("ffi")
+
+local assert_equals = lu.assert_equals
+local assert_true = lu.assert_true
+
+local NUM_STEPS = 50
+
+local nd = ubx.node_create("test_luablock", { loglevel = ffi.C.UBX_LOGLEVEL_WARN })
+
+ubx.load_module(nd, "stdtypes")
+ubx.load_module(nd, "luablock")
+ubx.load_module(nd, "lfds_cyclic")
+
+-- each step produces about 64 KiB of garbage
+local garbage_str = [[
+function step(b)
+   for i=1,1000 do garbage = { i } end
+end
+]]
+
+local lb, p_exec_str, p_lua_mem, p_gc_dur
+
+local function create(conf)
+   lb = ubx.block_create(nd, "ubx/luablock", "lb1", conf)
+   p_exec_str = ubx.port_clone_conn(lb, "exec_str", 1, 1, nil, 1)
+   p_lua_mem = ubx.port_clone_conn(lb, "lua_mem", nil, 1, 7, 0)
+   p_gc_dur = ubx.port_clone_conn(lb, "gc_dur", nil, 1, 7, 0)
+end
+
+-- step and return the lua_mem and gc_dur (or nil) values
+local function step()
+   ubx.cblock_step(lb)
+   local len, mem = ubx.port_read(p_lua_mem)
+   assert_equals(len, 1)
+   local dlen, dur = ubx.port_read(p_gc_dur)
+   return ubx.data_tolua(mem), dlen > 0 and ubx.data_tolua(dur) or nil
+end
+
+local function exec_str(str)
+   local d = ubx.data_alloc(nd, "char")
+   ubx.data_set(d, str, true)
+   ubx.port_write(p_exec_str, d)
+   ubx.cblock_step(lb)
+   local len, res = ubx.port_read(p_exec_str, ubx.data_alloc(nd, "int"))
+   if len <= 0 then error("no response from exec_str") end
+   return ubx.data_tolua(res)
+end
+
+TestLuablock = {}
+
+function TestLuablock:teardown()
+   ubx.node_clear(nd)
+end
+
+function TestLuablock:TestInvalidGCMode()
+   create({ lua_str = garbage_str, gc_mode = 3 })
+   lu.assert_not_equals(ubx.block_init(lb), 0)
+end
+
+-- the default incremental GC keeps the heap bounded
+function TestLuablock:TestGCAuto()
+   create({ lua_str = garbage_str })
+   assert_equals(ubx.block_tostate(lb, 'active'), 0)
+
+   local mem_max = 0
+   for _=1,NUM_STEPS do
+      local mem, dur = step()
+      assert_equals(dur, nil)
+      mem_max = math.max(mem_max, mem)
+   end
+   assert_true(mem_max < NUM_STEPS * 64 * 1024 / 2)
+end
+
+-- the GC is stopped between steps and stepped after each step hook
+function TestLuablock:TestGCStep()
+   create({ lua_str = garbage_str, gc_mode = 1, gc_step_size = 1024 })
+   assert_equals(ubx.block_tostate(lb, 'active'), 0)
+
+   for _=1,NUM_STEPS do
+      local _, dur = step()
+      lu.assert_not_nil(dur)
+   end
+end
+
+-- the GC is stopped while active and collects on stop
+function TestLuablock:TestGCManual()
+   create({ lua_str = garbage_str, gc_mode = 2 })
+   assert_equals(ubx.block_tostate(lb, 'active'), 0)
+
+   local mem_prev = step()
+   for _=2,NUM_STEPS do
+      local mem, dur = step()
+      assert_equals(dur, nil)
+      assert_true(mem > mem_prev)
+      mem_prev = mem
+   end
+
+   assert_equals(ubx.block_stop(lb), 0)
+   assert_equals(ubx.block_start(lb), 0)
+   assert_true(step() < mem_prev)
+end
+
+-- the hooks are called via registry refs and hence survive a GC
+-- even if no longer referenced from Lua
+function TestLuablock:TestHookRefsGC()
+   create({ lua_str = [[
+cnt = 0
+local function step_fun(b)
+   cnt = cnt + 1
+   collectgarbage("collect")
+end
+step = step_fun
+function start(b) step = nil; collectgarbage("collect"); return true end
+]] })
+   assert_equals(ubx.block_tostate(lb, 'active'), 0)
+
+   for _=1,NUM_STEPS do step() end
+
+   -- exec_str resolves the hooks again, hence step is no longer called
+   assert_equals(exec_str("assert(cnt == "..NUM_STEPS..")"), 0)
+   step()
+   assert_equals(exec_str("assert(cnt == "..NUM_STEPS..")"), 0)
+end
+
+local ret = lu.LuaUnit.run()
+ubx.node_rm(nd)
+os.exit(ret)
@@ -0,0 +1,136 @@
+local lu = require("luaunit")
+local ubx = require("ubx")
+local bd = require("blockdiagram")
+local ffi = require("ffi")
+
+local LOGLEVEL = ffi.C.UBX_LOGLEVEL_INFO
+local CHECK_VERBOSE = false
+local DATA_LEN = 1027	-- not a multiple of the vector length
+local MAX_ULP = 2
+
+-- functions with vectorized kernels
+local FUNCS = {
+   "sin", "cos", "exp", "log", "sqrt", "fabs",
+   "floor", "ceil", "trunc", "round", "rint", "nearbyint"
+}
+
+ffi.cdef [[
+double sin(double); double cos(double); double exp(double);
+double log(double); double sqrt(double); double fabs(double);
+double floor(double); double ceil(double); double trunc(double);
+double round(double); double rint(double); double nearbyint(double);
+]]
+
+local dbl_bits = ffi.new("union { double d; int64_t i; }")
+
+local function ordered(x)
+   dbl_bits.d = x
+   local i = dbl_bits.i
+   if i < 0 then i = -9223372036854775807LL - 1 - i end
+   return i
+end
+
+-- distance in ulp, NaNs are equal
+local function ulp_diff(a, b)
+   if a ~= a and b ~= b then return 0 end
+   if a == b then return 0 end
+   if a ~= a or b ~= b then return math.huge end
+   local d = ordered(a) - ordered(b)
+   return tonumber(d < 0 and -d or d)
+end
+
+local function inputs(func)
+   local x = { 0, -0.0, 1/0, -1/0, 0/0, 0.5, -0.5, 1.5, -2.5, 1e-310, 2^52 + 0.5,
+	       2^53, -1e9, 709.8, -745.2, math.pi, -math.pi / 2, 1e300 }
+   math.randomseed(42)
+   for i=#x+1,DATA_LEN do
+      local r = (math.random() - 0.5) * 2 ^ math.random(-20, 20)
+      if func == "log" then r = math.abs(r) end
+      x[i] = r
+   end
+   return x
+end
+
+local ni
+
+TestMathDouble = {}
+
+function TestMathDouble:teardown()
+   if ni then ubx.node_rm(ni) end
+   ni = nil
+end
+
+local function launch(config)
+   local sys = bd.system {
+      imports = { "stdtypes", "lfds_cyclic", "math_double" },
+      blocks = { { name = "math1", type = "ubx/math_double" } },
+      configurations = { { name = "math1", config = config } },
+   }
+
+   lu.assert_equals(sys:validate(CHECK_VERBOSE), 0)
+   ni = sys:launch({ nodename = "TestMath", loglevel=LOGLEVEL })
+
+   local math1 = ni:b("math1")
+   local pin = ubx.port_clone_conn(math1, "x", 1, nil, 7, 0)
+   local pout = ubx.port_clone_conn(math1, "y", nil, 1, 7, 0)
+
+   return function(x)
+      pin:write(x)
+      math1:do_step()
+      local len, val = pout:read()
+      lu.assert_equals(tonumber(len), #x)
+      return val:tolua()
+   end
+end
+
+-- compare all kernels against libm
+function TestMathDouble:TestAccuracy()
+   for _,func in ipairs(FUNCS) do
+      local x = inputs(func)
+      local compute = launch({ func = func, data_len = DATA_LEN })
+      local y = compute(x)
+
+      for i=1,DATA_LEN do
+	 local ref = ffi.C[func](x[i])
+	 local d = ulp_diff(y[i], ref)
+	 -- near the roots of sin and cos the relative error grows
+	 if d > MAX_ULP and math.abs(y[i] - ref) > 2^-52 then
+	    lu.fail(string.format("%s(%.17g): got %.17g, expected %.17g (%g ulp)",
+				  func, x[i], y[i], ref, d))
+	 end
+      end
+
+      ubx.node_rm(ni)
+      ni = nil
+   end
+end
+
+-- the scalar path must be identical to libm
+function TestMathDouble:TestNoSimd()
+   local x = inputs("exp")
+   local compute = launch({ func = "exp", data_len = DATA_LEN, simd = 0 })
+   local y = compute(x)
+
+   for i=1,DATA_LEN do
+      lu.assert_equals(ulp_diff(y[i], ffi.C.exp(x[i])), 0)
+   end
+end
+
+function TestMathDouble:TestMulAdd()
+   local x, mul, add = {}, {}, {}
+   for i=1,7 do x[i] = i * 0.25; mul[i] = i; add[i] = -i end
+
+   for _,simd in ipairs{ 0, 1 } do
+      local compute = launch({ func = "sqrt", data_len = #x, mul = mul, add = add, simd = simd })
+      local y = compute(x)
+
+      for i=1,#x do
+	 lu.assert_almost_equals(y[i], math.sqrt(x[i]) * mul[i] + add[i], 1e-15)
+      end
+
+      ubx.node_rm(ni)
+      ni = nil
+   end
+end
+
+os.exit( lu.LuaUnit.run() )
@@ -0,0 +1,135 @@
+local lu = require("luaunit")
+local ubx = require("ubx")
+local bd = require("blockdiagram")
+local ffi = require("ffi")
+
+local LOGLEVEL = ffi.C.UBX_LOGLEVEL_DEBUG
+local CHECK_VERBOSE = false
+
+local ni
+
+TestPID = {}
+
+function TestPID:teardown()
+   if ni then ubx.node_rm(ni) end
+   ni = nil
+end
+
+local function step(pid, pmsr, pdes, pout, msr, des)
+   pmsr:write(msr)
+   pdes:write(des)
+   pid:do_step()
+   local len, val = pout:read()
+   lu.assert_equals(tonumber(len), 2)
+   return val:tolua()
+end
+
+function TestPID:TestLiveGains()
+   local sys = bd.system {
+      imports = { "stdtypes", "lfds_cyclic", "pid" },
+      blocks = { { name = "pid1", type = "ubx/pid" } },
+      configurations = {
+	 { name = "pid1", config = { data_len = 2, Kp = { 2, 3 } } }
+      }
+   }
+
+   lu.assert_equals(sys:validate(CHECK_VERBOSE), 0)
+   ni = sys:launch({nodename = "TestLiveGains", loglevel=LOGLEVEL })
+   lu.assert_not_nil(ni)
+
+   local pid1 = ni:b("pid1")
+   local pmsr = ubx.port_clone_conn(pid1, "msr", 1, nil, 7, 0)
+   local pdes = ubx.port_clone_conn(pid1, "des", 1, nil, 7, 0)
+   local pout = ubx.port_clone_conn(pid1, "out", nil, 1, 7, 0)
+
+   lu.assert_equals(step(pid1, pmsr, pdes, pout, {0, 0}, {1, 1}), {2, 3})
+
+   -- block is active, so this is published and picked up in step
+   local c = ubx.ubx_config_get(pid1, "Kp")
+   lu.assert_true(ubx.config_is_live(c))
+   ubx.set_config(pid1, "Kp", { 5, 7 })
+   lu.assert_equals(tonumber(ubx.ubx_config_version(c)), 0)
+   lu.assert_equals(step(pid1, pmsr, pdes, pout, {0, 0}, {1, 1}), {5, 7})
+   lu.assert_equals(tonumber(ubx.ubx_config_version(c)), 1)
+   lu.assert_equals(ubx.data_tolua(c.value), { 5, 7 })
+
+   -- the array length can not be changed while running
+   lu.assert_error(ubx.set_config, pid1, "Kp", { 1, 2, 3 })
+   lu.assert_equals(step(pid1, pmsr, pdes, pout, {0, 0}, {1, 1}), {5, 7})
+
+   -- non-live configs of inactive blocks are still set in place
+   ubx.block_tostate(pid1, 'inactive')
+   lu.assert_false(ubx.config_is_live(c))
+   ubx.set_config(pid1, "Kp", { 1, 1 })
+   ubx.block_tostate(pid1, 'active')
+   lu.assert_equals(step(pid1, pmsr, pdes, pout, {0, 0}, {1, 1}), {1, 1})
+end
+
+local function launch(config)
+   local sys = bd.system {
+      imports = { "stdtypes", "lfds_cyclic", "pid" },
+      blocks = { { name = "pid1", type = "ubx/pid" } },
+      configurations = { { name = "pid1", config = config } }
+   }
+
+   lu.assert_equals(sys:validate(CHECK_VERBOSE), 0)
+   ni = sys:launch({nodename = "TestPID", loglevel=LOGLEVEL })
+
+   local pid1 = ni:b("pid1")
+   local pmsr = ubx.port_clone_conn(pid1, "msr", 1, nil, 7, 0)
+   local pdes = ubx.port_clone_conn(pid1, "des", 1, nil, 7, 0)
+   local pout = ubx.port_clone_conn(pid1, "out", nil, 1, 7, 0)
+
+   return function(msr, des)
+      pmsr:write(msr)
+      pdes:write(des)
+      pid1:do_step()
+      local len, val = pout:read()
+      lu.assert_equals(tonumber(len), #msr)
+      return val:tolua()
+   end
+end
+
+-- compare against a reference PID, with a length that is not a
+-- multiple of the vector length
+function TestPID:TestPID()
+   local data_len = 7
+   local kp, ki, kd = {}, {}, {}
+   for i=1,data_len do kp[i] = i; ki[i] = 0.5 * i; kd[i] = 0.25 * i end
+
+   local step = launch({ data_len = data_len, Kp = kp, Ki = ki, Kd = kd })
+   local integ, err_prev = {}, nil
+
+   for s=1,5 do
+      local msr, des, exp = {}, {}, {}
+      for i=1,data_len do
+	 msr[i] = i * 0.1 * s
+	 des[i] = i * 0.3
+	 local err = des[i] - msr[i]
+	 integ[i] = (integ[i] or 0) + err
+	 exp[i] = kp[i] * err + ki[i] * integ[i]
+	 if err_prev then exp[i] = exp[i] + kd[i] * (err - err_prev[i]) end
+      end
+
+      local out = step(msr, des)
+      for i=1,data_len do lu.assert_almost_equals(out[i], exp[i], 1e-12) end
+
+      err_prev = {}
+      for i=1,data_len do err_prev[i] = des[i] - msr[i] end
+   end
+end
+
+function TestPID:TestLimits()
+   local step = launch({ data_len = 2, Ki = { 1, 1 },
+			 out_min = { -1, -1 }, out_max = { 1, 1 } })
+
+   -- the integral stops at the limit
+   lu.assert_equals(step({0, 0}, {0.5, -0.5}), {0.5, -0.5})
+   lu.assert_equals(step({0, 0}, {0.5, -0.5}), {1, -1})
+   for _=1,10 do lu.assert_equals(step({0, 0}, {0.5, -0.5}), {1, -1}) end
+
+   -- so it recovers immediately on a sign change
+   lu.assert_equals(step({0, 0}, {-0.25, 0.25}), {0.75, -0.75})
+end
+
+os.exit( lu.LuaUnit.run() )
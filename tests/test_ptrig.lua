@@ -78,6 +78,103 @@ function TestPtrig:TestCountNumTrigs()
    ubx.node_rm(nd)
 end
 
+local SPIN_NS = 200000
+
+local sys_spin = bd.system {
+   imports = { "stdtypes", "ptrig", "ramp_uint64", "lfds_cyclic", "luablock" },
+   blocks = {
+      { name="ramp", type="ubx/ramp_uint64" },
+      { name="tester", type="ubx/luablock" },
+      { name="trig", type="ubx/ptrig" },
+   },
+   connections = {
+      { src="ramp.out", tgt="tester.ramp_cnt" },
+   },
+
+   configurations = {
+      { name="ramp", config = { start=0, slope=1 } },
+      { name="tester", config = { lua_str=count_num_trigs } },
+      { name="trig", config = { period = {sec=0, usec=1000 },
+				spin_ns=SPIN_NS,
+				spin_autotune=1,
+				jitter_stats=1,
+				chain0={
+				   { b="#ramp" },
+				   { b="#tester" } } } },
+   },
+}
+
+function TestPtrig:TestSpin()
+   local nd = sys_spin:launch{ nostart=true, loglevel=LOGLEVEL, nodename='sys_spin' }
+   local p_result = ubx.port_clone_conn(nd:b("tester"), "test_result")
+   local p_jitter = ubx.port_clone_conn(nd:b("trig"), "jitter", 2)
+   local trig = nd:b("trig")
+
+   local function read_jitter()
+      local cnt, res = p_jitter:read()
+      assert_equals(cnt, 1)
+      res = res:tolua()
+      assert_true(res.cnt > 0)
+      assert_true(res.lat_min <= res.lat_avg and res.lat_avg <= res.lat_max)
+      assert_true(res.jit_min <= res.jit_avg and res.jit_avg <= res.jit_max)
+      assert_true(res.spin_avg > 0)
+      return res
+   end
+
+   -- more than one tuning round (1024 cycles) at 1 kHz
+   sys_spin:startup(nd)
+   ubx.clock_mono_sleep(1, 500*1000^2)
+   trig:do_stop()
+   local _, res = p_result:read()
+   assert_equals(res:tolua(), 999)
+
+   local jit = read_jitter()
+   assert_true(jit.cnt >= 1024)
+   assert_true(jit.window ~= SPIN_NS, "spin window not autotuned")
+   assert_true(jit.window >= 3000 and jit.window <= 500000,
+	       "autotuned window "..tostring(jit.window).." out of range")
+
+   -- the configured window is restored on start
+   assert_equals(ubx.block_start(trig), 0)
+   ubx.clock_mono_sleep(0, 300*1000^2)
+   trig:do_stop()
+
+   jit = read_jitter()
+   assert_true(jit.cnt < 1024)
+   assert_equals(jit.window, SPIN_NS)
+
+   ubx.node_rm(nd)
+end
+
+
+--- invalid SCHED_DEADLINE configurations are rejected in init,
+--- i.e. before the thread is created
+function TestPtrig:TestDeadlineConfig()
+   local nd = ubx.node_create("TestDeadlineConfig", { loglevel=ffi.C.UBX_LOGLEVEL_CRIT })
+   ubx.load_module(nd, "stdtypes")
+   ubx.load_module(nd, "ptrig")
+
+   local period = { sec=0, usec=1000 }
+   local invalid = {
+      runtime_gt_deadline = { period=period, sched_runtime_ns=600000, sched_deadline_ns=500000 },
+      deadline_gt_period = { period=period, sched_runtime_ns=100000, sched_deadline_ns=2000000 },
+      runtime_gt_period = { sched_period_ns=500000, sched_runtime_ns=600000 },
+      no_runtime = { period=period },
+      no_period = { sched_runtime_ns=100000 },
+      priority = { period=period, sched_runtime_ns=100000, sched_priority=10 },
+      spin = { period=period, sched_runtime_ns=100000, spin_ns=1000 },
+      affinity = { period=period, sched_runtime_ns=100000, affinity={ 0 } },
+   }
+
+   for name, conf in pairs(invalid) do
+      conf.sched_policy = "SCHED_DEADLINE"
+      local b = ubx.block_create(nd, "ubx/ptrig", name, conf)
+      luaunit.assert_not_equals(ubx.block_init(b), 0, name)
+      assert_equals(b.block_state, ffi.C.BLOCK_STATE_PREINIT)
+   end
+
+   ubx.node_rm(nd)
+end
 
 ---
 --- timing statistics test
@@ -142,6 +239,10 @@ function TestPtrig:TestTstats()
 		  res.id..
 		     ": tstat.max ("..max_us..") larger than allowed max dur ("..
 		     block_dur_us[res.id]*(1+eps)..")")
+      -- page faults are only sampled with tstats_faults
+      assert_equals(res.minflt, 0)
+      assert_equals(res.majflt, 0)
+      assert_equals(res.overruns, 0)
    end
 
    local nd = sys2:launch{ nostart=true, loglevel=LOGLEVEL, nodename='sys2' }
@@ -161,6 +262,71 @@ function TestPtrig:TestTstats()
 end
 
 
+---
+--- page fault statistics test
+---
+
+-- touches 1 MiB of fresh (mmapped) memory per step
+local touch_block = [[
+local ffi = require("ffi")
+
+function step(b)
+   local buf = ffi.new("uint8_t[?]", 1024 * 1024)
+   buf[0] = 1
+   buf = nil
+   collectgarbage()
+end
+]]
+
+local sys_faults = bd.system {
+   imports = { "stdtypes", "ptrig", "lfds_cyclic", "luablock", "cconst" },
+   blocks = {
+      { name="touch", type="ubx/luablock" },
+      { name="const", type="ubx/cconst" },
+      { name="trig", type="ubx/ptrig" },
+   },
+   configurations = {
+      { name="touch", config = { lua_str=touch_block } },
+      { name="const", config = { type_name="int", value=1 } },
+      { name="trig", config = { period = {sec=0, usec=10000 },
+				tstats_mode=2,
+				tstats_faults=1,
+				prefault_stack=1,
+				chain0={
+				   { b="#touch" },
+				   { b="#const" } } } },
+   },
+}
+
+function TestPtrig:TestTstatsFaults()
+   local nd = sys_faults:launch{ nostart=true, loglevel=LOGLEVEL, nodename='sys_faults' }
+   local p_tstats = ubx.port_clone_conn(nd:b("trig"), "tstats", 4)
+   local res = {}
+
+   sys_faults:startup(nd)
+   ubx.clock_mono_sleep(1)
+   nd:b("trig"):do_stop()
+
+   while true do
+      local cnt, ts = p_tstats:read()
+      if cnt <= 0 then break end
+      ts = ts:tolua()
+      res[ts.id] = ts
+   end
+
+   local touch, total = res['chain0,touch'], res['chain0,#total#']
+
+   assert_true(touch.cnt > 0)
+   assert_true(touch.minflt >= touch.cnt,
+	       "expected at least one minor fault per step, got "..
+		  tostring(touch.minflt).." in "..tostring(touch.cnt).." steps")
+   assert_true(total.minflt >= touch.minflt)
+   assert_equals(total.majflt, 0)
+
+   ubx.node_rm(nd)
+end
+
+
 --
 -- trig multichain
 --
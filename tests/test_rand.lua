@@ -0,0 +1,106 @@
+local lu = require("luaunit")
+local ubx = require("ubx")
+local bd = require("blockdiagram")
+local ffi = require("ffi")
+
+local LOGLEVEL = ffi.C.UBX_LOGLEVEL_INFO
+local CHECK_VERBOSE = false
+
+local ni
+
+TestRand = {}
+
+function TestRand:teardown()
+   if ni then ubx.node_rm(ni) end
+   ni = nil
+end
+
+-- launch rand blocks of type t with the given configs and return a
+-- function that steps all and returns their outputs
+local function launch(t, configs)
+   local blocks, configurations = {}, {}
+
+   for i,c in ipairs(configs) do
+      blocks[i] = { name = "rand"..i, type = "ubx/rand_"..t }
+      configurations[i] = { name = "rand"..i, config = c }
+   end
+
+   local sys = bd.system {
+      imports = { "stdtypes", "lfds_cyclic", "rand_"..t },
+      blocks = blocks,
+      configurations = configurations,
+   }
+
+   lu.assert_equals(sys:validate(CHECK_VERBOSE), 0)
+   ni = sys:launch({ nodename = "TestRand", loglevel=LOGLEVEL })
+
+   local ports = {}
+   for i=1,#configs do
+      ports[i] = ubx.port_clone_conn(ni:b("rand"..i), "out", nil, 1, 7, 0)
+   end
+
+   return function()
+      local res = {}
+      for i=1,#configs do
+	 ni:b("rand"..i):do_step()
+	 local len, val = ports[i]:read()
+	 lu.assert_equals(tonumber(len), configs[i].data_len or 1)
+	 res[i] = val:tolua()
+      end
+      return res
+   end
+end
+
+-- blocks are independent and reproducible per seed
+function TestRand:TestSeed()
+   local step = launch("double", {
+			  { seed = 1, data_len = 13 },
+			  { seed = 1, data_len = 13 },
+			  { seed = 2, data_len = 13 } })
+
+   for _=1,3 do
+      local res = step()
+      lu.assert_equals(res[1], res[2])
+      lu.assert_not_equals(res[1], res[3])
+   end
+end
+
+function TestRand:TestUniform()
+   local n = 4096
+   local res = launch("double", { { data_len = n } })()[1]
+   local sum = 0
+
+   for i=1,n do
+      lu.assert_true(res[i] >= 0 and res[i] < 1)
+      sum = sum + res[i]
+   end
+
+   lu.assert_almost_equals(sum / n, 0.5, 0.05)
+end
+
+function TestRand:TestNormal()
+   local n = 4095
+   local res = launch("float", { { data_len = n, dist = "normal", mean = 3, stddev = 2 } })()[1]
+   local sum, sqsum = 0, 0
+
+   for i=1,n do sum = sum + res[i] end
+   local mean = sum / n
+
+   for i=1,n do sqsum = sqsum + (res[i] - mean)^2 end
+
+   lu.assert_almost_equals(mean, 3, 0.2)
+   lu.assert_almost_equals(math.sqrt(sqsum / (n - 1)), 2, 0.2)
+end
+
+function TestRand:TestInt()
+   local res = launch("int32", { { data_len = 100 } })()[1]
+   local neg = 0
+
+   for i=1,#res do
+      if res[i] < 0 then neg = neg + 1 end
+   end
+
+   lu.assert_true(neg > 0 and neg < #res)
+end
+
+os.exit( lu.LuaUnit.run() )
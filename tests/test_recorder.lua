@@ -0,0 +1,151 @@
+local lu = require("luaunit")
+local ubx = require("ubx")
+local u = require("utils")
+local bd = require("blockdiagram")
+local ffi = require("ffi")
+
+local LOGLEVEL = ffi.C.UBX_LOGLEVEL_INFO
+local CHECK_VERBOSE = false
+local DATA_LEN = 3
+local REC_PATH = "/tmp/ubx_test_recorder"
+
+local ni
+
+TestRecorder = {}
+
+function TestRecorder:teardown()
+   if ni then ubx.node_rm(ni) end
+   ni = nil
+   for i=0,3 do os.remove(string.format("%s.%04d", REC_PATH, i)) end
+end
+
+local function record_sys(num_segments)
+   return bd.system {
+      imports = { "stdtypes", "lfds_cyclic", "saturation_double", "recorder" },
+      blocks = {
+	 { name = "sat1", type = "ubx/saturation_double" },
+	 { name = "rec", type = "ubx/recorder" },
+      },
+      configurations = {
+	 { name = "sat1", config = {
+	      data_len = DATA_LEN,
+	      lower_limits = u.fill(-10, DATA_LEN),
+	      upper_limits = u.fill(10, DATA_LEN) } },
+	 { name = "rec", config = {
+	      path = REC_PATH, type_name = "double", data_len = DATA_LEN,
+	      segment_size = 4096, num_segments = num_segments } },
+      },
+      connections = {
+	 { src="sat1.out", tgt="rec" },
+      },
+   }
+end
+
+local function step_sat(nd, data, first, last)
+   local sat1 = nd:b("sat1")
+   local pin = ubx.port_clone_conn(sat1, "in", DATA_LEN, nil, 7, 0)
+
+   for i=first,last do
+      pin:write(data[i])
+      sat1:do_step()
+   end
+end
+
+-- record the output of a saturation block
+local function record(in_data, num_segments)
+   local sys = record_sys(num_segments)
+
+   lu.assert_equals(sys:validate(CHECK_VERBOSE), 0)
+   local nd = sys:launch({ nodename = "Record", loglevel=LOGLEVEL })
+   step_sat(nd, in_data, 1, #in_data)
+
+   local overruns = tonumber(nd:b("rec").stat_num_overruns)
+   ubx.node_rm(nd)
+   return overruns
+end
+
+local function replay_sys(speed)
+   return bd.system {
+      imports = { "stdtypes", "lfds_cyclic", "recorder" },
+      blocks = { { name = "rep", type = "ubx/replay" } },
+      configurations = {
+	 { name = "rep", config = { path = REC_PATH, speed = speed } },
+      },
+   }
+end
+
+function TestRecorder:TestRecordReplay()
+   local in_data = {}
+   for i=1,100 do in_data[i] = { i, -i, i * 0.5 } end
+
+   lu.assert_equals(record(in_data, 4), 0)
+
+   ni = replay_sys(0):launch({ nodename = "Replay", loglevel=LOGLEVEL })
+   local rep = ni:b("rep")
+   local pout = ubx.port_clone_conn(rep, "out", nil, DATA_LEN, 7, 0)
+
+   -- speed 0: one sample per step
+   for i=1,#in_data do
+      rep:do_step()
+      local len, val = pout:read()
+      lu.assert_equals(tonumber(len), DATA_LEN)
+      lu.assert_equals(val:tolua(), { math.min(i, 10), math.max(-i, -10), math.min(i * 0.5, 10) })
+   end
+
+   -- end of recording
+   rep:do_step()
+   lu.assert_equals(tonumber(pout:read()), 0)
+end
+
+-- stopping and starting the recorder continues the recording
+function TestRecorder:TestRestart()
+   local in_data = {}
+   for i=1,100 do in_data[i] = { i, i, i } end
+
+   local nd = record_sys(4):launch({ nodename = "Record", loglevel=LOGLEVEL })
+   local rec = nd:b("rec")
+
+   step_sat(nd, in_data, 1, 50)
+   lu.assert_equals(ubx.block_stop(rec), 0)
+   lu.assert_equals(ubx.block_start(rec), 0)
+   step_sat(nd, in_data, 51, #in_data)
+   ubx.node_rm(nd)
+
+   ni = replay_sys(0):launch({ nodename = "Replay", loglevel=LOGLEVEL })
+   local rep = ni:b("rep")
+   local pout = ubx.port_clone_conn(rep, "out", nil, DATA_LEN, 7, 0)
+
+   for i=1,#in_data do
+      rep:do_step()
+      local len, val = pout:read()
+      lu.assert_equals(tonumber(len), DATA_LEN)
+      lu.assert_equals(val:tolua()[1], math.min(i, 10))
+   end
+
+   rep:do_step()
+   lu.assert_equals(tonumber(pout:read()), 0)
+end
+
+function TestRecorder:TestOverrun()
+   local in_data = {}
+   for i=1,1000 do in_data[i] = { i, i, i } end
+
+   -- a single 4k segment holds less than 1000 samples
+   local overruns = record(in_data, 1)
+   lu.assert_true(overruns > 0)
+
+   ni = replay_sys(0):launch({ nodename = "Replay", loglevel=LOGLEVEL })
+   local rep = ni:b("rep")
+   local pout = ubx.port_clone_conn(rep, "out", nil, DATA_LEN, 7, 0)
+
+   local cnt = 0
+   while true do
+      rep:do_step()
+      if tonumber(pout:read()) == 0 then break end
+      cnt = cnt + 1
+   end
+
+   lu.assert_equals(cnt + overruns, #in_data)
+end
+
+os.exit( lu.LuaUnit.run() )
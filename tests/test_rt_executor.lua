@@ -0,0 +1,155 @@
+local lu = require("luaunit")
+local ubx = require("ubx")
+local bd = require("blockdiagram")
+local ffi = require("ffi")
+
+local LOGLEVEL = ffi.C.UBX_LOGLEVEL_INFO
+local RUN_S = 1
+local PERIODS_MS = { 2, 5, 10 }
+
+local function make_sys(num_threads, shared)
+   return bd.system {
+      imports = { "stdtypes", "lfds_cyclic", "rt_executor", "cconst" },
+      blocks = {
+	 { name = "c0", type = "ubx/cconst" },
+	 { name = "c1", type = "ubx/cconst" },
+	 { name = "c2", type = "ubx/cconst" },
+	 { name = "rtx", type = "ubx/rt_executor" },
+      },
+      configurations = {
+	 { name = "c0", config = { type_name = "int", value = 0 } },
+	 { name = "c1", config = { type_name = "int", value = 1 } },
+	 { name = "c2", config = { type_name = "int", value = 2 } },
+	 { name = "rtx", config = {
+	      num_chains = 3,
+	      num_threads = num_threads,
+	      period_ns = { PERIODS_MS[1] * 1e6, PERIODS_MS[2] * 1e6, PERIODS_MS[3] * 1e6 },
+	      phase_ns = { 0, 1e6, 2e6 },
+	      priority = { 0, 1, 2 },
+	      chain0 = { { b = "#c0" } },
+	      chain1 = { { b = "#c1" } },
+	      chain2 = { { b = shared and "#c0" or "#c2" } } } },
+      },
+   }
+end
+
+local ni
+
+TestRtExecutor = {}
+
+function TestRtExecutor:teardown()
+   if ni then ubx.node_rm(ni) end
+   ni = nil
+end
+
+-- each chain must be released once per period
+function TestRtExecutor:TestReleases()
+   for _,num_threads in ipairs{ 1, 2 } do
+      local sys = make_sys(num_threads)
+      ni = sys:launch{ nostart = true, loglevel = LOGLEVEL,
+		       nodename = "TestRtExecutor"..num_threads }
+
+      local p_stats = ubx.port_clone_conn(ni:b("rtx"), "chain_stats", 8)
+
+      sys:startup(ni)
+      ubx.clock_mono_sleep(RUN_S)
+      ni:b("rtx"):do_stop()
+
+      for i=1,#PERIODS_MS do
+	 local cnt, res = p_stats:read()
+	 lu.assert_true(cnt > 0)
+	 local s = res:tolua()
+	 local expected = RUN_S * 1000 / PERIODS_MS[i]
+
+	 lu.assert_equals(s.id, "chain"..(i-1))
+	 lu.assert_true(math.abs(tonumber(s.releases) - expected) <= expected * 0.1,
+			s.id..": "..tonumber(s.releases).." releases, expected "..expected)
+	 lu.assert_true(s.utilization >= 0 and s.utilization < 1)
+      end
+
+      ubx.node_rm(ni)
+      ni = nil
+   end
+end
+
+-- cleanup must free all private allocations, i.e. removing the block
+-- must not warn about leftovers
+function TestRtExecutor:TestCleanupFrees()
+   local warnings = {}
+   ni = make_sys(2):launch{ loglevel = LOGLEVEL, nodename = "TestRtExecutorCleanup" }
+   ubx.clock_mono_sleep(0, 100 * 1000^2)
+
+   local rtx = ni:b("rtx")
+   lu.assert_equals(ubx.block_tostate(rtx, 'preinit'), 0)
+
+   local log_orig = ni.log
+   local log = ffi.cast("void (*)(const struct ubx_node*, const struct ubx_log_msg*)",
+			function(_, msg)
+			   local s = ffi.string(msg.msg)
+			   if s:find("private data", 1, true) then warnings[#warnings+1] = s end
+			end)
+   ni.log = log
+   local ret = ubx.block_rm(ni, "rtx")
+   ni.log = log_orig
+   log:free()
+
+   lu.assert_equals(ret, 0)
+   lu.assert_equals(warnings, {})
+end
+
+-- a block in two chains could be stepped concurrently by two workers
+function TestRtExecutor:TestSharedBlock()
+   ni = make_sys(2, true):launch{ nostart = true, loglevel = LOGLEVEL,
+				  nodename = "TestRtExecutorShared" }
+
+   lu.assert_not_equals(ni:b("rtx"):do_start(), 0)
+end
+
+-- a block triggered by a nested trigger of another chain is shared too
+function TestRtExecutor:TestSharedNestedBlock()
+   local sys = bd.system {
+      imports = { "stdtypes", "lfds_cyclic", "rt_executor", "trig", "cconst" },
+      blocks = {
+	 { name = "c0", type = "ubx/cconst" },
+	 { name = "t", type = "ubx/trig" },
+	 { name = "rtx", type = "ubx/rt_executor" },
+      },
+      configurations = {
+	 { name = "c0", config = { type_name = "int", value = 0 } },
+	 { name = "t", config = { chain0 = { { b = "#c0" } } } },
+	 { name = "rtx", config = {
+	      num_chains = 2,
+	      num_threads = 2,
+	      period_ns = { 1e6, 2e6 },
+	      chain0 = { { b = "#c0" } },
+	      chain1 = { { b = "#t" } } } },
+      },
+   }
+
+   ni = sys:launch{ nostart = true, loglevel = LOGLEVEL,
+		    nodename = "TestRtExecutorSharedNested" }
+
+   lu.assert_not_equals(ni:b("rtx"):do_start(), 0)
+end
+
+-- chains of a multi-threaded rt_executor must not share a trigger root
+function TestRtExecutor:TestTriggerRoots()
+   for _,num_threads in ipairs{ 1, 2 } do
+      ni = make_sys(num_threads):launch{ nostart = true, loglevel = LOGLEVEL,
+					 nodename = "TestRtExecutorRoots"..num_threads }
+      local roots = ubx.trigger_roots(ni)
+
+      if num_threads == 1 then
+	 lu.assert_equals(roots["c0"], "rtx")
+	 lu.assert_equals(roots["c1"], "rtx")
+      else
+	 lu.assert_equals(roots["c0"], "rtx.chain0")
+	 lu.assert_equals(roots["c1"], "rtx.chain1")
+      end
+
+      ubx.node_rm(ni)
+      ni = nil
+   end
+end
+
+os.exit( lu.LuaUnit.run() )
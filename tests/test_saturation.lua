@@ -115,4 +115,57 @@ function TestSaturation:TestLen5()
    end
 end
 
+-- all types, with a length that is not a multiple of the vector
+-- length. Every fourth element (incl. the last, which is always in
+-- the scalar tail) has lower > upper limits, for which the lower
+-- limit wins both in the vector lanes and in the tail.
+function TestSaturation:TestTypes()
+   local data_len = 37
+
+   for _,t in ipairs{ "float", "double", "int32", "int64" } do
+      local lower, upper, in_data, exp_data = {}, {}, {}, {}
+
+      for i=1,data_len do
+	 if i % 4 == 1 then
+	    lower[i] = i * 2
+	    upper[i] = -i
+	 else
+	    lower[i] = -i
+	    upper[i] = i * 2
+	 end
+	 in_data[i] = (i % 2 == 0) and i * 3 or -i * 3
+	 exp_data[i] = math.max(lower[i], math.min(upper[i], in_data[i]))
+      end
+
+      local sys = bd.system {
+	 imports = { "stdtypes", "lfds_cyclic", "saturation_"..t },
+	 blocks = { { name = "sat1", type = "ubx/saturation_"..t } },
+	 configurations = {
+	    { name = "sat1", config = {
+		 data_len = data_len, lower_limits = lower, upper_limits = upper } }
+	 }
+      }
+
+      lu.assert_equals(sys:validate(CHECK_VERBOSE), 0)
+      ni = sys:launch({nodename = "TestTypes", loglevel=LOGLEVEL })
+
+      local sat1 = ni:b("sat1")
+      local pin = ubx.port_clone_conn(sat1, "in", 1, nil, 7, 0)
+      local pout = ubx.port_clone_conn(sat1, "out", nil, 1, 7, 0)
+
+      pin:write(in_data)
+      sat1:do_step()
+      local len, val = pout:read()
+      lu.assert_equals(tonumber(len), data_len)
+
+      local res = val:tolua()
+      for i=1,data_len do
+	 lu.assert_equals(tonumber(res[i]), exp_data[i], t)
+      end
+
+      ubx.node_rm(ni)
+      ni = nil
+   end
+end
+
 os.exit( lu.LuaUnit.run() )
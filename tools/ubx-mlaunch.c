@@ -0,0 +1,189 @@
+/*
+ * ubx-mlaunch: launch compiled microblx models without luajit
+ *
+ * Copyright (C) 2020 Markus Klotzbuecher <mk@mkio.de>
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * Compiled models are created with "ubx-launch -compile". Loading
+ * these requires no parsing or validation, so this tool only depends
+ * on libubx and the modules used by the model.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+
+#include "ubx.h"
+
+#ifndef UBX_MODDIR
+# define UBX_MODDIR	"/usr/local/lib/ubx/0.9"
+#endif
+
+void print_help(char **argv)
+{
+	printf("usage:\n");
+	printf(" %s [options] -c MODEL\n", argv[0]);
+	printf("   launch a compiled microblx model\n\n");
+	printf("Options:\n");
+	printf("  -c FILE   compiled model to launch (.ubxm)\n");
+	printf("  -m DIR    module directory (def: %s)\n", UBX_MODDIR);
+	printf("  -n NAME   node name (def: model file name)\n");
+	printf("  -l LEVEL  loglevel (0-7)\n");
+	printf("  -t SEC    exit after SEC seconds instead of waiting for SIGINT\n");
+	printf("  -s        only instantiate, don't start the blocks\n");
+	printf("  -M        lock all memory (mlockall)\n");
+	printf("  -q        don't print the startup statistics\n");
+	printf("  -h        show this help and exit\n");
+}
+
+/**
+ * model_map - map a compiled model file
+ *
+ * @param fn:	file name
+ * @param len:	set to the file length
+ *
+ * @return:	pointer to the mapping or NULL
+ */
+static void *model_map(const char *fn, size_t *len)
+{
+	int fd;
+	struct stat st;
+	void *buf = NULL;
+
+	fd = open(fn, O_RDONLY);
+
+	if (fd < 0) {
+		fprintf(stderr, "failed to open %s: %m\n", fn);
+		goto out;
+	}
+
+	if (fstat(fd, &st) < 0) {
+		fprintf(stderr, "failed to stat %s: %m\n", fn);
+		goto out_close;
+	}
+
+	*len = st.st_size;
+	buf = mmap(NULL, *len, PROT_READ, MAP_PRIVATE, fd, 0);
+
+	if (buf == MAP_FAILED) {
+		fprintf(stderr, "failed to map %s: %m\n", fn);
+		buf = NULL;
+	}
+
+out_close:
+	close(fd);
+out:
+	return buf;
+}
+
+int main(int argc, char **argv)
+{
+	int opt, ret = EXIT_FAILURE, nostart = 0, quiet = 0;
+	unsigned int timeout = UINT_MAX;
+	uint32_t attrs = 0;
+	const char *fn = NULL, *moddir = UBX_MODDIR, *name = NULL;
+	void *buf;
+	size_t len;
+	struct rusage ru;
+	struct ubx_timespec t0, t1, dur;
+	struct ubx_model m;
+	ubx_node_t nd;
+
+	memset(&nd, 0x0, sizeof(nd));
+
+	while ((opt = getopt(argc, argv, "c:m:n:l:t:sMqh")) != -1) {
+		switch (opt) {
+		case 'c':
+			fn = optarg;
+			break;
+		case 'm':
+			moddir = optarg;
+			break;
+		case 'n':
+			name = optarg;
+			break;
+		case 'l':
+			nd.loglevel = atoi(optarg);
+			break;
+		case 't':
+			timeout = atoi(optarg);
+			break;
+		case 's':
+			nostart = 1;
+			break;
+		case 'M':
+			attrs |= ND_MLOCK_ALL;
+			break;
+		case 'q':
+			quiet = 1;
+			break;
+		case 'h':
+		default: /* '?' */
+			print_help(argv);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	if (fn == NULL) {
+		print_help(argv);
+		exit(EXIT_FAILURE);
+	}
+
+	ubx_clock_mono_gettime(&t0);
+
+	buf = model_map(fn, &len);
+
+	if (buf == NULL)
+		goto out;
+
+	if (ubx_model_open(&m, buf, len) != 0) {
+		fprintf(stderr, "%s: invalid or incompatible model\n", fn);
+		goto out_unmap;
+	}
+
+	if (ubx_node_init(&nd, name ? name : fn, attrs) != 0) {
+		fprintf(stderr, "failed to initialize node\n");
+		goto out_unmap;
+	}
+
+	if (ubx_model_load_modules(&nd, &m, moddir) != 0 ||
+	    ubx_model_instantiate(&nd, &m) != 0) {
+		fprintf(stderr, "%s: failed to instantiate model\n", fn);
+		goto out_rm;
+	}
+
+	/* the model is no longer needed */
+	munmap(buf, len);
+	buf = NULL;
+
+	if (!nostart && ubx_model_start(&m) != 0) {
+		fprintf(stderr, "%s: failed to start model\n", fn);
+		goto out_rm;
+	}
+
+	ubx_clock_mono_gettime(&t1);
+
+	if (!quiet) {
+		ubx_ts_sub(&t1, &t0, &dur);
+		getrusage(RUSAGE_SELF, &ru);
+		printf("%s: %d blocks %s in %.3f ms, maxrss: %ld kB\n", fn,
+		       ubx_num_blocks(&nd), nostart ? "instantiated" : "started",
+		       ubx_ts_to_double(&dur) * 1000, ru.ru_maxrss);
+	}
+
+	ubx_wait_sigint(timeout);
+	ret = EXIT_SUCCESS;
+
+out_rm:
+	ubx_node_rm(&nd);
+	ubx_model_close(&m);
+out_unmap:
+	if (buf != NULL)
+		munmap(buf, len);
+out:
+	return ret;
+}